@@ -0,0 +1,382 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <chrono>
+#include <algorithm>
+
+#include <dirent.h>
+
+#include "aec_controller.h"
+#include "mapped_file.h"
+#include "wav_utils.h"
+
+// Offline processing of far/near recording pairs on all cores.
+//
+// aec_batch --manifest=list.txt | --dir=path [--out=path] [--jobs=N] [--summary=file.csv]
+//           [--ec=level] [--ns=level] [--agc=mode] [--hpf]
+//
+// manifest line: far.wav near.wav output.wav, directory mode pairs *_far.wav with *_near.wav
+
+namespace
+{
+
+const char far_suffix[] = "_far.wav";
+const char near_suffix[] = "_near.wav";
+const char out_suffix[] = "_out.wav";
+
+struct batch_job_t
+{
+    std::string     far_file;
+    std::string     near_file;
+    std::string     output_file;
+};
+
+struct batch_settings_t
+{
+    std::int32_t    ec_level;
+    std::int32_t    ns_level;
+    std::int32_t    agc_mode;
+    bool            hpf;
+};
+
+struct batch_result_t
+{
+    bool            success;
+    std::string     error;
+    std::uint64_t   frames;
+    double          audio_sec;
+    double          cpu_ms;
+    bool            erle_valid;
+    std::int32_t    erle_average;
+    std::int32_t    erl_average;
+
+    batch_result_t()
+        : success(false)
+        , frames(0)
+        , audio_sec(0.0)
+        , cpu_ms(0.0)
+        , erle_valid(false)
+        , erle_average(0)
+        , erl_average(0)
+    {}
+};
+
+double thread_cpu_ms()
+{
+    timespec ts = {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+    return static_cast<double>(ts.tv_sec) * 1000.0 + static_cast<double>(ts.tv_nsec) / 1000000.0;
+}
+
+bool ends_with(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size()
+            && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool load_manifest(const std::string& manifest_file, std::vector<batch_job_t>& jobs)
+{
+    std::ifstream manifest(manifest_file);
+
+    if (!manifest.is_open())
+    {
+        std::cerr << "Can't open manifest [" << manifest_file << "]" << std::endl;
+        return false;
+    }
+
+    std::string line;
+
+    while (std::getline(manifest, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream stream(line);
+        batch_job_t job;
+
+        if (stream >> job.far_file >> job.near_file >> job.output_file)
+        {
+            jobs.push_back(job);
+        }
+        else
+        {
+            std::cerr << "Bad manifest line: " << line << std::endl;
+        }
+    }
+
+    return true;
+}
+
+bool scan_directory(const std::string& input_dir, const std::string& output_dir, std::vector<batch_job_t>& jobs)
+{
+    auto dir = opendir(input_dir.c_str());
+
+    if (dir == nullptr)
+    {
+        std::cerr << "Can't open directory [" << input_dir << "]" << std::endl;
+        return false;
+    }
+
+    while (auto entry = readdir(dir))
+    {
+        std::string name(entry->d_name);
+
+        if (ends_with(name, far_suffix))
+        {
+            auto base = name.substr(0, name.size() - std::strlen(far_suffix));
+
+            batch_job_t job;
+            job.far_file = input_dir + "/" + name;
+            job.near_file = input_dir + "/" + base + near_suffix;
+            job.output_file = output_dir + "/" + base + out_suffix;
+
+            jobs.push_back(job);
+        }
+    }
+
+    closedir(dir);
+
+    return true;
+}
+
+void apply_settings(audio_processing::AecController& controller, const batch_settings_t& settings)
+{
+    controller.SetHighPassFilter(settings.hpf);
+    controller.SetEchoCancellation(settings.ec_level >= 0, settings.ec_level);
+    controller.SetNoiseSuppression(settings.ns_level >= 0, settings.ns_level);
+    controller.SetGainControl(settings.agc_mode >= 0, settings.agc_mode);
+    controller.SetMetrics(true, 1000);
+}
+
+batch_result_t process_job(const batch_job_t& job
+                           , const batch_settings_t& settings
+                           , std::unique_ptr<audio_processing::AecController>& controller
+                           , audio_devices::audio_format_t& controller_format)
+{
+    batch_result_t result;
+
+    audio_devices::MappedFile far_file, near_file, output_file;
+    audio_devices::audio_format_t far_format, near_format;
+    std::size_t far_offset = 0, far_size = 0, near_offset = 0, near_size = 0;
+
+    if (!far_file.Open(job.far_file)
+            || !audio_devices::wav_utils::parse_header(far_file.Data(), far_file.Size(), far_format, far_offset, far_size))
+    {
+        result.error = "bad far file";
+        return result;
+    }
+
+    if (!near_file.Open(job.near_file)
+            || !audio_devices::wav_utils::parse_header(near_file.Data(), near_file.Size(), near_format, near_offset, near_size))
+    {
+        result.error = "bad near file";
+        return result;
+    }
+
+    if (far_format.sample_rate != near_format.sample_rate
+            || far_format.format() != near_format.format()
+            || far_format.channels != near_format.channels
+            || near_format.channels != 1)
+    {
+        result.error = "far/near format mismatch or not mono";
+        return result;
+    }
+
+    far_size = (far_size == 0 || far_offset + far_size > far_file.Size()) ? far_file.Size() - far_offset : far_size;
+    near_size = (near_size == 0 || near_offset + near_size > near_file.Size()) ? near_file.Size() - near_offset : near_size;
+
+    // controller is reused while the format stays the same
+    if (controller == nullptr
+            || controller_format.sample_rate != near_format.sample_rate
+            || controller_format.format() != near_format.format())
+    {
+        controller.reset(new audio_processing::AecController(near_format.sample_rate, near_format.format(), near_format.channels));
+        controller_format = near_format;
+        apply_settings(*controller, settings);
+    }
+
+    if (!controller->Reset())
+    {
+        result.error = "controller reset failed";
+        return result;
+    }
+
+    auto step_size = near_format.octets_count(10);
+    auto frames = near_size / step_size;
+    auto output_size = frames * step_size;
+
+    if (!output_file.Create(job.output_file, audio_devices::wav_utils::wav_header_size + output_size))
+    {
+        result.error = "can't create output file";
+        return result;
+    }
+
+    audio_devices::wav_utils::make_header(near_format, static_cast<std::uint32_t>(output_size), output_file.MutableData());
+
+    std::vector<std::uint8_t> silence(step_size, 0);
+
+    auto far_ptr = far_file.Data() + far_offset;
+    auto near_ptr = near_file.Data() + near_offset;
+    auto output_ptr = output_file.MutableData() + audio_devices::wav_utils::wav_header_size;
+
+    auto cpu_start = thread_cpu_ms();
+
+    for (std::size_t f = 0; f < frames; f++)
+    {
+        auto far_frame = (f + 1) * step_size <= far_size
+                ? far_ptr + f * step_size
+                : silence.data();
+
+        controller->Playback(far_frame, step_size);
+
+        // near frame is not modified when the output is separate
+        controller->Capture(const_cast<std::uint8_t*>(near_ptr + f * step_size), step_size, output_ptr + f * step_size);
+    }
+
+    result.cpu_ms = thread_cpu_ms() - cpu_start;
+
+    // the interval sample may be up to a second old
+    controller->SampleMetrics();
+
+    result.frames = frames;
+    result.audio_sec = static_cast<double>(frames) / 100.0;
+
+    auto metrics = controller->GetMetrics();
+
+    result.erle_valid = metrics.echo_metrics_valid;
+    result.erle_average = metrics.echo_return_loss_enhancement.average;
+    result.erl_average = metrics.echo_return_loss.average;
+    result.success = true;
+
+    return result;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::map<std::string, std::string> options;
+
+    for (int a = 1; a < argc; a++)
+    {
+        std::string arg(argv[a]);
+
+        if (arg.compare(0, 2, "--") == 0)
+        {
+            auto pos = arg.find('=');
+            options[arg.substr(2, pos == std::string::npos ? pos : pos - 2)] = pos == std::string::npos ? "" : arg.substr(pos + 1);
+        }
+    }
+
+    std::vector<batch_job_t> jobs;
+
+    if (options.count("manifest") != 0)
+    {
+        load_manifest(options["manifest"], jobs);
+    }
+    else if (options.count("dir") != 0)
+    {
+        scan_directory(options["dir"], options.count("out") != 0 ? options["out"] : options["dir"], jobs);
+    }
+    else
+    {
+        std::cerr << "Usage: aec_batch --manifest=list.txt | --dir=path [--out=path] [--jobs=N] [--summary=file.csv]"
+                     " [--ec=level] [--ns=level] [--agc=mode] [--hpf]" << std::endl;
+        return 1;
+    }
+
+    batch_settings_t settings;
+    settings.ec_level = options.count("ec") != 0 ? std::atoi(options["ec"].c_str()) : 0;
+    settings.ns_level = options.count("ns") != 0 ? std::atoi(options["ns"].c_str()) : -1;
+    settings.agc_mode = options.count("agc") != 0 ? std::atoi(options["agc"].c_str()) : -1;
+    settings.hpf = options.count("hpf") != 0;
+
+    std::uint32_t worker_count = options.count("jobs") != 0
+            ? std::atoi(options["jobs"].c_str())
+            : std::thread::hardware_concurrency();
+
+    worker_count = std::max(1u, std::min<std::uint32_t>(worker_count, jobs.size()));
+
+    std::vector<batch_result_t> results(jobs.size());
+    std::atomic<std::size_t> next_job(0);
+    std::vector<std::thread> workers;
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    // whole files are distributed, each worker keeps its own controller
+    for (std::uint32_t w = 0; w < worker_count; w++)
+    {
+        workers.emplace_back([&]()
+        {
+            std::unique_ptr<audio_processing::AecController> controller;
+            audio_devices::audio_format_t controller_format;
+
+            for (auto j = next_job++; j < jobs.size(); j = next_job++)
+            {
+                results[j] = process_job(jobs[j], settings, controller, controller_format);
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    auto wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    std::ofstream summary_file;
+
+    if (options.count("summary") != 0)
+    {
+        summary_file.open(options["summary"]);
+    }
+
+    std::ostream& summary = summary_file.is_open() ? summary_file : std::cout;
+
+    summary << "output,status,audio_sec,cpu_ms,realtime_factor,erl_avg_db,erle_avg_db" << std::endl;
+
+    double total_audio_sec = 0.0;
+    std::size_t failed = 0;
+
+    for (std::size_t j = 0; j < jobs.size(); j++)
+    {
+        const auto& r = results[j];
+
+        summary << jobs[j].output_file << ","
+                << (r.success ? "ok" : r.error) << ","
+                << r.audio_sec << ","
+                << r.cpu_ms << ","
+                << (r.audio_sec > 0.0 ? r.cpu_ms / (r.audio_sec * 1000.0) : 0.0) << ",";
+
+        if (r.erle_valid)
+        {
+            summary << r.erl_average << "," << r.erle_average;
+        }
+        else
+        {
+            summary << ",";
+        }
+
+        summary << std::endl;
+
+        total_audio_sec += r.audio_sec;
+        failed += r.success ? 0 : 1;
+    }
+
+    std::cerr << "Processed " << jobs.size() - failed << "/" << jobs.size() << " files, "
+              << total_audio_sec << " s of audio in " << wall_sec << " s with "
+              << worker_count << " workers" << std::endl;
+
+    return failed == 0 ? 0 : 2;
+}
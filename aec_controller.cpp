@@ -2,9 +2,15 @@
 #include <webrtc/modules/audio_processing/include/audio_processing.h>
 
 #include "aec_controller.h"
+#include "aec_dump.h"
+#include "audio_processing_pool.h"
+#include "perf_profiler.h"
+#include "frame_pool.h"
 
 #include <vector>
 #include <limits>
+#include <cstring>
+#include <algorithm>
 
 #ifndef LOG_END
 
@@ -20,70 +26,35 @@
 namespace audio_processing
 {
 
-namespace converters
+static void deinterleave(const float* interleaved, std::uint32_t channels, std::uint32_t frames, float* const* planar)
 {
-
-template<typename Tval, Tval Tmax = std::numeric_limits<Tval>::max()>
-void pcm_to_float(const void* pcm_frame, std::size_t sample_count, float* float_frame)
-{
-
-    auto pcm_data =  static_cast<const Tval*>(pcm_frame);
-
-    for( int i = 0; i < sample_count; i++ )
-    {
-        float_frame[i] = static_cast<float>(pcm_data[i]) / static_cast<float>(Tmax);
-    }
-}
-
-void pcm_to_float(const void* pcm_frame, std::size_t sample_count, float* float_frame, std::uint32_t bit_per_sample)
-{
-    switch(bit_per_sample)
+    for (std::uint32_t c = 0; c < channels; c++)
     {
-        case 8:
-            pcm_to_float<std::int8_t>(pcm_frame, sample_count, float_frame);
-            break;
-        case 16:
-            pcm_to_float<std::int16_t>(pcm_frame, sample_count, float_frame);
-            break;
-        case 32:
-            pcm_to_float<std::int32_t>(pcm_frame, sample_count, float_frame);
-            break;
-        default:
-            throw("Error bit_per_sample parameter");
+        for (std::uint32_t i = 0; i < frames; i++)
+        {
+            planar[c][i] = interleaved[i * channels + c];
+        }
     }
 }
 
-template<typename Tval, Tval Tmax = std::numeric_limits<Tval>::max()>
-void float_to_pcm(const float* float_frame, std::size_t sample_count, void* pcm_frame)
+static void interleave(const float* const* planar, std::uint32_t channels, std::uint32_t frames, float* interleaved)
 {
-    auto pcm_data =  static_cast<Tval*>(pcm_frame);
-
-    for( int i = 0; i < sample_count; i++ )
+    for (std::uint32_t c = 0; c < channels; c++)
     {
-        pcm_data[i] = static_cast<Tval>(float_frame[i] * static_cast<float>(Tmax));
+        for (std::uint32_t i = 0; i < frames; i++)
+        {
+            interleaved[i * channels + c] = planar[c][i];
+        }
     }
 }
 
+// gain floor of the webrtc noise suppressor by level, what it takes noise
+// only frames to (denoiseBound of ns_core.c)
+static const float gated_noise_floor[] = { 0.5f, 0.25f, 0.125f, 0.09f };
 
-void float_to_pcm(const float* float_frame, std::size_t sample_count, void* pcm_frame, std::uint32_t bit_per_sample)
-{
-    switch(bit_per_sample)
-    {
-        case 8:
-            float_to_pcm<std::int8_t>(float_frame, sample_count, pcm_frame);
-            break;
-        case 16:
-            float_to_pcm<std::int16_t>(float_frame, sample_count, pcm_frame);
-            break;
-        case 32:
-            float_to_pcm<std::int32_t>(float_frame, sample_count, pcm_frame);
-            break;
-        default:
-            throw("Error bit_per_sample parameter");
-    }
-}
-
-} // converters
+// echo path covered by the normal and the extended AEC filter, ms
+const std::uint32_t aec_normal_filter_ms = 48;
+const std::uint32_t aec_extended_filter_ms = 128;
 
 template<typename T>
 void webrtc_deletor(T* webrtc_obj)
@@ -94,18 +65,51 @@ void webrtc_deletor(T* webrtc_obj)
     }
 }
 
-AecController::AecController(std::uint32_t sample_rate, std::uint32_t bit_per_sample, std::uint32_t channels)
+AecController::AecController(std::uint32_t sample_rate, std::uint32_t bit_per_sample, std::uint32_t channels, AudioProcessingPool* processing_pool, std::uint32_t reverse_channels)
+    : AecController(sample_rate, audio_devices::default_sample_format(bit_per_sample), channels, processing_pool, reverse_channels)
+{
+
+}
+
+AecController::AecController(std::uint32_t sample_rate, audio_devices::sample_format_t sample_format, std::uint32_t channels, AudioProcessingPool* processing_pool, std::uint32_t reverse_channels)
     : m_audio_processing(nullptr, webrtc_deletor<webrtc::AudioProcessing> )
     , m_stream_config(nullptr, webrtc_deletor<webrtc::StreamConfig> )
+    , m_reverse_stream_config(nullptr, webrtc_deletor<webrtc::StreamConfig> )
+    , m_stream_delay_ms(0)
+    , m_gate_mode(gate_mode_t::disabled)
+    , m_gate_threshold_dbfs(-60.0f)
+    , m_gate_hangover_ms(500)
+    , m_reverse_skipped(false)
+    , m_capture_gated(false)
+    , m_metrics_enabled(false)
+    , m_metrics_interval_frames(100)
+    , m_metrics_countdown(0)
+    , m_dump_recorder(nullptr)
+    , m_processing_pool(processing_pool)
+    , m_profiler(nullptr)
+    , m_delay_range_ms(0)
+    , m_frame_bytes(0)
 {
-    channels = 1; // temporarily
+    MemoryScope memory_scope(m_memory_account);
 
-    init(sample_rate, bit_per_sample, channels);
+    channels = std::max(channels, 1u);
+
+    init(sample_rate, sample_format, channels, reverse_channels > 0 ? reverse_channels : channels);
+}
+
+AecController::~AecController()
+{
+    releaseProcessor(m_audio_processing);
 }
 
 
 bool AecController::Playback(const void *speaker_data, std::size_t speaker_data_size)
 {
+    if (m_dump_recorder != nullptr)
+    {
+        m_dump_recorder->Record(dump_event_t::playback, speaker_data, speaker_data_size, m_metrics.playback_frames, m_reverse_step_size);
+    }
+
     return internalPlayback(speaker_data, speaker_data_size);
 }
 
@@ -116,16 +120,163 @@ bool AecController::Capture(void *capture_data, std::size_t capture_data_size, v
         output_data = capture_data;
     }
 
-    return internalCapture(capture_data, capture_data_size, output_data);
+    if (m_dump_recorder == nullptr)
+    {
+        return internalCapture(capture_data, capture_data_size, output_data);
+    }
+
+    auto frame_index = m_metrics.capture_frames;
+
+    m_dump_recorder->Record(dump_event_t::capture_input, capture_data, capture_data_size, frame_index, m_step_size);
+
+    auto result = internalCapture(capture_data, capture_data_size, output_data);
+
+    m_dump_recorder->Record(dump_event_t::capture_output, output_data, (m_metrics.capture_frames - frame_index) * m_step_size, frame_index, m_step_size);
+
+    return result;
+}
+
+bool AecController::Playback(const float * const *channel_data, std::size_t frame_count)
+{
+    bool result = false;
+
+    auto apm = getAudioProcessor();
+
+    if (apm != nullptr && m_playback_buffer && m_reverse_channels <= aec_max_channels)
+    {
+        auto start_time = std::chrono::steady_clock::now();
+
+        auto sample_count = (m_reverse_step_size * 8) / m_bit_per_sample;
+        auto step_frames = sample_count / m_reverse_channels;
+
+        const float* step_data[aec_max_channels];
+        std::size_t offset = 0;
+
+        for (; offset + step_frames <= frame_count; offset += step_frames)
+        {
+            for (std::uint32_t c = 0; c < m_reverse_channels; c++)
+            {
+                step_data[c] = channel_data[c] + offset;
+            }
+
+            if (m_dump_recorder != nullptr)
+            {
+                recordPlanar(dump_event_t::playback_float, step_data, m_reverse_channels, sample_count, m_metrics.playback_frames);
+            }
+
+            result = playbackStep(apm, step_data, sample_count);
+
+            if (!result)
+            {
+                break;
+            }
+        }
+
+        if (result && offset < frame_count)
+        {
+            LOG(error) "Remaing " << (frame_count - offset) << " unprocessed frames in playback buffer" LOG_END;
+        }
+
+        m_metrics.process_time_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+    }
+
+    return result;
+}
+
+bool AecController::Capture(float * const *channel_data, std::size_t frame_count, float * const *output_data)
+{
+    bool result = false;
+
+    if (output_data == nullptr)
+    {
+        output_data = channel_data;
+    }
+
+    auto apm = getAudioProcessor();
+
+    if (apm != nullptr && m_channels <= aec_max_channels)
+    {
+        auto start_time = std::chrono::steady_clock::now();
+        std::uint32_t frames = 0;
+
+        auto sample_count = (m_step_size * 8) / m_bit_per_sample;
+        auto step_frames = sample_count / m_channels;
+
+        const float* step_data[aec_max_channels];
+        float* step_output[aec_max_channels];
+        std::size_t offset = 0;
+
+        for (; offset + step_frames <= frame_count; offset += step_frames)
+        {
+            for (std::uint32_t c = 0; c < m_channels; c++)
+            {
+                step_data[c] = channel_data[c] + offset;
+                step_output[c] = output_data[c] + offset;
+            }
+
+            auto frame_index = m_metrics.capture_frames;
+
+            if (m_dump_recorder != nullptr)
+            {
+                recordPlanar(dump_event_t::capture_input_float, step_data, m_channels, sample_count, frame_index);
+            }
+
+            bool bypassed = false;
+
+            result = captureStep(apm, step_data, step_output, sample_count, bypassed);
+
+            if (!result)
+            {
+                break;
+            }
+
+            for (std::uint32_t c = 0; c < m_channels && bypassed; c++)
+            {
+                if (step_output[c] != step_data[c])
+                {
+                    std::memcpy(step_output[c], step_data[c], step_frames * sizeof(float));
+                }
+            }
+
+            if (m_dump_recorder != nullptr)
+            {
+                recordPlanar(dump_event_t::capture_output_float, step_output, m_channels, sample_count, frame_index);
+            }
+
+            frames++;
+        }
+
+        if (result && offset < frame_count)
+        {
+            LOG(error) "Remaing " << (frame_count - offset) << " unprocessed frames in capture buffer" LOG_END;
+        }
+
+        m_metrics.process_time_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+        if (m_metrics_enabled)
+        {
+            sampleMetrics(apm, frames);
+        }
+    }
+
+    return result;
 }
 
 bool AecController::Reset()
 {
+    MemoryScope memory_scope(m_memory_account);
+
+    if (m_dump_recorder != nullptr)
+    {
+        m_dump_recorder->Record(dump_event_t::reset, nullptr, 0, m_metrics.capture_frames);
+    }
+
     return internalReset();
 }
 
 void AecController::SetEchoCancellation(bool enabled, int32_t suppression_level)
 {
+    MemoryScope memory_scope(m_memory_account);
 
     if (m_audio_processing != nullptr)
     {
@@ -137,6 +288,8 @@ void AecController::SetEchoCancellation(bool enabled, int32_t suppression_level)
             m_audio_processing->echo_cancellation()->set_suppression_level(static_cast<webrtc::EchoCancellation::SuppressionLevel>(suppression_level));
         }
     }
+
+    recordConfig();
 }
 
 bool AecController::IsEchoCancellationEnabled() const
@@ -155,19 +308,65 @@ std::uint32_t AecController::GetEchoSuppressionLevel() const
     return -1;
 }
 
-void AecController::SetNoiseSuppression(bool enabled, int32_t suppression_level)
+void AecController::SetEchoControlMobile(bool enabled, std::int32_t routing_mode)
 {
+    MemoryScope memory_scope(m_memory_account);
+
     if (m_audio_processing != nullptr)
     {
-        m_audio_processing->noise_suppression()->Enable(enabled);
+        auto echo_control = m_audio_processing->echo_control_mobile();
+
+        if (echo_control->is_enabled() != enabled)
+        {
+            if (enabled)
+            {
+                m_audio_processing->echo_cancellation()->Enable(false);
+            }
+
+            // the processing rate is chosen on initialization only, the
+            // component alone refuses rates above 16 kHz
+            echo_control->Enable(enabled);
 
+            auto webrtc_err = m_audio_processing->Initialize();
+
+            if (webrtc_err != webrtc::AudioProcessing::kNoError)
+            {
+                LOG(error) << "Error reinitialize webrtc processing for mobile echo control, error = " << webrtc_err LOG_END;
+            }
+        }
+
+        if (routing_mode >= static_cast<std::int32_t>(webrtc::EchoControlMobile::RoutingMode::kQuietEarpieceOrHeadset)
+                && routing_mode <= static_cast<std::int32_t>(webrtc::EchoControlMobile::RoutingMode::kLoudSpeakerphone))
+        {
+            echo_control->set_routing_mode(static_cast<webrtc::EchoControlMobile::RoutingMode>(routing_mode));
+        }
+    }
+
+    recordConfig();
+}
+
+bool AecController::IsEchoControlMobileEnabled() const
+{
+    return m_audio_processing != nullptr && m_audio_processing->echo_control_mobile()->is_enabled();
+}
+
+void AecController::SetNoiseSuppression(bool enabled, int32_t suppression_level)
+{
+    MemoryScope memory_scope(m_memory_account);
+
+    if (m_audio_processing != nullptr)
+    {
         if (suppression_level >= static_cast<std::int32_t>(webrtc::NoiseSuppression::Level::kLow)
             && suppression_level <= static_cast<std::int32_t>(webrtc::NoiseSuppression::Level::kVeryHigh))
 
         {
             m_audio_processing->noise_suppression()->set_level(static_cast<webrtc::NoiseSuppression::Level>(suppression_level));
         }
+
+        m_audio_processing->noise_suppression()->Enable(enabled);
     }
+
+    recordConfig();
 }
 
 bool AecController::IsNoiseSuppressionEnabled() const
@@ -187,10 +386,14 @@ uint32_t AecController::GetNoiseSuppressionLevel() const
 
 void AecController::SetHighPassFilter(bool enabled)
 {
+    MemoryScope memory_scope(m_memory_account);
+
     if (m_audio_processing != nullptr)
     {
         m_audio_processing->high_pass_filter()->Enable(enabled);
     }
+
+    recordConfig();
 }
 
 bool AecController::IsHighPassFilterEnabled() const
@@ -200,6 +403,8 @@ bool AecController::IsHighPassFilterEnabled() const
 
 void AecController::SetVoiceDetection(bool enabled, std::int32_t likelihood)
 {
+    MemoryScope memory_scope(m_memory_account);
+
     if (m_audio_processing != nullptr)
     {
         m_audio_processing->voice_detection()->Enable(enabled);
@@ -210,6 +415,8 @@ void AecController::SetVoiceDetection(bool enabled, std::int32_t likelihood)
             m_audio_processing->voice_detection()->set_likelihood(static_cast<webrtc::VoiceDetection::Likelihood>(likelihood));
         }
     }
+
+    recordConfig();
 }
 
 bool AecController::IsVoiceDetectionEnabled() const
@@ -224,6 +431,8 @@ bool AecController::HasVoice() const
 
 void AecController::SetGainControl(bool enabled, int32_t mode)
 {
+    MemoryScope memory_scope(m_memory_account);
+
     if (m_audio_processing != nullptr)
     {
         m_audio_processing->gain_control()->Enable(enabled);
@@ -239,6 +448,8 @@ void AecController::SetGainControl(bool enabled, int32_t mode)
             }
         }
     }
+
+    recordConfig();
 }
 
 bool AecController::IsGainControlEnabled() const
@@ -256,8 +467,191 @@ int32_t AecController::GetGainMode() const
     return -1;
 }
 
+void AecController::SetEnergyGate(gate_mode_t mode, float threshold_dbfs, uint32_t hangover_ms)
+{
+    MemoryScope memory_scope(m_memory_account);
+
+    m_gate_mode = mode;
+    m_gate_threshold_dbfs = threshold_dbfs;
+    m_gate_hangover_ms = hangover_ms;
+
+    m_far_gate.SetThreshold(threshold_dbfs);
+    m_far_gate.SetHangover(hangover_ms / 10);
+    m_far_gate.Reset();
+
+    m_near_gate.SetThreshold(threshold_dbfs);
+    m_near_gate.SetHangover(hangover_ms / 10);
+    m_near_gate.Reset();
+
+    m_gate_stats = gate_stats_t();
+    m_reverse_skipped = false;
+    m_capture_gated = false;
+
+    recordConfig();
+}
+
+gate_mode_t AecController::GetEnergyGateMode() const
+{
+    return m_gate_mode;
+}
+
+const gate_stats_t& AecController::GetGateStats() const
+{
+    return m_gate_stats;
+}
+
+void AecController::SetMetrics(bool enabled, uint32_t interval_ms)
+{
+    MemoryScope memory_scope(m_memory_account);
+
+    m_metrics_enabled = enabled;
+    m_metrics_interval_frames = std::max(1u, interval_ms / 10);
+    m_metrics_countdown = 0;
+
+    if (m_audio_processing != nullptr)
+    {
+        enableMetrics(m_audio_processing.get());
+    }
+}
+
+bool AecController::IsMetricsEnabled() const
+{
+    return m_metrics_enabled;
+}
+
+aec_metrics_t AecController::GetMetrics() const
+{
+    std::lock_guard<std::mutex> lock(m_metrics_mutex);
+
+    return m_metrics_snapshot;
+}
+
+void AecController::SampleMetrics()
+{
+    if (m_metrics_enabled && m_audio_processing != nullptr)
+    {
+        m_metrics_countdown = 0;
+        sampleMetrics(m_audio_processing.get(), 0, true);
+    }
+}
+
+aec_config_t AecController::GetConfig() const
+{
+    aec_config_t config;
+
+    if (m_audio_processing != nullptr)
+    {
+        config.echo_cancellation = m_audio_processing->echo_cancellation()->is_enabled();
+        config.echo_suppression_level = static_cast<std::int32_t>(m_audio_processing->echo_cancellation()->suppression_level());
+        config.noise_suppression = IsNoiseSuppressionEnabled();
+        config.noise_suppression_level = static_cast<std::int32_t>(m_audio_processing->noise_suppression()->level());
+        config.high_pass_filter = m_audio_processing->high_pass_filter()->is_enabled();
+        config.voice_detection = m_audio_processing->voice_detection()->is_enabled();
+        config.voice_likelihood = static_cast<std::int32_t>(m_audio_processing->voice_detection()->likelihood());
+        config.gain_control = m_audio_processing->gain_control()->is_enabled();
+        config.gain_mode = static_cast<std::int32_t>(m_audio_processing->gain_control()->mode());
+        config.echo_control_mobile = m_audio_processing->echo_control_mobile()->is_enabled();
+        config.echo_routing_mode = static_cast<std::int32_t>(m_audio_processing->echo_control_mobile()->routing_mode());
+    }
+
+    config.gate_mode = m_gate_mode;
+    config.gate_threshold_dbfs = m_gate_threshold_dbfs;
+    config.gate_hangover_ms = m_gate_hangover_ms;
+    config.delay_range_ms = m_delay_range_ms;
+
+    return config;
+}
+
+void AecController::ApplyConfig(const aec_config_t &config)
+{
+    // a single config event for the whole set
+    auto dump_recorder = m_dump_recorder;
+    m_dump_recorder = nullptr;
+
+    SetDelayRange(config.delay_range_ms);
+    SetHighPassFilter(config.high_pass_filter);
+
+    // only one echo canceller at a time, the active one is switched off first
+    if (config.echo_control_mobile)
+    {
+        SetEchoCancellation(false, config.echo_suppression_level);
+        SetEchoControlMobile(true, config.echo_routing_mode);
+    }
+    else
+    {
+        SetEchoControlMobile(false, config.echo_routing_mode);
+        SetEchoCancellation(config.echo_cancellation, config.echo_suppression_level);
+    }
+
+    SetNoiseSuppression(config.noise_suppression, config.noise_suppression_level);
+    SetVoiceDetection(config.voice_detection, config.voice_likelihood);
+    SetGainControl(config.gain_control, config.gain_mode);
+    SetEnergyGate(config.gate_mode, config.gate_threshold_dbfs, config.gate_hangover_ms);
+
+    m_dump_recorder = dump_recorder;
+
+    recordConfig();
+}
+
+void AecController::SetDelayRange(std::uint32_t delay_range_ms)
+{
+    MemoryScope memory_scope(m_memory_account);
+
+    m_delay_range_ms = delay_range_ms;
+
+    if (m_audio_processing != nullptr)
+    {
+        applyDelayRange(m_audio_processing.get());
+    }
+
+    recordConfig();
+}
+
+aec_memory_stats_t AecController::GetMemoryStats() const
+{
+    aec_memory_stats_t stats;
+
+    stats.heap = m_memory_account.GetStats();
+    stats.frame_bytes = m_frame_bytes.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+void AecController::SetStreamDelay(std::int32_t delay_ms)
+{
+    m_stream_delay_ms = std::max(delay_ms, 0);
+
+    if (m_dump_recorder != nullptr)
+    {
+        m_dump_recorder->Record(dump_event_t::stream_delay, &m_stream_delay_ms, sizeof(m_stream_delay_ms), m_metrics.capture_frames);
+    }
+}
+
+std::int32_t AecController::GetStreamDelay() const
+{
+    return m_stream_delay_ms;
+}
+
+void AecController::SetDumpRecorder(AecDumpRecorder *dump_recorder)
+{
+    m_dump_recorder = dump_recorder;
+
+    if (m_dump_recorder != nullptr)
+    {
+        m_dump_recorder->Record(dump_event_t::init, nullptr, 0, m_metrics.capture_frames);
+        m_dump_recorder->Record(dump_event_t::stream_delay, &m_stream_delay_ms, sizeof(m_stream_delay_ms), m_metrics.capture_frames);
+
+        recordConfig();
+    }
+}
+
 
 
+void AecController::SetProfiler(PerfProfiler *profiler)
+{
+    m_profiler = profiler;
+}
+
 webrtc::AudioProcessing* AecController::getAudioProcessor()
 {
     if (m_audio_processing == nullptr)
@@ -267,14 +661,74 @@ webrtc::AudioProcessing* AecController::getAudioProcessor()
     return m_audio_processing.get();
 }
 
-bool AecController::init(std::uint32_t sample_rate, std::uint32_t bit_per_sample, std::uint32_t channels)
+webrtc::AudioProcessing *AecController::createProcessor(bool &initialized)
+{
+    webrtc::AudioProcessing* apm = nullptr;
+
+    // pooled instances are initialized with the same channels both ways
+    if (m_processing_pool != nullptr && m_reverse_channels == m_channels)
+    {
+        apm = m_processing_pool->Acquire(m_sample_rate, m_channels);
+    }
+
+    initialized = apm != nullptr;
+
+    return apm != nullptr
+            ? apm
+            : webrtc::AudioProcessing::Create();
+}
+
+void AecController::releaseProcessor(webrtc_amp_ptr &processor)
+{
+    if (m_processing_pool != nullptr && m_reverse_channels == m_channels)
+    {
+        m_processing_pool->Release(processor.release(), m_sample_rate, m_channels);
+    }
+    else
+    {
+        processor.reset(nullptr);
+    }
+}
+
+bool AecController::init(std::uint32_t sample_rate, audio_devices::sample_format_t sample_format, std::uint32_t channels, std::uint32_t reverse_channels)
 {
     m_sample_rate = sample_rate;
-    m_bit_per_sample = bit_per_sample;
+    m_sample_format = sample_format;
+    m_bit_per_sample = audio_devices::sample_format_bits(sample_format);
     m_channels = channels;
-    m_step_size = (sample_rate * channels * bit_per_sample) / (8 * 100);
+    m_step_size = (sample_rate * channels * m_bit_per_sample) / (8 * 100);
+    m_reverse_channels = reverse_channels;
+    m_reverse_step_size = (sample_rate * reverse_channels * m_bit_per_sample) / (8 * 100);
+
+    // the processing path does not allocate
+    auto sample_count = m_bit_per_sample > 0 ? (m_step_size * 8) / m_bit_per_sample : 0;
+    auto reverse_sample_count = m_bit_per_sample > 0 ? (m_reverse_step_size * 8) / m_bit_per_sample : 0;
+
+    if (sample_count > 0 && reverse_sample_count > 0)
+    {
+        auto& frame_pool = shared_frame_pool(sample_count * sizeof(float));
+        auto& reverse_frame_pool = shared_frame_pool(reverse_sample_count * sizeof(float));
+
+        m_playback_buffer = reverse_frame_pool.Acquire();
+        m_capture_buffer = frame_pool.Acquire();
+
+        // interleaved frames are split for the processor
+        if (m_reverse_channels > 1)
+        {
+            m_playback_planar = reverse_frame_pool.Acquire();
+        }
+
+        if (m_channels > 1)
+        {
+            m_capture_planar = frame_pool.Acquire();
+        }
+
+        m_frame_bytes = m_playback_buffer.Capacity() + m_capture_buffer.Capacity()
+                + m_playback_planar.Capacity() + m_capture_planar.Capacity();
+    }
 
     m_stream_config.reset(new webrtc::StreamConfig(m_sample_rate, m_channels, false));
+    m_reverse_stream_config.reset(new webrtc::StreamConfig(m_sample_rate, m_reverse_channels, false));
     auto sr = m_stream_config->sample_rate_hz();
 
     return getAudioProcessor() != nullptr;
@@ -283,10 +737,11 @@ bool AecController::init(std::uint32_t sample_rate, std::uint32_t bit_per_sample
 bool AecController::internalReset()
 {
     bool result = false;
+    bool initialized = false;
 
     if (m_audio_processing == nullptr)
     {
-        m_audio_processing.reset(webrtc::AudioProcessing::Create());
+        m_audio_processing.reset(createProcessor(initialized));
 
         LOG(info) << "Webrtc audio processor create success " LOG_END;
     }
@@ -297,11 +752,14 @@ bool AecController::internalReset()
         {
             *m_stream_config,
             *m_stream_config,
-            *m_stream_config,
-            *m_stream_config
+            *m_reverse_stream_config,
+            *m_reverse_stream_config
         };
 
-        auto webrtc_err = m_audio_processing->Initialize(config);
+        // pooled instances come initialized for the format
+        auto webrtc_err = initialized
+                ? webrtc::AudioProcessing::kNoError
+                : m_audio_processing->Initialize(config);
         result = webrtc_err == webrtc::AudioProcessing::kNoError;
 
         if (!result)
@@ -311,10 +769,37 @@ bool AecController::internalReset()
         }
         else
         {
+            enableMetrics(m_audio_processing.get());
+            applyDelayRange(m_audio_processing.get());
+
             LOG(info) << "Webrtc audio processor initialize success " LOG_END;
         }
     }
 
+    // the gated path restarts from the full processing
+    m_far_gate.Reset();
+    m_near_gate.Reset();
+    m_reverse_skipped = false;
+    m_capture_gated = false;
+
+    // estimates of the released processor are not reported for the new
+    // one, frame counters continue for the dump
+    m_metrics_countdown = 0;
+    m_metrics.echo_metrics_valid = false;
+    m_metrics.echo_return_loss = aec_statistic_t();
+    m_metrics.echo_return_loss_enhancement = aec_statistic_t();
+    m_metrics.residual_echo_return_loss = aec_statistic_t();
+    m_metrics.a_nlp = aec_statistic_t();
+    m_metrics.delay_metrics_valid = false;
+    m_metrics.stream_has_echo = false;
+    m_metrics.stream_has_voice = false;
+    m_metrics.speech_probability = 0.0f;
+
+    {
+        std::lock_guard<std::mutex> lock(m_metrics_mutex);
+        m_metrics_snapshot = m_metrics;
+    }
+
     return result;
 }
 
@@ -324,40 +809,69 @@ bool AecController::internalPlayback(const void *speaker_data, std::size_t speak
 
     auto apm = getAudioProcessor();
 
-    if (apm != nullptr)
+    if (apm != nullptr && m_playback_buffer && m_reverse_channels <= aec_max_channels
+            && (m_reverse_channels == 1 || m_playback_planar))
     {
+        auto start_time = std::chrono::steady_clock::now();
 
         auto speaker_ptr = static_cast<const std::uint8_t*>(speaker_data);
 
-        auto sample_count = (m_step_size * 8) / m_bit_per_sample;
+        auto sample_count = (m_reverse_step_size * 8) / m_bit_per_sample;
+        auto step_frames = sample_count / m_reverse_channels;
 
-        std::vector<float> float_buffer(sample_count);
+        auto float_buffer = reinterpret_cast<float*>(m_playback_buffer.Data());
 
-        while(speaker_data_size >= m_step_size)
+        auto native_float = m_sample_format == audio_devices::sample_format_t::float_le;
+
+        const float* channel_data[aec_max_channels];
+        float* planar[aec_max_channels];
+
+        for (std::uint32_t c = 0; c < m_reverse_channels && m_reverse_channels > 1; c++)
         {
+            planar[c] = reinterpret_cast<float*>(m_playback_planar.Data()) + c * step_frames;
+            channel_data[c] = planar[c];
+        }
 
-            converters::pcm_to_float(speaker_ptr, sample_count , float_buffer.data(), m_bit_per_sample);
+        while(speaker_data_size >= m_reverse_step_size)
+        {
+            const float* input = reinterpret_cast<const float*>(speaker_ptr);
 
-            auto samples = float_buffer.data();
+            if (!native_float)
+            {
+                PerfProfiler::Scope profile_scope(m_profiler, profile_stage_t::convert);
 
-            auto webrtc_status = apm->ProcessReverseStream(&samples, *m_stream_config, *m_stream_config, &samples);
+                audio_devices::audio_utils::pcm_to_float(speaker_ptr, sample_count , float_buffer, m_sample_format);
+                input = float_buffer;
+            }
 
-            result = webrtc_status == webrtc::AudioProcessing::kNoError;
+            if (m_reverse_channels > 1)
+            {
+                PerfProfiler::Scope profile_scope(m_profiler, profile_stage_t::convert);
+
+                deinterleave(input, m_reverse_channels, step_frames, planar);
+            }
+            else
+            {
+                channel_data[0] = input;
+            }
+
+            result = playbackStep(apm, channel_data, sample_count);
 
             if (!result)
             {
-                LOG(error) "Process reverse stream error = " << webrtc_status LOG_END;
                 break;
             }
 
-            speaker_data_size -= m_step_size;
-            speaker_ptr += m_step_size;
+            speaker_data_size -= m_reverse_step_size;
+            speaker_ptr += m_reverse_step_size;
         }
 
         if (speaker_data_size > 0)
         {
             LOG(error) "Remaing " << speaker_data_size << " unprocessed bytes in playback buffer" LOG_END;
         }
+
+        m_metrics.process_time_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
     }
 
     return result;
@@ -369,51 +883,364 @@ bool AecController::internalCapture(void *capture_data, std::size_t capture_data
 
     auto apm = getAudioProcessor();
 
-    if (apm != nullptr)
+    if (apm != nullptr && m_capture_buffer && m_channels <= aec_max_channels
+            && (m_channels == 1 || m_capture_planar))
     {
+        auto start_time = std::chrono::steady_clock::now();
+        std::uint32_t frames = 0;
 
         auto capturt_ptr = static_cast<std::uint8_t*>(capture_data);
         auto output_ptr = static_cast<std::uint8_t*>(output_data);
 
         auto sample_count = (m_step_size * 8) / m_bit_per_sample;
+        auto step_frames = sample_count / m_channels;
 
-        std::vector<float> float_buffer(sample_count);
+        auto float_buffer = reinterpret_cast<float*>(m_capture_buffer.Data());
+
+        // float device data goes to the processor as is
+        auto native_float = m_sample_format == audio_devices::sample_format_t::float_le;
+
+        // several channels are processed in place in the planar buffer
+        const float* channel_data[aec_max_channels];
+        float* planar[aec_max_channels];
+
+        for (std::uint32_t c = 0; c < m_channels && m_channels > 1; c++)
+        {
+            planar[c] = reinterpret_cast<float*>(m_capture_planar.Data()) + c * step_frames;
+            channel_data[c] = planar[c];
+        }
 
         while(capture_data_size >= m_step_size)
         {
-            converters::pcm_to_float(capturt_ptr, sample_count, float_buffer.data(), m_bit_per_sample);
+            const float* samples = reinterpret_cast<const float*>(capturt_ptr);
+            float* output_samples = reinterpret_cast<float*>(output_ptr);
+
+            if (!native_float)
+            {
+                PerfProfiler::Scope profile_scope(m_profiler, profile_stage_t::convert);
+
+                audio_devices::audio_utils::pcm_to_float(capturt_ptr, sample_count, float_buffer, m_sample_format);
+                samples = float_buffer;
+                output_samples = float_buffer;
+            }
 
-            auto samples = float_buffer.data();
+            bool bypassed = false;
 
-            apm->set_stream_delay_ms(0);
+            if (m_channels > 1)
+            {
+                {
+                    PerfProfiler::Scope profile_scope(m_profiler, profile_stage_t::convert);
 
-            auto webrtc_status = apm->ProcessStream(&samples, *m_stream_config, *m_stream_config, &samples);
+                    deinterleave(samples, m_channels, step_frames, planar);
+                }
 
-            result = webrtc_status == webrtc::AudioProcessing::kNoError;
+                result = captureStep(apm, channel_data, planar, sample_count, bypassed);
+
+                if (result && !bypassed)
+                {
+                    PerfProfiler::Scope profile_scope(m_profiler, profile_stage_t::convert);
+
+                    interleave(channel_data, m_channels, step_frames, output_samples);
+                }
+            }
+            else
+            {
+                result = captureStep(apm, &samples, &output_samples, sample_count, bypassed);
+            }
 
             if (!result)
             {
-                LOG(error) "Process stream error = " << webrtc_status LOG_END;
                 break;
             }
-            else
+
+            if (bypassed)
             {
-                converters::float_to_pcm(float_buffer.data(), sample_count, output_ptr, m_bit_per_sample);
+                if (output_ptr != capturt_ptr)
+                {
+                    std::memcpy(output_ptr, capturt_ptr, m_step_size);
+                }
+            }
+            else if (!native_float)
+            {
+                PerfProfiler::Scope profile_scope(m_profiler, profile_stage_t::convert);
+
+                audio_devices::audio_utils::float_to_pcm(float_buffer, sample_count, output_ptr, m_sample_format);
             }
 
             capture_data_size -= m_step_size;
             capturt_ptr += m_step_size;
             output_ptr += m_step_size;
+
+            frames++;
         }
 
         if (capture_data_size > 0)
         {
             LOG(error) "Remaing " << capture_data_size << " unprocessed bytes in capture buffer" LOG_END;
         }
+
+        m_metrics.process_time_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+        if (m_metrics_enabled)
+        {
+            sampleMetrics(apm, frames);
+        }
+    }
+
+    return result;
+}
+
+bool AecController::playbackStep(webrtc::AudioProcessing *apm, const float * const *channel_data, std::uint32_t sample_count)
+{
+    bool result = true;
+
+    m_gate_stats.playback_frames++;
+
+    // far-end stays processed until hangover expires, so the echo tail
+    // is still seen by the canceller; pass_through skips it only with an
+    // idle near end, the capture of the step follows
+    auto far_active = m_gate_mode != gate_mode_t::disabled
+            && m_far_gate.Process(channel_data, m_reverse_channels, sample_count / m_reverse_channels);
+
+    m_reverse_skipped = m_gate_mode != gate_mode_t::disabled
+            && !far_active
+            && m_far_gate.IsIdle()
+            && (m_gate_mode == gate_mode_t::skip_reverse || m_near_gate.IsIdle());
+
+    if (m_reverse_skipped)
+    {
+        m_gate_stats.skipped_playback_frames++;
+    }
+    else
+    {
+        PerfProfiler::Scope profile_scope(m_profiler, profile_stage_t::process_reverse);
+
+        // reverse output is not used
+        float* reverse_output[aec_max_channels];
+
+        for (std::uint32_t c = 0; c < m_reverse_channels; c++)
+        {
+            reverse_output[c] = reinterpret_cast<float*>(m_playback_buffer.Data()) + c * (sample_count / m_reverse_channels);
+        }
+
+        auto webrtc_status = apm->ProcessReverseStream(channel_data, *m_reverse_stream_config, *m_reverse_stream_config, reverse_output);
+
+        result = webrtc_status == webrtc::AudioProcessing::kNoError;
+
+        if (!result)
+        {
+            m_metrics.playback_errors++;
+            LOG(error) "Process reverse stream error = " << webrtc_status LOG_END;
+            return false;
+        }
     }
 
+    m_metrics.playback_frames++;
+
     return result;
 }
 
+bool AecController::captureStep(webrtc::AudioProcessing *apm, const float * const *channel_data, float * const *output_data, std::uint32_t sample_count, bool &bypassed)
+{
+    m_gate_stats.capture_frames++;
+
+    auto step_frames = sample_count / m_channels;
+
+    // a near frame skips the processor only with the far frame of its step,
+    // a reopening near end costs the canceller one silent far frame at most.
+    // Gated frames are not measured against the full path: no echo to
+    // cancel, the noise floor matches the suppressor's and the AGC gain
+    // holds, which is audible only with an adaptive digital gain
+    auto gated = m_gate_mode == gate_mode_t::pass_through
+            && !m_near_gate.Process(channel_data, m_channels, step_frames)
+            && m_near_gate.IsIdle()
+            && m_reverse_skipped;
+
+    bypassed = false;
+
+    if (gated)
+    {
+        m_gate_stats.reduced_capture_frames++;
+
+        if (!m_capture_gated)
+        {
+            auto noise_suppression = apm->noise_suppression();
+            auto level = static_cast<std::uint32_t>(noise_suppression->level());
+
+            m_gated_filter.Start(m_channels, m_sample_rate
+                                 , apm->high_pass_filter()->is_enabled()
+                                 , noise_suppression->is_enabled() && level < sizeof(gated_noise_floor) / sizeof(gated_noise_floor[0])
+                                    ? gated_noise_floor[level]
+                                    : 1.0f);
+        }
+
+        m_capture_gated = true;
+
+        if (m_gated_filter.IsBypass())
+        {
+            bypassed = true;
+        }
+        else
+        {
+            PerfProfiler::Scope profile_scope(m_profiler, profile_stage_t::process_stream);
+
+            m_gated_filter.Process(channel_data, output_data, m_channels, step_frames);
+        }
+
+        m_metrics.capture_frames++;
+
+        return true;
+    }
+
+    m_capture_gated = false;
+
+    apm->set_stream_delay_ms(m_stream_delay_ms);
+
+    int webrtc_status = webrtc::AudioProcessing::kNoError;
+
+    {
+        PerfProfiler::Scope profile_scope(m_profiler, profile_stage_t::process_stream);
+
+        webrtc_status = apm->ProcessStream(channel_data, *m_stream_config, *m_stream_config, output_data);
+    }
+
+    if (webrtc_status != webrtc::AudioProcessing::kNoError)
+    {
+        m_metrics.capture_errors++;
+        LOG(error) "Process stream error = " << webrtc_status LOG_END;
+        return false;
+    }
+
+    m_metrics.capture_frames++;
+
+    return true;
+}
+
+void AecController::recordPlanar(dump_event_t event, const float * const *channel_data, std::uint32_t channels, std::uint32_t sample_count, std::uint64_t frame_index)
+{
+    // kept as float, so the replay feeds the planar API the same samples
+    if (!reserve_frame(m_dump_buffer, sample_count * sizeof(float)))
+    {
+        return;
+    }
+
+    m_frame_bytes = m_playback_buffer.Capacity() + m_capture_buffer.Capacity()
+            + m_playback_planar.Capacity() + m_capture_planar.Capacity()
+            + m_dump_buffer.Capacity();
+
+    auto interleaved = reinterpret_cast<float*>(m_dump_buffer.Data());
+
+    interleave(channel_data, channels, sample_count / channels, interleaved);
+
+    m_dump_recorder->Record(event, interleaved, sample_count * sizeof(float), frame_index, sample_count * sizeof(float));
+}
+
+
+void AecController::enableMetrics(webrtc::AudioProcessing *apm)
+{
+    apm->echo_cancellation()->enable_metrics(m_metrics_enabled);
+    apm->echo_cancellation()->enable_delay_logging(m_metrics_enabled);
+    apm->level_estimator()->Enable(m_metrics_enabled);
+}
+
+// runtime options of the echo canceller, they keep its adaptive state
+void AecController::applyDelayRange(webrtc::AudioProcessing *apm)
+{
+    webrtc::Config config;
+
+    config.Set<webrtc::ExtendedFilter>(new webrtc::ExtendedFilter(m_delay_range_ms > aec_normal_filter_ms));
+    config.Set<webrtc::DelayAgnostic>(new webrtc::DelayAgnostic(m_delay_range_ms > aec_extended_filter_ms));
+
+    apm->SetExtraOptions(config);
+}
+
+void AecController::sampleMetrics(webrtc::AudioProcessing *apm, std::uint32_t frames, bool wait)
+{
+    if (m_metrics_countdown > frames)
+    {
+        m_metrics_countdown -= frames;
+        return;
+    }
+
+    auto echo_cancellation = apm->echo_cancellation();
+
+    if (echo_cancellation->is_enabled())
+    {
+        webrtc::EchoCancellation::Metrics echo_metrics;
+
+        m_metrics.echo_metrics_valid = echo_cancellation->GetMetrics(&echo_metrics) == webrtc::AudioProcessing::kNoError;
+
+        if (m_metrics.echo_metrics_valid)
+        {
+            auto convert = [](const webrtc::EchoCancellation::Statistic& s) -> aec_statistic_t
+            {
+                return { s.instant, s.average, s.maximum, s.minimum };
+            };
+
+            m_metrics.echo_return_loss = convert(echo_metrics.echo_return_loss);
+            m_metrics.echo_return_loss_enhancement = convert(echo_metrics.echo_return_loss_enhancement);
+            m_metrics.residual_echo_return_loss = convert(echo_metrics.residual_echo_return_loss);
+            m_metrics.a_nlp = convert(echo_metrics.a_nlp);
+        }
+
+        m_metrics.delay_metrics_valid = echo_cancellation->GetDelayMetrics(&m_metrics.delay_median_ms
+                                                                           , &m_metrics.delay_std_ms
+                                                                           , &m_metrics.fraction_poor_delays) == webrtc::AudioProcessing::kNoError;
+
+        m_metrics.stream_has_echo = echo_cancellation->stream_has_echo();
+    }
+    else
+    {
+        m_metrics.echo_metrics_valid = false;
+        m_metrics.delay_metrics_valid = false;
+    }
+
+    m_metrics.speech_probability = apm->noise_suppression()->is_enabled()
+            ? apm->noise_suppression()->speech_probability()
+            : 0.0f;
+
+    m_metrics.stream_has_voice = apm->voice_detection()->is_enabled()
+            && apm->voice_detection()->stream_has_voice();
+
+    // level estimator returns RMS as positive value below full scale
+    m_metrics.rms_level_dbfs = -apm->level_estimator()->RMS();
+
+    if (apm->gain_control()->is_enabled())
+    {
+        m_metrics.agc_analog_level = apm->gain_control()->stream_analog_level();
+        m_metrics.agc_saturated = apm->gain_control()->stream_is_saturated();
+    }
+
+    m_metrics.gate_stats = m_gate_stats;
+    m_metrics.sample_count++;
+
+    // never wait for the readers: retry on the next frame if busy
+    std::unique_lock<std::mutex> lock(m_metrics_mutex, std::defer_lock);
+
+    if (wait)
+    {
+        lock.lock();
+    }
+    else
+    {
+        lock.try_lock();
+    }
+
+    if (lock.owns_lock())
+    {
+        m_metrics_snapshot = m_metrics;
+        m_metrics_countdown = m_metrics_interval_frames;
+    }
+}
+
+void AecController::recordConfig()
+{
+    if (m_dump_recorder != nullptr)
+    {
+        auto config = GetConfig();
+
+        m_dump_recorder->Record(dump_event_t::config, &config, sizeof(config), m_metrics.capture_frames);
+    }
+}
 
 }
@@ -12,10 +12,164 @@ class StreamConfig;
 
 #include <memory>
 #include <chrono>
+#include <mutex>
+#include <atomic>
+
+#include "energy_gate.h"
+#include "sample_format.h"
+#include "audio_frame.h"
+#include "memory_tracker.h"
 
 namespace audio_processing
 {
 
+// channels of a controller, both APIs
+const std::uint32_t aec_max_channels = 8;
+
+enum class gate_mode_t
+{
+    disabled,
+    skip_reverse,   // far-end idle: skip ProcessReverseStream
+    pass_through    // far-end and near-end idle: neither stream reaches the
+                    // processor, capture gets a DC blocker and the noise
+                    // suppressor's gain floor; adaptation and AGC hold
+};
+
+struct gate_stats_t
+{
+    std::uint64_t   playback_frames;
+    std::uint64_t   skipped_playback_frames;
+    std::uint64_t   capture_frames;
+    std::uint64_t   reduced_capture_frames;
+
+    gate_stats_t()
+        : playback_frames(0)
+        , skipped_playback_frames(0)
+        , capture_frames(0)
+        , reduced_capture_frames(0)
+    {}
+
+    inline double playback_hit_rate() const { return playback_frames > 0 ? static_cast<double>(skipped_playback_frames) / playback_frames : 0.0; }
+    inline double capture_hit_rate() const { return capture_frames > 0 ? static_cast<double>(reduced_capture_frames) / capture_frames : 0.0; }
+};
+
+struct aec_statistic_t
+{
+    std::int32_t    instant;
+    std::int32_t    average;
+    std::int32_t    maximum;
+    std::int32_t    minimum;
+};
+
+struct aec_metrics_t
+{
+    // echo cancellation, dB
+    bool            echo_metrics_valid;
+    aec_statistic_t echo_return_loss;
+    aec_statistic_t echo_return_loss_enhancement;
+    aec_statistic_t residual_echo_return_loss;
+    aec_statistic_t a_nlp;
+    bool            stream_has_echo;
+
+    // delay estimation, ms
+    bool            delay_metrics_valid;
+    std::int32_t    delay_median_ms;
+    std::int32_t    delay_std_ms;
+    float           fraction_poor_delays;
+
+    float           speech_probability;
+    bool            stream_has_voice;
+    std::int32_t    rms_level_dbfs;
+
+    std::int32_t    agc_analog_level;
+    bool            agc_saturated;
+
+    // pipeline counters
+    std::uint64_t   playback_frames;
+    std::uint64_t   capture_frames;
+    std::uint64_t   playback_errors;
+    std::uint64_t   capture_errors;
+    std::uint64_t   process_time_us;
+    gate_stats_t    gate_stats;
+
+    std::uint64_t   sample_count;
+
+    aec_metrics_t()
+        : echo_metrics_valid(false)
+        , echo_return_loss()
+        , echo_return_loss_enhancement()
+        , residual_echo_return_loss()
+        , a_nlp()
+        , stream_has_echo(false)
+        , delay_metrics_valid(false)
+        , delay_median_ms(0)
+        , delay_std_ms(0)
+        , fraction_poor_delays(0.0f)
+        , speech_probability(0.0f)
+        , stream_has_voice(false)
+        , rms_level_dbfs(0)
+        , agc_analog_level(0)
+        , agc_saturated(false)
+        , playback_frames(0)
+        , capture_frames(0)
+        , playback_errors(0)
+        , capture_errors(0)
+        , process_time_us(0)
+        , sample_count(0)
+    {}
+};
+
+// complete processing settings, restored with ApplyConfig
+struct aec_config_t
+{
+    bool            echo_cancellation;
+    std::int32_t    echo_suppression_level;
+    bool            noise_suppression;
+    std::int32_t    noise_suppression_level;
+    bool            high_pass_filter;
+    bool            voice_detection;
+    std::int32_t    voice_likelihood;
+    bool            gain_control;
+    std::int32_t    gain_mode;
+    gate_mode_t     gate_mode;
+    float           gate_threshold_dbfs;
+    std::uint32_t   gate_hangover_ms;
+    bool            echo_control_mobile;
+    std::int32_t    echo_routing_mode;
+    std::uint32_t   delay_range_ms;
+
+    aec_config_t()
+        : echo_cancellation(false)
+        , echo_suppression_level(-1)
+        , noise_suppression(false)
+        , noise_suppression_level(-1)
+        , high_pass_filter(false)
+        , voice_detection(false)
+        , voice_likelihood(-1)
+        , gain_control(false)
+        , gain_mode(-1)
+        , gate_mode(gate_mode_t::disabled)
+        , gate_threshold_dbfs(-60.0f)
+        , gate_hangover_ms(500)
+        , echo_control_mobile(false)
+        , echo_routing_mode(-1)
+        , delay_range_ms(0)
+    {}
+};
+
+// readable from any thread
+struct aec_memory_stats_t
+{
+    memory_stats_t  heap;               // processors, stream config and buffers allocated for the controller
+    std::uint64_t   frame_bytes;        // frame pool blocks held
+};
+
+enum class dump_event_t : std::uint32_t;
+
+class AecDumpRecorder;
+class AudioProcessingPool;
+class PerfProfiler;
+
 class AecController
 {
     typedef std::unique_ptr<webrtc::AudioProcessing, void(*)(webrtc::AudioProcessing*)> webrtc_amp_ptr;
@@ -23,17 +177,74 @@ class AecController
 
     webrtc_amp_ptr                                      m_audio_processing;
     webrtc_cfg_ptr                                      m_stream_config;
+    webrtc_cfg_ptr                                      m_reverse_stream_config;
 
     std::uint32_t                                       m_sample_rate;
     std::uint32_t                                       m_bit_per_sample;
+    audio_devices::sample_format_t                      m_sample_format;
     std::uint32_t                                       m_channels;
     std::uint32_t                                       m_step_size;
+    std::uint32_t                                       m_reverse_channels;
+    std::uint32_t                                       m_reverse_step_size;
+
+    std::int32_t                                        m_stream_delay_ms;
+
+    // float conversion buffers of one step from the shared frame pool
+    FrameRef                                            m_playback_buffer;
+    FrameRef                                            m_capture_buffer;
+    // per channel blocks of the PCM API, several channels only
+    FrameRef                                            m_playback_planar;
+    FrameRef                                            m_capture_planar;
+    // planar frames interleaved for the dump
+    FrameRef                                            m_dump_buffer;
+
+    gate_mode_t                                         m_gate_mode;
+    float                                               m_gate_threshold_dbfs;
+    std::uint32_t                                       m_gate_hangover_ms;
+    EnergyGate                                          m_far_gate;
+    EnergyGate                                          m_near_gate;
+    gate_stats_t                                        m_gate_stats;
+    // pass_through: the processor skips far and near frames together, so
+    // the canceller's render and capture streams stay paired
+    bool                                                m_reverse_skipped;
+    bool                                                m_capture_gated;
+    GatedFilter                                         m_gated_filter;
+
+    // m_metrics is owned by the processing thread, m_metrics_snapshot is
+    // published to readers with try_lock only
+    bool                                                m_metrics_enabled;
+    std::uint32_t                                       m_metrics_interval_frames;
+    std::uint32_t                                       m_metrics_countdown;
+    aec_metrics_t                                       m_metrics;
+    aec_metrics_t                                       m_metrics_snapshot;
+    mutable std::mutex                                  m_metrics_mutex;
+
+    AecDumpRecorder*                                    m_dump_recorder;
+
+    AudioProcessingPool*                                m_processing_pool;
+
+    PerfProfiler*                                       m_profiler;
+
+    std::uint32_t                                       m_delay_range_ms;
+    MemoryAccount                                       m_memory_account;
+    std::atomic<std::uint64_t>                          m_frame_bytes;
 
 public:
-    AecController(std::uint32_t sample_rate, std::uint32_t bit_per_sample, std::uint32_t channels);
+    // with a pool the processors are taken from and returned to it;
+    // reverse_channels of the playback stream, 0 - as the capture
+    AecController(std::uint32_t sample_rate, std::uint32_t bit_per_sample, std::uint32_t channels, AudioProcessingPool* processing_pool = nullptr, std::uint32_t reverse_channels = 0);
+    // float_le data is processed in place without conversion
+    AecController(std::uint32_t sample_rate, audio_devices::sample_format_t sample_format, std::uint32_t channels, AudioProcessingPool* processing_pool = nullptr, std::uint32_t reverse_channels = 0);
+    ~AecController();
 
     bool Playback(const void* speaker_data, std::size_t speaker_data_size);
     bool Capture(void* capture_data, std::size_t capture_data_size, void* output_data = nullptr);
+
+    // planar float at the controller rate, channel_data[c] holds frame_count
+    // samples of channel c; handed to the processor without conversion,
+    // capture output nullptr - in place
+    bool Playback(const float* const* channel_data, std::size_t frame_count);
+    bool Capture(float* const* channel_data, std::size_t frame_count, float* const* output_data = nullptr);
     bool Reset();
 
     // echo cancellation
@@ -41,6 +252,11 @@ public:
     bool IsEchoCancellationEnabled() const;
     std::uint32_t GetEchoSuppressionLevel() const;
 
+    // mobile echo control: cheaper, exclusive with echo cancellation, which
+    // it turns off; the processor is reinitialized to run capture at 16 kHz
+    void SetEchoControlMobile(bool enabled, std::int32_t routing_mode = -1);
+    bool IsEchoControlMobileEnabled() const;
+
     // noise suppression
     void SetNoiseSuppression(bool enabled, std::int32_t suppression_level = -1);
     bool IsNoiseSuppressionEnabled() const;
@@ -60,14 +276,63 @@ public:
     bool IsGainControlEnabled() const;
     std::int32_t GetGainMode() const;
 
+    // energy gate
+    void SetEnergyGate(gate_mode_t mode, float threshold_dbfs = -60.0f, std::uint32_t hangover_ms = 500);
+    gate_mode_t GetEnergyGateMode() const;
+    const gate_stats_t& GetGateStats() const;
+
+    // metrics, sampled by the processing thread every interval_ms of capture
+    void SetMetrics(bool enabled, std::uint32_t interval_ms = 1000);
+    bool IsMetricsEnabled() const;
+    // thread safe, returns the last sampled metrics
+    aec_metrics_t GetMetrics() const;
+    // samples now instead of at the next interval, processing thread only
+    void SampleMetrics();
+
+    aec_config_t GetConfig() const;
+    void ApplyConfig(const aec_config_t& config);
+
+    // far frame to its echo in the capture, as seen by the processing
+    // thread; set by the processing thread, the dump records every change
+    void SetStreamDelay(std::int32_t delay_ms);
+    std::int32_t GetStreamDelay() const;
+
+    // uncertainty of the stream delay the echo canceller has to cover:
+    // the extended filter above 48 ms, delay-agnostic mode above 128 ms,
+    // 0 for the processor defaults. Applied to the running processor
+    void SetDelayRange(std::uint32_t delay_range_ms);
+    inline std::uint32_t GetDelayRange() const { return m_delay_range_ms; }
+
+    // heap accounted in the tools built with AEC_MEMORY_TRACKING: operator
+    // new and malloc blocks of the setup calls, the processing calls don't
+    // allocate; processors taken from a pool were allocated by it
+    aec_memory_stats_t GetMemoryStats() const;
+
+    // taps inputs, outputs and settings, attach before Reset for a
+    // bit-exact replay; nullptr detaches
+    void SetDumpRecorder(AecDumpRecorder* dump_recorder);
 
+    // conversion and processing stages are accounted to the profiler,
+    // which must be opened by the processing thread; nullptr disables
+    void SetProfiler(PerfProfiler* profiler);
 
 private:
     webrtc::AudioProcessing* getAudioProcessor();
-    bool init(std::uint32_t sample_rate, std::uint32_t bit_per_sample, std::uint32_t channels);
+    webrtc::AudioProcessing* createProcessor(bool& initialized);
+    void releaseProcessor(webrtc_amp_ptr& processor);
+    bool init(std::uint32_t sample_rate, audio_devices::sample_format_t sample_format, std::uint32_t channels, std::uint32_t reverse_channels);
     bool internalReset();
     bool internalPlayback(const void* speaker_data, std::size_t speaker_data_size);
     bool internalCapture(void* capture_data, std::size_t capture_data_size, void* output_data);
+    // one 10 ms step of planar float, sample_count of all channels of the
+    // stream
+    bool playbackStep(webrtc::AudioProcessing* apm, const float* const* channel_data, std::uint32_t sample_count);
+    bool captureStep(webrtc::AudioProcessing* apm, const float* const* channel_data, float* const* output_data, std::uint32_t sample_count, bool& bypassed);
+    void recordPlanar(dump_event_t event, const float* const* channel_data, std::uint32_t channels, std::uint32_t sample_count, std::uint64_t frame_index);
+    void enableMetrics(webrtc::AudioProcessing* apm);
+    void applyDelayRange(webrtc::AudioProcessing* apm);
+    void sampleMetrics(webrtc::AudioProcessing* apm, std::uint32_t frames, bool wait = false);
+    void recordConfig();
 };
 
 }
@@ -0,0 +1,365 @@
+#include "aec_core.h"
+#include "aec_controller.h"
+#include "delay_estimator.h"
+
+#include <new>
+#include <memory>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+// formats are passed through as sample_format_t
+static_assert(static_cast<int>(audio_devices::sample_format_t::u8) == AEC_SAMPLE_U8
+              && static_cast<int>(audio_devices::sample_format_t::float_le) == AEC_SAMPLE_FLOAT_LE, "sample format mismatch");
+
+struct aec_session
+{
+    audio_processing::AecController                     controller;
+    std::size_t                                         frame_size;
+    std::size_t                                         frame_samples;  // per channel
+    std::unique_ptr<audio_processing::DelayEstimator>   delay_estimator;
+
+    aec_session(const aec_session_config_t& config)
+        : controller(config.sample_rate, static_cast<audio_devices::sample_format_t>(config.sample_format), config.channels)
+        , frame_size((config.sample_rate / 100) * config.channels * (audio_devices::sample_format_bits(static_cast<audio_devices::sample_format_t>(config.sample_format)) / 8))
+        , frame_samples(config.sample_rate / 100)
+    {
+        if (config.delay_search != 0)
+        {
+            delay_estimator.reset(new audio_processing::DelayEstimator(controller, config.sample_rate, static_cast<audio_devices::sample_format_t>(config.sample_format), config.channels));
+        }
+    }
+};
+
+namespace
+{
+
+bool is_supported(const aec_session_config_t& config)
+{
+    if (config.sample_rate != 8000
+            && config.sample_rate != 16000
+            && config.sample_rate != 32000
+            && config.sample_rate != 48000)
+    {
+        return false;
+    }
+
+    return config.channels >= 1
+            && config.channels <= audio_processing::aec_max_channels
+            && config.sample_format >= AEC_SAMPLE_U8
+            && config.sample_format <= AEC_SAMPLE_FLOAT_LE;
+}
+
+// fields of the first version of each struct
+const std::size_t config_min_size = offsetof(aec_session_config_t, delay_search);
+const std::size_t stats_min_size = offsetof(aec_session_stats_t, stream_delay_ms);
+const std::size_t memory_min_size = offsetof(aec_session_memory_t, malloc_bytes);
+
+// the caller's part of a full struct
+template<typename T>
+void copy_out(const T& full, T* caller)
+{
+    auto size = std::min<std::size_t>(caller->struct_size, sizeof(T));
+
+    std::memcpy(reinterpret_cast<std::uint8_t*>(caller) + sizeof(caller->struct_size)
+                , reinterpret_cast<const std::uint8_t*>(&full) + sizeof(full.struct_size)
+                , size - sizeof(caller->struct_size));
+}
+
+bool is_valid_size(const aec_session_t* session, std::size_t size)
+{
+    return size > 0 && size % session->frame_size == 0;
+}
+
+bool is_valid_frames(const aec_session_t* session, std::size_t frames)
+{
+    return frames > 0 && frames % session->frame_samples == 0;
+}
+
+}
+
+extern "C"
+{
+
+int aec_core_version(void)
+{
+    return AEC_CORE_VERSION;
+}
+
+void aec_session_config_init(aec_session_config_t *config)
+{
+    if (config == nullptr)
+    {
+        return;
+    }
+
+    config->struct_size = sizeof(aec_session_config_t);
+
+    config->sample_rate = 48000;
+    config->channels = 1;
+    config->sample_format = AEC_SAMPLE_S16_LE;
+
+    config->echo_cancellation = 1;
+    config->echo_suppression_level = -1;
+    config->echo_control_mobile = 0;
+    config->echo_routing_mode = -1;
+    config->noise_suppression = 1;
+    config->noise_suppression_level = -1;
+    config->high_pass_filter = 1;
+    config->voice_detection = 0;
+    config->voice_likelihood = -1;
+    config->gain_control = 0;
+    config->gain_mode = -1;
+
+    config->metrics_interval_ms = 0;
+
+    config->delay_search = 0;
+
+    config->delay_range = 0;
+    config->delay_range_ms = 0;
+}
+
+aec_session_t* aec_session_create(const aec_session_config_t *caller_config)
+{
+    if (caller_config == nullptr || caller_config->struct_size < config_min_size)
+    {
+        return nullptr;
+    }
+
+    // fields the caller was built without keep the defaults
+    aec_session_config_t full_config;
+    aec_session_config_init(&full_config);
+
+    std::memcpy(&full_config, caller_config, std::min<std::size_t>(caller_config->struct_size, sizeof(full_config)));
+    full_config.struct_size = sizeof(full_config);
+
+    auto config = &full_config;
+
+    if (!is_supported(*config))
+    {
+        return nullptr;
+    }
+
+    // nothing may be thrown through the C interface
+    aec_session_t* session = nullptr;
+
+    try
+    {
+        session = new aec_session_t(*config);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+
+    if (!session->controller.Reset())
+    {
+        delete session;
+        return nullptr;
+    }
+
+    audio_processing::aec_config_t aec_config;
+
+    aec_config.echo_cancellation = config->echo_cancellation != 0;
+    aec_config.echo_suppression_level = config->echo_suppression_level;
+    aec_config.echo_control_mobile = config->echo_control_mobile != 0;
+    aec_config.echo_routing_mode = config->echo_routing_mode;
+    aec_config.noise_suppression = config->noise_suppression != 0;
+    aec_config.noise_suppression_level = config->noise_suppression_level;
+    aec_config.high_pass_filter = config->high_pass_filter != 0;
+    aec_config.voice_detection = config->voice_detection != 0;
+    aec_config.voice_likelihood = config->voice_likelihood;
+    aec_config.gain_control = config->gain_control != 0;
+    aec_config.gain_mode = config->gain_mode;
+    aec_config.delay_range_ms = config->delay_range != 0 ? config->delay_range_ms : 0;
+
+    session->controller.ApplyConfig(aec_config);
+
+    if (config->metrics_interval_ms > 0)
+    {
+        session->controller.SetMetrics(true, config->metrics_interval_ms);
+    }
+
+    return session;
+}
+
+void aec_session_destroy(aec_session_t *session)
+{
+    delete session;
+}
+
+size_t aec_session_frame_size(const aec_session_t *session)
+{
+    return session != nullptr ? session->frame_size : 0;
+}
+
+int aec_session_process_frame(aec_session_t *session, const void *far_frame, const void *near_frame, void *out_frame, size_t size)
+{
+    if (far_frame != nullptr)
+    {
+        auto result = aec_session_process_far(session, far_frame, size);
+
+        if (result < 0)
+        {
+            return result;
+        }
+    }
+
+    return aec_session_process_near(session, near_frame, out_frame, size);
+}
+
+int aec_session_process_far(aec_session_t *session, const void *far_frame, size_t size)
+{
+    if (session == nullptr || far_frame == nullptr || !is_valid_size(session, size))
+    {
+        return -EINVAL;
+    }
+
+    if (session->delay_estimator != nullptr)
+    {
+        session->delay_estimator->AddPlayback(far_frame, size);
+    }
+
+    return session->controller.Playback(far_frame, size) ? 0 : -EIO;
+}
+
+int aec_session_process_near(aec_session_t *session, const void *near_frame, void *out_frame, size_t size)
+{
+    if (session == nullptr || near_frame == nullptr || out_frame == nullptr || !is_valid_size(session, size))
+    {
+        return -EINVAL;
+    }
+
+    if (session->delay_estimator != nullptr)
+    {
+        session->delay_estimator->AddCapture(near_frame, size);
+    }
+
+    // the input is only read when the output is another buffer
+    return session->controller.Capture(const_cast<void*>(near_frame), size, out_frame) ? 0 : -EIO;
+}
+
+int aec_session_process_far_planar(aec_session_t *session, const float * const *far_channels, size_t frames)
+{
+    if (session == nullptr || far_channels == nullptr || !is_valid_frames(session, frames))
+    {
+        return -EINVAL;
+    }
+
+    if (session->delay_estimator != nullptr)
+    {
+        session->delay_estimator->AddPlayback(far_channels, frames);
+    }
+
+    return session->controller.Playback(far_channels, frames) ? 0 : -EIO;
+}
+
+int aec_session_process_near_planar(aec_session_t *session, float * const *near_channels, float * const *out_channels, size_t frames)
+{
+    if (session == nullptr || near_channels == nullptr || !is_valid_frames(session, frames))
+    {
+        return -EINVAL;
+    }
+
+    if (session->delay_estimator != nullptr)
+    {
+        session->delay_estimator->AddCapture(near_channels, frames);
+    }
+
+    return session->controller.Capture(near_channels, frames, out_channels) ? 0 : -EIO;
+}
+
+int aec_session_set_stream_delay(aec_session_t *session, int32_t delay_ms)
+{
+    if (session == nullptr || delay_ms < 0)
+    {
+        return -EINVAL;
+    }
+
+    session->controller.SetStreamDelay(delay_ms);
+
+    return 0;
+}
+
+int aec_session_reset(aec_session_t *session)
+{
+    if (session == nullptr)
+    {
+        return -EINVAL;
+    }
+
+    auto config = session->controller.GetConfig();
+
+    if (!session->controller.Reset())
+    {
+        return -EIO;
+    }
+
+    session->controller.ApplyConfig(config);
+
+    return 0;
+}
+
+int aec_session_get_stats(const aec_session_t *session, aec_session_stats_t *stats)
+{
+    if (session == nullptr || stats == nullptr || stats->struct_size < stats_min_size)
+    {
+        return -EINVAL;
+    }
+
+    auto metrics = session->controller.GetMetrics();
+    auto caller_stats = stats;
+
+    aec_session_stats_t full_stats = {};
+    stats = &full_stats;
+
+    stats->far_frames = metrics.playback_frames;
+    stats->near_frames = metrics.capture_frames;
+    stats->far_errors = metrics.playback_errors;
+    stats->near_errors = metrics.capture_errors;
+    stats->process_time_us = metrics.process_time_us;
+
+    stats->echo_metrics_valid = metrics.echo_metrics_valid ? 1 : 0;
+    stats->echo_return_loss_enhancement = metrics.echo_return_loss_enhancement.instant;
+    stats->delay_metrics_valid = metrics.delay_metrics_valid ? 1 : 0;
+    stats->delay_median_ms = metrics.delay_median_ms;
+    stats->stream_has_echo = metrics.stream_has_echo ? 1 : 0;
+    stats->stream_has_voice = metrics.stream_has_voice ? 1 : 0;
+
+    stats->stream_delay_ms = session->delay_estimator != nullptr
+            ? session->delay_estimator->GetStats().delay_ms
+            : -1;
+
+    copy_out(full_stats, caller_stats);
+
+    return 0;
+}
+
+int aec_session_get_memory(const aec_session_t *session, aec_session_memory_t *memory)
+{
+    if (session == nullptr || memory == nullptr || memory->struct_size < memory_min_size)
+    {
+        return -EINVAL;
+    }
+
+    auto stats = session->controller.GetMemoryStats();
+    auto caller_memory = memory;
+
+    aec_session_memory_t full_memory = {};
+    memory = &full_memory;
+
+    memory->tracked = stats.heap.tracked ? 1 : 0;
+    memory->heap_bytes = stats.heap.bytes;
+    memory->peak_heap_bytes = stats.heap.peak_bytes;
+    memory->heap_blocks = stats.heap.blocks;
+    memory->allocations = stats.heap.allocations;
+    memory->frame_bytes = stats.frame_bytes;
+    memory->malloc_bytes = stats.heap.malloc_bytes;
+
+    copy_out(full_memory, caller_memory);
+
+    return 0;
+}
+
+}
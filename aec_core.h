@@ -0,0 +1,167 @@
+#ifndef AEC_CORE_H
+#define AEC_CORE_H
+
+/*
+ * C interface of the aec_core library, for in-process use from C, Go (cgo)
+ * and other FFI callers:
+ *
+ *  aec_session_config_t config;
+ *  aec_session_config_init(&config);
+ *  aec_session_t* session = aec_session_create(&config);
+ *  while (...) aec_session_process_frame(session, far, near, out, aec_session_frame_size(session));
+ *  aec_session_destroy(session);
+ *
+ * All buffers belong to the caller, nothing is allocated after create.
+ * Structs start with struct_size, the sizeof the caller was built with:
+ * fields are only appended, older callers get defaults for the fields
+ * they lack and never have newer ones written.
+ * A session is processed by one thread at a time, sessions are independent.
+ * Static linking also needs -lwebrtc_audio_processing -lstdc++ -lpthread.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AEC_CORE_VERSION 5
+
+typedef struct aec_session aec_session_t;
+
+/* interleaved little endian samples */
+typedef enum aec_sample_format
+{
+    AEC_SAMPLE_U8       = 1,
+    AEC_SAMPLE_S16_LE   = 2,
+    AEC_SAMPLE_S24_3LE  = 3,
+    AEC_SAMPLE_S24_LE   = 4,
+    AEC_SAMPLE_S32_LE   = 5,
+    AEC_SAMPLE_FLOAT_LE = 6
+} aec_sample_format_t;
+
+/* flags are 0/1, levels and modes are -1 for the processor default */
+typedef struct aec_session_config
+{
+    uint32_t    struct_size;                /* set by aec_session_config_init */
+
+    uint32_t    sample_rate;                /* 8000, 16000, 32000 or 48000 */
+    uint32_t    channels;                   /* 1 to 8 */
+    int32_t     sample_format;              /* aec_sample_format_t */
+
+    int32_t     echo_cancellation;
+    int32_t     echo_suppression_level;
+    int32_t     echo_control_mobile;        /* replaces echo_cancellation */
+    int32_t     echo_routing_mode;
+    int32_t     noise_suppression;
+    int32_t     noise_suppression_level;
+    int32_t     high_pass_filter;
+    int32_t     voice_detection;
+    int32_t     voice_likelihood;
+    int32_t     gain_control;
+    int32_t     gain_mode;
+
+    uint32_t    metrics_interval_ms;        /* 0 - no stats */
+
+    /* version 2 */
+    int32_t     delay_search;               /* stream delay found from the signals */
+
+    /* version 3 */
+    int32_t     delay_range;                /* echo canceller filter and delay handling chosen for the range below */
+    uint32_t    delay_range_ms;             /* stream delay uncertainty to cover, extended filter above 48 ms, delay agnostic above 128 ms */
+} aec_session_config_t;
+
+/* sampled every metrics_interval_ms of near end, may be read from any thread */
+typedef struct aec_session_stats
+{
+    uint32_t    struct_size;                    /* sizeof(aec_session_stats_t), set by the caller */
+
+    uint64_t    far_frames;
+    uint64_t    near_frames;
+    uint64_t    far_errors;
+    uint64_t    near_errors;
+    uint64_t    process_time_us;
+
+    int32_t     echo_metrics_valid;
+    int32_t     echo_return_loss_enhancement;   /* dB */
+    int32_t     delay_metrics_valid;
+    int32_t     delay_median_ms;
+    int32_t     stream_has_echo;
+    int32_t     stream_has_voice;
+
+    /* version 2 */
+    int32_t     stream_delay_ms;                /* found by the delay search, -1 none yet */
+} aec_session_stats_t;
+
+/*
+ * heap figures are counted only in the tools built with AEC_MEMORY_TRACKING,
+ * which link their own operator new; the library never replaces the
+ * allocator of its caller, tracked is 0 there
+ */
+typedef struct aec_session_memory
+{
+    uint32_t    struct_size;                /* sizeof(aec_session_memory_t), set by the caller */
+
+    int32_t     tracked;
+    uint64_t    heap_bytes;
+    uint64_t    peak_heap_bytes;
+    uint64_t    heap_blocks;
+    uint64_t    allocations;
+    uint64_t    frame_bytes;                /* shared frame pool blocks held */
+
+    /* version 5 */
+    int64_t     malloc_bytes;               /* malloc blocks of setup calls on their thread, webrtc submodule state */
+} aec_session_memory_t;
+
+/* AEC_CORE_VERSION of the library */
+int aec_core_version(void);
+
+/* 48 kHz mono s16, echo cancellation, noise suppression and high pass filter */
+void aec_session_config_init(aec_session_config_t* config);
+
+/* NULL for an unsupported config or a processor failure */
+aec_session_t* aec_session_create(const aec_session_config_t* config);
+void aec_session_destroy(aec_session_t* session);
+
+/* bytes of one 10 ms frame, buffer sizes are multiples of it */
+size_t aec_session_frame_size(const aec_session_t* session);
+
+/*
+ * far_frame is the signal sent to the speaker, NULL if there is none;
+ * near_frame is the microphone signal, out_frame receives the processed
+ * one and may be near_frame. 0 or a negative errno.
+ */
+int aec_session_process_frame(aec_session_t* session, const void* far_frame, const void* near_frame, void* out_frame, size_t size);
+
+/* far and near ends delivered apart, the far end goes first */
+int aec_session_process_far(aec_session_t* session, const void* far_frame, size_t size);
+int aec_session_process_near(aec_session_t* session, const void* near_frame, void* out_frame, size_t size);
+
+/*
+ * planar float at the session rate whatever the sample format: one array
+ * of frames samples per channel, a multiple of 10 ms; out_channels NULL
+ * processes in place
+ */
+int aec_session_process_far_planar(aec_session_t* session, const float* const* far_channels, size_t frames);
+int aec_session_process_near_planar(aec_session_t* session, float* const* near_channels, float* const* out_channels, size_t frames);
+
+/*
+ * far frame to its echo in the near frames, 0 at create; replaced by the
+ * delay search when it is on. Called by the processing thread.
+ */
+int aec_session_set_stream_delay(aec_session_t* session, int32_t delay_ms);
+
+/* drops the adaptive state, settings are kept */
+int aec_session_reset(aec_session_t* session);
+
+int aec_session_get_stats(const aec_session_t* session, aec_session_stats_t* stats);
+
+/* may be called from any thread */
+int aec_session_get_memory(const aec_session_t* session, aec_session_memory_t* memory);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AEC_CORE_H */
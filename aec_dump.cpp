@@ -0,0 +1,274 @@
+#include "aec_dump.h"
+
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_processing
+{
+
+const std::uint32_t dump_writer_idle_ms = 2;
+const std::size_t dump_max_parts = 16;
+
+static std::uint64_t monotonic_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AecDumpRecorder::AecDumpRecorder(std::size_t block_count, std::size_t block_size)
+    : m_blocks(block_count)
+    , m_block_size(block_size)
+    , m_free_blocks(block_count)
+    , m_ready_blocks(block_count)
+    , m_file(nullptr)
+    , m_running(false)
+    , m_sequence(0)
+    , m_recorded_events(0)
+    , m_dropped_events(0)
+    , m_written_bytes(0)
+{
+    for (std::size_t i = 0; i < block_count; i++)
+    {
+        m_blocks[i].data.resize(block_size);
+        m_free_blocks.Push(static_cast<std::uint32_t>(i));
+    }
+}
+
+AecDumpRecorder::~AecDumpRecorder()
+{
+    Stop();
+}
+
+bool AecDumpRecorder::Start(const std::string &file_name, std::uint32_t sample_rate, audio_devices::sample_format_t sample_format, std::uint32_t channels, std::uint32_t reverse_channels)
+{
+    Stop();
+
+    m_file = std::fopen(file_name.c_str(), "wb");
+
+    if (m_file == nullptr)
+    {
+        LOG(error) << "Can't create dump file [" << file_name << "], errno = " << errno LOG_END;
+        return false;
+    }
+
+    dump_file_header_t header =
+    {
+        aec_dump_magic,
+        aec_dump_version,
+        sample_rate,
+        audio_devices::sample_format_bits(sample_format),
+        channels,
+        static_cast<std::uint32_t>(sample_format),
+        reverse_channels > 0 ? reverse_channels : channels
+    };
+    std::fwrite(&header, sizeof(header), 1, m_file);
+
+    m_sequence = 0;
+    m_recorded_events = 0;
+    m_dropped_events = 0;
+    m_written_bytes = sizeof(header);
+
+    m_running = true;
+    m_writer_thread = std::thread(&AecDumpRecorder::writerProc, this);
+
+    LOG(info) << "Dump recording started [" << file_name << "]" LOG_END;
+
+    return true;
+}
+
+bool AecDumpRecorder::Stop()
+{
+    bool result = m_running;
+
+    m_running = false;
+
+    if (m_writer_thread.joinable())
+    {
+        m_writer_thread.join();
+    }
+
+    if (m_file != nullptr)
+    {
+        writeReady();
+
+        std::fclose(m_file);
+        m_file = nullptr;
+
+        LOG(info) << "Dump recording stopped, events = " << m_recorded_events
+                  << ", dropped = " << m_dropped_events
+                  << ", bytes = " << m_written_bytes LOG_END;
+    }
+
+    return result;
+}
+
+bool AecDumpRecorder::Record(dump_event_t event, const void *data, std::size_t size, std::uint64_t frame_index, std::size_t align)
+{
+    if (!m_running)
+    {
+        return false;
+    }
+
+    auto time_ns = monotonic_ns();
+    auto sequence = m_sequence++;
+    auto ptr = static_cast<const std::uint8_t*>(data);
+    auto part_limit = std::max(align, m_block_size - m_block_size % align);
+    auto part_count = std::max<std::size_t>(1, (size + part_limit - 1) / part_limit);
+
+    // all parts or nothing, so the replay never sees a partial call
+    std::uint32_t indexes[dump_max_parts];
+    std::size_t reserved = 0;
+
+    if (part_limit <= m_block_size && part_count <= dump_max_parts)
+    {
+        while (reserved < part_count && m_free_blocks.Pop(indexes[reserved]))
+        {
+            reserved++;
+        }
+    }
+
+    if (reserved < part_count)
+    {
+        while (reserved > 0)
+        {
+            m_free_blocks.Push(indexes[--reserved]);
+        }
+
+        m_dropped_events++;
+        return false;
+    }
+
+    for (std::size_t i = 0; i < part_count; i++)
+    {
+        auto part = std::min(size, part_limit);
+        auto& block = m_blocks[indexes[i]];
+
+        block.header.event = static_cast<std::uint32_t>(event);
+        block.header.size = static_cast<std::uint32_t>(part);
+        block.header.frame_index = frame_index;
+        block.header.time_ns = time_ns;
+        block.header.sequence = sequence;
+
+        if (part > 0)
+        {
+            std::memcpy(block.data.data(), ptr, part);
+        }
+
+        m_ready_blocks.Push(indexes[i]);
+
+        ptr += part;
+        size -= part;
+    }
+
+    m_recorded_events++;
+
+    return true;
+}
+
+void AecDumpRecorder::writerProc()
+{
+    while (m_running)
+    {
+        if (writeReady() == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(dump_writer_idle_ms));
+        }
+    }
+}
+
+std::size_t AecDumpRecorder::writeReady()
+{
+    std::size_t count = 0;
+    std::uint32_t index = 0;
+
+    while (m_ready_blocks.Pop(index))
+    {
+        const auto& block = m_blocks[index];
+
+        std::fwrite(&block.header, sizeof(block.header), 1, m_file);
+        std::fwrite(block.data.data(), 1, block.header.size, m_file);
+
+        m_written_bytes += sizeof(block.header) + block.header.size;
+
+        m_free_blocks.Push(index);
+        count++;
+    }
+
+    return count;
+}
+
+//------------------------------------------------------------------------------
+
+AecDumpReader::AecDumpReader()
+    : m_file(nullptr)
+    , m_header()
+{
+
+}
+
+AecDumpReader::~AecDumpReader()
+{
+    Close();
+}
+
+bool AecDumpReader::Open(const std::string &file_name)
+{
+    Close();
+
+    m_file = std::fopen(file_name.c_str(), "rb");
+
+    if (m_file == nullptr)
+    {
+        LOG(error) << "Can't open dump file [" << file_name << "], errno = " << errno LOG_END;
+        return false;
+    }
+
+    if (std::fread(&m_header, sizeof(m_header), 1, m_file) != 1
+            || m_header.magic != aec_dump_magic
+            || m_header.version != aec_dump_version)
+    {
+        LOG(error) << "File [" << file_name << "] is not an aec dump" LOG_END;
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+bool AecDumpReader::Close()
+{
+    bool result = false;
+
+    if (m_file != nullptr)
+    {
+        result = std::fclose(m_file) == 0;
+        m_file = nullptr;
+    }
+
+    return result;
+}
+
+bool AecDumpReader::Next(dump_record_header_t &record, std::vector<std::uint8_t> &data)
+{
+    if (m_file == nullptr
+            || std::fread(&record, sizeof(record), 1, m_file) != 1)
+    {
+        return false;
+    }
+
+    data.resize(record.size);
+
+    return record.size == 0
+            || std::fread(data.data(), 1, record.size, m_file) == record.size;
+}
+
+}
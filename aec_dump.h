@@ -0,0 +1,132 @@
+#ifndef AEC_DUMP_H
+#define AEC_DUMP_H
+
+#include "lockfree_queue.h"
+#include "sample_format.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+
+namespace audio_processing
+{
+
+const std::uint32_t aec_dump_magic = 0x44434541; // "AECD"
+// 2: record sequence numbers; the config record is aec_config_t as
+// built, bump with every change of its layout
+// 3: float events of the planar API
+// 4: channels of the playback stream
+// 5: delay range of the config
+const std::uint32_t aec_dump_version = 5;
+
+enum class dump_event_t : std::uint32_t
+{
+    init = 1,
+    config,             // aec_config_t
+    reset,
+    playback,           // far-end input
+    capture_input,      // near-end input
+    capture_output,     // processed near-end
+    stream_delay,       // std::int32_t, ms
+    playback_float,     // interleaved float of the planar API, as the ones above
+    capture_input_float,
+    capture_output_float
+};
+
+struct dump_file_header_t
+{
+    std::uint32_t   magic;
+    std::uint32_t   version;
+    std::uint32_t   sample_rate;
+    std::uint32_t   bit_per_sample;
+    std::uint32_t   channels;
+    std::uint32_t   sample_format;  // audio_devices::sample_format_t
+    std::uint32_t   reverse_channels;
+};
+
+struct dump_record_header_t
+{
+    std::uint32_t   event;
+    std::uint32_t   size;
+    std::uint64_t   frame_index;    // 10 ms frames processed by the stream so far
+    std::uint64_t   time_ns;        // monotonic
+    std::uint64_t   sequence;       // per Record call, parts of a call share it, dropped calls leave a gap
+};
+
+// Records controller inputs, outputs and settings. Record() only copies into
+// a pre-allocated block and queues it, the file is written by a background
+// thread; when all blocks are busy the event is dropped and counted, and
+// its sequence number is missing from the file.
+class AecDumpRecorder
+{
+    struct block_t
+    {
+        dump_record_header_t        header;
+        std::vector<std::uint8_t>   data;
+    };
+
+    std::vector<block_t>                m_blocks;
+    std::size_t                         m_block_size;
+    LockFreeQueue<std::uint32_t>        m_free_blocks;
+    LockFreeQueue<std::uint32_t>        m_ready_blocks;
+
+    std::FILE*                          m_file;
+    std::thread                         m_writer_thread;
+    std::atomic<bool>                   m_running;
+
+    std::atomic<std::uint64_t>          m_sequence;
+    std::atomic<std::uint64_t>          m_recorded_events;
+    std::atomic<std::uint64_t>          m_dropped_events;
+    std::atomic<std::uint64_t>          m_written_bytes;
+
+public:
+
+    AecDumpRecorder(std::size_t block_count = 512, std::size_t block_size = 8192);
+    ~AecDumpRecorder();
+
+    // reverse_channels of the playback events, 0 - as the capture
+    bool Start(const std::string& file_name, std::uint32_t sample_rate, audio_devices::sample_format_t sample_format, std::uint32_t channels, std::uint32_t reverse_channels = 0);
+    // writes all queued blocks before return
+    bool Stop();
+
+    inline bool IsRecording() const { return m_running; }
+
+    // never blocks, data larger than a block is split on align boundary
+    // into at most 16 records
+    bool Record(dump_event_t event, const void* data, std::size_t size, std::uint64_t frame_index, std::size_t align = 1);
+
+    inline std::uint64_t GetRecordedEvents() const { return m_recorded_events; }
+    inline std::uint64_t GetDroppedEvents() const { return m_dropped_events; }
+    inline std::uint64_t GetWrittenBytes() const { return m_written_bytes; }
+
+private:
+
+    void writerProc();
+    std::size_t writeReady();
+};
+
+class AecDumpReader
+{
+    std::FILE*                          m_file;
+    dump_file_header_t                  m_header;
+
+public:
+
+    AecDumpReader();
+    ~AecDumpReader();
+
+    bool Open(const std::string& file_name);
+    bool Close();
+
+    inline const dump_file_header_t& GetHeader() const { return m_header; }
+
+    // false at the end of file
+    bool Next(dump_record_header_t& record, std::vector<std::uint8_t>& data);
+};
+
+}
+
+#endif // AEC_DUMP_H
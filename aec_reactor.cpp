@@ -0,0 +1,130 @@
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <csignal>
+
+#include "pcm_coroutine.h"
+#include "aec_controller.h"
+
+// Many AEC sessions on one thread: each recorder/player pair is a
+// coroutine on a shared PcmReactor instead of a blocking loop per pair.
+//
+// aec_reactor recorder1 player1 [recorder2 player2...]
+//
+// Every session does what aec_test does: capture a 10 ms frame, process
+// it with the frame as the reference, play it back.
+
+namespace
+{
+
+const std::uint32_t sample_rate = 48000;
+const std::uint32_t frame_size = sample_rate / 100;
+
+audio_devices::PcmReactor* active_reactor = nullptr;
+
+void on_stop_signal(int)
+{
+    if (active_reactor != nullptr)
+    {
+        active_reactor->Stop();
+    }
+}
+
+struct session_t
+{
+    audio_devices::AlsaDevice                           recorder;
+    audio_devices::AlsaDevice                           player;
+    audio_processing::AecController                     aec_controller;
+    std::vector<char>                                   buffer;
+
+    session_t(const audio_devices::audio_format_t& format)
+        : aec_controller(format.sample_rate, format.format(), format.channels)
+        , buffer(format.octets_count(10))
+    {}
+};
+
+audio_devices::pcm_task_t run_session(audio_devices::PcmReactor& reactor, session_t& session, std::size_t index)
+{
+    // one frame of silence ahead, the player never waits for the capture
+    co_await audio_devices::async_write_frame(reactor, session.player, session.buffer.data());
+
+    while (true)
+    {
+        auto result = co_await audio_devices::async_read_frame(reactor, session.recorder, session.buffer.data());
+
+        if (result < 0)
+        {
+            std::cout << "Session " << index << ": read error " << result << std::endl;
+            break;
+        }
+
+        session.aec_controller.Playback(session.buffer.data(), session.buffer.size());
+        session.aec_controller.Capture(session.buffer.data(), session.buffer.size());
+
+        result = co_await audio_devices::async_write_frame(reactor, session.player, session.buffer.data());
+
+        if (result < 0)
+        {
+            std::cout << "Session " << index << ": write error " << result << std::endl;
+            break;
+        }
+    }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || argc % 2 == 0)
+    {
+        std::cout << "Usage: aec_reactor recorder player [recorder player...]" << std::endl;
+        return 1;
+    }
+
+    const audio_devices::audio_format_t audio_format(sample_rate, audio_devices::sample_format_t::s16_le, 1);
+
+    // 10 ms periods, reads wake up every frame
+    audio_devices::audio_params_t recorder_params(true, audio_format, frame_size, true, 4);
+    audio_devices::audio_params_t player_params(false, audio_format, frame_size, true, 4);
+
+    // the reactor goes first: its destructor resumes pending coroutines
+    // with -ECANCELED while the sessions still exist
+    std::vector<std::unique_ptr<session_t>> sessions;
+    audio_devices::PcmReactor reactor;
+
+    for (int a = 1; a + 1 < argc; a += 2)
+    {
+        std::unique_ptr<session_t> session(new session_t(audio_format));
+
+        if (!session->recorder.Open(argv[a], recorder_params)
+                || !session->player.Open(argv[a + 1], player_params)
+                || !session->aec_controller.Reset())
+        {
+            std::cout << "Can't open session " << argv[a] << " -> " << argv[a + 1] << std::endl;
+            continue;
+        }
+
+        session->aec_controller.SetHighPassFilter(true);
+        session->aec_controller.SetEchoCancellation(true, 0);
+
+        sessions.push_back(std::move(session));
+    }
+
+    for (std::size_t s = 0; s < sessions.size(); s++)
+    {
+        run_session(reactor, *sessions[s], s);
+    }
+
+    active_reactor = &reactor;
+
+    std::signal(SIGINT, on_stop_signal);
+    std::signal(SIGTERM, on_stop_signal);
+
+    std::cout << sessions.size() << " sessions on one thread" << std::endl;
+
+    reactor.Run();
+
+    active_reactor = nullptr;
+
+    return 0;
+}
@@ -0,0 +1,414 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <map>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+#include "aec_controller.h"
+#include "aec_dump.h"
+#include "wav_utils.h"
+#include "perf_profiler.h"
+
+// Offline replay of a session recorded with AecDumpRecorder.
+//
+// aec_replay --dump=file [--out=processed.wav] [--far=far.wav] [--near=near.wav] [--profile]
+//
+// Feeds the recorded settings and inputs through a new controller in the
+// original order and compares the output with the recorded one. Events
+// dropped by the recorder leave a sequence gap, the output from there on
+// is not reproducible and is no longer compared.
+
+namespace
+{
+
+double thread_cpu_ms()
+{
+    timespec ts = {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+    return static_cast<double>(ts.tv_sec) * 1000.0 + static_cast<double>(ts.tv_nsec) / 1000000.0;
+}
+
+// header is rewritten with the final size on close
+class WavWriter
+{
+    std::ofstream               m_stream;
+    audio_devices::audio_format_t m_format;
+    std::uint32_t               m_data_size;
+
+public:
+
+    WavWriter()
+        : m_data_size(0)
+    {}
+
+    ~WavWriter()
+    {
+        Close();
+    }
+
+    bool Open(const std::string& file_name, const audio_devices::audio_format_t& format)
+    {
+        std::uint8_t header[audio_devices::wav_utils::wav_header_size] = {};
+
+        m_format = format;
+        m_data_size = 0;
+        m_stream.open(file_name, std::ios::binary);
+
+        audio_devices::wav_utils::make_header(m_format, 0, header);
+        m_stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+        return m_stream.good();
+    }
+
+    void Write(const void* data, std::size_t size)
+    {
+        if (m_stream.is_open())
+        {
+            m_stream.write(static_cast<const char*>(data), size);
+            m_data_size += static_cast<std::uint32_t>(size);
+        }
+    }
+
+    void Close()
+    {
+        if (m_stream.is_open())
+        {
+            std::uint8_t header[audio_devices::wav_utils::wav_header_size] = {};
+
+            audio_devices::wav_utils::make_header(m_format, m_data_size, header);
+            m_stream.seekp(0);
+            m_stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+            m_stream.close();
+        }
+    }
+};
+
+// records of the planar API: interleaved float, split for the controller
+class PlanarFrames
+{
+    std::uint32_t               m_channels;
+    std::vector<float>          m_samples;
+    std::vector<float*>         m_channel_data;
+
+public:
+
+    explicit PlanarFrames(std::uint32_t channels)
+        : m_channels(std::max(channels, 1u))
+        , m_channel_data(m_channels)
+    {}
+
+    // frames per channel
+    std::size_t Load(const std::vector<std::uint8_t>& data)
+    {
+        auto frames = data.size() / (sizeof(float) * m_channels);
+        auto interleaved = reinterpret_cast<const float*>(data.data());
+
+        m_samples.resize(frames * m_channels);
+
+        for (std::uint32_t c = 0; c < m_channels; c++)
+        {
+            m_channel_data[c] = m_samples.data() + c * frames;
+
+            for (std::size_t i = 0; i < frames; i++)
+            {
+                m_channel_data[c][i] = interleaved[i * m_channels + c];
+            }
+        }
+
+        return frames;
+    }
+
+    void Store(std::vector<std::uint8_t>& data) const
+    {
+        auto frames = m_samples.size() / m_channels;
+
+        data.resize(m_samples.size() * sizeof(float));
+
+        auto interleaved = reinterpret_cast<float*>(data.data());
+
+        for (std::uint32_t c = 0; c < m_channels; c++)
+        {
+            for (std::size_t i = 0; i < frames; i++)
+            {
+                interleaved[i * m_channels + c] = m_channel_data[c][i];
+            }
+        }
+    }
+
+    inline float* const* ChannelData() { return m_channel_data.data(); }
+};
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::map<std::string, std::string> options;
+
+    for (int a = 1; a < argc; a++)
+    {
+        std::string arg(argv[a]);
+
+        if (arg.compare(0, 2, "--") == 0)
+        {
+            auto pos = arg.find('=');
+            options[arg.substr(2, pos == std::string::npos ? pos : pos - 2)] = pos == std::string::npos ? "" : arg.substr(pos + 1);
+        }
+    }
+
+    if (options.count("dump") == 0)
+    {
+        std::cerr << "Usage: aec_replay --dump=file [--out=processed.wav] [--far=far.wav] [--near=near.wav] [--profile]" << std::endl;
+        return 1;
+    }
+
+    audio_processing::AecDumpReader reader;
+
+    if (!reader.Open(options["dump"]))
+    {
+        return 1;
+    }
+
+    const auto& header = reader.GetHeader();
+
+    audio_devices::audio_format_t format(header.sample_rate, header.bit_per_sample, header.channels, static_cast<audio_devices::sample_format_t>(header.sample_format));
+
+    audio_devices::audio_format_t far_format(header.sample_rate, header.bit_per_sample, header.reverse_channels, format.format());
+
+    audio_processing::AecController controller(format.sample_rate, format.format(), format.channels, nullptr, far_format.channels);
+
+    audio_processing::PerfProfiler profiler;
+
+    if (options.count("profile") != 0)
+    {
+        profiler.Open();
+        controller.SetProfiler(&profiler);
+    }
+
+    WavWriter out_writer, far_writer, near_writer;
+
+    if (options.count("out") != 0)
+    {
+        out_writer.Open(options["out"], format);
+    }
+
+    if (options.count("far") != 0)
+    {
+        far_writer.Open(options["far"], far_format);
+    }
+
+    if (options.count("near") != 0)
+    {
+        near_writer.Open(options["near"], format);
+    }
+
+    audio_processing::dump_record_header_t record;
+    std::vector<std::uint8_t> data;
+    std::vector<std::uint8_t> output;
+
+    // replayed output waiting for the recorded capture_output record
+    std::deque<std::uint8_t> pending_output;
+
+    PlanarFrames planar(format.channels);
+    PlanarFrames far_planar(far_format.channels);
+    std::vector<std::uint8_t> pcm;
+
+    // float records go to the wav files in the session format
+    auto to_pcm = [&format, &pcm](const std::vector<std::uint8_t>& float_data) -> const std::vector<std::uint8_t>&
+    {
+        auto sample_count = float_data.size() / sizeof(float);
+
+        pcm.resize(sample_count * (format.bit_per_sample / 8));
+        audio_devices::audio_utils::float_to_pcm(reinterpret_cast<const float*>(float_data.data()), sample_count, pcm.data(), format.format());
+
+        return pcm;
+    };
+
+    std::uint64_t events = 0;
+    std::uint64_t compared_bytes = 0;
+    std::uint64_t mismatched_bytes = 0;
+    std::uint64_t first_mismatch_frame = 0;
+    std::uint64_t next_sequence = 0;
+    std::uint64_t dropped_events = 0;
+    std::uint64_t first_gap_frame = 0;
+    std::uint64_t playback_bytes = 0;
+    std::uint64_t capture_bytes = 0;
+    double process_ms = 0.0;
+
+    while (reader.Next(record, data))
+    {
+        events++;
+
+        // records of concurrent Record calls may be written out of order
+        if (record.sequence > next_sequence)
+        {
+            if (dropped_events == 0)
+            {
+                first_gap_frame = record.frame_index;
+            }
+
+            dropped_events += record.sequence - next_sequence;
+        }
+
+        next_sequence = std::max(next_sequence, record.sequence + 1);
+
+        switch (static_cast<audio_processing::dump_event_t>(record.event))
+        {
+            case audio_processing::dump_event_t::init:
+            break;
+            case audio_processing::dump_event_t::config:
+                if (data.size() == sizeof(audio_processing::aec_config_t))
+                {
+                    audio_processing::aec_config_t config;
+                    std::memcpy(&config, data.data(), data.size());
+
+                    controller.ApplyConfig(config);
+                }
+                else
+                {
+                    std::cerr << "Config of " << data.size() << " bytes does not match this build, skipped" << std::endl;
+                }
+            break;
+            case audio_processing::dump_event_t::reset:
+                controller.Reset();
+                pending_output.clear();
+            break;
+            case audio_processing::dump_event_t::stream_delay:
+                if (data.size() == sizeof(std::int32_t))
+                {
+                    std::int32_t delay_ms = 0;
+                    std::memcpy(&delay_ms, data.data(), sizeof(delay_ms));
+
+                    controller.SetStreamDelay(delay_ms);
+                }
+            break;
+            case audio_processing::dump_event_t::playback:
+            {
+                far_writer.Write(data.data(), data.size());
+                playback_bytes += data.size();
+
+                auto cpu_start = thread_cpu_ms();
+                controller.Playback(data.data(), data.size());
+                process_ms += thread_cpu_ms() - cpu_start;
+            }
+            break;
+            case audio_processing::dump_event_t::capture_input:
+            {
+                near_writer.Write(data.data(), data.size());
+                capture_bytes += data.size();
+
+                output.resize(data.size());
+
+                auto cpu_start = thread_cpu_ms();
+                controller.Capture(data.data(), data.size(), output.data());
+                process_ms += thread_cpu_ms() - cpu_start;
+
+                if (dropped_events == 0)
+                {
+                    pending_output.insert(pending_output.end(), output.begin(), output.end());
+                }
+
+                out_writer.Write(output.data(), output.size());
+            }
+            break;
+            case audio_processing::dump_event_t::playback_float:
+            {
+                far_writer.Write(to_pcm(data).data(), pcm.size());
+
+                auto frames = far_planar.Load(data);
+                playback_bytes += frames * far_format.frames_octets();
+
+                auto cpu_start = thread_cpu_ms();
+                controller.Playback(far_planar.ChannelData(), frames);
+                process_ms += thread_cpu_ms() - cpu_start;
+            }
+            break;
+            case audio_processing::dump_event_t::capture_input_float:
+            {
+                near_writer.Write(to_pcm(data).data(), pcm.size());
+
+                auto frames = planar.Load(data);
+                capture_bytes += frames * format.frames_octets();
+
+                auto cpu_start = thread_cpu_ms();
+                controller.Capture(planar.ChannelData(), frames);
+                process_ms += thread_cpu_ms() - cpu_start;
+
+                planar.Store(output);
+
+                if (dropped_events == 0)
+                {
+                    pending_output.insert(pending_output.end(), output.begin(), output.end());
+                }
+
+                out_writer.Write(to_pcm(output).data(), pcm.size());
+            }
+            break;
+            case audio_processing::dump_event_t::capture_output:
+            case audio_processing::dump_event_t::capture_output_float:
+            {
+                if (dropped_events != 0)
+                {
+                    break;
+                }
+
+                auto size = std::min(data.size(), pending_output.size());
+
+                for (std::size_t i = 0; i < size; i++)
+                {
+                    if (data[i] != pending_output[i])
+                    {
+                        if (mismatched_bytes == 0)
+                        {
+                            first_mismatch_frame = record.frame_index;
+                        }
+
+                        mismatched_bytes++;
+                    }
+                }
+
+                compared_bytes += size;
+                pending_output.erase(pending_output.begin(), pending_output.begin() + size);
+            }
+            break;
+            default:
+                std::cerr << "Unknown event " << record.event << " skipped" << std::endl;
+        }
+    }
+
+    auto step_size = format.octets_count(10);
+    auto frames = capture_bytes / step_size;
+
+    std::cout << "Events: " << events << std::endl;
+    std::cout << "Frames: playback " << playback_bytes / far_format.octets_count(10) << ", capture " << frames << std::endl;
+    std::cout << "Processing: " << process_ms << " ms cpu"
+              << ", " << (frames > 0 ? process_ms * 1000.0 / frames : 0.0) << " us per capture frame"
+              << ", realtime factor " << (frames > 0 ? process_ms / (frames * 10.0) : 0.0) << std::endl;
+
+    if (dropped_events != 0)
+    {
+        std::cout << "Dropped: " << dropped_events << " events, first gap at frame " << first_gap_frame
+                  << ", output not reproducible from there" << std::endl;
+    }
+
+    if (mismatched_bytes == 0)
+    {
+        std::cout << "Output: bit-exact, " << compared_bytes << " bytes compared"
+                  << (dropped_events != 0 ? " before the gap" : "") << std::endl;
+    }
+    else
+    {
+        std::cout << "Output: " << mismatched_bytes << " of " << compared_bytes
+                  << " bytes differ, first at frame " << first_mismatch_frame << std::endl;
+    }
+
+    if (options.count("profile") != 0)
+    {
+        profiler.Report(std::cout);
+    }
+
+    return mismatched_bytes != 0 ? 2 : dropped_events != 0 ? 3 : 0;
+}
@@ -0,0 +1,450 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <iomanip>
+#include <algorithm>
+#include <unistd.h>
+
+#include "alsa_device.h"
+#include "simulated_pcm.h"
+#include "aec_controller.h"
+
+// Accelerated soak of the aec_test loop on simulated PCM streams.
+//
+// aec_soak [--hours=1] [--rate=48000] [--format=s16] [--low-latency]
+//          [--period-ms=N] [--periods=N] [--jitter-us=N] [--nonblock]
+//          [--prefill-ms=N] [--script=file] [--aec] [--report-min=10] [--seed=N]
+//
+// Both streams run on one virtual clock through AlsaDevice, so the retry
+// and recovery code is the production one. The loop keeps the pacing of
+// main.cpp: blocking capture read, processing, playback write, sleep to
+// the next 10 ms. Script lines (# comments):
+//
+//   <time_ms>[/<repeat_ms>] xrun|suspend|stall|partial|jitter [value] [player|recorder|both]
+
+namespace
+{
+
+const std::uint64_t ns_per_ms = 1000000;
+
+struct target_fault_t
+{
+    audio_devices::sim_fault_event_t    fault_event;
+    bool                                player;
+    bool                                recorder;
+};
+
+bool parse_script(const std::string& file_name, std::vector<target_fault_t>& faults)
+{
+    const std::map<std::string, audio_devices::sim_fault_t> fault_names =
+    {
+        { "xrun", audio_devices::sim_fault_t::xrun },
+        { "suspend", audio_devices::sim_fault_t::suspend },
+        { "stall", audio_devices::sim_fault_t::stall },
+        { "partial", audio_devices::sim_fault_t::partial },
+        { "jitter", audio_devices::sim_fault_t::jitter }
+    };
+
+    // value when the script omits it
+    const std::map<std::string, std::uint32_t> default_values =
+    {
+        { "suspend", 1000 },
+        { "stall", 50 },
+        { "partial", 1 }
+    };
+
+    std::ifstream stream(file_name);
+
+    if (!stream.is_open())
+    {
+        std::cout << "Can't open script " << file_name << std::endl;
+        return false;
+    }
+
+    std::string line;
+    std::uint32_t line_number = 0;
+
+    while (std::getline(stream, line))
+    {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream tokens(line);
+        std::string time, type, token;
+
+        if (!(tokens >> time))
+        {
+            continue;
+        }
+
+        tokens >> type;
+
+        auto it = fault_names.find(type);
+
+        if (it == fault_names.end())
+        {
+            std::cout << "Script line " << line_number << ": unknown fault " << type << std::endl;
+            return false;
+        }
+
+        target_fault_t fault = { { 0, it->second, 0, 0 }, true, true };
+
+        auto repeat_pos = time.find('/');
+
+        fault.fault_event.time_ms = std::strtoull(time.c_str(), nullptr, 10);
+        fault.fault_event.repeat_ms = repeat_pos != std::string::npos
+                ? std::strtoull(time.c_str() + repeat_pos + 1, nullptr, 10)
+                : 0;
+        fault.fault_event.value = default_values.count(type) != 0 ? default_values.at(type) : 0;
+
+        while (tokens >> token)
+        {
+            if (token == "player" || token == "recorder" || token == "both")
+            {
+                fault.player = token != "recorder";
+                fault.recorder = token != "player";
+            }
+            else
+            {
+                fault.fault_event.value = std::strtoul(token.c_str(), nullptr, 10);
+            }
+        }
+
+        faults.push_back(fault);
+    }
+
+    return true;
+}
+
+std::uint64_t rss_kb()
+{
+    std::ifstream statm("/proc/self/statm");
+    std::uint64_t size = 0, resident = 0;
+
+    statm >> size >> resident;
+
+    return (resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE))) / 1024;
+}
+
+struct delay_stats_t
+{
+    std::uint64_t   count;
+    double          total_ms;
+    double          min_ms;
+    double          max_ms;
+
+    delay_stats_t()
+        : count(0)
+        , total_ms(0.0)
+        , min_ms(0.0)
+        , max_ms(0.0)
+    {}
+
+    void add(double delay_ms)
+    {
+        min_ms = count == 0 ? delay_ms : std::min(min_ms, delay_ms);
+        max_ms = count == 0 ? delay_ms : std::max(max_ms, delay_ms);
+        total_ms += delay_ms;
+        count++;
+    }
+
+    inline double avg_ms() const { return count > 0 ? total_ms / count : 0.0; }
+};
+
+struct interval_stats_t
+{
+    std::uint64_t   frames;
+    std::uint64_t   capture_glitches;
+    std::uint64_t   playback_glitches;
+    delay_stats_t   player_delay;
+    delay_stats_t   recorder_delay;
+
+    interval_stats_t()
+        : frames(0)
+        , capture_glitches(0)
+        , playback_glitches(0)
+    {}
+};
+
+double recovery_avg_ms(const audio_devices::sim_pcm_stats_t& stats)
+{
+    return stats.recoveries > 0
+            ? static_cast<double>(stats.recovery_time_total_ns) / stats.recoveries / ns_per_ms
+            : 0.0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::map<std::string, std::string> options;
+
+    for (int a = 1; a < argc; a++)
+    {
+        std::string arg(argv[a]);
+
+        if (arg.compare(0, 2, "--") == 0)
+        {
+            auto pos = arg.find('=');
+            options[arg.substr(2, pos == std::string::npos ? pos : pos - 2)] = pos == std::string::npos ? "" : arg.substr(pos + 1);
+        }
+    }
+
+    auto option = [&options](const std::string& name, double default_value)
+    {
+        return options.count(name) != 0 ? std::strtod(options[name].c_str(), nullptr) : default_value;
+    };
+
+    const std::map<std::string, audio_devices::sample_format_t> sample_formats =
+    {
+        { "u8", audio_devices::sample_format_t::u8 },
+        { "s16", audio_devices::sample_format_t::s16_le },
+        { "s24_3", audio_devices::sample_format_t::s24_3le },
+        { "s24", audio_devices::sample_format_t::s24_le },
+        { "s32", audio_devices::sample_format_t::s32_le },
+        { "float", audio_devices::sample_format_t::float_le }
+    };
+
+    auto sample_format = audio_devices::sample_format_t::s16_le;
+
+    if (options.count("format") != 0)
+    {
+        auto it = sample_formats.find(options["format"]);
+
+        if (it == sample_formats.end())
+        {
+            std::cout << "Unknown sample format " << options["format"] << std::endl;
+            return 1;
+        }
+
+        sample_format = it->second;
+    }
+
+    const auto sample_rate = static_cast<std::uint32_t>(option("rate", 48000));
+    const std::uint32_t frame_size = sample_rate / 100;
+    const auto duration_ns = static_cast<std::uint64_t>(option("hours", 1.0) * 3600.0 * 1000.0) * ns_per_ms;
+    const auto report_ns = std::max<std::uint64_t>(static_cast<std::uint64_t>(option("report-min", 10.0) * 60.0 * 1000.0), 1) * ns_per_ms;
+
+    const audio_devices::audio_format_t audio_format(sample_rate, sample_format, 1);
+    const std::size_t frame_octets = frame_size * audio_format.frames_octets();
+
+    // the same device params as aec_test
+    audio_devices::audio_params_t player_params(false, audio_format, frame_size * 6, true);
+    audio_devices::audio_params_t recorder_params(true, audio_format, frame_size * 4, false);
+
+    if (options.count("low-latency") != 0)
+    {
+        player_params = audio_devices::audio_params_t(false, audio_format, frame_size / 2, true, 2, audio_devices::latency_profile_t::low_latency);
+        recorder_params = audio_devices::audio_params_t(true, audio_format, frame_size / 2, false, 2, audio_devices::latency_profile_t::low_latency);
+    }
+
+    if (options.count("period-ms") != 0)
+    {
+        player_params.buffer_size = recorder_params.buffer_size = static_cast<std::uint32_t>((option("period-ms", 10) * sample_rate) / 1000);
+    }
+
+    if (options.count("periods") != 0)
+    {
+        player_params.period_count = recorder_params.period_count = static_cast<std::uint32_t>(option("periods", 2));
+    }
+
+    recorder_params.nonblock_mode = options.count("nonblock") != 0;
+
+    auto clock = std::make_shared<audio_devices::VirtualClock>();
+
+    audio_devices::sim_pcm_config_t sim_config;
+
+    sim_config.jitter_us = static_cast<std::uint32_t>(option("jitter-us", 0));
+    sim_config.seed = static_cast<std::uint32_t>(option("seed", 1));
+
+    // devices own the streams, stats are read through these
+    auto player_pcm = new audio_devices::SimulatedPcm(clock, sim_config);
+    sim_config.seed++;
+    auto recorder_pcm = new audio_devices::SimulatedPcm(clock, sim_config);
+
+    audio_devices::AlsaDevice player { std::unique_ptr<audio_devices::PcmBackend>(player_pcm) };
+    audio_devices::AlsaDevice recorder { std::unique_ptr<audio_devices::PcmBackend>(recorder_pcm) };
+
+    if (options.count("script") != 0)
+    {
+        std::vector<target_fault_t> faults;
+
+        if (!parse_script(options["script"], faults))
+        {
+            return 1;
+        }
+
+        for (const auto& f : faults)
+        {
+            if (f.player)
+            {
+                player_pcm->AddFault(f.fault_event);
+            }
+
+            if (f.recorder)
+            {
+                recorder_pcm->AddFault(f.fault_event);
+            }
+        }
+
+        std::cout << "Script " << options["script"] << ": " << faults.size() << " faults" << std::endl;
+    }
+
+    if (!player.Open("sim:player", player_params) || !recorder.Open("sim:recorder", recorder_params))
+    {
+        std::cout << "Can't open simulated devices" << std::endl;
+        return 1;
+    }
+
+    player.SetVolume(100);
+    recorder.SetVolume(100);
+
+    std::unique_ptr<audio_processing::AecController> aec_controller;
+
+    if (options.count("aec") != 0)
+    {
+        aec_controller.reset(new audio_processing::AecController(sample_rate, sample_format, 1));
+
+        aec_controller->Reset();
+        aec_controller->SetHighPassFilter(true);
+        aec_controller->SetGainControl(true, 0);
+        aec_controller->SetEchoCancellation(true, 0);
+    }
+
+    std::vector<char> buffer(frame_octets);
+    std::vector<char> prefill(static_cast<std::size_t>(option("prefill-ms", 0) / 10) * frame_octets);
+
+    interval_stats_t total, interval, first_interval;
+    std::uint32_t interval_index = 0;
+
+    const auto rss_start_kb = rss_kb();
+    auto rss_last_kb = rss_start_kb;
+
+    auto wall_begin = std::chrono::steady_clock::now();
+    auto next_report_ns = report_ns;
+
+    auto print_interval = [&](const interval_stats_t& stats)
+    {
+        const auto& ps = player_pcm->GetStats();
+        const auto& rs = recorder_pcm->GetStats();
+
+        auto wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_begin).count();
+        auto virtual_s = static_cast<double>(clock->Now()) / 1e9;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "[" << std::setw(8) << virtual_s / 60.0 << " min]"
+                  << " glitches capture = " << stats.capture_glitches
+                  << ", playback = " << stats.playback_glitches
+                  << " | xruns player = " << ps.xruns
+                  << ", recorder = " << rs.xruns
+                  << ", suspends = " << ps.suspends + rs.suspends
+                  << " | recovery avg = " << std::max(recovery_avg_ms(ps), recovery_avg_ms(rs))
+                  << " ms, max = " << static_cast<double>(std::max(ps.recovery_time_max_ns, rs.recovery_time_max_ns)) / ns_per_ms
+                  << " ms | delay player = " << stats.player_delay.avg_ms()
+                  << " [" << stats.player_delay.min_ms << ", " << stats.player_delay.max_ms << "]"
+                  << " ms, recorder = " << stats.recorder_delay.avg_ms()
+                  << " ms | rss = " << rss_last_kb << " KB"
+                  << " | x" << std::setprecision(0) << (wall_s > 0.0 ? virtual_s / wall_s : 0.0)
+                  << std::endl;
+    };
+
+    std::uint64_t begin_ns = 0;
+
+    // aec_test main loop on the virtual clock
+    while (clock->Now() < duration_ns)
+    {
+        auto ret = recorder.Read(buffer.data(), frame_octets);
+
+        if (ret != static_cast<std::int32_t>(frame_octets))
+        {
+            interval.capture_glitches++;
+        }
+
+        if (aec_controller != nullptr)
+        {
+            aec_controller->Playback(buffer.data(), frame_octets);
+            aec_controller->Capture(buffer.data(), frame_octets);
+        }
+
+        // silence ahead of the frame whenever the player (re)starts,
+        // aec_test has none and the playback queue never gets headroom
+        if (ret > 0 && !prefill.empty() && player.GetDelay() <= 0)
+        {
+            player.Write(prefill.data(), prefill.size());
+        }
+
+        if (ret > 0 && player.Write(buffer.data(), ret) != ret)
+        {
+            interval.playback_glitches++;
+        }
+
+        interval.frames++;
+
+        std::int32_t delay = 0;
+
+        if ((delay = player.GetDelay()) >= 0)
+        {
+            interval.player_delay.add(static_cast<double>(delay) * 1000.0 / sample_rate);
+        }
+
+        if ((delay = recorder.GetDelay()) >= 0)
+        {
+            interval.recorder_delay.add(static_cast<double>(delay) * 1000.0 / sample_rate);
+        }
+
+        begin_ns += 10 * ns_per_ms;
+        clock->AdvanceTo(begin_ns);
+
+        if (clock->Now() >= next_report_ns || clock->Now() >= duration_ns)
+        {
+            rss_last_kb = rss_kb();
+            print_interval(interval);
+
+            if (interval_index++ == 0)
+            {
+                first_interval = interval;
+            }
+
+            total.frames += interval.frames;
+            total.capture_glitches += interval.capture_glitches;
+            total.playback_glitches += interval.playback_glitches;
+
+            next_report_ns += report_ns;
+
+            // drift is last interval against the first one
+            if (clock->Now() < duration_ns)
+            {
+                interval = interval_stats_t();
+            }
+        }
+    }
+
+    const auto& ps = player_pcm->GetStats();
+    const auto& rs = recorder_pcm->GetStats();
+
+    auto wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_begin).count();
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "Soak " << static_cast<double>(clock->Now()) / 3.6e12 << " h in " << wall_s << " s"
+              << ", frames = " << total.frames << std::endl
+              << "glitches: capture = " << total.capture_glitches << ", playback = " << total.playback_glitches << std::endl
+              << "player: xruns = " << ps.xruns << ", suspends = " << ps.suspends
+              << ", partial = " << ps.partial_transfers << ", eagain = " << ps.eagain
+              << ", recoveries = " << ps.recoveries << " (avg " << recovery_avg_ms(ps)
+              << " ms, max " << static_cast<double>(ps.recovery_time_max_ns) / ns_per_ms << " ms)" << std::endl
+              << "recorder: xruns = " << rs.xruns << ", suspends = " << rs.suspends
+              << ", partial = " << rs.partial_transfers << ", eagain = " << rs.eagain
+              << ", recoveries = " << rs.recoveries << " (avg " << recovery_avg_ms(rs)
+              << " ms, max " << static_cast<double>(rs.recovery_time_max_ns) / ns_per_ms << " ms)" << std::endl
+              << "delay drift: player = " << interval.player_delay.avg_ms() - first_interval.player_delay.avg_ms()
+              << " ms, recorder = " << interval.recorder_delay.avg_ms() - first_interval.recorder_delay.avg_ms() << " ms" << std::endl
+              << "rss: start = " << rss_start_kb << " KB, end = " << rss_last_kb
+              << " KB, growth = " << static_cast<std::int64_t>(rss_last_kb) - static_cast<std::int64_t>(rss_start_kb) << " KB" << std::endl;
+
+    return 0;
+}
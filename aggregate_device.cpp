@@ -0,0 +1,510 @@
+#include "aggregate_device.h"
+
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_devices
+{
+
+const std::uint32_t aggregate_ring_ms = 1000;
+const std::int32_t aggregate_poll_timeout_ms = 20;
+const std::uint32_t aggregate_wait_ms = 100;
+
+// ratio control: error in seconds of input, per second
+const double aggregate_error_time_constant = 1.0;
+const double aggregate_proportional_gain = 0.5;
+const double aggregate_integral_gain = 0.05;
+const double aggregate_max_drift = 0.005;
+
+// 4-point Hermite between x0 and x1
+static inline float interpolate(float xm1, float x0, float x1, float x2, float t)
+{
+    float c = (x1 - xm1) * 0.5f;
+    float v = x0 - x1;
+    float w = c + v;
+    float a = w + v + (x2 - x0) * 0.5f;
+    float b = w + a;
+
+    return ((a * t - b) * t + c) * t + x0;
+}
+
+AggregateDevice::AggregateDevice()
+    : m_open(false)
+    , m_volume(100)
+    , m_aligned(false)
+    , m_stop(false)
+    , m_error(0)
+{
+
+}
+
+AggregateDevice::~AggregateDevice()
+{
+    Close();
+}
+
+bool AggregateDevice::Open(const std::string &device_name, const audio_params_t &audio_params)
+{
+    Close();
+
+    std::vector<std::string> names;
+    std::size_t pos = 0;
+
+    while (pos <= device_name.size())
+    {
+        auto end = device_name.find('+', pos);
+        names.push_back(device_name.substr(pos, end == std::string::npos ? std::string::npos : end - pos));
+        pos = end == std::string::npos ? device_name.size() + 1 : end + 1;
+    }
+
+    if (!audio_params.is_init()
+            || !audio_params.recorder
+            || audio_params.audio_format.channels % names.size() != 0)
+    {
+        LOG(error) << "Can't open aggregate device [" << device_name << "]: a recorder with a multiple of " << names.size() << " channels expected" LOG_END;
+        return false;
+    }
+
+    m_audio_params = audio_params;
+
+    auto input_params = audio_params;
+    input_params.audio_format.channels /= names.size();
+    input_params.nonblock_mode = true;
+
+    auto ring_frames = std::uint64_t(1);
+
+    while (ring_frames < static_cast<std::uint64_t>(audio_params.audio_format.sample_rate) * aggregate_ring_ms / 1000)
+    {
+        ring_frames <<= 1;
+    }
+
+    for (const auto& name : names)
+    {
+        std::unique_ptr<input_t> input(new input_t());
+
+        input->name = name;
+        input->device.reset(new AlsaDevice());
+        input->device->SetManualStart(true);
+        input->device->SetVolume(m_volume);
+        input->channels = input_params.audio_format.channels;
+
+        if (!input->device->Open(name, input_params))
+        {
+            LOG(error) << "Can't open aggregate input [" << name << "]" LOG_END;
+
+            m_inputs.clear();
+            return false;
+        }
+
+        auto period_frames = std::max<std::size_t>(input->device->GetPcmConfig().period_frames, input_params.audio_format.sample_rate / 100);
+
+        input->poll_offset = m_descriptors.size();
+        input->poll_count = input->device->GetPollCount();
+        input->transfer.resize(period_frames * input_params.audio_format.frames_octets());
+        input->convert.resize(period_frames * input->channels);
+        input->ring.resize(ring_frames * input->channels);
+        input->ring_mask = ring_frames - 1;
+        input->written = 0;
+        input->read_position = 0.0;
+        input->ratio = 1.0;
+        input->drift = 0.0;
+        input->error = 0.0;
+        input->offset_frames = 0.0;
+        input->overruns = 0;
+
+        m_descriptors.resize(m_descriptors.size() + input->poll_count);
+
+        if (!input->device->GetPollDescriptors(m_descriptors.data() + input->poll_offset, input->poll_count))
+        {
+            LOG(error) << "No poll descriptors of aggregate input [" << name << "]" LOG_END;
+
+            m_inputs.clear();
+            m_descriptors.clear();
+            return false;
+        }
+
+        m_inputs.push_back(std::move(input));
+    }
+
+    // started back to back, alignment takes care of the rest
+    for (auto& input : m_inputs)
+    {
+        input->device->Start();
+    }
+
+    m_aligned = false;
+    m_stop = false;
+    m_error = 0;
+    m_open = true;
+
+    m_thread = std::thread(&AggregateDevice::pollThread, this);
+
+    return true;
+}
+
+bool AggregateDevice::Close()
+{
+    if (!m_open)
+    {
+        return false;
+    }
+
+    m_stop = true;
+    m_signal.notify_all();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    for (auto& input : m_inputs)
+    {
+        input->device->Close();
+    }
+
+    m_inputs.clear();
+    m_descriptors.clear();
+    m_open = false;
+
+    return true;
+}
+
+bool AggregateDevice::IsOpen() const
+{
+    return m_open;
+}
+
+bool AggregateDevice::IsRecorder() const
+{
+    return true;
+}
+
+const audio_params_t &AggregateDevice::GetParams() const
+{
+    return m_audio_params;
+}
+
+bool AggregateDevice::SetParams(const audio_params_t &audio_params)
+{
+    // the inputs are opened for the aggregate format
+    return !m_open && audio_params.recorder && (m_audio_params = audio_params).is_init();
+}
+
+std::int32_t AggregateDevice::Read(void *capture_data, std::size_t size)
+{
+    if (!m_open)
+    {
+        return -EBADF;
+    }
+
+    auto frames = size / m_audio_params.audio_format.frames_octets();
+    auto channels = m_audio_params.audio_format.channels;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto deadline = clock_t::now() + std::chrono::milliseconds(aggregate_wait_ms);
+
+    while (true)
+    {
+        if (m_error < 0)
+        {
+            return m_error;
+        }
+
+        if (!m_aligned)
+        {
+            m_aligned = align();
+        }
+
+        if (m_aligned && isReady(frames))
+        {
+            break;
+        }
+
+        if (m_stop
+                || m_audio_params.nonblock_mode
+                || m_signal.wait_until(lock, deadline) == std::cv_status::timeout)
+        {
+            return -EAGAIN;
+        }
+    }
+
+    // the ring no longer holds the frames to read
+    if (checkOverruns())
+    {
+        m_aligned = align();
+        return -EAGAIN;
+    }
+
+    updateRatios(frames);
+
+    m_output.resize(frames * channels);
+
+    std::uint32_t channel_offset = 0;
+
+    for (std::size_t i = 0; i < m_inputs.size(); i++)
+    {
+        auto& input = *m_inputs[i];
+
+        for (std::size_t f = 0; f < frames; f++)
+        {
+            auto position = input.read_position;
+            auto index = static_cast<std::uint64_t>(position);
+            auto t = static_cast<float>(position - static_cast<double>(index));
+
+            auto xm1 = &input.ring[((index - 1) & input.ring_mask) * input.channels];
+            auto x0 = &input.ring[(index & input.ring_mask) * input.channels];
+            auto x1 = &input.ring[((index + 1) & input.ring_mask) * input.channels];
+            auto x2 = &input.ring[((index + 2) & input.ring_mask) * input.channels];
+
+            auto output = &m_output[f * channels + channel_offset];
+
+            for (std::uint32_t c = 0; c < input.channels; c++)
+            {
+                // the master stays on whole frames
+                output[c] = i == 0
+                        ? x0[c]
+                        : interpolate(xm1[c], x0[c], x1[c], x2[c], t);
+            }
+
+            input.read_position += input.ratio;
+        }
+
+        channel_offset += input.channels;
+    }
+
+    lock.unlock();
+
+    audio_utils::float_to_pcm(m_output.data(), m_output.size(), capture_data, m_audio_params.audio_format.format());
+
+    return static_cast<std::int32_t>(frames * m_audio_params.audio_format.frames_octets());
+}
+
+std::int32_t AggregateDevice::Write(const void *playback_data, std::size_t size)
+{
+    return m_open ? -EACCES : -EBADF;
+}
+
+void AggregateDevice::SetVolume(std::uint32_t volume)
+{
+    m_volume = volume;
+
+    for (auto& input : m_inputs)
+    {
+        input->device->SetVolume(volume);
+    }
+}
+
+aggregate_input_stats_t AggregateDevice::GetInputStats(std::size_t index)
+{
+    aggregate_input_stats_t stats = {};
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (index < m_inputs.size())
+    {
+        const auto& input = *m_inputs[index];
+
+        stats.drift_ppm = (input.ratio - 1.0) * 1e6;
+        stats.offset_ms = input.offset_frames * 1000.0 / m_audio_params.audio_format.sample_rate;
+        stats.frames = input.written;
+        stats.overruns = input.overruns;
+    }
+
+    return stats;
+}
+
+void AggregateDevice::pollThread()
+{
+    while (!m_stop)
+    {
+        auto result = poll(m_descriptors.data(), m_descriptors.size(), aggregate_poll_timeout_ms);
+
+        if (result < 0 && errno != EINTR)
+        {
+            auto error = errno;
+
+            LOG(error) << "Aggregate device poll error, errno = " << error << ", capture stopped" LOG_END;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_error = -error;
+            }
+
+            break;
+        }
+
+        for (auto& input : m_inputs)
+        {
+            auto events = input->device->GetPollEvents(m_descriptors.data() + input->poll_offset, input->poll_count);
+
+            if ((events & (POLLIN | POLLERR)) != 0)
+            {
+                transfer(*input);
+            }
+        }
+    }
+
+    m_signal.notify_all();
+}
+
+void AggregateDevice::transfer(input_t &input)
+{
+    auto frame_octets = input.device->GetParams().audio_format.frames_octets();
+    auto format = input.device->GetParams().audio_format.format();
+
+    while (!m_stop)
+    {
+        auto result = input.device->TryRead(input.transfer.data(), input.transfer.size());
+
+        if (result <= 0)
+        {
+            if (result < 0 && result != -EAGAIN)
+            {
+                LOG(error) << "Aggregate input [" << input.name << "] read error = " << result LOG_END;
+            }
+
+            break;
+        }
+
+        auto frames = static_cast<std::size_t>(result) / frame_octets;
+        auto delay = input.device->GetDelay();
+        auto now = clock_t::now();
+
+        audio_utils::pcm_to_float(input.transfer.data(), frames * input.channels, input.convert.data(), format);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            for (std::size_t f = 0; f < frames; f++)
+            {
+                std::memcpy(&input.ring[((input.written + f) & input.ring_mask) * input.channels]
+                            , &input.convert[f * input.channels]
+                            , input.channels * sizeof(float));
+            }
+
+            input.written += frames;
+
+            // frames still in the device buffer were captured after these
+            input.end_time = now - std::chrono::nanoseconds(static_cast<std::int64_t>(std::max(delay, 0)) * 1000000000ll / m_audio_params.audio_format.sample_rate);
+        }
+
+        m_signal.notify_all();
+    }
+}
+
+double AggregateDevice::capturedFrames(const input_t &input, clock_t::time_point time) const
+{
+    auto elapsed = std::chrono::duration<double>(time - input.end_time).count();
+
+    return static_cast<double>(input.written) + elapsed * m_audio_params.audio_format.sample_rate;
+}
+
+bool AggregateDevice::align()
+{
+    for (const auto& input : m_inputs)
+    {
+        if (input->written == 0)
+        {
+            return false;
+        }
+    }
+
+    // the master's next frame and the frames of the others captured with it
+    auto& master = *m_inputs.front();
+    auto time = master.end_time;
+
+    master.read_position = static_cast<double>(master.written);
+
+    for (std::size_t i = 1; i < m_inputs.size(); i++)
+    {
+        auto& input = *m_inputs[i];
+
+        input.read_position = std::max(capturedFrames(input, time), 1.0);
+        input.offset_frames = static_cast<double>(input.written) - input.read_position;
+        input.error = 0.0;
+        input.ratio = 1.0 + input.drift;
+    }
+
+    LOG(info) << "Aggregate device aligned " << m_inputs.size() << " inputs" LOG_END;
+
+    return true;
+}
+
+bool AggregateDevice::isReady(std::size_t frames) const
+{
+    for (const auto& input : m_inputs)
+    {
+        // the interpolator looks two frames ahead
+        if (input->read_position + frames * input->ratio + 3.0 > static_cast<double>(input->written))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AggregateDevice::checkOverruns()
+{
+    bool overrun = false;
+
+    for (auto& input : m_inputs)
+    {
+        // a reader that fell a ring behind lost frames
+        if (static_cast<double>(input->written) - input->read_position > static_cast<double>(input->ring_mask))
+        {
+            input->overruns++;
+            overrun = true;
+        }
+    }
+
+    if (overrun)
+    {
+        LOG(warning) << "Aggregate device overrun, inputs realigned" LOG_END;
+    }
+
+    return overrun;
+}
+
+void AggregateDevice::updateRatios(std::size_t frames)
+{
+    auto now = clock_t::now();
+    auto& master = *m_inputs.front();
+    auto rate = static_cast<double>(m_audio_params.audio_format.sample_rate);
+    auto dt = frames / rate;
+    auto alpha = std::min(1.0, dt / aggregate_error_time_constant);
+
+    auto master_lag = capturedFrames(master, now) - master.read_position;
+
+    for (std::size_t i = 0; i < m_inputs.size(); i++)
+    {
+        auto& input = *m_inputs[i];
+
+        if (i == 0)
+        {
+            continue;
+        }
+
+        // frames of delay above the master's: a fast input piles them up
+        auto error = (capturedFrames(input, now) - input.read_position) - master_lag;
+
+        input.error += (error - input.error) * alpha;
+        input.drift = std::max(-aggregate_max_drift, std::min(aggregate_max_drift, input.drift + aggregate_integral_gain * input.error / rate * dt));
+        input.ratio = 1.0 + std::max(-aggregate_max_drift, std::min(aggregate_max_drift, input.drift + aggregate_proportional_gain * input.error / rate));
+        input.offset_frames = static_cast<double>(input.written) - input.read_position - (static_cast<double>(master.written) - master.read_position);
+    }
+}
+
+}
@@ -0,0 +1,112 @@
+#ifndef AGGREGATE_DEVICE_H
+#define AGGREGATE_DEVICE_H
+
+#include "alsa_device.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include <poll.h>
+
+namespace audio_devices
+{
+
+struct aggregate_input_stats_t
+{
+    double          drift_ppm;          // rate against the first input
+    double          offset_ms;          // capture time of the aligned frames, against the first input
+    std::uint64_t   frames;             // captured
+    std::uint64_t   overruns;           // frames lost to a slow reader, Read returned -EAGAIN and realigned
+};
+
+// Recorder made of several ALSA capture devices, name "dev1+dev2+...",
+// each with channels / N of the requested channels. One thread polls all
+// inputs and stamps every transfer with its capture time, Read aligns the
+// inputs on it and returns interleaved frames, inputs in name order. The
+// first input is the clock master, the others are resampled with a cubic
+// interpolator at a ratio that keeps their delay equal to the master's, so
+// small rate differences never pile up. A reader a ring behind gets -EAGAIN
+// once and the inputs are realigned; a failed poll stops the thread and
+// every Read returns its error until the device is reopened.
+class AggregateDevice : public AudioDevice
+{
+    using clock_t = std::chrono::steady_clock;
+
+    struct input_t
+    {
+        std::string                                     name;
+        std::unique_ptr<AlsaDevice>                     device;
+        std::uint32_t                                   channels;
+        std::size_t                                     poll_offset;
+        std::size_t                                     poll_count;
+        std::vector<std::uint8_t>                       transfer;
+        std::vector<float>                              convert;
+
+        // guarded by m_mutex
+        std::vector<float>                              ring;           // interleaved
+        std::uint64_t                                   ring_mask;      // frames - 1
+        std::uint64_t                                   written;        // frames
+        clock_t::time_point                             end_time;       // capture time of frame 'written'
+        double                                          read_position;
+        double                                          ratio;
+        double                                          drift;
+        double                                          error;          // filtered, frames
+        double                                          offset_frames;
+        std::uint64_t                                   overruns;
+    };
+
+    bool                                                m_open;
+    audio_params_t                                      m_audio_params;
+    std::uint32_t                                       m_volume;
+
+    std::vector<std::unique_ptr<input_t>>               m_inputs;
+    std::vector<pollfd>                                 m_descriptors;
+    std::vector<float>                                  m_output;
+    bool                                                m_aligned;
+
+    std::thread                                         m_thread;
+    std::mutex                                          m_mutex;
+    std::condition_variable                             m_signal;
+    std::atomic<bool>                                   m_stop;
+    std::atomic<std::int32_t>                           m_error;            // of the poll thread, negative errno
+
+public:
+
+    AggregateDevice();
+    ~AggregateDevice() override;
+
+    bool Open(const std::string& device_name, const audio_params_t& audio_params = null_audio_params) override;
+    bool Close() override;
+
+    bool IsOpen() const override;
+    bool IsRecorder() const override;
+
+    const audio_params_t& GetParams() const override;
+    bool SetParams(const audio_params_t& audio_params) override;
+
+    std::int32_t Read(void* capture_data, std::size_t size) override;
+    std::int32_t Write(const void* playback_data, std::size_t size) override;
+
+    void SetVolume(std::uint32_t volume) override;
+    inline std::uint32_t GetVolume() const override { return m_volume; }
+
+    inline std::size_t GetInputCount() const { return m_inputs.size(); }
+    aggregate_input_stats_t GetInputStats(std::size_t index);
+
+private:
+    void pollThread();
+    void transfer(input_t& input);
+    double capturedFrames(const input_t& input, clock_t::time_point time) const;
+    bool align();
+    bool isReady(std::size_t frames) const;
+    bool checkOverruns();
+    void updateRatios(std::size_t frames);
+};
+
+}
+
+#endif // AGGREGATE_DEVICE_H
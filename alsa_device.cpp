@@ -6,6 +6,7 @@ extern "C"
 }
 
 #include "alsa_device.h"
+#include "frame_pool.h"
 
 #include <cstring>
 #include <algorithm>
@@ -50,66 +51,53 @@ static std::string get_field_from_hint(const void* hint, const char* field_name)
 	return std::move(result);
 }
 
-snd_pcm_format_t bits_to_snd_format(std::uint32_t bits)
+snd_pcm_format_t sample_format_to_snd_format(sample_format_t sample_format)
 {
     snd_pcm_format_t result = SND_PCM_FORMAT_UNKNOWN;
 
-    switch(bits)
+    switch(sample_format)
     {
-        case 8:
+        case sample_format_t::u8:
             result = SND_PCM_FORMAT_U8;
         break;
-        case 16:
+        case sample_format_t::s16_le:
 			result = SND_PCM_FORMAT_S16_LE;
         break;
-        case 32:
+        case sample_format_t::s24_3le:
+			result = SND_PCM_FORMAT_S24_3LE;
+        break;
+        case sample_format_t::s24_le:
+			result = SND_PCM_FORMAT_S24_LE;
+        break;
+        case sample_format_t::s32_le:
 			result = SND_PCM_FORMAT_S32_LE;
+        break;
+        case sample_format_t::float_le:
+			result = SND_PCM_FORMAT_FLOAT_LE;
+        break;
+        default:;
     }
 
     return result;
 }
 
-template<typename Tval>
-void change_volume(const void *sound_data, std::size_t size, void *output_data, std::uint32_t volume)
-{
-    volume = std::min(100u, std::max(0u, volume));
-
-    for (int i = 0; i < size / sizeof(Tval); i++)
-    {
-
-        auto& input_sample = *(static_cast<const Tval*>(sound_data) + i);
-        auto& output_sample = *(static_cast<Tval*>(output_data) + i);
-
-        output_sample = static_cast<Tval>((static_cast<double>(input_sample) * static_cast<double>(volume)) / 100.0f);
-
-    }
-}
-
-void change_volume(const void *sound_data, std::size_t size, void* output_data, std::uint32_t bit_per_sample, std::uint32_t volume)
-{
-    switch(bit_per_sample)
-    {
-        case 8:
-            change_volume<std::int8_t>(sound_data, size, output_data, volume);
-        break;
-        case 16:
-            change_volume<std::int16_t>(sound_data, size, output_data, volume);
-        break;
-        case 32:
-            change_volume<std::int32_t>(sound_data, size, output_data, volume);
-        break;
-    }
-}
 }
 
 AlsaDevice::AlsaDevice()
 		: m_handle(nullptr)
         , m_device_name("default")
         , m_volume(100)
+        , m_manual_start(false)
 {
 
 }
 
+AlsaDevice::AlsaDevice(std::unique_ptr<PcmBackend> backend)
+		: AlsaDevice()
+{
+	m_backend = std::move(backend);
+}
+
 AlsaDevice::~AlsaDevice()
 {
 	Close();
@@ -217,7 +205,26 @@ bool AlsaDevice::Open(const std::string &device_name, const audio_params_t& audi
 		Close();
 	}
 
-	if ( audio_params.is_init() )
+	// SetParams reopens the backend by this name
+	m_device_name = device_name;
+
+	if ( audio_params.is_init() && m_backend != nullptr )
+	{
+		auto err = m_backend->Open(device_name, audio_params, m_manual_start, m_pcm_config);
+
+		result = err >= 0;
+
+		if (result)
+		{
+			m_audio_params = audio_params;
+			LOG(info) "Open backend device [" << device_name << "]: success" LOG_END;
+		}
+		else
+		{
+			LOG(warning) << "Can't Open backend device [" << device_name << "]: errno = " << err LOG_END;
+		}
+	}
+	else if ( audio_params.is_init() )
 	{
 
 		auto err = snd_pcm_open(&m_handle
@@ -257,6 +264,12 @@ bool AlsaDevice::Close()
 {
     bool result = false;
 
+	if (m_backend != nullptr && m_backend->IsOpen())
+	{
+		m_backend->Close();
+		result = true;
+	}
+
 	if (m_handle != nullptr)
 	{
 		snd_pcm_abort(m_handle);
@@ -272,7 +285,8 @@ bool AlsaDevice::Close()
 
 bool AlsaDevice::IsOpen() const
 {
-    return m_handle != nullptr;
+    return m_handle != nullptr
+            || (m_backend != nullptr && m_backend->IsOpen());
 }
 
 bool AlsaDevice::IsRecorder() const
@@ -287,7 +301,11 @@ const audio_params_t &AlsaDevice::GetParams() const
 
 bool AlsaDevice::SetParams(const audio_params_t &audio_params)
 {
-	bool result = audio_params.is_init() && (!IsOpen() || setHardwareParams(audio_params) >= 0);
+	bool result = audio_params.is_init()
+			&& (!IsOpen()
+				|| (m_backend != nullptr
+					? m_backend->Open(m_device_name, audio_params, m_manual_start, m_pcm_config) >= 0
+					: setHardwareParams(audio_params) >= 0));
 
 	if (result == true)
 	{
@@ -363,10 +381,10 @@ std::int32_t AlsaDevice::setHardwareParams(const audio_params_t& audio_params)
 					break;
 				}
 
-                result = snd_pcm_hw_params_set_format(m_handle, hw_params, alsa_utils::bits_to_snd_format(audio_params.audio_format.bit_per_sample));
+                result = snd_pcm_hw_params_set_format(m_handle, hw_params, alsa_utils::sample_format_to_snd_format(audio_params.audio_format.format()));
 				if (result < 0)
 				{
-					LOG(error) << "Can't set format S" << audio_params.audio_format.bit_per_sample << " hardware params, errno = " << result LOG_END;
+					LOG(error) << "Can't set format " << sample_format_name(audio_params.audio_format.format()) << " hardware params, errno = " << result LOG_END;
 					break;
 				}
 
@@ -385,33 +403,60 @@ std::int32_t AlsaDevice::setHardwareParams(const audio_params_t& audio_params)
 					break;
 				}
 
-				//default buffer_size
-				if(audio_params.buffer_size == 0)
+				// the callers size frames and resamplers from the requested rate
+				if (sample_rate != audio_params.audio_format.sample_rate)
 				{
+					LOG(error) << "Sample rate " << audio_params.audio_format.sample_rate << " not supported, granted " << sample_rate LOG_END;
+					result = -EINVAL;
 					break;
 				}
 
-				snd_pcm_uframes_t period_size = (audio_params.buffer_size * audio_params.audio_format.bit_per_sample) / 8;
-				result = snd_pcm_hw_params_set_buffer_size_near(m_handle, hw_params, &period_size);
-
-				if (result < 0)
+				// default buffer_size if not set
+				if (audio_params.buffer_size != 0)
 				{
-					LOG(error) << "Can't set buffer size " << period_size << " hardware params, errno = " << result LOG_END;
-					break;
+					snd_pcm_uframes_t period_size = audio_params.buffer_size;
+					result = snd_pcm_hw_params_set_period_size_near(m_handle, hw_params, &period_size, nullptr);
+					if (result < 0)
+					{
+						LOG(error) << "Can't set period size " << period_size << " hardware params, errno = " << result LOG_END;
+						break;
+					}
+
+					snd_pcm_uframes_t buffer_size = period_size * std::max(2u, audio_params.period_count);
+					result = snd_pcm_hw_params_set_buffer_size_near(m_handle, hw_params, &buffer_size);
+					if (result < 0)
+					{
+						LOG(error) << "Can't set buffer size " << buffer_size << " hardware params, errno = " << result LOG_END;
+						break;
+					}
 				}
 
-				period_size = audio_params.buffer_size;
-				result = snd_pcm_hw_params_set_period_size_near(m_handle, hw_params, &period_size, nullptr);
-				if (result < 0)
+				result = snd_pcm_hw_params(m_handle, hw_params);
+				if(result < 0)
 				{
-					LOG(error) << "Can't set period size " << period_size << " hardware params, errno = " << result LOG_END;
+					LOG(error) << "Can't set hardware params, errno = " << result LOG_END;
 					break;
 				}
 
-				result = snd_pcm_hw_params(m_handle, hw_params);
+				// read back what the driver really granted
+				pcm_config_t pcm_config;
+				snd_pcm_uframes_t frames = 0;
+				unsigned int value = 0;
+
+				snd_pcm_hw_params_get_rate(hw_params, &value, nullptr);
+				pcm_config.sample_rate = value;
+				snd_pcm_hw_params_get_period_size(hw_params, &frames, nullptr);
+				pcm_config.period_frames = frames;
+				snd_pcm_hw_params_get_buffer_size(hw_params, &frames);
+				pcm_config.buffer_frames = frames;
+				snd_pcm_hw_params_get_periods(hw_params, &value, nullptr);
+				pcm_config.periods = value;
+
+				m_pcm_config = pcm_config;
+
+				result = setSoftwareParams(audio_params);
 				if(result < 0)
 				{
-					LOG(error) << "Can't set hardware params, errno = " << errno LOG_END;
 					break;
 				}
 
@@ -427,17 +472,118 @@ std::int32_t AlsaDevice::setHardwareParams(const audio_params_t& audio_params)
 
 		}
 
+		if (result >= 0)
+		{
+			LOG(info) << "Set hardware params success: rate = " << m_pcm_config.sample_rate
+					  << ", period = " << m_pcm_config.period_frames
+					  << ", buffer = " << m_pcm_config.buffer_frames
+					  << " (" << m_pcm_config.buffer_duration_us() << " us)"
+					  << ", start = " << m_pcm_config.start_threshold
+					  << ", stop = " << m_pcm_config.stop_threshold
+					  << ", avail_min = " << m_pcm_config.avail_min LOG_END;
+		}
+	}
+
+    return result;
+}
+
+std::int32_t AlsaDevice::setSoftwareParams(const audio_params_t &audio_params)
+{
+	std::int32_t result = -EINVAL;
+
+	snd_pcm_sw_params_t* sw_params = nullptr;
+	snd_pcm_sw_params_alloca(&sw_params);
+
+	// for braking seq
+	do
+	{
+		result = snd_pcm_sw_params_current(m_handle, sw_params);
 		if (result < 0)
 		{
-			result = -errno;
+			LOG(error) << "Can't get software params, errno = " << result LOG_END;
+			break;
 		}
-		else
+
+		if (audio_params.latency_profile == latency_profile_t::low_latency)
 		{
-			LOG(info) << "Set hardware params success " << errno LOG_END;
+			// playback starts as soon as the first period is queued, capture on the first read
+			snd_pcm_uframes_t start_threshold = audio_params.recorder ? 1 : m_pcm_config.period_frames;
+
+			result = snd_pcm_sw_params_set_start_threshold(m_handle, sw_params, start_threshold);
+			if (result < 0)
+			{
+				LOG(error) << "Can't set start threshold " << start_threshold << ", errno = " << result LOG_END;
+				break;
+			}
+
+			// stop (xrun) as soon as the whole buffer is empty/full
+			result = snd_pcm_sw_params_set_stop_threshold(m_handle, sw_params, m_pcm_config.buffer_frames);
+			if (result < 0)
+			{
+				LOG(error) << "Can't set stop threshold " << m_pcm_config.buffer_frames << ", errno = " << result LOG_END;
+				break;
+			}
+
+			result = snd_pcm_sw_params_set_avail_min(m_handle, sw_params, m_pcm_config.period_frames);
+			if (result < 0)
+			{
+				LOG(error) << "Can't set avail min " << m_pcm_config.period_frames << ", errno = " << result LOG_END;
+				break;
+			}
+
+			result = snd_pcm_sw_params_set_tstamp_mode(m_handle, sw_params, SND_PCM_TSTAMP_ENABLE);
+			if (result < 0)
+			{
+				LOG(error) << "Can't enable timestamps, errno = " << result LOG_END;
+				break;
+			}
+
+			// timestamp type is optional: older drivers have gettimeofday only
+			if (snd_pcm_sw_params_set_tstamp_type(m_handle, sw_params, SND_PCM_TSTAMP_TYPE_MONOTONIC) < 0)
+			{
+				LOG(warning) << "Can't set monotonic timestamps" LOG_END;
+			}
+		}
+
+		if (m_manual_start)
+		{
+			// never starts by itself, only by Start() or a linked device
+			snd_pcm_uframes_t boundary = 0;
+			snd_pcm_sw_params_get_boundary(sw_params, &boundary);
+
+			result = snd_pcm_sw_params_set_start_threshold(m_handle, sw_params, boundary);
+			if (result < 0)
+			{
+				LOG(error) << "Can't set start threshold " << boundary << ", errno = " << result LOG_END;
+				break;
+			}
+		}
+
+		if (audio_params.latency_profile == latency_profile_t::low_latency || m_manual_start)
+		{
+			result = snd_pcm_sw_params(m_handle, sw_params);
+			if (result < 0)
+			{
+				LOG(error) << "Can't set software params, errno = " << result LOG_END;
+				break;
+			}
 		}
+
+		snd_pcm_uframes_t frames = 0;
+		snd_pcm_tstamp_t tstamp_mode = SND_PCM_TSTAMP_NONE;
+
+		snd_pcm_sw_params_get_start_threshold(sw_params, &frames);
+		m_pcm_config.start_threshold = frames;
+		snd_pcm_sw_params_get_stop_threshold(sw_params, &frames);
+		m_pcm_config.stop_threshold = frames;
+		snd_pcm_sw_params_get_avail_min(sw_params, &frames);
+		m_pcm_config.avail_min = frames;
+		snd_pcm_sw_params_get_tstamp_mode(sw_params, &tstamp_mode);
+		m_pcm_config.timestamps = tstamp_mode != SND_PCM_TSTAMP_NONE;
 	}
+	while(false);
 
-    return result;
+	return result;
 }
 
 std::int32_t AlsaDevice::internalRead(void *capture_data, std::size_t size)
@@ -460,21 +606,29 @@ std::int32_t AlsaDevice::internalRead(void *capture_data, std::size_t size)
         io_complete = false;
         retry_read_count++;
 
-        auto err = snd_pcm_readi(m_handle, data, size / frame_bytes);
+        auto err = pcmRead(data, size / frame_bytes);
 
         switch(err)
         {
             case -EPIPE:
-                snd_pcm_prepare(m_handle);
+            case -ESTRPIPE:
+
+                // xrun or suspend, the call gives up while the stream is
+                // still resuming
+
+                if ( pcmRecover(err) < 0 )
+                {
+                    io_complete = true;
+                }
+
             break;
 
-            case -ESTRPIPE:
             case -EAGAIN:
 
                 // сюда попадаем если устройство не готово, snd_pcm_wait вернет 1,
                 // если устройство освободилось за заданный таймаут в мсек
 
-                if ( snd_pcm_wait( m_handle, m_audio_params.audio_format.duration_ms(size) ) != 1 )
+                if ( pcmWait( m_audio_params.audio_format.duration_ms(size) ) != 1 )
                 {
                     io_complete = true;
                 }
@@ -514,7 +668,7 @@ std::int32_t AlsaDevice::internalRead(void *capture_data, std::size_t size)
 
     if (result >= 0)
 	{
-        alsa_utils::change_volume(capture_data, size, capture_data, m_audio_params.audio_format.bit_per_sample, m_volume);
+        audio_utils::change_volume(capture_data, total, capture_data, m_audio_params.audio_format.format(), m_volume);
 		// LOG(debug) << "Read " << total << " bytes from device success" LOG_END;
 	}
 	else
@@ -535,11 +689,15 @@ std::int32_t AlsaDevice::internalWrite(const void *playback_data, std::size_t si
     std::int32_t retry_write_count = 0;
     bool io_complete = false;
 
-    m_sample_buffer.resize(size);
+    if (!audio_processing::reserve_frame(m_sample_buffer, size))
+    {
+        LOG(error) << "No sample buffer of " << size << " bytes" LOG_END;
+        return -ENOMEM;
+    }
 
-    alsa_utils::change_volume(playback_data, size, m_sample_buffer.data(), m_audio_params.audio_format.bit_per_sample, m_volume);
+    audio_utils::change_volume(playback_data, size, m_sample_buffer.Data(), m_audio_params.audio_format.format(), m_volume);
 
-    auto data = m_sample_buffer.data();
+    auto data = m_sample_buffer.Data();
 
     do
     {
@@ -550,21 +708,29 @@ std::int32_t AlsaDevice::internalWrite(const void *playback_data, std::size_t si
         io_complete = false;
         retry_write_count++;
 
-        auto err = snd_pcm_writei(m_handle, data, size / frame_bytes);
+        auto err = pcmWrite(data, size / frame_bytes);
 
         switch(err)
         {
             case -EPIPE:
-                snd_pcm_prepare(m_handle);
+            case -ESTRPIPE:
+
+                // xrun or suspend, the call gives up while the stream is
+                // still resuming
+
+                if ( pcmRecover(err) < 0 )
+                {
+                    io_complete = true;
+                }
+
             break;
 
-            case -ESTRPIPE:
             case -EAGAIN:
 
                 // сюда попадаем если устройство не готово, snd_pcm_wait вернет 1,
                 // если устройство освободилось за заданный таймаут в мсек
 
-                if ( snd_pcm_wait( m_handle, m_audio_params.audio_format.duration_ms(size) ) != 1 )
+                if ( pcmWait( m_audio_params.audio_format.duration_ms(size) ) != 1 )
                 {
                     io_complete = true;
                 }
@@ -616,4 +782,276 @@ std::int32_t AlsaDevice::internalWrite(const void *playback_data, std::size_t si
     return result;
 }
 
+std::size_t AlsaDevice::GetPollCount() const
+{
+	auto count = m_handle != nullptr
+			? snd_pcm_poll_descriptors_count(m_handle)
+			: 0;
+
+	return count > 0 ? static_cast<std::size_t>(count) : 0;
+}
+
+bool AlsaDevice::GetPollDescriptors(pollfd *descriptors, std::size_t count) const
+{
+	return m_handle != nullptr
+			&& snd_pcm_poll_descriptors(m_handle, descriptors, count) == static_cast<int>(count);
+}
+
+std::uint16_t AlsaDevice::GetPollEvents(pollfd *descriptors, std::size_t count) const
+{
+	unsigned short revents = 0;
+
+	if (m_handle == nullptr
+			|| snd_pcm_poll_descriptors_revents(m_handle, descriptors, count, &revents) < 0)
+	{
+		return POLLERR;
+	}
+
+	return revents;
+}
+
+std::int32_t AlsaDevice::TryRead(void *capture_data, std::size_t size)
+{
+	if (m_handle == nullptr)
+	{
+		return -EBADF;
+	}
+
+	if (!IsRecorder())
+	{
+		return -EACCES;
+	}
+
+	auto frame_bytes = m_audio_params.audio_format.frames_octets();
+	auto frames = readyFrames();
+
+	if (frames <= 0)
+	{
+		return frames < 0 ? frames : -EAGAIN;
+	}
+
+	auto err = snd_pcm_readi(m_handle, capture_data, std::min<std::size_t>(frames, size / frame_bytes));
+
+	if (err == -EPIPE || err == -ESTRPIPE)
+	{
+		err = pcmRecover(err);
+		return err < 0 ? err : -EAGAIN;
+	}
+
+	if (err > 0)
+	{
+		err *= frame_bytes;
+		audio_utils::change_volume(capture_data, err, capture_data, m_audio_params.audio_format.format(), m_volume);
+	}
+
+	return err;
+}
+
+std::int32_t AlsaDevice::TryWrite(const void *playback_data, std::size_t size)
+{
+	if (m_handle == nullptr)
+	{
+		return -EBADF;
+	}
+
+	if (IsRecorder())
+	{
+		return -EACCES;
+	}
+
+	auto frame_bytes = m_audio_params.audio_format.frames_octets();
+	auto frames = readyFrames();
+
+	if (frames <= 0)
+	{
+		return frames < 0 ? frames : -EAGAIN;
+	}
+
+	size = std::min<std::size_t>(frames, size / frame_bytes) * frame_bytes;
+
+	if (!audio_processing::reserve_frame(m_sample_buffer, size))
+	{
+		return -ENOMEM;
+	}
+
+	audio_utils::change_volume(playback_data, size, m_sample_buffer.Data(), m_audio_params.audio_format.format(), m_volume);
+
+	auto err = snd_pcm_writei(m_handle, m_sample_buffer.Data(), size / frame_bytes);
+
+	if (err == -EPIPE || err == -ESTRPIPE)
+	{
+		err = pcmRecover(err);
+		return err < 0 ? err : -EAGAIN;
+	}
+
+	return err > 0 ? err * frame_bytes : err;
+}
+
+std::int32_t AlsaDevice::readyFrames()
+{
+	auto avail = snd_pcm_avail_update(m_handle);
+
+	if (avail == -EPIPE || avail == -ESTRPIPE)
+	{
+		auto err = pcmRecover(avail);
+
+		if (err < 0)
+		{
+			return err;
+		}
+
+		avail = snd_pcm_avail_update(m_handle);
+	}
+
+	// capture starts on the first read, a prepared stream never gets ready
+	if (avail == 0 && IsRecorder() && !m_manual_start
+			&& snd_pcm_state(m_handle) == SND_PCM_STATE_PREPARED)
+	{
+		snd_pcm_start(m_handle);
+	}
+
+	return static_cast<std::int32_t>(avail);
+}
+
+std::int32_t AlsaDevice::pcmRead(void *data, std::uint32_t frames)
+{
+	return m_backend != nullptr
+			? m_backend->ReadFrames(data, frames)
+			: static_cast<std::int32_t>(snd_pcm_readi(m_handle, data, frames));
+}
+
+std::int32_t AlsaDevice::pcmWrite(const void *data, std::uint32_t frames)
+{
+	return m_backend != nullptr
+			? m_backend->WriteFrames(data, frames)
+			: static_cast<std::int32_t>(snd_pcm_writei(m_handle, data, frames));
+}
+
+std::int32_t AlsaDevice::pcmWait(std::int32_t timeout_ms)
+{
+	return m_backend != nullptr
+			? m_backend->Wait(timeout_ms)
+			: snd_pcm_wait(m_handle, timeout_ms);
+}
+
+std::int32_t AlsaDevice::pcmRecover(std::int32_t err)
+{
+	if (err == -ESTRPIPE)
+	{
+		// -EAGAIN while the hardware is still resuming,
+		// drivers without resume support need prepare
+		err = m_backend != nullptr
+				? m_backend->Resume()
+				: snd_pcm_resume(m_handle);
+
+		if (err >= 0 || err == -EAGAIN)
+		{
+			return err;
+		}
+	}
+
+	return m_backend != nullptr
+			? m_backend->Prepare()
+			: snd_pcm_prepare(m_handle);
+}
+
+bool AlsaDevice::Start()
+{
+	bool result = false;
+
+	if ( IsOpen() )
+	{
+		auto err = m_backend != nullptr
+				? m_backend->Start()
+				: snd_pcm_start(m_handle);
+
+		result = err >= 0;
+
+		if (!result)
+		{
+			LOG(error) << "Can't start device [" << m_device_name << "], errno = " << err LOG_END;
+		}
+	}
+
+	return result;
+}
+
+bool AlsaDevice::Link(AlsaDevice &device)
+{
+	bool result = false;
+
+	// backends have no hardware link, duplex falls back to trigger timestamps
+	if ( IsOpen() && device.IsOpen() && m_handle != nullptr && device.m_handle != nullptr )
+	{
+		auto err = snd_pcm_link(m_handle, device.m_handle);
+
+		result = err >= 0;
+
+		if (!result)
+		{
+			LOG(warning) << "Can't link devices, errno = " << err LOG_END;
+		}
+	}
+
+	return result;
+}
+
+bool AlsaDevice::Unlink()
+{
+	return m_handle != nullptr && snd_pcm_unlink(m_handle) >= 0;
+}
+
+std::int32_t AlsaDevice::GetDelay() const
+{
+	std::int32_t result = -EBADF;
+
+	if ( m_backend != nullptr && m_backend->IsOpen() )
+	{
+		std::int32_t delay = 0;
+
+		result = m_backend->Delay(delay);
+
+		if (result >= 0)
+		{
+			result = delay;
+		}
+	}
+	else if ( IsOpen() )
+	{
+		snd_pcm_sframes_t delay = 0;
+
+		result = snd_pcm_delay(m_handle, &delay);
+
+		if (result >= 0)
+		{
+			result = static_cast<std::int32_t>(delay);
+		}
+	}
+
+	return result;
+}
+
+bool AlsaDevice::GetTriggerTime(std::uint64_t &time_ns) const
+{
+	bool result = false;
+
+	if ( m_handle != nullptr )
+	{
+		snd_pcm_status_t* status = nullptr;
+		snd_pcm_status_alloca(&status);
+
+		if (snd_pcm_status(m_handle, status) >= 0)
+		{
+			snd_htimestamp_t trigger_time = {};
+			snd_pcm_status_get_trigger_htstamp(status, &trigger_time);
+
+			time_ns = static_cast<std::uint64_t>(trigger_time.tv_sec) * 1000000000ull + trigger_time.tv_nsec;
+
+			result = time_ns != 0;
+		}
+	}
+
+	return result;
+}
+
 }
@@ -1,10 +1,16 @@
 #ifndef ALSA_DEVICE_H
 #define ALSA_DEVICE_H
 
+#include "audio_device.h"
+#include "pcm_backend.h"
+#include "audio_frame.h"
+
 #include <string>
 #include <vector>
 #include <memory>
 
+struct pollfd;
+
 namespace audio_devices
 {
 
@@ -12,64 +18,11 @@ namespace audio_devices
 struct snd_pcm_t;
 #endif
 
-struct audio_format_t
-{
-    std::uint32_t   sample_rate;
-    std::uint32_t   bit_per_sample;
-    std::uint32_t   channels;
-
-	audio_format_t(std::uint32_t sr = 0, std::uint32_t bps = 0, std::uint32_t c = 0)
-        : sample_rate(sr)
-        , bit_per_sample(bps)
-        , channels(c)
-    {}
-
-	inline bool is_init() const { return sample_rate >= 8000 && bit_per_sample > 7 && channels > 0; }
-    inline std::uint32_t frames_octets() const { return (bit_per_sample * channels) / 8; }
-    inline std::uint32_t bytes_per_second() const { return (sample_rate * bit_per_sample * channels) / 8; }
-    inline std::uint32_t duration_ms(std::size_t size) const { return (size * 1000) / bytes_per_second(); }
-    inline std::size_t octets_count(std::uint32_t duration_ms) const { return (duration_ms * bytes_per_second()) / 1000; }
-};
-
-static const audio_format_t default_audio_format = { 44100, 16, 1 };
-static const audio_format_t null_audio_format = { 0, 0, 0 };
-
-struct audio_params_t
-{
-	bool			recorder;
-	audio_format_t	audio_format;
-	std::uint32_t	buffer_size;
-	bool			nonblock_mode;
-
-	audio_params_t(bool rec = false, const audio_format_t& afmt = null_audio_format, std::uint32_t bsz = 0, bool nonblock = false)
-		: recorder(rec)
-		, audio_format(afmt)
-		, buffer_size(bsz)
-		, nonblock_mode(nonblock)
-	{}
-
-	inline bool is_init() const { return audio_format.is_init(); }
-};
-
-
-static const audio_params_t default_audio_params = { false, default_audio_format, 0, false };
-static const audio_params_t null_audio_params = { false, null_audio_format, 0, false };
-
-struct audio_device_info
-{
-    std::string name;
-    std::string description;
-    std::string hint;
-    bool        input;
-    bool        output;
-};
-
-class AlsaDevice
+class AlsaDevice : public AudioDevice
 {
 public:
 
     using device_names_list_t = std::vector<audio_device_info>;
-    using sample_buffer_t = std::vector<std::uint8_t>;
 
 private:
 
@@ -79,40 +32,82 @@ private:
 
 	audio_params_t					m_audio_params;
 
+	pcm_config_t					m_pcm_config;
+
     std::uint32_t                   m_volume;
 
-    sample_buffer_t                 m_sample_buffer;
+    // volume scaled playback data, shared frame pool block
+    audio_processing::FrameRef      m_sample_buffer;
+
+    bool                            m_manual_start;
+
+    // simulated or other non-libasound stream, nullptr - ALSA
+    std::unique_ptr<PcmBackend>     m_backend;
 
 
 public:
 
     AlsaDevice();
-    ~AlsaDevice();
+    explicit AlsaDevice(std::unique_ptr<PcmBackend> backend);
+    ~AlsaDevice() override;
 
     static const device_names_list_t GetDeviceList(bool recorder, const std::string& hw_profile = "");
 
-	bool Open(const std::string& device_name, const audio_params_t& audio_params = null_audio_params);
-    bool Close();
+	bool Open(const std::string& device_name, const audio_params_t& audio_params = null_audio_params) override;
+    bool Close() override;
+
+    bool IsOpen() const override;
+	bool IsRecorder() const override;
 
-    inline bool IsOpen() const;
-	inline bool IsRecorder() const;
+	const audio_params_t& GetParams() const override;
+	bool SetParams(const audio_params_t& audio_params) override;
 
-	inline const audio_params_t& GetParams() const;
-	bool SetParams(const audio_params_t& audio_params);
+	std::int32_t Read(void* capture_data, std::size_t size) override;
+	std::int32_t Write(const void* playback_data, std::size_t size) override;
 
-	std::int32_t Read(void* capture_data, std::size_t size);
-	std::int32_t Write(const void* playback_data, std::size_t size);
+    inline void SetVolume(std::uint32_t volume) override { m_volume = volume; }
+    inline std::uint32_t GetVolume() const override { return m_volume; }
 
-    inline void SetVolume(std::uint32_t volume) { m_volume = volume; }
-    inline std::uint32_t GetVolume() const { return m_volume; }
+    // actual parameters after Open/SetParams
+    inline const pcm_config_t& GetPcmConfig() const { return m_pcm_config; }
+
+    // device does not start on the first io, applied by the next Open/SetParams
+    inline void SetManualStart(bool manual_start) { m_manual_start = manual_start; }
+    bool Start();
+
+    // linked devices start and stop together
+    bool Link(AlsaDevice& device);
+    bool Unlink();
+
+    // frames between application pointer and the hardware, negative on error
+    std::int32_t GetDelay() const;
+    // monotonic (if timestamps enabled) time of the last start, ns
+    bool GetTriggerTime(std::uint64_t& time_ns) const;
+
+    // poll(2) support for reactors, ALSA streams only
+    std::size_t GetPollCount() const;
+    bool GetPollDescriptors(pollfd* descriptors, std::size_t count) const;
+    // POLLIN/POLLOUT/POLLERR of the stream after poll, 0 - not ready
+    std::uint16_t GetPollEvents(pollfd* descriptors, std::size_t count) const;
+
+    // one transfer of the frames ready now, never blocks: bytes or -EAGAIN
+    std::int32_t TryRead(void* capture_data, std::size_t size);
+    std::int32_t TryWrite(const void* playback_data, std::size_t size);
 
 private:
 
 	std::int32_t setHardwareParams(const audio_params_t& audio_params);
+	std::int32_t setSoftwareParams(const audio_params_t& audio_params);
 
 	std::int32_t internalRead(void* capture_data, std::size_t size);
 	std::int32_t internalWrite(const void* playback_data, std::size_t size);
 
+	std::int32_t pcmRead(void* data, std::uint32_t frames);
+	std::int32_t pcmWrite(const void* data, std::uint32_t frames);
+	std::int32_t pcmWait(std::int32_t timeout_ms);
+	std::int32_t pcmRecover(std::int32_t err);
+	std::int32_t readyFrames();
+
 };
 
 }
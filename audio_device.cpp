@@ -0,0 +1,141 @@
+#include "audio_device.h"
+
+#include "alsa_device.h"
+#include "file_device.h"
+#include "null_device.h"
+#include "loopback_device.h"
+#include "aggregate_device.h"
+
+#include <algorithm>
+
+namespace audio_devices
+{
+
+namespace audio_utils
+{
+
+template<typename Tval>
+void change_volume(const void *sound_data, std::size_t size, void *output_data, std::uint32_t volume)
+{
+    volume = std::min(100u, std::max(0u, volume));
+
+    for (int i = 0; i < size / sizeof(Tval); i++)
+    {
+
+        auto& input_sample = *(static_cast<const Tval*>(sound_data) + i);
+        auto& output_sample = *(static_cast<Tval*>(output_data) + i);
+
+        output_sample = static_cast<Tval>((static_cast<double>(input_sample) * static_cast<double>(volume)) / 100.0f);
+
+    }
+}
+
+void change_volume(const void *sound_data, std::size_t size, void* output_data, sample_format_t sample_format, std::uint32_t volume)
+{
+    switch(sample_format)
+    {
+        case sample_format_t::s16_le:
+            change_volume<std::int16_t>(sound_data, size, output_data, volume);
+        break;
+        case sample_format_t::s32_le:
+            change_volume<std::int32_t>(sound_data, size, output_data, volume);
+        break;
+        case sample_format_t::float_le:
+            change_volume<float>(sound_data, size, output_data, volume);
+        break;
+        case sample_format_t::u8:
+        case sample_format_t::s24_3le:
+        case sample_format_t::s24_le:
+        {
+            // no native arithmetic type, scaled through float in blocks
+            const std::size_t block_samples = 256;
+            float float_buffer[block_samples];
+
+            auto sample_octets = sample_format_bits(sample_format) / 8;
+            auto sample_count = size / sample_octets;
+            auto input_ptr = static_cast<const std::uint8_t*>(sound_data);
+            auto output_ptr = static_cast<std::uint8_t*>(output_data);
+            auto scale = static_cast<float>(std::min(100u, volume)) / 100.0f;
+
+            for (std::size_t i = 0; i < sample_count; i += block_samples)
+            {
+                auto count = std::min(block_samples, sample_count - i);
+
+                pcm_to_float(input_ptr + i * sample_octets, count, float_buffer, sample_format);
+
+                for (std::size_t s = 0; s < count; s++)
+                {
+                    float_buffer[s] *= scale;
+                }
+
+                float_to_pcm(float_buffer, count, output_ptr + i * sample_octets, sample_format);
+            }
+        }
+        break;
+        default:;
+    }
+}
+
+}
+
+std::unique_ptr<AudioDevice> AudioDevice::Create(audio_device_type_t device_type)
+{
+    std::unique_ptr<AudioDevice> device;
+
+    switch(device_type)
+    {
+        case audio_device_type_t::alsa:
+            device.reset(new AlsaDevice());
+        break;
+        case audio_device_type_t::file:
+            device.reset(new FileDevice());
+        break;
+        case audio_device_type_t::null:
+            device.reset(new NullDevice());
+        break;
+        case audio_device_type_t::loopback:
+            device.reset(new LoopbackDevice());
+        break;
+        case audio_device_type_t::aggregate:
+            device.reset(new AggregateDevice());
+        break;
+    }
+
+    return device;
+}
+
+std::unique_ptr<AudioDevice> AudioDevice::Create(const std::string &device_spec, std::string &device_name)
+{
+    static const struct
+    {
+        const char*             prefix;
+        audio_device_type_t     type;
+    }
+    device_types[] =
+    {
+        { "alsa:", audio_device_type_t::alsa },
+        { "file:", audio_device_type_t::file },
+        { "null:", audio_device_type_t::null },
+        { "loopback:", audio_device_type_t::loopback },
+        { "aggregate:", audio_device_type_t::aggregate }
+    };
+
+    for (const auto& t : device_types)
+    {
+        std::string prefix(t.prefix);
+
+        if (device_spec.compare(0, prefix.size(), prefix) == 0)
+        {
+            device_name = device_spec.substr(prefix.size());
+            return Create(t.type);
+        }
+    }
+
+    device_name = device_spec;
+
+    return Create(device_spec == "null"
+                  ? audio_device_type_t::null
+                  : audio_device_type_t::alsa);
+}
+
+}
@@ -0,0 +1,130 @@
+#ifndef AUDIO_DEVICE_H
+#define AUDIO_DEVICE_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "sample_format.h"
+
+namespace audio_devices
+{
+
+struct audio_format_t
+{
+    std::uint32_t   sample_rate;
+    std::uint32_t   bit_per_sample;     // container size
+    std::uint32_t   channels;
+    sample_format_t sample_format;      // unknown - implied by bit_per_sample
+
+	audio_format_t(std::uint32_t sr = 0, std::uint32_t bps = 0, std::uint32_t c = 0, sample_format_t sf = sample_format_t::unknown)
+        : sample_rate(sr)
+        , bit_per_sample(bps)
+        , channels(c)
+        , sample_format(sf)
+    {}
+
+	audio_format_t(std::uint32_t sr, sample_format_t sf, std::uint32_t c)
+        : sample_rate(sr)
+        , bit_per_sample(sample_format_bits(sf))
+        , channels(c)
+        , sample_format(sf)
+    {}
+
+	inline bool is_init() const { return sample_rate >= 8000 && bit_per_sample > 7 && channels > 0; }
+    inline std::uint32_t frames_octets() const { return (bit_per_sample * channels) / 8; }
+    inline std::uint32_t bytes_per_second() const { return (sample_rate * bit_per_sample * channels) / 8; }
+    inline std::uint32_t duration_ms(std::size_t size) const { return (size * 1000) / bytes_per_second(); }
+    inline std::size_t octets_count(std::uint32_t duration_ms) const { return (duration_ms * bytes_per_second()) / 1000; }
+    inline sample_format_t format() const { return sample_format != sample_format_t::unknown ? sample_format : default_sample_format(bit_per_sample); }
+};
+
+static const audio_format_t default_audio_format = { 44100, 16, 1 };
+static const audio_format_t null_audio_format = { 0, 0, 0 };
+
+enum class latency_profile_t
+{
+    default_latency,
+    low_latency     // start on the first period, wake up every period, timestamps
+};
+
+struct audio_params_t
+{
+	bool			recorder;
+	audio_format_t	audio_format;
+	std::uint32_t	buffer_size;    // period size in frames, 0 - device default
+	bool			nonblock_mode;
+	std::uint32_t	period_count;   // buffer size in periods
+	latency_profile_t	latency_profile;
+
+	audio_params_t(bool rec = false, const audio_format_t& afmt = null_audio_format, std::uint32_t bsz = 0, bool nonblock = false
+			, std::uint32_t periods = 2, latency_profile_t profile = latency_profile_t::default_latency)
+		: recorder(rec)
+		, audio_format(afmt)
+		, buffer_size(bsz)
+		, nonblock_mode(nonblock)
+		, period_count(periods)
+		, latency_profile(profile)
+	{}
+
+	inline bool is_init() const { return audio_format.is_init(); }
+};
+
+
+static const audio_params_t default_audio_params = { false, default_audio_format, 0, false };
+static const audio_params_t null_audio_params = { false, null_audio_format, 0, false };
+
+struct audio_device_info
+{
+    std::string name;
+    std::string description;
+    std::string hint;
+    bool        input;
+    bool        output;
+};
+
+namespace audio_utils
+{
+
+void change_volume(const void* sound_data, std::size_t size, void* output_data, sample_format_t sample_format, std::uint32_t volume);
+
+}
+
+enum class audio_device_type_t
+{
+    alsa,
+    file,
+    null,
+    loopback,
+    aggregate
+};
+
+class AudioDevice
+{
+public:
+
+    virtual ~AudioDevice() {}
+
+    // device_spec: "[alsa:|file:|null:|loopback:|aggregate:]name", alsa if no type prefix
+    static std::unique_ptr<AudioDevice> Create(audio_device_type_t device_type);
+    static std::unique_ptr<AudioDevice> Create(const std::string& device_spec, std::string& device_name);
+
+    virtual bool Open(const std::string& device_name, const audio_params_t& audio_params = null_audio_params) = 0;
+    virtual bool Close() = 0;
+
+    virtual bool IsOpen() const = 0;
+    virtual bool IsRecorder() const = 0;
+
+    virtual const audio_params_t& GetParams() const = 0;
+    virtual bool SetParams(const audio_params_t& audio_params) = 0;
+
+    virtual std::int32_t Read(void* capture_data, std::size_t size) = 0;
+    virtual std::int32_t Write(const void* playback_data, std::size_t size) = 0;
+
+    virtual void SetVolume(std::uint32_t volume) = 0;
+    virtual std::uint32_t GetVolume() const = 0;
+};
+
+}
+
+#endif // AUDIO_DEVICE_H
@@ -0,0 +1,104 @@
+#ifndef AUDIO_FRAME_H
+#define AUDIO_FRAME_H
+
+#include <atomic>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace audio_processing
+{
+
+class FramePool;
+
+// header of a pool block, shared by FrameRef handles and returned to its
+// pool when the last one goes away; the data follows on the next cache line
+struct audio_frame_t
+{
+    std::atomic<std::uint32_t>  refs;
+    FramePool*                  pool;
+    std::uint8_t*               data;
+    std::size_t                 capacity;
+    std::size_t                 size;       // valid octets
+};
+
+// Reference counted frame handle: copies share the frame, nothing is
+// copied but the pointer. A frame may be written only through a unique
+// handle.
+class FrameRef
+{
+    audio_frame_t*                                      m_frame;
+
+public:
+    FrameRef() : m_frame(nullptr) {}
+
+    // takes over a reference already counted in the frame
+    explicit FrameRef(audio_frame_t* frame) : m_frame(frame) {}
+
+    FrameRef(const FrameRef& other)
+        : m_frame(other.m_frame)
+    {
+        if (m_frame != nullptr)
+        {
+            m_frame->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    FrameRef(FrameRef&& other) noexcept
+        : m_frame(other.m_frame)
+    {
+        other.m_frame = nullptr;
+    }
+
+    ~FrameRef() { Reset(); }
+
+    FrameRef& operator=(const FrameRef& other)
+    {
+        if (m_frame != other.m_frame)
+        {
+            FrameRef copy(other);
+            std::swap(m_frame, copy.m_frame);
+        }
+
+        return *this;
+    }
+
+    FrameRef& operator=(FrameRef&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            m_frame = other.m_frame;
+            other.m_frame = nullptr;
+        }
+
+        return *this;
+    }
+
+    inline void Reset();
+
+    inline explicit operator bool() const { return m_frame != nullptr; }
+    inline std::uint8_t* Data() const { return m_frame->data; }
+    inline std::size_t Size() const { return m_frame != nullptr ? m_frame->size : 0; }
+    inline std::size_t Capacity() const { return m_frame != nullptr ? m_frame->capacity : 0; }
+    inline void SetSize(std::size_t size) { m_frame->size = size; }
+    inline bool IsUnique() const { return m_frame != nullptr && m_frame->refs.load(std::memory_order_acquire) == 1; }
+};
+
+// returns the frame to its pool, frame_pool.cpp
+void recycle_frame(audio_frame_t* frame);
+
+inline void FrameRef::Reset()
+{
+    if (m_frame != nullptr
+            && m_frame->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        recycle_frame(m_frame);
+    }
+
+    m_frame = nullptr;
+}
+
+}
+
+#endif // AUDIO_FRAME_H
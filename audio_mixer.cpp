@@ -0,0 +1,289 @@
+#include "audio_mixer.h"
+
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace audio_processing
+{
+
+const float s16_scale = 32767.0f;
+
+// acc += frame * gain, frame is s16
+static void accumulate_s16(float* acc, const std::int16_t* frame, std::size_t sample_count, float gain)
+{
+    std::size_t i = 0;
+
+#if defined(__SSE2__)
+
+    __m128 g = _mm_set1_ps(gain);
+
+    for (; i + 8 <= sample_count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + i));
+
+        // sign extension: samples to the high half, arithmetic shift back
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(lo, g)));
+        _mm_storeu_ps(acc + i + 4, _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(hi, g)));
+    }
+
+#elif defined(__ARM_NEON)
+
+    for (; i + 8 <= sample_count; i += 8)
+    {
+        int16x8_t v = vld1q_s16(frame + i);
+
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+
+        vst1q_f32(acc + i, vmlaq_n_f32(vld1q_f32(acc + i), lo, gain));
+        vst1q_f32(acc + i + 4, vmlaq_n_f32(vld1q_f32(acc + i + 4), hi, gain));
+    }
+
+#endif
+
+    for (; i < sample_count; i++)
+    {
+        acc[i] += static_cast<float>(frame[i]) * gain;
+    }
+}
+
+// acc += frame * gain
+static void accumulate_float(float* acc, const float* frame, std::size_t sample_count, float gain)
+{
+    std::size_t i = 0;
+
+#if defined(__SSE2__)
+
+    __m128 g = _mm_set1_ps(gain);
+
+    for (; i + 4 <= sample_count; i += 4)
+    {
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(frame + i), g)));
+    }
+
+#elif defined(__ARM_NEON)
+
+    for (; i + 4 <= sample_count; i += 4)
+    {
+        vst1q_f32(acc + i, vmlaq_n_f32(vld1q_f32(acc + i), vld1q_f32(frame + i), gain));
+    }
+
+#endif
+
+    for (; i < sample_count; i++)
+    {
+        acc[i] += frame[i] * gain;
+    }
+}
+
+// s16 output with saturation, acc is in s16 scale
+static void store_s16(const float* acc, std::int16_t* output, std::size_t sample_count)
+{
+    std::size_t i = 0;
+
+#if defined(__SSE2__)
+
+    // float to int32 overflows to 0x80000000, clamp before the conversion
+    __m128 max_value = _mm_set1_ps(s16_scale);
+    __m128 min_value = _mm_set1_ps(-s16_scale - 1.0f);
+
+    for (; i + 8 <= sample_count; i += 8)
+    {
+        __m128 lo = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + i), min_value), max_value);
+        __m128 hi = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + i + 4), min_value), max_value);
+
+        __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), packed);
+    }
+
+#elif defined(__ARM_NEON)
+
+    for (; i + 8 <= sample_count; i += 8)
+    {
+        // conversion saturates to int32, narrowing saturates to int16
+        int16x4_t lo = vqmovn_s32(vcvtq_s32_f32(vld1q_f32(acc + i)));
+        int16x4_t hi = vqmovn_s32(vcvtq_s32_f32(vld1q_f32(acc + i + 4)));
+
+        vst1q_s16(output + i, vcombine_s16(lo, hi));
+    }
+
+#endif
+
+    for (; i < sample_count; i++)
+    {
+        output[i] = static_cast<std::int16_t>(std::min(s16_scale, std::max(-s16_scale - 1.0f, acc[i])));
+    }
+}
+
+static void store_float(const float* acc, float* output, std::size_t sample_count)
+{
+    std::size_t i = 0;
+
+#if defined(__SSE2__)
+
+    __m128 max_value = _mm_set1_ps(1.0f);
+    __m128 min_value = _mm_set1_ps(-1.0f);
+
+    for (; i + 4 <= sample_count; i += 4)
+    {
+        _mm_storeu_ps(output + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + i), min_value), max_value));
+    }
+
+#elif defined(__ARM_NEON)
+
+    float32x4_t max_value = vdupq_n_f32(1.0f);
+    float32x4_t min_value = vdupq_n_f32(-1.0f);
+
+    for (; i + 4 <= sample_count; i += 4)
+    {
+        vst1q_f32(output + i, vminq_f32(vmaxq_f32(vld1q_f32(acc + i), min_value), max_value));
+    }
+
+#endif
+
+    for (; i < sample_count; i++)
+    {
+        output[i] = std::min(1.0f, std::max(-1.0f, acc[i]));
+    }
+}
+
+AudioMixer::AudioMixer(const audio_devices::audio_format_t &format)
+    : m_format(format)
+    , m_frame_size(format.octets_count(10))
+    , m_sample_count((format.sample_rate / 100) * format.channels)
+    , m_accumulator(m_sample_count)
+    , m_output(m_frame_size)
+{
+    auto sample_format = m_format.format();
+
+    if (sample_format != audio_devices::sample_format_t::s16_le
+            && sample_format != audio_devices::sample_format_t::float_le)
+    {
+        m_convert_buffer.resize(m_sample_count);
+    }
+}
+
+std::uint32_t AudioMixer::AddStream(float gain)
+{
+    // reuse removed slots, ids stay stable
+    for (std::uint32_t i = 0; i < m_streams.size(); i++)
+    {
+        if (!m_streams[i].active)
+        {
+            m_streams[i] = { true, gain, nullptr };
+            return i;
+        }
+    }
+
+    m_streams.push_back({ true, gain, nullptr });
+
+    return static_cast<std::uint32_t>(m_streams.size() - 1);
+}
+
+bool AudioMixer::RemoveStream(uint32_t stream_id)
+{
+    if (stream_id < m_streams.size() && m_streams[stream_id].active)
+    {
+        m_streams[stream_id] = { false, 0.0f, nullptr };
+        return true;
+    }
+
+    return false;
+}
+
+std::size_t AudioMixer::GetStreamCount() const
+{
+    return std::count_if(m_streams.begin(), m_streams.end(), [](const stream_t& s) { return s.active; });
+}
+
+bool AudioMixer::SetGain(uint32_t stream_id, float gain)
+{
+    if (stream_id < m_streams.size() && m_streams[stream_id].active)
+    {
+        m_streams[stream_id].gain = gain;
+        return true;
+    }
+
+    return false;
+}
+
+float AudioMixer::GetGain(uint32_t stream_id) const
+{
+    return stream_id < m_streams.size()
+            ? m_streams[stream_id].gain
+            : 0.0f;
+}
+
+bool AudioMixer::SetFrame(uint32_t stream_id, const void *frame)
+{
+    if (stream_id < m_streams.size() && m_streams[stream_id].active)
+    {
+        m_streams[stream_id].frame = frame;
+        return true;
+    }
+
+    return false;
+}
+
+const void *AudioMixer::Mix()
+{
+    std::fill(m_accumulator.begin(), m_accumulator.end(), 0.0f);
+
+    for (auto& s : m_streams)
+    {
+        if (s.active && s.frame != nullptr && s.gain != 0.0f)
+        {
+            accumulate(s.frame, s.gain);
+        }
+
+        s.frame = nullptr;
+    }
+
+    store();
+
+    return m_output.data();
+}
+
+void AudioMixer::accumulate(const void *frame, float gain)
+{
+    switch(m_format.format())
+    {
+        case audio_devices::sample_format_t::s16_le:
+            accumulate_s16(m_accumulator.data(), static_cast<const std::int16_t*>(frame), m_sample_count, gain);
+        break;
+        case audio_devices::sample_format_t::float_le:
+            accumulate_float(m_accumulator.data(), static_cast<const float*>(frame), m_sample_count, gain);
+        break;
+        default:
+            audio_devices::audio_utils::pcm_to_float(frame, m_sample_count, m_convert_buffer.data(), m_format.format());
+            accumulate_float(m_accumulator.data(), m_convert_buffer.data(), m_sample_count, gain);
+    }
+}
+
+void AudioMixer::store()
+{
+    switch(m_format.format())
+    {
+        case audio_devices::sample_format_t::s16_le:
+            store_s16(m_accumulator.data(), reinterpret_cast<std::int16_t*>(m_output.data()), m_sample_count);
+        break;
+        case audio_devices::sample_format_t::float_le:
+            store_float(m_accumulator.data(), reinterpret_cast<float*>(m_output.data()), m_sample_count);
+        break;
+        default:
+            // saturated by the converter
+            audio_devices::audio_utils::float_to_pcm(m_accumulator.data(), m_sample_count, m_output.data(), m_format.format());
+    }
+}
+
+}
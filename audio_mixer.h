@@ -0,0 +1,62 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include "audio_device.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace audio_processing
+{
+
+// Sums far-end streams into one 10 ms frame. Stream frames are referenced,
+// not copied; the mixed frame is owned by the mixer and stays valid until
+// the next Mix, so the same buffer goes to the player and to the AEC.
+class AudioMixer
+{
+    struct stream_t
+    {
+        bool            active;
+        float           gain;
+        const void*     frame;
+    };
+
+    audio_devices::audio_format_t                       m_format;
+    std::size_t                                         m_frame_size;
+    std::size_t                                         m_sample_count;
+
+    std::vector<stream_t>                               m_streams;
+    std::vector<float>                                  m_accumulator;
+    std::vector<float>                                  m_convert_buffer;
+    std::vector<std::uint8_t>                           m_output;
+
+public:
+    AudioMixer(const audio_devices::audio_format_t& format);
+
+    // returns stream id
+    std::uint32_t AddStream(float gain = 1.0f);
+    bool RemoveStream(std::uint32_t stream_id);
+    std::size_t GetStreamCount() const;
+
+    // linear gain
+    bool SetGain(std::uint32_t stream_id, float gain);
+    float GetGain(std::uint32_t stream_id) const;
+
+    // frame of GetFrameSize() bytes, must stay valid until Mix;
+    // nullptr or no frame - the stream is silent in this frame
+    bool SetFrame(std::uint32_t stream_id, const void* frame);
+
+    // saturated sum of the frames set since the previous Mix
+    const void* Mix();
+
+    inline std::size_t GetFrameSize() const { return m_frame_size; }
+    inline const audio_devices::audio_format_t& GetFormat() const { return m_format; }
+
+private:
+    void accumulate(const void* frame, float gain);
+    void store();
+};
+
+}
+
+#endif // AUDIO_MIXER_H
@@ -0,0 +1,287 @@
+#include <webrtc/modules/audio_processing/include/audio_processing.h>
+
+#include "audio_processing_pool.h"
+
+#include <vector>
+#include <chrono>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_processing
+{
+
+const std::uint32_t pool_idle_check_ms = 500;
+
+static std::uint64_t format_key(std::uint32_t sample_rate, std::uint32_t channels)
+{
+    return (static_cast<std::uint64_t>(sample_rate) << 32) | channels;
+}
+
+// settings of a freshly created instance. The Create-time options
+// (ExperimentalAgc, ExperimentalNs) can't be changed afterwards, pooled
+// instances are always created without a config and callers needing one
+// create their own
+static void restore_defaults(webrtc::AudioProcessing* apm)
+{
+    // extended filter and delay agnostic mode off
+    apm->SetExtraOptions(webrtc::Config());
+
+    apm->set_stream_delay_ms(0);
+    apm->set_delay_offset_ms(0);
+
+    apm->echo_cancellation()->Enable(false);
+    apm->echo_cancellation()->set_suppression_level(webrtc::EchoCancellation::kModerateSuppression);
+    apm->echo_cancellation()->enable_metrics(false);
+    apm->echo_cancellation()->enable_delay_logging(false);
+
+    apm->echo_control_mobile()->Enable(false);
+    apm->echo_control_mobile()->set_routing_mode(webrtc::EchoControlMobile::kSpeakerphone);
+
+    apm->noise_suppression()->Enable(false);
+    apm->noise_suppression()->set_level(webrtc::NoiseSuppression::kModerate);
+
+    apm->high_pass_filter()->Enable(false);
+
+    apm->voice_detection()->Enable(false);
+    apm->voice_detection()->set_likelihood(webrtc::VoiceDetection::kLowLikelihood);
+
+    apm->gain_control()->Enable(false);
+    apm->gain_control()->set_mode(webrtc::GainControl::kAdaptiveAnalog);
+    apm->gain_control()->set_analog_level_limits(0, 255);
+    apm->gain_control()->set_stream_analog_level(0);
+
+    apm->level_estimator()->Enable(false);
+}
+
+static bool initialize(webrtc::AudioProcessing* apm, std::uint32_t sample_rate, std::uint32_t channels)
+{
+    webrtc::StreamConfig stream_config(sample_rate, channels, false);
+
+    webrtc::ProcessingConfig config =
+    {
+        stream_config,
+        stream_config,
+        stream_config,
+        stream_config
+    };
+
+    return apm->Initialize(config) == webrtc::AudioProcessing::kNoError;
+}
+
+AudioProcessingPool::format_pool_t::format_pool_t(uint32_t sample_rate, uint32_t channels, std::size_t capacity)
+    : sample_rate(sample_rate)
+    , channels(channels)
+    , capacity(capacity)
+    , ready(capacity)
+    , released(capacity)
+    , ready_count(0)
+{
+
+}
+
+AudioProcessingPool::AudioProcessingPool()
+    : m_running(true)
+    , m_acquired(0)
+    , m_missed(0)
+    , m_released(0)
+    , m_created(0)
+    , m_destroyed(0)
+{
+    m_warmup_thread = std::thread(&AudioProcessingPool::warmupProc, this);
+}
+
+AudioProcessingPool::~AudioProcessingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+
+    m_signal.notify_all();
+
+    if (m_warmup_thread.joinable())
+    {
+        m_warmup_thread.join();
+    }
+
+    for (auto& p : m_pools)
+    {
+        webrtc::AudioProcessing* apm = nullptr;
+
+        while (p.second->ready.Pop(apm) || p.second->released.Pop(apm))
+        {
+            delete apm;
+        }
+    }
+}
+
+void AudioProcessingPool::Prepare(uint32_t sample_rate, uint32_t channels, std::size_t count)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto& pool = m_pools[format_key(sample_rate, channels)];
+
+        if (pool == nullptr)
+        {
+            pool.reset(new format_pool_t(sample_rate, channels, count));
+        }
+        else if (pool->capacity < count)
+        {
+            // queues are not resizable, the format keeps its first capacity
+            LOG(warning) << "Pool " << sample_rate << "/" << channels << " capacity stays " << pool->capacity LOG_END;
+        }
+    }
+
+    m_signal.notify_one();
+}
+
+webrtc::AudioProcessing *AudioProcessingPool::Acquire(uint32_t sample_rate, uint32_t channels)
+{
+    webrtc::AudioProcessing* apm = nullptr;
+
+    auto pool = getPool(sample_rate, channels);
+
+    if (pool != nullptr && pool->ready.Pop(apm))
+    {
+        pool->ready_count--;
+        m_acquired++;
+    }
+    else
+    {
+        m_missed++;
+    }
+
+    // refill in background
+    m_signal.notify_one();
+
+    return apm;
+}
+
+void AudioProcessingPool::Release(webrtc::AudioProcessing *audio_processing, uint32_t sample_rate, uint32_t channels)
+{
+    if (audio_processing == nullptr)
+    {
+        return;
+    }
+
+    auto pool = getPool(sample_rate, channels);
+
+    if (pool != nullptr && pool->released.Push(audio_processing))
+    {
+        m_released++;
+        m_signal.notify_one();
+    }
+    else
+    {
+        delete audio_processing;
+        m_destroyed++;
+    }
+}
+
+std::size_t AudioProcessingPool::GetReadyCount(uint32_t sample_rate, uint32_t channels) const
+{
+    auto pool = getPool(sample_rate, channels);
+
+    return pool != nullptr ? pool->ready_count.load() : 0;
+}
+
+pool_stats_t AudioProcessingPool::GetStats() const
+{
+    return { m_acquired, m_missed, m_released, m_created, m_destroyed };
+}
+
+AudioProcessingPool::format_pool_t *AudioProcessingPool::getPool(uint32_t sample_rate, uint32_t channels) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_pools.find(format_key(sample_rate, channels));
+
+    return it != m_pools.end() ? it->second.get() : nullptr;
+}
+
+void AudioProcessingPool::warmupProc()
+{
+    std::vector<format_pool_t*> pools;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_signal.wait_for(lock, std::chrono::milliseconds(pool_idle_check_ms));
+
+            if (!m_running)
+            {
+                break;
+            }
+
+            // format pools are never removed, work without the lock
+            pools.clear();
+
+            for (auto& p : m_pools)
+            {
+                pools.push_back(p.second.get());
+            }
+        }
+
+        for (auto pool : pools)
+        {
+            while (serviceFormat(*pool) && m_running) {}
+        }
+    }
+}
+
+bool AudioProcessingPool::serviceFormat(format_pool_t &pool)
+{
+    webrtc::AudioProcessing* apm = nullptr;
+
+    if (pool.released.Pop(apm))
+    {
+        if (pool.ready_count >= pool.capacity)
+        {
+            delete apm;
+            m_destroyed++;
+            return true;
+        }
+
+        restore_defaults(apm);
+    }
+    else if (pool.ready_count < pool.capacity)
+    {
+        apm = webrtc::AudioProcessing::Create();
+
+        if (apm == nullptr)
+        {
+            return false;
+        }
+
+        m_created++;
+    }
+    else
+    {
+        return false;
+    }
+
+    if (initialize(apm, pool.sample_rate, pool.channels)
+            && pool.ready.Push(apm))
+    {
+        pool.ready_count++;
+    }
+    else
+    {
+        delete apm;
+        m_destroyed++;
+    }
+
+    return true;
+}
+
+}
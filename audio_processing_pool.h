@@ -0,0 +1,92 @@
+#ifndef AUDIO_PROCESSING_POOL_H
+#define AUDIO_PROCESSING_POOL_H
+
+#ifndef WEBRTC_MODULES_AUDIO_PROCESSING_INCLUDE_AUDIO_PROCESSING_H_
+namespace webrtc
+{
+class AudioProcessing;
+}
+#endif
+
+#include "lockfree_queue.h"
+
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+namespace audio_processing
+{
+
+struct pool_stats_t
+{
+    std::uint64_t   acquired;       // served from the pool
+    std::uint64_t   missed;         // pool was empty, caller created its own
+    std::uint64_t   released;
+    std::uint64_t   created;        // by the warm-up thread
+    std::uint64_t   destroyed;      // released over capacity
+};
+
+// Pre-created and initialized AudioProcessing instances per stream format.
+// Acquire never creates, released instances are restored to the default
+// settings and re-initialized by the warm-up thread before reuse.
+class AudioProcessingPool
+{
+    struct format_pool_t
+    {
+        std::uint32_t                               sample_rate;
+        std::uint32_t                               channels;
+        std::size_t                                 capacity;
+        LockFreeQueue<webrtc::AudioProcessing*>     ready;
+        LockFreeQueue<webrtc::AudioProcessing*>     released;
+        std::atomic<std::size_t>                    ready_count;
+
+        format_pool_t(std::uint32_t sample_rate, std::uint32_t channels, std::size_t capacity);
+    };
+
+    typedef std::unique_ptr<format_pool_t> format_pool_ptr;
+
+    std::map<std::uint64_t, format_pool_ptr>        m_pools;
+    mutable std::mutex                              m_mutex;
+    std::condition_variable                         m_signal;
+    std::thread                                     m_warmup_thread;
+    std::atomic<bool>                               m_running;
+
+    std::atomic<std::uint64_t>                      m_acquired;
+    std::atomic<std::uint64_t>                      m_missed;
+    std::atomic<std::uint64_t>                      m_released;
+    std::atomic<std::uint64_t>                      m_created;
+    std::atomic<std::uint64_t>                      m_destroyed;
+
+public:
+
+    AudioProcessingPool();
+    ~AudioProcessingPool();
+
+    AudioProcessingPool(const AudioProcessingPool&) = delete;
+    AudioProcessingPool& operator=(const AudioProcessingPool&) = delete;
+
+    // keeps count instances of the format ready, filled in background
+    void Prepare(std::uint32_t sample_rate, std::uint32_t channels, std::size_t count);
+
+    // initialized instance or nullptr when the pool is empty
+    webrtc::AudioProcessing* Acquire(std::uint32_t sample_rate, std::uint32_t channels);
+    // takes ownership, the instance is reset in background
+    void Release(webrtc::AudioProcessing* audio_processing, std::uint32_t sample_rate, std::uint32_t channels);
+
+    std::size_t GetReadyCount(std::uint32_t sample_rate, std::uint32_t channels) const;
+    pool_stats_t GetStats() const;
+
+private:
+
+    format_pool_t* getPool(std::uint32_t sample_rate, std::uint32_t channels) const;
+    void warmupProc();
+    bool serviceFormat(format_pool_t& pool);
+};
+
+}
+
+#endif // AUDIO_PROCESSING_POOL_H
@@ -0,0 +1,191 @@
+#include "capture_fanout.h"
+#include "frame_pool.h"
+
+#include <cstring>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_processing
+{
+
+static bool is_same_format(const audio_devices::audio_format_t& a, const audio_devices::audio_format_t& b)
+{
+    return a.sample_rate == b.sample_rate
+            && a.channels == b.channels
+            && a.format() == b.format();
+}
+
+CaptureFanout::CaptureFanout(const audio_devices::audio_format_t &format, std::uint32_t duration_ms)
+    : m_format(format)
+    , m_duration_ms(duration_ms)
+{
+    m_input_samples.resize((format.sample_rate * duration_ms / 1000) * format.channels);
+}
+
+std::int32_t CaptureFanout::AddConsumer(const audio_devices::audio_format_t &format, std::size_t queue_frames)
+{
+    if (!format.is_init()
+            || format.channels != m_format.channels
+            || (format.sample_rate * m_duration_ms) % 1000 != 0)
+    {
+        LOG(error) << "Can't add fan-out consumer of " << format.sample_rate << " Hz, " << format.channels << " channels" LOG_END;
+        return -1;
+    }
+
+    std::size_t rate_group = 0;
+
+    while (rate_group < m_rate_groups.size()
+           && m_rate_groups[rate_group].sample_rate != format.sample_rate)
+    {
+        rate_group++;
+    }
+
+    if (rate_group == m_rate_groups.size())
+    {
+        rate_group_t group;
+
+        group.sample_rate = format.sample_rate;
+        group.frames = format.sample_rate * m_duration_ms / 1000;
+
+        if (format.sample_rate != m_format.sample_rate)
+        {
+            group.resampler.reset(new Resampler(m_format.sample_rate, format.sample_rate, m_format.channels));
+            group.samples.resize(group.resampler->GetMaxOutputFrames(m_input_samples.size() / m_format.channels) * m_format.channels);
+        }
+
+        m_rate_groups.push_back(std::move(group));
+    }
+
+    std::size_t format_group = 0;
+
+    while (format_group < m_format_groups.size()
+           && !is_same_format(m_format_groups[format_group].format, format))
+    {
+        format_group++;
+    }
+
+    if (format_group == m_format_groups.size())
+    {
+        format_group_t group;
+
+        const auto& rates = m_rate_groups[rate_group];
+
+        // resampled frames vary, the pool takes the longest one; the lookup
+        // locks and stays off the processing thread
+        auto max_samples = rates.resampler != nullptr
+                ? rates.samples.size()
+                : rates.frames * m_format.channels;
+
+        group.format = format;
+        group.rate_group = rate_group;
+        group.pool = &shared_frame_pool(max_samples * (format.bit_per_sample / 8));
+
+        m_format_groups.push_back(std::move(group));
+    }
+
+    std::unique_ptr<consumer_t> consumer(new consumer_t());
+
+    consumer->format = format;
+    consumer->queue.reset(new LockFreeQueue<FrameRef>(queue_frames));
+    consumer->frames = 0;
+    consumer->drops = 0;
+
+    auto consumer_id = static_cast<std::uint32_t>(m_consumers.size());
+
+    m_consumers.push_back(std::move(consumer));
+    m_format_groups[format_group].consumers.push_back(consumer_id);
+
+    return consumer_id;
+}
+
+bool CaptureFanout::Push(const void *frame, std::size_t size)
+{
+    if (size != m_input_samples.size() * (m_format.bit_per_sample / 8))
+    {
+        return false;
+    }
+
+    audio_devices::audio_utils::pcm_to_float(frame, m_input_samples.size(), m_input_samples.data(), m_format.format());
+
+    for (auto& rate_group : m_rate_groups)
+    {
+        if (rate_group.resampler != nullptr)
+        {
+            rate_group.frames = rate_group.resampler->Process(m_input_samples.data(), m_input_samples.size() / m_format.channels, rate_group.samples.data());
+        }
+    }
+
+    for (const auto& format_group : m_format_groups)
+    {
+        const auto& rate_group = m_rate_groups[format_group.rate_group];
+        auto sample_count = rate_group.frames * m_format.channels;
+        auto frame_size = sample_count * (format_group.format.bit_per_sample / 8);
+
+        auto output = format_group.pool->Acquire();
+
+        if (output)
+        {
+            if (is_same_format(format_group.format, m_format))
+            {
+                std::memcpy(output.Data(), frame, frame_size);
+            }
+            else
+            {
+                auto samples = rate_group.resampler != nullptr
+                        ? rate_group.samples.data()
+                        : m_input_samples.data();
+
+                audio_devices::audio_utils::float_to_pcm(samples, sample_count, output.Data(), format_group.format.format());
+            }
+
+            output.SetSize(frame_size);
+        }
+
+        for (auto consumer_id : format_group.consumers)
+        {
+            auto& consumer = *m_consumers[consumer_id];
+
+            if (output && consumer.queue->Push(output))
+            {
+                consumer.frames++;
+            }
+            else
+            {
+                consumer.drops++;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool CaptureFanout::Pop(std::uint32_t consumer_id, FrameRef &frame)
+{
+    return consumer_id < m_consumers.size()
+            && m_consumers[consumer_id]->queue->Pop(frame);
+}
+
+fanout_consumer_stats_t CaptureFanout::GetConsumerStats(std::uint32_t consumer_id) const
+{
+    fanout_consumer_stats_t stats = {};
+
+    if (consumer_id < m_consumers.size())
+    {
+        const auto& consumer = *m_consumers[consumer_id];
+
+        stats.format = consumer.format;
+        stats.frames = consumer.frames;
+        stats.drops = consumer.drops;
+    }
+
+    return stats;
+}
+
+}
@@ -0,0 +1,90 @@
+#ifndef CAPTURE_FANOUT_H
+#define CAPTURE_FANOUT_H
+
+#include "audio_device.h"
+#include "audio_frame.h"
+#include "lockfree_queue.h"
+#include "resampler.h"
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+namespace audio_processing
+{
+
+// readable from any thread
+struct fanout_consumer_stats_t
+{
+    audio_devices::audio_format_t   format;
+    std::uint64_t                   frames;     // queued
+    std::uint64_t                   drops;      // refused by a full queue
+};
+
+// Delivers every processed capture frame to consumers at their own rate and
+// sample format. Each distinct rate is resampled once and each distinct
+// rate and format converted once per frame, consumers of the same format
+// share that frame by reference through their own bounded lock-free queue.
+// A consumer that falls behind loses frames, Push never waits.
+// Consumers are added before the first Push, channels follow the input.
+class CaptureFanout
+{
+    struct rate_group_t
+    {
+        std::uint32_t                                   sample_rate;
+        std::unique_ptr<Resampler>                      resampler;      // none at the input rate
+        std::vector<float>                              samples;
+        std::size_t                                     frames;
+    };
+
+    struct format_group_t
+    {
+        audio_devices::audio_format_t                   format;
+        std::size_t                                     rate_group;
+        FramePool*                                      pool;           // blocks of the largest frame, resolved once
+        std::vector<std::uint32_t>                      consumers;
+    };
+
+    struct consumer_t
+    {
+        audio_devices::audio_format_t                   format;
+        std::unique_ptr<LockFreeQueue<FrameRef>>        queue;
+        std::atomic<std::uint64_t>                      frames;
+        std::atomic<std::uint64_t>                      drops;
+    };
+
+    audio_devices::audio_format_t                       m_format;
+    std::uint32_t                                       m_duration_ms;
+    std::vector<float>                                  m_input_samples;
+
+    std::vector<rate_group_t>                           m_rate_groups;
+    std::vector<format_group_t>                         m_format_groups;
+    std::vector<std::unique_ptr<consumer_t>>            m_consumers;
+
+public:
+    CaptureFanout(const audio_devices::audio_format_t& format, std::uint32_t duration_ms = 10);
+
+    CaptureFanout(const CaptureFanout&) = delete;
+    CaptureFanout& operator=(const CaptureFanout&) = delete;
+
+    // returns the consumer id, -1 for a rate that gives no whole frames or
+    // another channel count
+    std::int32_t AddConsumer(const audio_devices::audio_format_t& format, std::size_t queue_frames = 8);
+
+    // frame of the input format, called by the processing thread
+    bool Push(const void* frame, std::size_t size);
+
+    // consumer side, false when nothing is queued
+    bool Pop(std::uint32_t consumer_id, FrameRef& frame);
+
+    inline std::size_t GetConsumerCount() const { return m_consumers.size(); }
+    // conversions done per pushed frame
+    inline std::size_t GetConversionCount() const { return m_format_groups.size(); }
+
+    fanout_consumer_stats_t GetConsumerStats(std::uint32_t consumer_id) const;
+};
+
+}
+
+#endif // CAPTURE_FANOUT_H
@@ -0,0 +1,251 @@
+#include "deadline_monitor.h"
+
+#include <algorithm>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_processing
+{
+
+// webrtc::NoiseSuppression::kLow
+const std::int32_t noise_suppression_low_level = 0;
+
+const char* degrade_step_name(degrade_step_t step)
+{
+    switch(step)
+    {
+        case degrade_step_t::noise_suppression_low:
+            return "noise_suppression_low";
+        case degrade_step_t::voice_detection_off:
+            return "voice_detection_off";
+        case degrade_step_t::echo_control_mobile:
+            return "echo_control_mobile";
+        case degrade_step_t::noise_suppression_off:
+            return "noise_suppression_off";
+        case degrade_step_t::gain_control_off:
+            return "gain_control_off";
+    }
+
+    return "unknown";
+}
+
+static void apply_step(degrade_step_t step, aec_config_t& config)
+{
+    switch(step)
+    {
+        case degrade_step_t::noise_suppression_low:
+            config.noise_suppression_level = noise_suppression_low_level;
+        break;
+        case degrade_step_t::voice_detection_off:
+            config.voice_detection = false;
+        break;
+        case degrade_step_t::echo_control_mobile:
+            if (config.echo_cancellation)
+            {
+                config.echo_cancellation = false;
+                config.echo_control_mobile = true;
+            }
+        break;
+        case degrade_step_t::noise_suppression_off:
+            config.noise_suppression = false;
+        break;
+        case degrade_step_t::gain_control_off:
+            config.gain_control = false;
+        break;
+    }
+}
+
+DeadlineMonitor::DeadlineMonitor(AecController &controller, const deadline_config_t &config)
+    : m_controller(controller)
+    , m_config(config)
+    , m_steps({ degrade_step_t::noise_suppression_low, degrade_step_t::voice_detection_off, degrade_step_t::echo_control_mobile })
+    , m_baseline(controller.GetConfig())
+    , m_level(0)
+    , m_window_loads(std::max(1u, config.window_frames))
+    , m_window_misses(std::max(1u, config.window_frames))
+    , m_frame_index(0)
+    , m_last_transition(0)
+    , m_last_reinit(0)
+    , m_frames(0)
+    , m_misses(0)
+    , m_degrades(0)
+    , m_restores(0)
+    , m_reinitializations(0)
+    , m_atomic_level(0)
+    , m_max_processing_us(0)
+{
+    resetWindow();
+}
+
+void DeadlineMonitor::SetSteps(const std::vector<degrade_step_t> &steps)
+{
+    m_steps = steps;
+
+    if (m_level > m_steps.size())
+    {
+        setLevel(static_cast<std::uint32_t>(m_steps.size()));
+    }
+}
+
+void DeadlineMonitor::SetEventHandler(const event_handler_t &event_handler)
+{
+    m_event_handler = event_handler;
+}
+
+void DeadlineMonitor::Rebase()
+{
+    m_baseline = m_controller.GetConfig();
+    m_level = 0;
+    m_atomic_level = 0;
+
+    resetWindow();
+}
+
+void DeadlineMonitor::AddFrame(std::uint64_t processing_ns)
+{
+    auto budget_ns = static_cast<std::uint64_t>(m_config.budget_us) * 1000;
+    auto load = static_cast<std::uint32_t>(std::min<std::uint64_t>((processing_ns * 1000) / std::max<std::uint64_t>(budget_ns, 1), 100000));
+    bool miss = load >= static_cast<std::uint32_t>(m_config.miss_load * 1000.0f);
+
+    // the oldest frame leaves the window
+    if (m_window_count == m_window_loads.size())
+    {
+        m_window_load_total -= m_window_loads[m_window_position];
+        m_window_miss_count -= m_window_misses[m_window_position] ? 1 : 0;
+    }
+    else
+    {
+        m_window_count++;
+    }
+
+    m_window_loads[m_window_position] = load;
+    m_window_misses[m_window_position] = miss;
+    m_window_load_total += load;
+    m_window_miss_count += miss ? 1 : 0;
+    m_window_position = (m_window_position + 1) % m_window_loads.size();
+
+    m_frame_index++;
+    m_frames++;
+
+    if (miss)
+    {
+        m_misses++;
+    }
+
+    auto processing_us = processing_ns / 1000;
+
+    if (processing_us > m_max_processing_us)
+    {
+        m_max_processing_us = processing_us;
+    }
+
+    auto since_transition = m_frame_index - m_last_transition;
+
+    if (m_window_miss_count >= m_config.degrade_misses
+            && m_level < m_steps.size()
+            && canCross(m_level))
+    {
+        m_degrades++;
+        setLevel(m_level + 1);
+    }
+    else if (m_level > 0
+             && m_window_miss_count == 0
+             && since_transition >= m_config.restore_frames
+             && m_window_load_total < static_cast<std::uint64_t>(m_config.restore_load * 1000.0f) * m_window_count
+             && canCross(m_level - 1))
+    {
+        m_restores++;
+        setLevel(m_level - 1);
+    }
+}
+
+deadline_stats_t DeadlineMonitor::GetStats() const
+{
+    deadline_stats_t stats;
+
+    stats.frames = m_frames;
+    stats.misses = m_misses;
+    stats.degrades = m_degrades;
+    stats.restores = m_restores;
+    stats.reinitializations = m_reinitializations;
+    stats.level = m_atomic_level;
+    stats.max_processing_us = m_max_processing_us;
+
+    return stats;
+}
+
+void DeadlineMonitor::setLevel(std::uint32_t level)
+{
+    degrade_event_t event;
+
+    event.frame_index = m_frame_index;
+    event.from_level = m_level;
+    event.to_level = level;
+    event.average_load = m_window_count > 0
+            ? static_cast<float>(m_window_load_total) / m_window_count / 1000.0f
+            : 0.0f;
+    event.window_misses = m_window_miss_count;
+
+    // the step applied or undone by a single step transition
+    auto crossed = std::min(level, m_level);
+    auto config = m_baseline;
+
+    for (std::uint32_t s = 0; s < level && s < m_steps.size(); s++)
+    {
+        apply_step(m_steps[s], config);
+    }
+
+    m_controller.ApplyConfig(config);
+
+    m_level = level;
+    m_atomic_level = level;
+    m_last_transition = m_frame_index;
+
+    if (crossed < m_steps.size()
+            && m_steps[crossed] == degrade_step_t::echo_control_mobile
+            && m_baseline.echo_cancellation)
+    {
+        m_last_reinit = m_frame_index;
+        m_reinitializations++;
+    }
+
+    // the new settings are judged on their own frames
+    resetWindow();
+
+    if (m_event_handler)
+    {
+        m_event_handler(event);
+    }
+}
+
+bool DeadlineMonitor::canCross(std::uint32_t step_index) const
+{
+    // the canceller swap costs a reconvergence, so it is not repeated
+    // before the dwell time even when the load keeps flapping
+    if (step_index >= m_steps.size()
+            || m_steps[step_index] != degrade_step_t::echo_control_mobile
+            || !m_baseline.echo_cancellation
+            || m_last_reinit == 0)
+    {
+        return true;
+    }
+
+    return m_frame_index - m_last_reinit >= m_config.reinit_dwell_frames;
+}
+
+void DeadlineMonitor::resetWindow()
+{
+    m_window_position = 0;
+    m_window_count = 0;
+    m_window_load_total = 0;
+    m_window_miss_count = 0;
+}
+
+}
@@ -0,0 +1,133 @@
+#ifndef DEADLINE_MONITOR_H
+#define DEADLINE_MONITOR_H
+
+#include "aec_controller.h"
+
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+namespace audio_processing
+{
+
+// one step of load shedding, applied on top of the previous ones
+enum class degrade_step_t
+{
+    noise_suppression_low,
+    voice_detection_off,
+    echo_control_mobile,    // echo cancellation replaced by the mobile one; both ways
+                            // reinitialize the processor, echo leaks until the new
+                            // canceller converges, so transitions keep a dwell time
+    noise_suppression_off,
+    gain_control_off
+};
+
+const char* degrade_step_name(degrade_step_t step);
+
+struct deadline_config_t
+{
+    std::uint32_t   budget_us;          // frame period
+    float           miss_load;          // processing / budget counted as a miss
+    std::uint32_t   window_frames;      // misses are counted over this window
+    std::uint32_t   degrade_misses;     // misses in the window for one step down
+    float           restore_load;       // average load with headroom
+    std::uint32_t   restore_frames;     // frames of headroom for one step up
+    std::uint32_t   reinit_dwell_frames;// frames between two transitions through a reinitializing step
+
+    deadline_config_t()
+        : budget_us(10000)
+        , miss_load(0.9f)
+        , window_frames(100)
+        , degrade_misses(5)
+        , restore_load(0.5f)
+        , restore_frames(500)
+        , reinit_dwell_frames(3000)
+    {}
+};
+
+struct degrade_event_t
+{
+    std::uint64_t   frame_index;
+    std::uint32_t   from_level;
+    std::uint32_t   to_level;
+    float           average_load;       // over the window that triggered the transition
+    std::uint32_t   window_misses;
+};
+
+// readable from any thread
+struct deadline_stats_t
+{
+    std::uint64_t   frames;
+    std::uint64_t   misses;
+    std::uint64_t   degrades;
+    std::uint64_t   restores;
+    std::uint64_t   reinitializations;  // transitions through a reinitializing step
+    std::uint32_t   level;
+    std::uint64_t   max_processing_us;
+};
+
+// Compares the processing time of every frame with the frame budget and
+// sheds load in configured steps when misses pile up: level N is the
+// settings taken at construction (or Rebase) with the first N steps
+// applied. Steps are undone one by one once the load stays low. Settings
+// are changed through ApplyConfig, so dumps and replays follow them.
+// AddFrame is called by the processing thread.
+class DeadlineMonitor
+{
+public:
+    using event_handler_t = std::function<void(const degrade_event_t& event)>;
+
+private:
+    AecController&                                      m_controller;
+    deadline_config_t                                   m_config;
+    std::vector<degrade_step_t>                         m_steps;
+    aec_config_t                                        m_baseline;
+    event_handler_t                                     m_event_handler;
+
+    std::uint32_t                                       m_level;
+    std::vector<std::uint32_t>                          m_window_loads;     // permille of the budget
+    std::vector<bool>                                   m_window_misses;
+    std::size_t                                         m_window_position;
+    std::size_t                                         m_window_count;
+    std::uint64_t                                       m_window_load_total;
+    std::uint32_t                                       m_window_miss_count;
+    std::uint64_t                                       m_frame_index;
+    std::uint64_t                                       m_last_transition;
+    std::uint64_t                                       m_last_reinit;      // 0 - none yet
+
+    std::atomic<std::uint64_t>                          m_frames;
+    std::atomic<std::uint64_t>                          m_misses;
+    std::atomic<std::uint64_t>                          m_degrades;
+    std::atomic<std::uint64_t>                          m_restores;
+    std::atomic<std::uint64_t>                          m_reinitializations;
+    std::atomic<std::uint32_t>                          m_atomic_level;
+    std::atomic<std::uint64_t>                          m_max_processing_us;
+
+public:
+    // default steps: noise suppression low, voice detection off, mobile echo control
+    DeadlineMonitor(AecController& controller, const deadline_config_t& config = deadline_config_t());
+
+    void SetSteps(const std::vector<degrade_step_t>& steps);
+    inline const std::vector<degrade_step_t>& GetSteps() const { return m_steps; }
+
+    // called on the processing thread for every transition
+    void SetEventHandler(const event_handler_t& event_handler);
+
+    // settings changed by the user become the new level 0
+    void Rebase();
+
+    void AddFrame(std::uint64_t processing_ns);
+
+    inline std::uint32_t GetLevel() const { return m_level; }
+    deadline_stats_t GetStats() const;
+
+private:
+    void setLevel(std::uint32_t level);
+    bool canCross(std::uint32_t step_index) const;
+    void resetWindow();
+};
+
+}
+
+#endif // DEADLINE_MONITOR_H
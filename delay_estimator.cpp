@@ -0,0 +1,403 @@
+#include "delay_estimator.h"
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_processing
+{
+
+// the search runs on this rate, enough for the speech band
+const std::uint32_t delay_search_rate = 8000;
+
+static std::size_t ring_size(std::uint64_t samples)
+{
+    std::size_t size = 1;
+
+    while (size < samples)
+    {
+        size <<= 1;
+    }
+
+    return size;
+}
+
+static float level_dbfs(const float* samples, std::size_t count)
+{
+    double energy = 0.0;
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        energy += static_cast<double>(samples[i]) * samples[i];
+    }
+
+    return count > 0 && energy > 0.0
+            ? static_cast<float>(10.0 * std::log10(energy / count))
+            : -200.0f;
+}
+
+DelayEstimator::DelayEstimator(AecController &controller, std::uint32_t sample_rate, audio_devices::sample_format_t sample_format, std::uint32_t channels, const delay_search_config_t &config)
+    : m_controller(controller)
+    , m_config(config)
+    , m_sample_format(sample_format)
+    , m_channels(std::max(channels, 1u))
+    , m_decimation(std::max(sample_rate / delay_search_rate, 1u))
+    , m_analysis_rate(sample_rate / m_decimation)
+    , m_convert((sample_rate / 100) * m_channels)
+    , m_window(static_cast<std::uint64_t>(m_analysis_rate) * config.window_ms / 1000)
+    , m_max_lag(static_cast<std::uint64_t>(m_analysis_rate) * config.max_delay_ms / 1000)
+    , m_next_search(0)
+    , m_candidate_ms(0)
+    , m_candidate_count(0)
+    , m_locked(false)
+    , m_drop_result(false)
+    , m_fft(m_window + m_max_lag)
+    , m_far_window(m_window + m_max_lag)
+    , m_near_window(m_window + m_max_lag)
+    , m_spectrum(m_fft.GetSize())
+    , m_result_ms(-1)
+    , m_result_ratio(0.0f)
+    , m_busy(false)
+    , m_result_ready(false)
+    , m_stop(false)
+    , m_searches(0)
+    , m_confident(0)
+    , m_published(0)
+    , m_delay_ms(-1)
+    , m_last_estimate_ms(-1)
+    , m_last_peak_ratio(0.0f)
+    , m_last_search_us(0)
+{
+    for (auto history : { &m_far, &m_near })
+    {
+        history->ring.resize(ring_size(m_window + m_max_lag));
+        history->written = 0;
+        history->sum = 0.0f;
+        history->count = 0;
+    }
+
+    m_next_search = m_window + m_max_lag;
+
+    m_thread = std::thread(&DelayEstimator::searchThread, this);
+}
+
+DelayEstimator::~DelayEstimator()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_signal.notify_one();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+void DelayEstimator::AddPlayback(const void *speaker_data, std::size_t speaker_data_size)
+{
+    addPcm(m_far, speaker_data, speaker_data_size);
+}
+
+void DelayEstimator::AddCapture(const void *capture_data, std::size_t capture_data_size)
+{
+    addPcm(m_near, capture_data, capture_data_size);
+    update();
+}
+
+void DelayEstimator::AddPlayback(const float * const *channel_data, std::size_t frame_count)
+{
+    append(m_far, channel_data[0], frame_count, 1);
+}
+
+void DelayEstimator::AddCapture(const float * const *channel_data, std::size_t frame_count)
+{
+    append(m_near, channel_data[0], frame_count, 1);
+    update();
+}
+
+void DelayEstimator::Reset()
+{
+    for (auto history : { &m_far, &m_near })
+    {
+        history->written = 0;
+        history->sum = 0.0f;
+        history->count = 0;
+    }
+
+    m_next_search = m_window + m_max_lag;
+    m_candidate_count = 0;
+    m_locked = false;
+
+    m_result_ready.store(false, std::memory_order_release);
+    m_drop_result = m_busy.load(std::memory_order_acquire);
+}
+
+delay_search_stats_t DelayEstimator::GetStats() const
+{
+    delay_search_stats_t stats;
+
+    stats.searches = m_searches.load(std::memory_order_relaxed);
+    stats.confident = m_confident.load(std::memory_order_relaxed);
+    stats.published = m_published.load(std::memory_order_relaxed);
+    stats.delay_ms = m_delay_ms.load(std::memory_order_relaxed);
+    stats.last_estimate_ms = m_last_estimate_ms.load(std::memory_order_relaxed);
+    stats.last_peak_ratio = m_last_peak_ratio.load(std::memory_order_relaxed);
+    stats.last_search_us = m_last_search_us.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+void DelayEstimator::addPcm(history_t &history, const void *data, std::size_t size)
+{
+    auto frame_octets = (audio_devices::sample_format_bits(m_sample_format) / 8) * m_channels;
+    auto frames = size / frame_octets;
+    auto chunk_frames = m_convert.size() / m_channels;
+    auto pcm = static_cast<const std::uint8_t*>(data);
+
+    while (frames > 0)
+    {
+        auto count = std::min(frames, chunk_frames);
+
+        audio_devices::audio_utils::pcm_to_float(pcm, count * m_channels, m_convert.data(), m_sample_format);
+        append(history, m_convert.data(), count, m_channels);
+
+        pcm += count * frame_octets;
+        frames -= count;
+    }
+}
+
+void DelayEstimator::append(history_t &history, const float *samples, std::size_t frame_count, std::uint32_t stride)
+{
+    // box decimation: aliases land on both ends alike and keep the lag
+    auto mask = history.ring.size() - 1;
+
+    for (std::size_t f = 0; f < frame_count; f++)
+    {
+        history.sum += samples[f * stride];
+
+        if (++history.count == m_decimation)
+        {
+            history.ring[history.written & mask] = history.sum / static_cast<float>(m_decimation);
+            history.written++;
+            history.sum = 0.0f;
+            history.count = 0;
+        }
+    }
+}
+
+void DelayEstimator::update()
+{
+    if (m_result_ready.load(std::memory_order_acquire))
+    {
+        auto estimate_ms = m_result_ms;
+        auto peak_ratio = m_result_ratio;
+
+        m_result_ready.store(false, std::memory_order_release);
+
+        if (m_drop_result)
+        {
+            m_drop_result = false;
+        }
+        else
+        {
+            publish(estimate_ms, peak_ratio);
+        }
+    }
+
+    // far and near ends are cut at the same sample
+    auto end = std::min(m_far.written, m_near.written);
+
+    if (end < m_next_search
+            || m_busy.load(std::memory_order_acquire)
+            || m_result_ready.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    auto length = m_far_window.size();
+    auto mask = m_far.ring.size() - 1;
+    auto start = end - length;
+
+    // near samples before the window are left out, so every lag up to
+    // m_max_lag correlates the same window against history
+    for (std::size_t i = 0; i < length; i++)
+    {
+        m_far_window[i] = m_far.ring[(start + i) & mask];
+        m_near_window[i] = i < m_max_lag ? 0.0f : m_near.ring[(start + i) & mask];
+    }
+
+    auto interval_ms = m_locked ? m_config.track_interval_ms : m_config.search_interval_ms;
+    m_next_search = end + std::max<std::uint64_t>(static_cast<std::uint64_t>(m_analysis_rate) * interval_ms / 1000, 1);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_busy.store(true, std::memory_order_release);
+    }
+
+    m_signal.notify_one();
+}
+
+void DelayEstimator::publish(std::int32_t estimate_ms, float peak_ratio)
+{
+    m_searches++;
+    m_last_estimate_ms.store(estimate_ms, std::memory_order_relaxed);
+    m_last_peak_ratio.store(peak_ratio, std::memory_order_relaxed);
+
+    // silence neither confirms nor breaks a candidate
+    if (estimate_ms < 0)
+    {
+        return;
+    }
+
+    if (peak_ratio < m_config.min_peak_ratio)
+    {
+        m_candidate_count = 0;
+        return;
+    }
+
+    m_confident++;
+
+    auto tolerance_ms = static_cast<std::int32_t>(m_config.tolerance_ms);
+
+    if (m_candidate_count > 0 && std::abs(estimate_ms - m_candidate_ms) <= tolerance_ms)
+    {
+        m_candidate_count++;
+    }
+    else
+    {
+        m_candidate_ms = estimate_ms;
+        m_candidate_count = 1;
+    }
+
+    if (m_candidate_count < m_config.agreements
+            || (m_locked && std::abs(estimate_ms - m_controller.GetStreamDelay()) <= tolerance_ms))
+    {
+        return;
+    }
+
+    LOG(info) << "Stream delay " << m_controller.GetStreamDelay() << " -> " << estimate_ms << " ms, peak ratio " << peak_ratio LOG_END;
+
+    m_controller.SetStreamDelay(estimate_ms);
+    m_locked = true;
+
+    m_published++;
+    m_delay_ms.store(estimate_ms, std::memory_order_relaxed);
+}
+
+void DelayEstimator::searchThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_stop)
+    {
+        m_signal.wait(lock, [this]() { return m_stop || m_busy.load(std::memory_order_acquire); });
+
+        if (m_stop)
+        {
+            break;
+        }
+
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+
+        search();
+
+        m_last_search_us.store(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+
+        lock.lock();
+
+        m_result_ready.store(true, std::memory_order_release);
+        m_busy.store(false, std::memory_order_release);
+    }
+}
+
+void DelayEstimator::search()
+{
+    auto length = m_far_window.size();
+    auto size = m_spectrum.size();
+    auto mask = size - 1;
+
+    m_result_ms = -1;
+    m_result_ratio = 0.0f;
+
+    if (level_dbfs(m_far_window.data(), length) < m_config.min_level_dbfs
+            || level_dbfs(m_near_window.data() + m_max_lag, m_window) < m_config.min_level_dbfs)
+    {
+        return;
+    }
+
+    // far end real, near end imaginary: both spectra from one transform
+    for (std::size_t i = 0; i < size; i++)
+    {
+        m_spectrum[i] = i < length
+                ? std::complex<float>(m_far_window[i], m_near_window[i])
+                : std::complex<float>(0.0f, 0.0f);
+    }
+
+    m_fft.Forward(m_spectrum.data());
+
+    // near times conjugate far, whitened; bins k and size - k are done
+    // together, the cross spectrum of real signals is conjugate symmetric
+    for (std::size_t k = 0; k <= size / 2; k++)
+    {
+        auto z = m_spectrum[k];
+        auto z_mirror = std::conj(m_spectrum[(size - k) & mask]);
+
+        auto far = (z + z_mirror) * 0.5f;
+        auto near = (z - z_mirror) * std::complex<float>(0.0f, -0.5f);
+        auto cross = near * std::conj(far);
+        auto magnitude = std::abs(cross);
+
+        cross = k != 0 && magnitude > 1e-20f
+                ? cross / magnitude
+                : std::complex<float>(0.0f, 0.0f);
+
+        m_spectrum[k] = cross;
+        m_spectrum[(size - k) & mask] = std::conj(cross);
+    }
+
+    m_fft.Inverse(m_spectrum.data());
+
+    std::size_t peak_lag = 0;
+    float peak = 0.0f;
+
+    for (std::size_t lag = 0; lag <= m_max_lag; lag++)
+    {
+        auto value = std::abs(m_spectrum[lag].real());
+
+        if (value > peak)
+        {
+            peak = value;
+            peak_lag = lag;
+        }
+    }
+
+    auto tolerance = static_cast<std::size_t>(m_analysis_rate) * m_config.tolerance_ms / 1000;
+    float second = 0.0f;
+
+    for (std::size_t lag = 0; lag <= m_max_lag; lag++)
+    {
+        if (lag + tolerance < peak_lag || lag > peak_lag + tolerance)
+        {
+            second = std::max(second, std::abs(m_spectrum[lag].real()));
+        }
+    }
+
+    m_result_ms = static_cast<std::int32_t>((peak_lag * 1000 + m_analysis_rate / 2) / m_analysis_rate);
+    m_result_ratio = second > 0.0f ? peak / second : peak > 0.0f ? 1000.0f : 0.0f;
+}
+
+}
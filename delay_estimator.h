@@ -0,0 +1,146 @@
+#ifndef DELAY_ESTIMATOR_H
+#define DELAY_ESTIMATOR_H
+
+#include "aec_controller.h"
+#include "fft.h"
+
+#include <vector>
+#include <complex>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+namespace audio_processing
+{
+
+struct delay_search_config_t
+{
+    std::uint32_t   max_delay_ms;       // far to near lags searched
+    std::uint32_t   window_ms;          // near end correlated per search
+    std::uint32_t   search_interval_ms; // until a delay is published
+    std::uint32_t   track_interval_ms;  // afterwards
+    float           min_peak_ratio;     // main peak over the largest one outside tolerance_ms
+    std::uint32_t   agreements;         // confident searches in a row within tolerance_ms
+    std::uint32_t   tolerance_ms;
+    float           min_level_dbfs;     // quieter far or near windows are not searched
+
+    delay_search_config_t()
+        : max_delay_ms(500)
+        , window_ms(1000)
+        , search_interval_ms(500)
+        , track_interval_ms(5000)
+        , min_peak_ratio(2.0f)
+        , agreements(2)
+        , tolerance_ms(4)
+        , min_level_dbfs(-50.0f)
+    {}
+};
+
+// readable from any thread
+struct delay_search_stats_t
+{
+    std::uint64_t   searches;
+    std::uint64_t   confident;          // passed the peak ratio
+    std::uint64_t   published;
+    std::int32_t    delay_ms;           // published, -1 before the first one
+    std::int32_t    last_estimate_ms;
+    float           last_peak_ratio;
+    std::uint64_t   last_search_us;
+};
+
+// Finds the stream delay of the controller from the signals instead of
+// leaving it at 0: far and near ends are decimated to 8 kHz into a short
+// history, and every search_interval_ms a background thread correlates the
+// last window_ms of the near end with the far end by GCC-PHAT (cross
+// spectrum whitened to its phase, one FFT for both ends). The lag of the
+// main peak is published with SetStreamDelay once it stands out of the
+// correlation and repeats, later searches run at track_interval_ms and
+// only republish a moved echo path. Add* and the publishing run on the
+// processing thread, near frames are the unprocessed capture.
+class DelayEstimator
+{
+    struct history_t
+    {
+        std::vector<float>                              ring;
+        std::uint64_t                                   written;
+        float                                           sum;            // of the samples being decimated
+        std::uint32_t                                   count;
+    };
+
+    AecController&                                      m_controller;
+    delay_search_config_t                               m_config;
+    audio_devices::sample_format_t                      m_sample_format;
+    std::uint32_t                                       m_channels;
+    std::uint32_t                                       m_decimation;
+    std::uint32_t                                       m_analysis_rate;
+    std::vector<float>                                  m_convert;      // one frame, interleaved
+
+    // processing thread
+    history_t                                           m_far;
+    history_t                                           m_near;
+    std::uint64_t                                       m_window;       // samples at m_analysis_rate
+    std::uint64_t                                       m_max_lag;
+    std::uint64_t                                       m_next_search;
+    std::int32_t                                        m_candidate_ms;
+    std::uint32_t                                       m_candidate_count;
+    bool                                                m_locked;
+    bool                                                m_drop_result;  // of a search started before Reset
+
+    // search thread while m_busy
+    Fft                                                 m_fft;
+    std::vector<float>                                  m_far_window;
+    std::vector<float>                                  m_near_window;
+    std::vector<std::complex<float>>                    m_spectrum;
+    std::int32_t                                        m_result_ms;
+    float                                               m_result_ratio;
+
+    std::atomic<bool>                                   m_busy;
+    std::atomic<bool>                                   m_result_ready;
+    std::thread                                         m_thread;
+    std::mutex                                          m_mutex;
+    std::condition_variable                             m_signal;
+    bool                                                m_stop;
+
+    std::atomic<std::uint64_t>                          m_searches;
+    std::atomic<std::uint64_t>                          m_confident;
+    std::atomic<std::uint64_t>                          m_published;
+    std::atomic<std::int32_t>                           m_delay_ms;
+    std::atomic<std::int32_t>                           m_last_estimate_ms;
+    std::atomic<float>                                  m_last_peak_ratio;
+    std::atomic<std::uint64_t>                          m_last_search_us;
+
+public:
+    // rate and format of the controller frames, the first channel is used
+    DelayEstimator(AecController& controller, std::uint32_t sample_rate, audio_devices::sample_format_t sample_format, std::uint32_t channels = 1, const delay_search_config_t& config = delay_search_config_t());
+    ~DelayEstimator();
+
+    DelayEstimator(const DelayEstimator&) = delete;
+    DelayEstimator& operator=(const DelayEstimator&) = delete;
+
+    // interleaved frames of the controller format
+    void AddPlayback(const void* speaker_data, std::size_t speaker_data_size);
+    void AddCapture(const void* capture_data, std::size_t capture_data_size);
+
+    // planar float as given to the controller
+    void AddPlayback(const float* const* channel_data, std::size_t frame_count);
+    void AddCapture(const float* const* channel_data, std::size_t frame_count);
+
+    // restarts the search, e.g. after a device change
+    void Reset();
+
+    delay_search_stats_t GetStats() const;
+
+private:
+    void addPcm(history_t& history, const void* data, std::size_t size);
+    void append(history_t& history, const float* samples, std::size_t frame_count, std::uint32_t stride);
+    void update();
+    void publish(std::int32_t estimate_ms, float peak_ratio);
+    void searchThread();
+    void search();
+};
+
+}
+
+#endif // DELAY_ESTIMATOR_H
@@ -0,0 +1,237 @@
+#include "duplex_device.h"
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_devices
+{
+
+static std::uint64_t monotonic_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AlsaDuplexDevice::AlsaDuplexDevice()
+    : m_linked(false)
+    , m_started(false)
+    , m_round_trip_frames(0)
+    , m_stats()
+{
+
+}
+
+AlsaDuplexDevice::~AlsaDuplexDevice()
+{
+    Close();
+}
+
+bool AlsaDuplexDevice::Open(const std::string &player_name
+                            , const audio_params_t &player_params
+                            , const std::string &recorder_name
+                            , const audio_params_t &recorder_params)
+{
+    Close();
+
+    if (!player_params.is_init()
+            || !recorder_params.is_init()
+            || player_params.recorder
+            || !recorder_params.recorder
+            || player_params.audio_format.sample_rate != recorder_params.audio_format.sample_rate)
+    {
+        LOG(warning) << "Can't open duplex device: inconsistent params" LOG_END;
+        return false;
+    }
+
+    m_player.SetManualStart(true);
+    m_recorder.SetManualStart(true);
+
+    if (!m_player.Open(player_name, player_params)
+            || !m_recorder.Open(recorder_name, recorder_params))
+    {
+        Close();
+        return false;
+    }
+
+    m_linked = m_player.Link(m_recorder);
+
+    LOG(info) << "Duplex device opened, " << (m_linked ? "linked" : "not linked, timestamp aligned") LOG_END;
+
+    return true;
+}
+
+bool AlsaDuplexDevice::Close()
+{
+    bool result = IsOpen();
+
+    if (m_linked)
+    {
+        m_player.Unlink();
+        m_linked = false;
+    }
+
+    m_player.Close();
+    m_recorder.Close();
+
+    m_started = false;
+    m_round_trip_frames = 0;
+
+    return result;
+}
+
+bool AlsaDuplexDevice::IsOpen() const
+{
+    return m_player.IsOpen() && m_recorder.IsOpen();
+}
+
+bool AlsaDuplexDevice::Start(std::uint32_t prefill_ms)
+{
+    if (!IsOpen() || m_started)
+    {
+        return false;
+    }
+
+    const auto& audio_format = m_player.GetParams().audio_format;
+    const auto& pcm_config = m_player.GetPcmConfig();
+
+    // keep at least one period free to avoid blocking on prefill
+    std::uint32_t prefill_frames = (audio_format.sample_rate * prefill_ms) / 1000;
+
+    if (pcm_config.buffer_frames > pcm_config.period_frames)
+    {
+        prefill_frames = std::min(prefill_frames, pcm_config.buffer_frames - pcm_config.period_frames);
+    }
+
+    if (prefill_frames > 0)
+    {
+        std::vector<std::uint8_t> silence(prefill_frames * audio_format.frames_octets(), 0);
+
+        if (m_player.Write(silence.data(), silence.size()) < 0)
+        {
+            LOG(error) << "Can't prefill duplex player" LOG_END;
+            return false;
+        }
+    }
+
+    std::int64_t skew_ns = 0;
+    std::int32_t corrected_frames = 0;
+
+    if (m_linked)
+    {
+        m_started = m_player.Start();
+    }
+    else
+    {
+        auto player_start_ns = monotonic_ns();
+        m_started = m_player.Start();
+        auto recorder_start_ns = monotonic_ns();
+        m_started = m_recorder.Start() && m_started;
+
+        std::uint64_t player_trigger_ns = 0, recorder_trigger_ns = 0;
+
+        // driver trigger timestamps are precise, local clock is the fallback
+        if (m_player.GetTriggerTime(player_trigger_ns)
+                && m_recorder.GetTriggerTime(recorder_trigger_ns))
+        {
+            skew_ns = static_cast<std::int64_t>(recorder_trigger_ns - player_trigger_ns);
+        }
+        else
+        {
+            skew_ns = static_cast<std::int64_t>(recorder_start_ns - player_start_ns);
+        }
+    }
+
+    auto skew_frames = static_cast<std::int32_t>((skew_ns * audio_format.sample_rate) / 1000000000);
+
+    if (m_started && skew_frames != 0)
+    {
+        corrected_frames = correctSkew(skew_frames);
+    }
+
+    m_stats = duplex_stats_t();
+    m_stats.linked = m_linked;
+    m_stats.started = m_started;
+    m_stats.skew_us = skew_ns / 1000;
+    m_stats.corrected_frames = corrected_frames;
+    m_stats.residual_frames = skew_frames - corrected_frames;
+
+    if (m_started)
+    {
+        // the recorder starting later sees the playback earlier in its stream
+        m_round_trip_frames = static_cast<std::int32_t>(prefill_frames)
+                - skew_frames
+                + corrected_frames;
+
+        m_stats.round_trip_frames = m_round_trip_frames;
+
+        LOG(info) << "Duplex device started, round trip " << GetRoundTripMs()
+                  << " ms, skew " << skew_ns / 1000 << " us, corrected " << corrected_frames << " frames" LOG_END;
+    }
+    else
+    {
+        LOG(error) << "Can't start duplex device" LOG_END;
+    }
+
+    return m_started;
+}
+
+std::int32_t AlsaDuplexDevice::correctSkew(std::int32_t skew_frames)
+{
+    const auto& audio_format = m_player.GetParams().audio_format;
+    const auto& pcm_config = m_player.GetPcmConfig();
+
+    if (skew_frames > 0)
+    {
+        // player ahead: delay it by silence, without blocking on a full buffer
+        auto queued = std::max(m_player.GetDelay(), 0);
+        auto free_frames = std::max(static_cast<std::int32_t>(pcm_config.buffer_frames) - queued, 0);
+        auto frames = std::min(skew_frames, free_frames);
+
+        if (frames > 0)
+        {
+            std::vector<std::uint8_t> silence(frames * audio_format.frames_octets(), 0);
+
+            if (m_player.Write(silence.data(), silence.size()) < 0)
+            {
+                LOG(warning) << "Can't pad duplex player, skew not corrected" LOG_END;
+                return 0;
+            }
+        }
+
+        return frames;
+    }
+
+    // recorder ahead: its first frames precede the playback start
+    const auto& recorder_format = m_recorder.GetParams().audio_format;
+    std::vector<std::uint8_t> dropped(static_cast<std::size_t>(-skew_frames) * recorder_format.frames_octets());
+
+    auto result = m_recorder.Read(dropped.data(), dropped.size());
+
+    if (result < 0)
+    {
+        LOG(warning) << "Can't drop duplex recorder frames, skew not corrected" LOG_END;
+        return 0;
+    }
+
+    return -static_cast<std::int32_t>(result / std::max<std::size_t>(recorder_format.frames_octets(), 1));
+}
+
+std::int32_t AlsaDuplexDevice::GetRoundTripMs() const
+{
+    auto sample_rate = m_player.GetParams().audio_format.sample_rate;
+
+    return sample_rate > 0
+            ? (m_round_trip_frames * 1000) / static_cast<std::int32_t>(sample_rate)
+            : 0;
+}
+
+}
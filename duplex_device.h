@@ -0,0 +1,69 @@
+#ifndef DUPLEX_DEVICE_H
+#define DUPLEX_DEVICE_H
+
+#include "alsa_device.h"
+
+namespace audio_devices
+{
+
+struct duplex_stats_t
+{
+    bool            linked;
+    bool            started;
+    std::int64_t    skew_us;            // recorder trigger after the player's
+    std::int32_t    corrected_frames;   // silence padded to the player, negative - dropped from the recorder
+    std::int32_t    residual_frames;    // skew left after the correction
+    std::int32_t    round_trip_frames;
+};
+
+// Player and recorder started together, so the capture-to-render offset
+// is fixed for the whole session. PCMs are linked when the driver allows it,
+// otherwise the start skew is measured from trigger timestamps and
+// compensated on the leading stream: silence padded to the player or
+// captured frames dropped, as far as the player buffer allows.
+class AlsaDuplexDevice
+{
+    AlsaDevice                      m_player;
+    AlsaDevice                      m_recorder;
+
+    bool                            m_linked;
+    bool                            m_started;
+    std::int32_t                    m_round_trip_frames;
+    duplex_stats_t                  m_stats;
+
+public:
+
+    AlsaDuplexDevice();
+    ~AlsaDuplexDevice();
+
+    bool Open(const std::string& player_name
+              , const audio_params_t& player_params
+              , const std::string& recorder_name
+              , const audio_params_t& recorder_params);
+    bool Close();
+
+    bool IsOpen() const;
+    inline bool IsLinked() const { return m_linked; }
+    inline bool IsStarted() const { return m_started; }
+
+    // queues prefill_ms of silence to the player and starts both devices
+    bool Start(std::uint32_t prefill_ms = 20);
+
+    inline AlsaDevice& Player() { return m_player; }
+    inline AlsaDevice& Recorder() { return m_recorder; }
+
+    // offset between the frame written to the player and its position
+    // in the captured stream, excluding converters and acoustic path
+    inline std::int32_t GetRoundTripFrames() const { return m_round_trip_frames; }
+    std::int32_t GetRoundTripMs() const;
+
+    // of the last Start
+    inline const duplex_stats_t& GetStats() const { return m_stats; }
+
+private:
+    std::int32_t correctSkew(std::int32_t skew_frames);
+};
+
+}
+
+#endif // DUPLEX_DEVICE_H
@@ -0,0 +1,193 @@
+#include "energy_gate.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace audio_processing
+{
+
+float frame_energy(const float *samples, std::size_t sample_count)
+{
+    if (sample_count == 0)
+    {
+        return 0.0f;
+    }
+
+    std::size_t i = 0;
+    float sum = 0.0f;
+
+#if defined(__SSE__)
+
+    __m128 acc_0 = _mm_setzero_ps();
+    __m128 acc_1 = _mm_setzero_ps();
+
+    for (; i + 8 <= sample_count; i += 8)
+    {
+        __m128 v_0 = _mm_loadu_ps(samples + i);
+        __m128 v_1 = _mm_loadu_ps(samples + i + 4);
+        acc_0 = _mm_add_ps(acc_0, _mm_mul_ps(v_0, v_0));
+        acc_1 = _mm_add_ps(acc_1, _mm_mul_ps(v_1, v_1));
+    }
+
+    float partial[4];
+    _mm_storeu_ps(partial, _mm_add_ps(acc_0, acc_1));
+    sum = partial[0] + partial[1] + partial[2] + partial[3];
+
+#elif defined(__ARM_NEON)
+
+    float32x4_t acc = vdupq_n_f32(0.0f);
+
+    for (; i + 4 <= sample_count; i += 4)
+    {
+        float32x4_t v = vld1q_f32(samples + i);
+        acc = vmlaq_f32(acc, v, v);
+    }
+
+    sum = vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1) + vgetq_lane_f32(acc, 2) + vgetq_lane_f32(acc, 3);
+
+#endif
+
+    for (; i < sample_count; i++)
+    {
+        sum += samples[i] * samples[i];
+    }
+
+    return sum / static_cast<float>(sample_count);
+}
+
+EnergyGate::EnergyGate(float threshold_dbfs, std::uint32_t hangover_frames)
+    : m_threshold(0.0f)
+    , m_hangover_frames(hangover_frames)
+    , m_silent_frames(0)
+{
+    SetThreshold(threshold_dbfs);
+}
+
+void EnergyGate::SetThreshold(float threshold_dbfs)
+{
+    // dBFS is relative to a full scale sine, mean square of which is 0.5
+    m_threshold = 0.5f * std::pow(10.0f, threshold_dbfs / 10.0f);
+}
+
+void EnergyGate::SetHangover(std::uint32_t hangover_frames)
+{
+    m_hangover_frames = hangover_frames;
+}
+
+bool EnergyGate::Process(const float *samples, std::size_t sample_count)
+{
+    bool active = frame_energy(samples, sample_count) >= m_threshold;
+
+    if (active)
+    {
+        m_silent_frames = 0;
+    }
+    else if (m_silent_frames < m_hangover_frames)
+    {
+        m_silent_frames++;
+    }
+
+    return active;
+}
+
+bool EnergyGate::Process(const float * const *channel_data, std::uint32_t channels, std::size_t frame_count)
+{
+    float energy = 0.0f;
+
+    for (std::uint32_t c = 0; c < channels; c++)
+    {
+        energy = std::max(energy, frame_energy(channel_data[c], frame_count));
+    }
+
+    bool active = energy >= m_threshold;
+
+    if (active)
+    {
+        m_silent_frames = 0;
+    }
+    else if (m_silent_frames < m_hangover_frames)
+    {
+        m_silent_frames++;
+    }
+
+    return active;
+}
+
+void EnergyGate::Reset()
+{
+    m_silent_frames = 0;
+}
+
+// DC blocker corner, well below the 80 Hz of the webrtc filter
+const float gated_high_pass_hz = 20.0f;
+
+GatedFilter::GatedFilter()
+    : m_pole(0.0f)
+    , m_gain(1.0f)
+    , m_high_pass(false)
+    , m_primed(false)
+{
+
+}
+
+void GatedFilter::Start(std::uint32_t channels, std::uint32_t sample_rate, bool high_pass, float floor_gain)
+{
+    m_high_pass = high_pass;
+    m_gain = floor_gain;
+    m_pole = sample_rate > 0 ? std::exp(-2.0f * 3.14159265f * gated_high_pass_hz / sample_rate) : 0.0f;
+
+    m_x1.assign(channels, 0.0f);
+    m_y1.assign(channels, 0.0f);
+    m_primed = false;
+}
+
+void GatedFilter::Process(const float * const *channel_data, float * const *output_data, std::uint32_t channels, std::size_t frame_count)
+{
+    for (std::uint32_t c = 0; c < channels && c < m_x1.size(); c++)
+    {
+        // the run starts from the current level, no step
+        if (!m_primed && frame_count > 0)
+        {
+            m_x1[c] = channel_data[c][0];
+        }
+
+        auto input = channel_data[c];
+        auto output = output_data[c];
+
+        if (!m_high_pass)
+        {
+            for (std::size_t i = 0; i < frame_count; i++)
+            {
+                output[i] = input[i] * m_gain;
+            }
+
+            continue;
+        }
+
+        auto x1 = m_x1[c];
+        auto y1 = m_y1[c];
+
+        for (std::size_t i = 0; i < frame_count; i++)
+        {
+            auto x = input[i];
+
+            y1 = x - x1 + m_pole * y1;
+            x1 = x;
+
+            output[i] = y1 * m_gain;
+        }
+
+        m_x1[c] = x1;
+        m_y1[c] = y1;
+    }
+
+    m_primed = true;
+}
+
+}
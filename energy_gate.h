@@ -0,0 +1,63 @@
+#ifndef ENERGY_GATE_H
+#define ENERGY_GATE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace audio_processing
+{
+
+// mean square of normalized [-1..1] samples
+float frame_energy(const float* samples, std::size_t sample_count);
+
+class EnergyGate
+{
+    float                                               m_threshold;
+    std::uint32_t                                       m_hangover_frames;
+    std::uint32_t                                       m_silent_frames;
+
+public:
+    EnergyGate(float threshold_dbfs = -60.0f, std::uint32_t hangover_frames = 50);
+
+    void SetThreshold(float threshold_dbfs);
+    void SetHangover(std::uint32_t hangover_frames);
+
+    // returns true if frame is above threshold
+    bool Process(const float* samples, std::size_t sample_count);
+    // planar, the loudest channel decides
+    bool Process(const float* const* channel_data, std::uint32_t channels, std::size_t frame_count);
+
+    // the stream has been silent for at least hangover frames
+    inline bool IsIdle() const { return m_silent_frames >= m_hangover_frames; }
+
+    void Reset();
+};
+
+// Stand-in for the processor on gated frames, which are noise only: a DC
+// blocker for the high pass filter and the gain floor the noise
+// suppressor takes noise to. Processes in place.
+class GatedFilter
+{
+    std::vector<float>                                  m_x1;               // per channel
+    std::vector<float>                                  m_y1;
+    float                                               m_pole;
+    float                                               m_gain;
+    bool                                                m_high_pass;
+    bool                                                m_primed;
+
+public:
+    GatedFilter();
+
+    // at the first frame of a gated run; floor_gain 1.0 - no suppression
+    void Start(std::uint32_t channels, std::uint32_t sample_rate, bool high_pass, float floor_gain);
+
+    // nothing to do, frames may be copied as is
+    inline bool IsBypass() const { return !m_high_pass && m_gain >= 1.0f; }
+
+    void Process(const float* const* channel_data, float* const* output_data, std::uint32_t channels, std::size_t frame_count);
+};
+
+}
+
+#endif // ENERGY_GATE_H
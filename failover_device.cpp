@@ -0,0 +1,414 @@
+#include "failover_device.h"
+
+#include <cstring>
+#include <cerrno>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_devices
+{
+
+static void fill_silence(void* data, std::size_t size, sample_format_t sample_format)
+{
+    std::memset(data, sample_format == sample_format_t::u8 ? 0x80 : 0, size);
+}
+
+FailoverDevice::FailoverDevice(std::unique_ptr<AudioDevice> device, const failover_config_t &config)
+    : m_config(config)
+    , m_open(false)
+    , m_volume(100)
+    , m_state(state_t::active)
+    , m_active(0)
+    , m_last_error(0)
+    , m_error_count(0)
+    , m_stop(false)
+    , m_failures(0)
+    , m_recoveries(0)
+    , m_concealed_calls(0)
+    , m_last_outage_ms(0)
+    , m_active_device(0)
+{
+    m_candidates.resize(1);
+    m_candidates[0].device = std::move(device);
+}
+
+FailoverDevice::~FailoverDevice()
+{
+    Close();
+}
+
+void FailoverDevice::AddStandby(const std::string &device_spec)
+{
+    candidate_t candidate;
+    candidate.spec = device_spec;
+
+    m_candidates.push_back(std::move(candidate));
+}
+
+void FailoverDevice::SetEventHandler(const event_handler_t &event_handler)
+{
+    m_event_handler = event_handler;
+}
+
+bool FailoverDevice::Open(const std::string &device_name, const audio_params_t &audio_params)
+{
+    Close();
+
+    m_audio_params = audio_params;
+    m_candidates[0].name = device_name;
+
+    for (std::size_t i = 0; i < m_candidates.size() && !m_open; i++)
+    {
+        if (openCandidate(i))
+        {
+            m_open = true;
+            m_active = i;
+        }
+    }
+
+    if (m_open)
+    {
+        m_state = state_t::active;
+        m_active_device = m_active;
+        m_error_count = 0;
+        m_last_progress = std::chrono::steady_clock::now();
+        m_last_call = m_last_progress;
+
+        m_thread = std::thread(&FailoverDevice::recoveryThread, this);
+    }
+    else
+    {
+        LOG(error) << "Can't open " << device_name << " or any of " << (m_candidates.size() - 1) << " standby devices" LOG_END;
+    }
+
+    return m_open;
+}
+
+bool FailoverDevice::Close()
+{
+    if (!m_open)
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_signal.notify_one();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    for (auto& candidate : m_candidates)
+    {
+        if (candidate.device != nullptr)
+        {
+            candidate.device->Close();
+        }
+    }
+
+    m_stop = false;
+    m_open = false;
+    m_state = state_t::active;
+
+    return true;
+}
+
+bool FailoverDevice::IsOpen() const
+{
+    return m_open;
+}
+
+bool FailoverDevice::IsRecorder() const
+{
+    return m_audio_params.recorder;
+}
+
+const audio_params_t &FailoverDevice::GetParams() const
+{
+    return m_audio_params;
+}
+
+bool FailoverDevice::SetParams(const audio_params_t &audio_params)
+{
+    if (!m_open)
+    {
+        m_audio_params = audio_params;
+        return audio_params.is_init();
+    }
+
+    // not while the recovery thread may open a device with them
+    auto device = acquireDevice();
+
+    if (device != nullptr && device->SetParams(audio_params))
+    {
+        m_audio_params = audio_params;
+        return true;
+    }
+
+    return false;
+}
+
+std::int32_t FailoverDevice::Read(void *capture_data, std::size_t size)
+{
+    if (!m_open)
+    {
+        return -EBADF;
+    }
+
+    if (!IsRecorder())
+    {
+        return -EACCES;
+    }
+
+    auto device = acquireDevice();
+
+    if (device != nullptr)
+    {
+        auto result = device->Read(capture_data, size);
+
+        checkResult(result);
+
+        if (result >= 0 || result == -EAGAIN)
+        {
+            return result;
+        }
+    }
+
+    m_concealed_calls++;
+    fill_silence(capture_data, size, m_audio_params.audio_format.format());
+
+    return static_cast<std::int32_t>(size);
+}
+
+std::int32_t FailoverDevice::Write(const void *playback_data, std::size_t size)
+{
+    if (!m_open)
+    {
+        return -EBADF;
+    }
+
+    if (IsRecorder())
+    {
+        return -EACCES;
+    }
+
+    auto device = acquireDevice();
+
+    if (device != nullptr)
+    {
+        auto result = device->Write(playback_data, size);
+
+        checkResult(result);
+
+        if (result >= 0 || result == -EAGAIN)
+        {
+            return result;
+        }
+    }
+
+    m_concealed_calls++;
+
+    return static_cast<std::int32_t>(size);
+}
+
+void FailoverDevice::SetVolume(std::uint32_t volume)
+{
+    m_volume = volume;
+
+    auto device = m_open ? acquireDevice() : nullptr;
+
+    if (device != nullptr)
+    {
+        device->SetVolume(volume);
+    }
+}
+
+failover_stats_t FailoverDevice::GetStats() const
+{
+    failover_stats_t stats;
+
+    stats.failures = m_failures;
+    stats.recoveries = m_recoveries;
+    stats.concealed_calls = m_concealed_calls;
+    stats.last_outage_ms = m_last_outage_ms;
+    stats.active_device = m_active_device;
+    stats.healthy = IsHealthy();
+
+    return stats;
+}
+
+AudioDevice *FailoverDevice::acquireDevice()
+{
+    auto state = m_state.load(std::memory_order_acquire);
+
+    if (state == state_t::failed)
+    {
+        return nullptr;
+    }
+
+    if (state == state_t::ready)
+    {
+        m_error_count = 0;
+        m_last_progress = std::chrono::steady_clock::now();
+        m_last_call = m_last_progress;
+        m_state.store(state_t::active, std::memory_order_relaxed);
+    }
+
+    return m_candidates[m_active].device.get();
+}
+
+void FailoverDevice::checkResult(std::int32_t result)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    // a caller that paused is not a stalled device
+    if (now - m_last_call > std::chrono::milliseconds(m_config.stall_ms))
+    {
+        m_last_progress = now;
+    }
+
+    m_last_call = now;
+
+    if (result > 0)
+    {
+        m_last_progress = now;
+        m_error_count = 0;
+        return;
+    }
+
+    if (result < 0 && result != -EAGAIN)
+    {
+        m_last_error = result;
+        m_error_count++;
+    }
+    else
+    {
+        m_last_error = 0;
+    }
+
+    if (m_error_count >= m_config.error_count
+            || now - m_last_progress >= std::chrono::milliseconds(m_config.stall_ms))
+    {
+        m_fail_time = now;
+        m_failures++;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_state.store(state_t::failed, std::memory_order_release);
+        }
+
+        m_signal.notify_one();
+    }
+}
+
+bool FailoverDevice::openCandidate(std::size_t index)
+{
+    auto& candidate = m_candidates[index];
+
+    if (candidate.device == nullptr)
+    {
+        candidate.device = AudioDevice::Create(candidate.spec, candidate.name);
+
+        if (candidate.device == nullptr)
+        {
+            return false;
+        }
+    }
+
+    if (!candidate.device->Open(candidate.name, m_audio_params))
+    {
+        return false;
+    }
+
+    candidate.device->SetVolume(m_volume);
+
+    return true;
+}
+
+void FailoverDevice::recoveryThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_stop)
+    {
+        if (m_state.load(std::memory_order_acquire) != state_t::failed)
+        {
+            m_signal.wait(lock);
+            continue;
+        }
+
+        lock.unlock();
+
+        auto failed = m_active;
+        auto& failed_name = m_candidates[failed].name;
+
+        LOG(warning) << "Device " << failed_name << " failed, error = " << m_last_error << ", recovering" LOG_END;
+
+        if (m_event_handler)
+        {
+            m_event_handler({ failed_name, false, m_last_error, 0 });
+        }
+
+        m_candidates[failed].device->Close();
+
+        bool recovered = false;
+
+        while (!recovered)
+        {
+            // the failed device first: a wedged stream reopens in place
+            for (std::size_t i = 0; i < m_candidates.size() && !recovered; i++)
+            {
+                auto index = (failed + i) % m_candidates.size();
+
+                if (openCandidate(index))
+                {
+                    m_active = index;
+                    recovered = true;
+                }
+            }
+
+            if (!recovered)
+            {
+                lock.lock();
+
+                if (m_signal.wait_for(lock, std::chrono::milliseconds(m_config.retry_ms), [this] { return m_stop; }))
+                {
+                    return;
+                }
+
+                lock.unlock();
+            }
+        }
+
+        auto outage_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_fail_time).count();
+
+        m_last_outage_ms = static_cast<std::uint32_t>(outage_ms);
+        m_active_device = m_active;
+        m_recoveries++;
+
+        LOG(info) << "Device " << m_candidates[m_active].name << " recovered in " << outage_ms << " ms" LOG_END;
+
+        m_state.store(state_t::ready, std::memory_order_release);
+
+        if (m_event_handler)
+        {
+            m_event_handler({ m_candidates[m_active].name, true, 0, static_cast<std::uint32_t>(outage_ms) });
+        }
+
+        lock.lock();
+    }
+}
+
+}
@@ -0,0 +1,143 @@
+#ifndef FAILOVER_DEVICE_H
+#define FAILOVER_DEVICE_H
+
+#include "audio_device.h"
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+namespace audio_devices
+{
+
+struct failover_config_t
+{
+    std::uint32_t   stall_ms;           // no data moved for this long fails the device
+    std::uint32_t   error_count;        // failed calls in a row that fail the device
+    std::uint32_t   retry_ms;           // pause between recovery rounds
+
+    failover_config_t()
+        : stall_ms(200)
+        , error_count(3)
+        , retry_ms(100)
+    {}
+};
+
+struct failover_event_t
+{
+    std::string     device_name;        // failed or recovered device
+    bool            recovered;
+    std::int32_t    error;              // last result of the failed device, 0 - stall
+    std::uint32_t   outage_ms;          // recovered only
+};
+
+// readable from any thread
+struct failover_stats_t
+{
+    std::uint64_t   failures;
+    std::uint64_t   recoveries;
+    std::uint64_t   concealed_calls;    // Read/Write answered while recovering
+    std::uint32_t   last_outage_ms;
+    std::uint32_t   active_device;      // 0 - primary, then standbys in order
+    bool            healthy;
+};
+
+// Wraps a device and watches its results: errors in a row or no progress
+// for stall_ms fail it. A background thread then closes it and opens the
+// same device again or the standbys, in a round starting from the failed
+// one, until one opens. Meanwhile Read returns silence and Write discards,
+// so the caller keeps its pace and its processing state. The devices are
+// handed between the calling thread and the recovery thread, only one of
+// them uses a device at a time.
+class FailoverDevice : public AudioDevice
+{
+public:
+    using event_handler_t = std::function<void(const failover_event_t& event)>;
+
+private:
+    enum class state_t
+    {
+        active,         // the calling thread owns the active device
+        failed,         // the recovery thread owns all devices
+        ready           // recovered, taken over by the next call
+    };
+
+    struct candidate_t
+    {
+        std::string                                     spec;       // standby: "[type:]name"
+        std::string                                     name;
+        std::unique_ptr<AudioDevice>                    device;
+    };
+
+    failover_config_t                                   m_config;
+    std::vector<candidate_t>                            m_candidates;
+    event_handler_t                                     m_event_handler;
+
+    bool                                                m_open;
+    audio_params_t                                      m_audio_params;
+    std::atomic<std::uint32_t>                          m_volume;
+
+    std::atomic<state_t>                                m_state;
+    std::size_t                                         m_active;
+    std::int32_t                                        m_last_error;
+    std::uint32_t                                       m_error_count;
+    std::chrono::steady_clock::time_point               m_last_progress;
+    std::chrono::steady_clock::time_point               m_last_call;
+    std::chrono::steady_clock::time_point               m_fail_time;
+
+    std::thread                                         m_thread;
+    std::mutex                                          m_mutex;
+    std::condition_variable                             m_signal;
+    bool                                                m_stop;
+
+    std::atomic<std::uint64_t>                          m_failures;
+    std::atomic<std::uint64_t>                          m_recoveries;
+    std::atomic<std::uint64_t>                          m_concealed_calls;
+    std::atomic<std::uint32_t>                          m_last_outage_ms;
+    std::atomic<std::uint32_t>                          m_active_device;
+
+public:
+
+    FailoverDevice(std::unique_ptr<AudioDevice> device, const failover_config_t& config = failover_config_t());
+    ~FailoverDevice() override;
+
+    // tried in the order added, before Open
+    void AddStandby(const std::string& device_spec);
+
+    // called on the recovery thread
+    void SetEventHandler(const event_handler_t& event_handler);
+
+    // the primary device, standbys if it can't be opened
+    bool Open(const std::string& device_name, const audio_params_t& audio_params = null_audio_params) override;
+    bool Close() override;
+
+    bool IsOpen() const override;
+    bool IsRecorder() const override;
+
+    const audio_params_t& GetParams() const override;
+    bool SetParams(const audio_params_t& audio_params) override;
+
+    std::int32_t Read(void* capture_data, std::size_t size) override;
+    std::int32_t Write(const void* playback_data, std::size_t size) override;
+
+    void SetVolume(std::uint32_t volume) override;
+    inline std::uint32_t GetVolume() const override { return m_volume; }
+
+    inline bool IsHealthy() const { return m_state != state_t::failed; }
+    failover_stats_t GetStats() const;
+
+private:
+    // active device of the calling thread, nullptr while recovering
+    AudioDevice* acquireDevice();
+    void checkResult(std::int32_t result);
+    bool openCandidate(std::size_t index);
+    void recoveryThread();
+};
+
+}
+
+#endif // FAILOVER_DEVICE_H
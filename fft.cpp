@@ -0,0 +1,93 @@
+#include "fft.h"
+
+#include <cmath>
+#include <utility>
+
+namespace audio_processing
+{
+
+Fft::Fft(std::size_t size)
+    : m_size(2)
+{
+    std::uint32_t bits = 1;
+
+    while (m_size < size)
+    {
+        m_size <<= 1;
+        bits++;
+    }
+
+    const double pi = 3.14159265358979323846;
+
+    m_twiddles.resize(m_size / 2);
+
+    for (std::size_t k = 0; k < m_twiddles.size(); k++)
+    {
+        auto angle = -2.0 * pi * static_cast<double>(k) / static_cast<double>(m_size);
+        m_twiddles[k] = std::complex<float>(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+    }
+
+    m_reversed.resize(m_size);
+
+    for (std::uint32_t i = 0; i < m_size; i++)
+    {
+        std::uint32_t reversed = 0;
+
+        for (std::uint32_t b = 0; b < bits; b++)
+        {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+
+        m_reversed[i] = reversed;
+    }
+}
+
+void Fft::Forward(std::complex<float> *data) const
+{
+    transform(data, false);
+}
+
+void Fft::Inverse(std::complex<float> *data) const
+{
+    transform(data, true);
+
+    auto scale = 1.0f / static_cast<float>(m_size);
+
+    for (std::size_t i = 0; i < m_size; i++)
+    {
+        data[i] *= scale;
+    }
+}
+
+void Fft::transform(std::complex<float> *data, bool inverse) const
+{
+    for (std::size_t i = 0; i < m_size; i++)
+    {
+        if (i < m_reversed[i])
+        {
+            std::swap(data[i], data[m_reversed[i]]);
+        }
+    }
+
+    for (std::size_t half = 1; half < m_size; half <<= 1)
+    {
+        auto stride = m_size / (half * 2);
+
+        for (std::size_t start = 0; start < m_size; start += half * 2)
+        {
+            for (std::size_t k = 0; k < half; k++)
+            {
+                auto twiddle = inverse
+                        ? std::conj(m_twiddles[k * stride])
+                        : m_twiddles[k * stride];
+
+                auto odd = data[start + k + half] * twiddle;
+
+                data[start + k + half] = data[start + k] - odd;
+                data[start + k] += odd;
+            }
+        }
+    }
+}
+
+}
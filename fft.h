@@ -0,0 +1,35 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <vector>
+#include <complex>
+#include <cstdint>
+#include <cstddef>
+
+namespace audio_processing
+{
+
+// In place radix-2 complex FFT of a fixed power of two size, twiddles and
+// bit reversal are tabulated at construction. Inverse is scaled by 1 / size.
+class Fft
+{
+    std::size_t                                         m_size;
+    std::vector<std::complex<float>>                    m_twiddles;     // size / 2, forward
+    std::vector<std::uint32_t>                          m_reversed;
+
+public:
+    // size is rounded up to a power of two
+    explicit Fft(std::size_t size);
+
+    void Forward(std::complex<float>* data) const;
+    void Inverse(std::complex<float>* data) const;
+
+    inline std::size_t GetSize() const { return m_size; }
+
+private:
+    void transform(std::complex<float>* data, bool inverse) const;
+};
+
+}
+
+#endif // FFT_H
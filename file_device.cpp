@@ -0,0 +1,289 @@
+#include "file_device.h"
+#include "wav_utils.h"
+#include "frame_pool.h"
+
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_devices
+{
+
+static bool is_wav_file_name(const std::string& file_name)
+{
+    static const std::string wav_ext = ".wav";
+
+    return file_name.size() >= wav_ext.size()
+            && file_name.compare(file_name.size() - wav_ext.size(), wav_ext.size(), wav_ext) == 0;
+}
+
+FileDevice::FileDevice()
+    : m_file(nullptr)
+    , m_wav(false)
+    , m_loop(false)
+    , m_data_offset(0)
+    , m_data_size(0)
+    , m_position(0)
+    , m_volume(100)
+{
+
+}
+
+FileDevice::~FileDevice()
+{
+    Close();
+}
+
+bool FileDevice::Open(const std::string &device_name, const audio_params_t &audio_params)
+{
+    bool result = false;
+
+    if ( IsOpen() )
+    {
+        Close();
+    }
+
+    if ( audio_params.is_init() )
+    {
+        m_file_name = device_name;
+        m_wav = is_wav_file_name(device_name);
+        m_data_offset = 0;
+        m_data_size = 0;
+        m_position = 0;
+        m_audio_params = audio_params;
+
+        result = audio_params.recorder
+                ? openRead(audio_params)
+                : openWrite(audio_params);
+
+        if (result == false)
+        {
+            Close();
+            LOG(warning) << "Can't Open file [" << device_name << "], errno = " << errno LOG_END;
+        }
+        else
+        {
+            LOG(info) "Open file [" << device_name << "]: success" LOG_END;
+        }
+    }
+    else
+    {
+        LOG(warning) << "Can't Open file [" << device_name << "]: audio params not set" LOG_END;
+    }
+
+    return result;
+}
+
+bool FileDevice::Close()
+{
+    bool result = false;
+
+    if (m_file != nullptr)
+    {
+        if (m_wav && !IsRecorder())
+        {
+            std::uint8_t header[wav_utils::wav_header_size];
+            wav_utils::make_header(m_audio_params.audio_format, static_cast<std::uint32_t>(m_data_size), header);
+
+            std::fseek(m_file, 0, SEEK_SET);
+            std::fwrite(header, 1, sizeof(header), m_file);
+        }
+
+        result = std::fclose(m_file) == 0;
+
+        m_file = nullptr;
+
+        LOG(info) << "File [" << m_file_name << "] closed" LOG_END;
+    }
+
+    return result;
+}
+
+bool FileDevice::IsOpen() const
+{
+    return m_file != nullptr;
+}
+
+bool FileDevice::IsRecorder() const
+{
+    return m_audio_params.recorder;
+}
+
+const audio_params_t &FileDevice::GetParams() const
+{
+    return m_audio_params;
+}
+
+bool FileDevice::SetParams(const audio_params_t &audio_params)
+{
+    // the file format is fixed once opened
+    bool result = audio_params.is_init() && !IsOpen();
+
+    if (result == true)
+    {
+        m_audio_params = audio_params;
+    }
+    else
+    {
+        LOG(info) << "Cant't set params for [" << m_file_name << "]" LOG_END;
+    }
+
+    return result;
+}
+
+std::int32_t FileDevice::Read(void *capture_data, std::size_t size)
+{
+    std::int32_t result = -EBADF;
+
+    if ( IsOpen() )
+    {
+        result = -EACCES;
+
+        if (IsRecorder())
+        {
+            auto data = static_cast<std::uint8_t*>(capture_data);
+            std::size_t total = 0;
+
+            while (total < size)
+            {
+                auto part = size - total;
+
+                if (m_data_size != 0)
+                {
+                    part = std::min(part, m_data_size - m_position);
+                }
+
+                auto count = std::fread(data + total, 1, part, m_file);
+
+                total += count;
+                m_position += count;
+
+                if (count < part || (m_data_size != 0 && m_position >= m_data_size))
+                {
+                    if (!m_loop || m_position == 0)
+                    {
+                        break;
+                    }
+
+                    std::fseek(m_file, static_cast<long>(m_data_offset), SEEK_SET);
+                    m_position = 0;
+                }
+            }
+
+            // keep whole frames only, a partial one is read again next
+            // time; the part of it before a loop rewind was the unaligned
+            // tail of the data and is dropped
+            auto remainder = std::min(total % m_audio_params.audio_format.frames_octets(), m_position);
+
+            if (remainder > 0 && std::fseek(m_file, -static_cast<long>(remainder), SEEK_CUR) == 0)
+            {
+                m_position -= remainder;
+            }
+
+            total -= total % m_audio_params.audio_format.frames_octets();
+
+            audio_utils::change_volume(capture_data, total, capture_data, m_audio_params.audio_format.format(), m_volume);
+
+            result = static_cast<std::int32_t>(total);
+        }
+    }
+
+    return result;
+}
+
+std::int32_t FileDevice::Write(const void *playback_data, std::size_t size)
+{
+    std::int32_t result = -EBADF;
+
+    if ( IsOpen() )
+    {
+        result = -EACCES;
+
+        if (!IsRecorder())
+        {
+            if (!audio_processing::reserve_frame(m_sample_buffer, size))
+            {
+                return -ENOMEM;
+            }
+
+            audio_utils::change_volume(playback_data, size, m_sample_buffer.Data(), m_audio_params.audio_format.format(), m_volume);
+
+            auto count = std::fwrite(m_sample_buffer.Data(), 1, size, m_file);
+
+            m_data_size += count;
+
+            result = count == size
+                    ? static_cast<std::int32_t>(count)
+                    : -EIO;
+        }
+    }
+
+    return result;
+}
+
+bool FileDevice::openRead(const audio_params_t &audio_params)
+{
+    m_file = std::fopen(m_file_name.c_str(), "rb");
+
+    if (m_file != nullptr && m_wav)
+    {
+        std::uint8_t header[4096];
+
+        auto count = std::fread(header, 1, sizeof(header), m_file);
+
+        audio_format_t file_format;
+
+        if (!wav_utils::parse_header(header, count, file_format, m_data_offset, m_data_size))
+        {
+            LOG(error) << "File [" << m_file_name << "] has unsupported wav header" LOG_END;
+            return false;
+        }
+
+        if (file_format.sample_rate != audio_params.audio_format.sample_rate
+                || file_format.format() != audio_params.audio_format.format()
+                || file_format.channels != audio_params.audio_format.channels)
+        {
+            LOG(error) << "File [" << m_file_name << "] format " << file_format.sample_rate
+                       << "/" << sample_format_name(file_format.format()) << "/" << file_format.channels
+                       << " mismatch device params" LOG_END;
+            return false;
+        }
+
+        std::fseek(m_file, 0, SEEK_END);
+        auto file_size = static_cast<std::size_t>(std::ftell(m_file));
+        if (m_data_size == 0 || m_data_offset + m_data_size > file_size)
+        {
+            m_data_size = file_size - m_data_offset;
+        }
+
+        std::fseek(m_file, static_cast<long>(m_data_offset), SEEK_SET);
+    }
+
+    return m_file != nullptr;
+}
+
+bool FileDevice::openWrite(const audio_params_t &audio_params)
+{
+    m_file = std::fopen(m_file_name.c_str(), "wb");
+
+    if (m_file != nullptr && m_wav)
+    {
+        std::uint8_t header[wav_utils::wav_header_size];
+        wav_utils::make_header(audio_params.audio_format, 0, header);
+
+        return std::fwrite(header, 1, sizeof(header), m_file) == sizeof(header);
+    }
+
+    return m_file != nullptr;
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef FILE_DEVICE_H
+#define FILE_DEVICE_H
+
+#include "audio_device.h"
+#include "audio_frame.h"
+
+#include <cstdio>
+
+namespace audio_devices
+{
+
+// WAV (*.wav) or headerless raw PCM file: recorder reads, player writes
+class FileDevice : public AudioDevice
+{
+    std::string                     m_file_name;
+    std::FILE*                      m_file;
+    bool                            m_wav;
+    bool                            m_loop;
+
+    std::size_t                     m_data_offset;
+    std::size_t                     m_data_size;
+    std::size_t                     m_position;
+
+    audio_params_t                  m_audio_params;
+    std::uint32_t                   m_volume;
+
+    // volume scaled playback data, shared frame pool block
+    audio_processing::FrameRef      m_sample_buffer;
+
+public:
+
+    FileDevice();
+    ~FileDevice() override;
+
+    bool Open(const std::string& device_name, const audio_params_t& audio_params = null_audio_params) override;
+    bool Close() override;
+
+    bool IsOpen() const override;
+    bool IsRecorder() const override;
+
+    const audio_params_t& GetParams() const override;
+    bool SetParams(const audio_params_t& audio_params) override;
+
+    std::int32_t Read(void* capture_data, std::size_t size) override;
+    std::int32_t Write(const void* playback_data, std::size_t size) override;
+
+    inline void SetVolume(std::uint32_t volume) override { m_volume = volume; }
+    inline std::uint32_t GetVolume() const override { return m_volume; }
+
+    // recorder restarts from the beginning of the data at the end of file
+    inline void SetLoop(bool loop) { m_loop = loop; }
+    inline bool IsLoop() const { return m_loop; }
+
+private:
+
+    bool openRead(const audio_params_t& audio_params);
+    bool openWrite(const audio_params_t& audio_params);
+};
+
+}
+
+#endif // FILE_DEVICE_H
@@ -0,0 +1,481 @@
+#include "frame_pool.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <map>
+#include <new>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_processing
+{
+
+namespace
+{
+
+const std::size_t huge_page_size = 2 * 1024 * 1024;
+const std::size_t thread_cache_slots = 8;
+
+static_assert(sizeof(audio_frame_t) <= frame_cache_line, "frame header exceeds a cache line");
+
+std::atomic<std::uint64_t> next_pool_id(1);
+
+// live pools, a thread cache returns its blocks only to these; never
+// destroyed, threads may exit after static destructors ran
+struct pool_registry_t
+{
+    std::mutex                                          mutex;
+    std::map<std::uint64_t, FramePool*>                 pools;
+};
+
+pool_registry_t& pool_registry()
+{
+    static auto registry = new pool_registry_t();
+    return *registry;
+}
+
+struct thread_cache_slot_t
+{
+    FramePool*                                          pool;
+    std::uint64_t                                       pool_id;
+    std::uint32_t                                       count;
+    audio_frame_t*                                      blocks[max_thread_cache];
+};
+
+struct thread_cache_t
+{
+    thread_cache_slot_t                                 slots[thread_cache_slots];
+
+    thread_cache_t() : slots() {}
+
+    ~thread_cache_t()
+    {
+        auto& registry = pool_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        for (auto& slot : slots)
+        {
+            if (slot.count > 0 && registry.pools.count(slot.pool_id) != 0)
+            {
+                slot.pool->FlushThreadCache();
+            }
+        }
+    }
+};
+
+thread_local thread_cache_t thread_cache;
+
+thread_cache_slot_t* find_slot(std::uint64_t pool_id)
+{
+    for (auto& slot : thread_cache.slots)
+    {
+        if (slot.pool_id == pool_id)
+        {
+            return &slot;
+        }
+    }
+
+    return nullptr;
+}
+
+// first use of the pool by this thread takes a slot, slots of destroyed
+// pools are reused; nullptr - the thread uses the shared list only
+thread_cache_slot_t* claim_slot(FramePool* pool, std::uint64_t pool_id)
+{
+    auto slot = find_slot(pool_id);
+
+    if (slot != nullptr)
+    {
+        return slot;
+    }
+
+    auto& registry = pool_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    for (auto& free_slot : thread_cache.slots)
+    {
+        if (free_slot.pool_id == 0 || registry.pools.count(free_slot.pool_id) == 0)
+        {
+            free_slot.pool = pool;
+            free_slot.pool_id = pool_id;
+            free_slot.count = 0;
+
+            return &free_slot;
+        }
+    }
+
+    return nullptr;
+}
+
+inline std::size_t align_up(std::size_t value, std::size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+void recycle_frame(audio_frame_t *frame)
+{
+    frame->pool->Recycle(frame);
+}
+
+FramePool::FramePool(std::size_t block_size, std::size_t block_count, const frame_pool_options_t &options)
+    : m_id(next_pool_id++)
+    , m_block_size(block_size)
+    , m_stride(frame_cache_line + align_up(std::max<std::size_t>(block_size, 1), frame_cache_line))
+    , m_grow_count(std::max<std::size_t>(block_count, 1))
+    , m_options(options)
+    , m_huge_pages(false)
+    , m_free_blocks(std::max(m_grow_count, options.max_block_count))
+    , m_block_count(0)
+    , m_outstanding(0)
+    , m_high_water(0)
+    , m_failures(0)
+{
+    m_options.thread_cache = std::min(m_options.thread_cache, max_thread_cache);
+
+    if (m_options.max_block_count < m_grow_count)
+    {
+        m_options.max_block_count = 0;
+    }
+
+    {
+        auto& registry = pool_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        registry.pools[m_id] = this;
+    }
+
+    grow(m_grow_count);
+}
+
+FramePool::~FramePool()
+{
+    {
+        auto& registry = pool_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        registry.pools.erase(m_id);
+    }
+
+    // blocks cached by other threads are forgotten with the memory
+    auto slot = find_slot(m_id);
+
+    if (slot != nullptr)
+    {
+        slot->count = 0;
+        slot->pool_id = 0;
+    }
+
+    for (const auto& chunk : m_chunks)
+    {
+        munmap(chunk.memory, chunk.size);
+    }
+}
+
+FrameRef FramePool::Acquire()
+{
+    audio_frame_t* frame = nullptr;
+    bool cached = false;
+
+    auto slot = m_options.thread_cache > 0
+            ? claim_slot(this, m_id)
+            : nullptr;
+
+    if (slot != nullptr)
+    {
+        if (slot->count == 0)
+        {
+            // refill half, the other half takes released blocks
+            std::uint32_t refill = std::max(1u, m_options.thread_cache / 2);
+
+            while (slot->count < refill
+                   && (slot->blocks[slot->count] = popShared()) != nullptr)
+            {
+                slot->count++;
+            }
+
+            addOutstanding(slot->count);
+        }
+
+        if (slot->count > 0)
+        {
+            frame = slot->blocks[--slot->count];
+            cached = true;
+        }
+    }
+
+    if (frame == nullptr
+            && (frame = popShared()) == nullptr
+            && m_options.max_block_count > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_grow_mutex);
+
+        // another thread may have grown it meanwhile
+        frame = popShared();
+
+        auto block_count = m_block_count.load();
+
+        if (frame == nullptr
+                && block_count < m_options.max_block_count
+                && grow(std::min(m_grow_count, m_options.max_block_count - block_count)))
+        {
+            frame = popShared();
+        }
+    }
+
+    if (frame == nullptr)
+    {
+        m_failures++;
+        return FrameRef();
+    }
+
+    if (!cached)
+    {
+        addOutstanding(1);
+    }
+
+    frame->refs.store(1, std::memory_order_relaxed);
+    frame->size = m_block_size;
+
+    return FrameRef(frame);
+}
+
+frame_pool_stats_t FramePool::GetStats() const
+{
+    frame_pool_stats_t stats;
+
+    stats.block_size = m_block_size;
+    stats.block_count = m_block_count;
+    stats.outstanding = m_outstanding;
+    stats.high_water = m_high_water;
+    stats.failures = m_failures;
+    stats.huge_pages = m_huge_pages;
+
+    return stats;
+}
+
+void FramePool::Recycle(audio_frame_t *frame)
+{
+    auto slot = m_options.thread_cache > 0
+            ? claim_slot(this, m_id)
+            : nullptr;
+
+    if (slot == nullptr)
+    {
+        pushShared(frame);
+        m_outstanding--;
+        return;
+    }
+
+    if (slot->count >= m_options.thread_cache)
+    {
+        // a consumer thread passes the surplus on to the producers
+        std::uint32_t keep = m_options.thread_cache / 2;
+        std::size_t released = slot->count - keep;
+
+        while (slot->count > keep)
+        {
+            pushShared(slot->blocks[--slot->count]);
+        }
+
+        m_outstanding -= released;
+    }
+
+    slot->blocks[slot->count++] = frame;
+}
+
+void FramePool::FlushThreadCache()
+{
+    auto slot = find_slot(m_id);
+
+    if (slot != nullptr && slot->count > 0)
+    {
+        std::size_t released = slot->count;
+
+        while (slot->count > 0)
+        {
+            pushShared(slot->blocks[--slot->count]);
+        }
+
+        m_outstanding -= released;
+    }
+}
+
+bool FramePool::grow(std::size_t block_count)
+{
+    auto size = align_up(m_stride * block_count, m_options.huge_pages ? huge_page_size : static_cast<std::size_t>(sysconf(_SC_PAGESIZE)));
+    auto memory = MAP_FAILED;
+
+    if (m_options.huge_pages)
+    {
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (memory != MAP_FAILED)
+        {
+            m_huge_pages = true;
+        }
+        else
+        {
+            LOG(warning) << "No reserved huge pages for the frame pool, errno = " << errno LOG_END;
+        }
+    }
+
+    if (memory == MAP_FAILED)
+    {
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (memory == MAP_FAILED)
+        {
+            LOG(error) << "Can't map " << size << " bytes for the frame pool, errno = " << errno LOG_END;
+            return false;
+        }
+
+        if (m_options.huge_pages)
+        {
+            madvise(memory, size, MADV_HUGEPAGE);
+        }
+    }
+
+    // no page fault on the audio thread
+    if (m_options.prefault)
+    {
+        std::memset(memory, 0, size);
+    }
+
+    m_chunks.push_back({ memory, size });
+
+    for (std::size_t i = 0; i < block_count; i++)
+    {
+        auto block = static_cast<std::uint8_t*>(memory) + i * m_stride;
+        auto frame = new (block) audio_frame_t();
+
+        frame->refs.store(0, std::memory_order_relaxed);
+        frame->pool = this;
+        frame->data = block + frame_cache_line;
+        frame->capacity = m_block_size;
+        frame->size = 0;
+
+        pushShared(frame);
+    }
+
+    m_block_count += block_count;
+
+    return true;
+}
+
+audio_frame_t *FramePool::popShared()
+{
+    audio_frame_t* frame = nullptr;
+
+    return m_free_blocks.Pop(frame) ? frame : nullptr;
+}
+
+void FramePool::pushShared(audio_frame_t *frame)
+{
+    // sized for max_block_count, never full
+    m_free_blocks.Push(frame);
+}
+
+void FramePool::addOutstanding(std::size_t count)
+{
+    auto outstanding = m_outstanding.fetch_add(count) + count;
+    auto high_water = m_high_water.load(std::memory_order_relaxed);
+
+    while (outstanding > high_water
+           && !m_high_water.compare_exchange_weak(high_water, outstanding, std::memory_order_relaxed))
+    {
+    }
+}
+
+namespace
+{
+
+struct shared_pools_t
+{
+    std::mutex                                          mutex;
+    frame_pool_options_t                                options;
+    std::size_t                                         block_count;
+    std::map<std::size_t, FramePool*>                   pools;
+
+    shared_pools_t()
+        : block_count(16)
+    {
+        options.max_block_count = 1024;
+        options.thread_cache = 4;
+    }
+};
+
+// never destroyed, handles may be released by static destructors
+shared_pools_t& shared_pools()
+{
+    static auto pools = new shared_pools_t();
+    return *pools;
+}
+
+}
+
+void set_shared_frame_pool_options(const frame_pool_options_t &options, std::size_t block_count)
+{
+    auto& pools = shared_pools();
+    std::lock_guard<std::mutex> lock(pools.mutex);
+
+    pools.options = options;
+    pools.block_count = block_count;
+}
+
+FramePool &shared_frame_pool(std::size_t block_size)
+{
+    auto& pools = shared_pools();
+    std::lock_guard<std::mutex> lock(pools.mutex);
+
+    block_size = align_up(std::max<std::size_t>(block_size, 1), frame_cache_line);
+
+    auto& pool = pools.pools[block_size];
+
+    if (pool == nullptr)
+    {
+        pool = new FramePool(block_size, pools.block_count, pools.options);
+    }
+
+    return *pool;
+}
+
+std::vector<frame_pool_stats_t> get_shared_frame_pool_stats()
+{
+    auto& pools = shared_pools();
+    std::lock_guard<std::mutex> lock(pools.mutex);
+
+    std::vector<frame_pool_stats_t> stats;
+
+    for (const auto& pool : pools.pools)
+    {
+        stats.push_back(pool.second->GetStats());
+    }
+
+    return stats;
+}
+
+bool reserve_frame(FrameRef &frame, std::size_t size)
+{
+    if (frame.Capacity() < size)
+    {
+        frame.Reset();
+        frame = shared_frame_pool(size).Acquire();
+    }
+
+    return static_cast<bool>(frame);
+}
+
+}
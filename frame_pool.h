@@ -0,0 +1,119 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include "audio_frame.h"
+#include "lockfree_queue.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+namespace audio_processing
+{
+
+const std::size_t frame_cache_line = 64;
+// blocks a thread keeps per pool at most
+const std::uint32_t max_thread_cache = 16;
+
+struct frame_pool_options_t
+{
+    std::size_t     max_block_count;    // grow by block_count up to it, 0 - fixed size
+    bool            huge_pages;         // explicit huge pages, transparent ones if none reserved
+    bool            prefault;           // pages mapped before the first block is used
+    std::uint32_t   thread_cache;       // blocks cached per thread, 0 - none
+
+    frame_pool_options_t()
+        : max_block_count(0)
+        , huge_pages(false)
+        , prefault(true)
+        , thread_cache(0)
+    {}
+};
+
+struct frame_pool_stats_t
+{
+    std::size_t     block_size;
+    std::size_t     block_count;        // allocated
+    std::size_t     outstanding;        // taken from the shared list, held or thread cached
+    std::size_t     high_water;         // of outstanding
+    std::uint64_t   failures;           // Acquire with nothing left
+    bool            huge_pages;         // explicit huge pages in use
+};
+
+// Lock-free pool of equal blocks for 10 ms frames. Every block starts on
+// its own cache line with the header, data on the next one, so blocks used
+// by different threads never share a line. Memory is mapped up front and
+// optionally prefaulted; Acquire and release take no lock and never
+// allocate, except the grow step of a growable pool running dry. With a
+// thread cache most calls stay within the thread. The pool must outlive
+// the handles of its blocks.
+class FramePool
+{
+    struct chunk_t
+    {
+        void*                                           memory;
+        std::size_t                                     size;
+    };
+
+    std::uint64_t                                       m_id;
+    std::size_t                                         m_block_size;
+    std::size_t                                         m_stride;
+    std::size_t                                         m_grow_count;
+    frame_pool_options_t                                m_options;
+
+    std::vector<chunk_t>                                m_chunks;
+    std::mutex                                          m_grow_mutex;
+    bool                                                m_huge_pages;
+
+    LockFreeQueue<audio_frame_t*>                       m_free_blocks;
+
+    char                                                m_pad0[frame_cache_line];
+    std::atomic<std::size_t>                            m_block_count;
+    std::atomic<std::size_t>                            m_outstanding;
+    std::atomic<std::size_t>                            m_high_water;
+    std::atomic<std::uint64_t>                          m_failures;
+    char                                                m_pad1[frame_cache_line];
+
+public:
+    FramePool(std::size_t block_size, std::size_t block_count, const frame_pool_options_t& options = frame_pool_options_t());
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // block of the full size with undefined content, empty when exhausted
+    FrameRef Acquire();
+
+    inline std::size_t GetBlockSize() const { return m_block_size; }
+    frame_pool_stats_t GetStats() const;
+
+    // called by the last handle of a block
+    void Recycle(audio_frame_t* frame);
+
+    // blocks cached by the calling thread go back to the shared list
+    void FlushThreadCache();
+
+private:
+    bool grow(std::size_t block_count);
+    audio_frame_t* popShared();
+    void pushShared(audio_frame_t* frame);
+    void addOutstanding(std::size_t count);
+};
+
+// Process wide pools for device and processing buffers, one per block size
+// rounded to the cache line. Pools are created on first use and live until
+// exit, the lookup locks: callers keep the reference. Options apply to
+// pools created after the call.
+void set_shared_frame_pool_options(const frame_pool_options_t& options, std::size_t block_count);
+FramePool& shared_frame_pool(std::size_t block_size);
+std::vector<frame_pool_stats_t> get_shared_frame_pool_stats();
+
+// frame holds a shared pool block of at least size bytes afterwards, a
+// big enough block is kept; false if none is left
+bool reserve_frame(FrameRef& frame, std::size_t size);
+
+}
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,337 @@
+#include "latency_meter.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace audio_processing
+{
+
+// fades of the chirp, ms
+const double latency_chirp_fade_ms = 5.0;
+
+// Fibonacci LFSR taps of maximum length, by order
+static const std::uint32_t mls_taps[][4] =
+{
+    { 8, 6, 5, 4 },
+    { 9, 5, 0, 0 },
+    { 10, 7, 0, 0 },
+    { 11, 9, 0, 0 },
+    { 12, 11, 10, 4 },
+    { 13, 12, 11, 8 },
+    { 14, 13, 12, 2 },
+    { 15, 14, 0, 0 },
+    { 16, 15, 13, 4 }
+};
+
+const std::uint32_t mls_min_order = 8;
+const std::uint32_t mls_max_order = 16;
+
+LatencyMeter::LatencyMeter(const audio_devices::audio_format_t &format, const latency_meter_config_t &config)
+    : m_format(format)
+    , m_config(config)
+    , m_period(static_cast<std::size_t>(format.sample_rate) * config.period_ms / 1000)
+    , m_convert((format.sample_rate / 100) * std::max(format.channels, 1u))
+    , m_played(0)
+    , m_captured(0)
+{
+    m_config.probe_ms = std::min(config.probe_ms, config.period_ms / 2);
+
+    auto probe_length = static_cast<std::size_t>(format.sample_rate) * m_config.probe_ms / 1000;
+
+    if (m_config.probe == latency_probe_t::mls)
+    {
+        createMls(probe_length);
+    }
+    else
+    {
+        createChirp(probe_length);
+    }
+
+    auto periods = m_config.warmup + m_config.repetitions;
+
+    m_capture.resize(periods * m_period);
+    m_delay_sums.resize(periods, 0.0);
+    m_delay_counts.resize(periods, 0);
+}
+
+void LatencyMeter::GetPlayback(void *playback_data, std::size_t size)
+{
+    auto channels = std::max(m_format.channels, 1u);
+    auto frame_octets = m_format.frames_octets();
+    auto frames = frame_octets > 0 ? size / frame_octets : 0;
+    auto chunk_frames = m_convert.size() / channels;
+    auto pcm = static_cast<std::uint8_t*>(playback_data);
+    auto end = static_cast<std::uint64_t>(m_config.warmup + m_config.repetitions) * m_period;
+
+    while (frames > 0)
+    {
+        auto count = std::min(frames, chunk_frames);
+
+        for (std::size_t f = 0; f < count; f++)
+        {
+            auto position = (m_played + f) % m_period;
+            auto sample = m_played + f < end && position < m_probe.size()
+                    ? m_probe[position]
+                    : 0.0f;
+
+            for (std::uint32_t c = 0; c < channels; c++)
+            {
+                m_convert[f * channels + c] = sample;
+            }
+        }
+
+        audio_devices::audio_utils::float_to_pcm(m_convert.data(), count * channels, pcm, m_format.format());
+
+        m_played += count;
+        pcm += count * frame_octets;
+        frames -= count;
+    }
+}
+
+void LatencyMeter::AddCapture(const void *capture_data, std::size_t size, std::int32_t playback_delay, std::int32_t capture_delay)
+{
+    auto channels = std::max(m_format.channels, 1u);
+    auto frame_octets = m_format.frames_octets();
+    auto frames = frame_octets > 0 ? size / frame_octets : 0;
+    auto chunk_frames = m_convert.size() / channels;
+    auto pcm = static_cast<const std::uint8_t*>(capture_data);
+
+    if (frames > 0 && playback_delay >= 0 && capture_delay >= 0 && m_captured < m_capture.size())
+    {
+        auto period = m_captured / m_period;
+
+        m_delay_sums[period] += playback_delay + capture_delay;
+        m_delay_counts[period]++;
+    }
+
+    while (frames > 0 && m_captured < m_capture.size())
+    {
+        auto count = std::min(std::min(frames, chunk_frames), m_capture.size() - m_captured);
+
+        audio_devices::audio_utils::pcm_to_float(pcm, count * channels, m_convert.data(), m_format.format());
+
+        for (std::size_t f = 0; f < count; f++)
+        {
+            m_capture[m_captured + f] = m_convert[f * channels];
+        }
+
+        m_captured += count;
+        pcm += count * frame_octets;
+        frames -= count;
+    }
+}
+
+bool LatencyMeter::IsDone() const
+{
+    return m_captured >= m_capture.size();
+}
+
+latency_report_t LatencyMeter::Analyze()
+{
+    latency_report_t report = {};
+    report.buffering_ms = -1.0;
+
+    m_measurements.clear();
+
+    auto probe_length = m_probe.size();
+
+    if (m_period <= probe_length || m_format.sample_rate == 0)
+    {
+        return report;
+    }
+
+    // linear correlation of a period against the probe for lags up to
+    // period - probe, no circular wrap
+    Fft fft(m_period + probe_length);
+
+    auto size = fft.GetSize();
+    auto max_lag = m_period - probe_length;
+    auto ms_per_frame = 1000.0 / m_format.sample_rate;
+
+    std::vector<std::complex<float>> probe_spectrum(size);
+    std::vector<std::complex<float>> spectrum(size);
+
+    std::copy(m_probe.begin(), m_probe.end(), probe_spectrum.begin());
+    fft.Forward(probe_spectrum.data());
+
+    double buffering_total = 0.0;
+    std::uint32_t buffering_count = 0;
+    double latency_total = 0.0;
+
+    for (std::uint32_t r = 0; r < m_config.repetitions; r++)
+    {
+        auto period = m_config.warmup + r;
+        auto start = period * m_period;
+
+        latency_measurement_t measurement = {};
+        measurement.buffering_ms = -1.0;
+
+        if (start + m_period > m_captured)
+        {
+            break;
+        }
+
+        std::fill(spectrum.begin(), spectrum.end(), std::complex<float>(0.0f, 0.0f));
+        std::copy(m_capture.begin() + start, m_capture.begin() + start + m_period, spectrum.begin());
+
+        fft.Forward(spectrum.data());
+
+        for (std::size_t k = 0; k < size; k++)
+        {
+            spectrum[k] *= std::conj(probe_spectrum[k]);
+        }
+
+        fft.Inverse(spectrum.data());
+
+        std::size_t peak_lag = 0;
+        float peak = 0.0f;
+        double energy = 0.0;
+
+        for (std::size_t lag = 0; lag <= max_lag; lag++)
+        {
+            auto value = std::abs(spectrum[lag].real());
+
+            energy += static_cast<double>(value) * value;
+
+            if (value > peak)
+            {
+                peak = value;
+                peak_lag = lag;
+            }
+        }
+
+        auto rms = std::sqrt(energy / (max_lag + 1));
+
+        measurement.peak_ratio = rms > 0.0 ? static_cast<float>(peak / rms) : 0.0f;
+        measurement.valid = measurement.peak_ratio >= m_config.min_peak_ratio;
+
+        // parabolic interpolation of the peak between samples
+        double offset = 0.0;
+
+        if (peak_lag > 0 && peak_lag < max_lag)
+        {
+            double before = std::abs(spectrum[peak_lag - 1].real());
+            double after = std::abs(spectrum[peak_lag + 1].real());
+            double curvature = before - 2.0 * peak + after;
+
+            offset = curvature != 0.0 ? 0.5 * (before - after) / curvature : 0.0;
+        }
+
+        measurement.latency_ms = (peak_lag + offset) * ms_per_frame;
+
+        if (m_delay_counts[period] > 0)
+        {
+            measurement.buffering_ms = m_delay_sums[period] / m_delay_counts[period] * ms_per_frame;
+        }
+
+        m_measurements.push_back(measurement);
+
+        report.measurements++;
+
+        if (!measurement.valid)
+        {
+            continue;
+        }
+
+        report.min_ms = report.valid == 0 ? measurement.latency_ms : std::min(report.min_ms, measurement.latency_ms);
+        report.max_ms = report.valid == 0 ? measurement.latency_ms : std::max(report.max_ms, measurement.latency_ms);
+        report.valid++;
+
+        latency_total += measurement.latency_ms;
+
+        if (measurement.buffering_ms >= 0.0)
+        {
+            buffering_total += measurement.buffering_ms;
+            buffering_count++;
+        }
+    }
+
+    if (report.valid > 0)
+    {
+        report.mean_ms = latency_total / report.valid;
+
+        double variance = 0.0;
+
+        for (const auto& measurement : m_measurements)
+        {
+            if (measurement.valid)
+            {
+                variance += (measurement.latency_ms - report.mean_ms) * (measurement.latency_ms - report.mean_ms);
+            }
+        }
+
+        report.jitter_ms = std::sqrt(variance / report.valid);
+    }
+
+    if (buffering_count > 0)
+    {
+        report.buffering_ms = buffering_total / buffering_count;
+        report.other_ms = report.mean_ms - report.buffering_ms;
+    }
+
+    return report;
+}
+
+void LatencyMeter::createChirp(std::size_t length)
+{
+    const double pi = 3.14159265358979323846;
+
+    double rate = m_format.sample_rate;
+    double start_hz = 200.0;
+    double end_hz = std::min(8000.0, 0.45 * rate);
+    double duration = length / rate;
+    auto fade = static_cast<std::size_t>(latency_chirp_fade_ms * rate / 1000.0);
+
+    m_probe.resize(length);
+
+    for (std::size_t n = 0; n < length; n++)
+    {
+        double t = n / rate;
+        double phase = 2.0 * pi * (start_hz * t + 0.5 * (end_hz - start_hz) / duration * t * t);
+        double gain = 1.0;
+
+        if (n < fade)
+        {
+            gain = 0.5 - 0.5 * std::cos(pi * n / fade);
+        }
+        else if (length - n <= fade)
+        {
+            gain = 0.5 - 0.5 * std::cos(pi * (length - n) / fade);
+        }
+
+        m_probe[n] = static_cast<float>(m_config.level * gain * std::sin(phase));
+    }
+}
+
+void LatencyMeter::createMls(std::size_t length)
+{
+    std::uint32_t order = mls_min_order;
+
+    while (order < mls_max_order && (1u << (order + 1)) - 1 <= length)
+    {
+        order++;
+    }
+
+    const auto& taps = mls_taps[order - mls_min_order];
+    std::uint32_t state = 1;
+
+    m_probe.resize((1u << order) - 1);
+
+    for (auto& chip : m_probe)
+    {
+        std::uint32_t feedback = 0;
+
+        for (auto tap : taps)
+        {
+            if (tap != 0)
+            {
+                feedback ^= (state >> (tap - 1)) & 1;
+            }
+        }
+
+        chip = (state & 1) != 0 ? m_config.level : -m_config.level;
+        state = ((state << 1) | feedback) & ((1u << order) - 1);
+    }
+}
+
+}
@@ -0,0 +1,110 @@
+#ifndef LATENCY_METER_H
+#define LATENCY_METER_H
+
+#include "audio_device.h"
+#include "fft.h"
+
+#include <vector>
+#include <complex>
+#include <cstdint>
+
+namespace audio_processing
+{
+
+enum class latency_probe_t
+{
+    chirp,  // linear sweep, robust to speaker distortion
+    mls     // maximum length sequence, flat spectrum
+};
+
+struct latency_meter_config_t
+{
+    latency_probe_t probe;
+    std::uint32_t   probe_ms;
+    std::uint32_t   period_ms;          // one probe per period, latencies up to period_ms - probe_ms
+    std::uint32_t   repetitions;
+    std::uint32_t   warmup;             // first periods not measured, devices settle
+    float           level;              // peak, full scale 1.0
+    float           min_peak_ratio;     // matched filter peak over its rms
+
+    latency_meter_config_t()
+        : probe(latency_probe_t::chirp)
+        , probe_ms(100)
+        , period_ms(1000)
+        , repetitions(20)
+        , warmup(1)
+        , level(0.5f)
+        , min_peak_ratio(10.0f)
+    {}
+};
+
+struct latency_measurement_t
+{
+    bool            valid;              // the probe was found
+    double          latency_ms;         // probe written to probe read
+    double          buffering_ms;       // player and recorder delay over the period, -1 unknown
+    float           peak_ratio;
+};
+
+struct latency_report_t
+{
+    std::uint32_t   measurements;
+    std::uint32_t   valid;
+    double          mean_ms;
+    double          min_ms;
+    double          max_ms;
+    double          jitter_ms;          // standard deviation
+    double          buffering_ms;       // mean, -1 unknown
+    double          other_ms;           // mean minus buffering: converters, FIFOs and the acoustic path
+};
+
+// Round trip latency of a player and recorder pair: a known probe is
+// played once per period and the captured stream is searched for it with a
+// matched filter. The caller runs the devices in lockstep, one playback
+// frame per capture frame, so the lag of the filter peak is the latency of
+// the whole player -> speaker -> mic -> recorder path. Device delays given
+// with the capture (snd_pcm_delay) tell the part held in ALSA buffers.
+// The capture is kept and analyzed after the run, the device loop does no
+// more than copies. The probe goes to every channel, channel 0 is analyzed.
+class LatencyMeter
+{
+    audio_devices::audio_format_t                       m_format;
+    latency_meter_config_t                              m_config;
+    std::vector<float>                                  m_probe;
+    std::size_t                                         m_period;           // frames
+    std::vector<float>                                  m_convert;
+
+    std::uint64_t                                       m_played;           // frames
+    std::vector<float>                                  m_capture;          // channel 0, preallocated
+    std::size_t                                         m_captured;
+    std::vector<double>                                 m_delay_sums;       // per period, frames
+    std::vector<std::uint32_t>                          m_delay_counts;
+
+    std::vector<latency_measurement_t>                  m_measurements;
+
+public:
+    LatencyMeter(const audio_devices::audio_format_t& format, const latency_meter_config_t& config = latency_meter_config_t());
+
+    // the next playback frame of the device format
+    void GetPlayback(void* playback_data, std::size_t size);
+
+    // the frame read in the same cycle; device delays in frames as
+    // returned by AlsaDevice::GetDelay, negative - unknown
+    void AddCapture(const void* capture_data, std::size_t size, std::int32_t playback_delay = -1, std::int32_t capture_delay = -1);
+
+    bool IsDone() const;
+
+    // matched filter over the capture, once IsDone
+    latency_report_t Analyze();
+
+    inline const std::vector<latency_measurement_t>& GetMeasurements() const { return m_measurements; }
+    inline double GetMaxLatencyMs() const { return m_config.period_ms - m_config.probe_ms; }
+
+private:
+    void createChirp(std::size_t length);
+    void createMls(std::size_t length);
+};
+
+}
+
+#endif // LATENCY_METER_H
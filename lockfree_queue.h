@@ -0,0 +1,141 @@
+#ifndef LOCKFREE_QUEUE_H
+#define LOCKFREE_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+namespace audio_processing
+{
+
+// Bounded multi-producer/multi-consumer queue (D. Vyukov), never blocks:
+// Push fails when full, Pop fails when empty.
+template<typename T>
+class LockFreeQueue
+{
+    struct cell_t
+    {
+        std::atomic<std::size_t>    sequence;
+        T                           data;
+    };
+
+    std::unique_ptr<cell_t[]>                   m_buffer;
+    std::size_t                                 m_mask;
+
+    // padding instead of alignas: the queue may be heap allocated in C++11
+    char                                        m_pad0[64];
+    std::atomic<std::size_t>                    m_enqueue_pos;
+    char                                        m_pad1[64];
+    std::atomic<std::size_t>                    m_dequeue_pos;
+    char                                        m_pad2[64];
+
+public:
+
+    // capacity is rounded up to a power of two
+    explicit LockFreeQueue(std::size_t capacity)
+        : m_mask(0)
+        , m_enqueue_pos(0)
+        , m_dequeue_pos(0)
+    {
+        std::size_t size = 2;
+
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+
+        m_buffer.reset(new cell_t[size]);
+        m_mask = size - 1;
+
+        for (std::size_t i = 0; i < size; i++)
+        {
+            m_buffer[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    bool Push(const T& value)
+    {
+        cell_t* cell = nullptr;
+        auto pos = m_enqueue_pos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            cell = &m_buffer[pos & m_mask];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+            if (diff == 0)
+            {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool Pop(T& value)
+    {
+        cell_t* cell = nullptr;
+        auto pos = m_dequeue_pos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            cell = &m_buffer[pos & m_mask];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+
+            if (diff == 0)
+            {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->data);
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    inline std::size_t Capacity() const { return m_mask + 1; }
+
+    // approximate, for statistics only
+    inline std::size_t Size() const
+    {
+        auto enqueue_pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        auto dequeue_pos = m_dequeue_pos.load(std::memory_order_relaxed);
+
+        return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+    }
+};
+
+}
+
+#endif // LOCKFREE_QUEUE_H
@@ -0,0 +1,306 @@
+#include "loopback_device.h"
+#include "frame_pool.h"
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_devices
+{
+
+// ring buffer is kept this long above the latency before overrun
+const std::uint32_t loopback_headroom_ms = 1000;
+
+struct loopback_channel_t
+{
+    std::mutex                      mutex;
+    audio_format_t                  audio_format;
+    std::size_t                     latency_size;
+
+    std::vector<std::uint8_t>       buffer;
+    std::size_t                     read_pos;
+    std::size_t                     fill;
+
+    std::uint64_t                   underruns;
+    std::uint64_t                   overruns;
+
+    loopback_channel_t(const audio_format_t& afmt, std::uint32_t latency_ms)
+        : audio_format(afmt)
+        , latency_size(afmt.octets_count(latency_ms))
+        , buffer(afmt.octets_count(latency_ms + loopback_headroom_ms), 0)
+        , read_pos(0)
+        , fill(0)
+        , underruns(0)
+        , overruns(0)
+    {
+        latency_size -= latency_size % afmt.frames_octets();
+        prime();
+    }
+
+    // fill latency with silence
+    void prime()
+    {
+        read_pos = 0;
+        fill = latency_size;
+        std::fill(buffer.begin(), buffer.begin() + fill, 0);
+    }
+
+    void push(const std::uint8_t* data, std::size_t size)
+    {
+        if (size > buffer.size())
+        {
+            data += size - buffer.size();
+            size = buffer.size();
+        }
+
+        if (fill + size > buffer.size())
+        {
+            auto drop = fill + size - buffer.size();
+            read_pos = (read_pos + drop) % buffer.size();
+            fill -= drop;
+            overruns++;
+        }
+
+        auto write_pos = (read_pos + fill) % buffer.size();
+        auto part = std::min(size, buffer.size() - write_pos);
+
+        std::memcpy(buffer.data() + write_pos, data, part);
+        std::memcpy(buffer.data(), data + part, size - part);
+
+        fill += size;
+    }
+
+    std::size_t pop(std::uint8_t* data, std::size_t size)
+    {
+        auto count = std::min(size, fill);
+        auto part = std::min(count, buffer.size() - read_pos);
+
+        std::memcpy(data, buffer.data() + read_pos, part);
+        std::memcpy(data + part, buffer.data(), count - part);
+
+        read_pos = (read_pos + count) % buffer.size();
+        fill -= count;
+
+        return count;
+    }
+};
+
+static std::shared_ptr<loopback_channel_t> get_channel(const std::string& channel_name, const audio_format_t& audio_format, std::uint32_t latency_ms)
+{
+    static std::mutex registry_mutex;
+    static std::map<std::string, std::weak_ptr<loopback_channel_t>> registry;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    auto channel = registry[channel_name].lock();
+
+    if (channel == nullptr)
+    {
+        channel = std::make_shared<loopback_channel_t>(audio_format, latency_ms);
+        registry[channel_name] = channel;
+    }
+    else if (channel->audio_format.sample_rate != audio_format.sample_rate
+             || channel->audio_format.format() != audio_format.format()
+             || channel->audio_format.channels != audio_format.channels)
+    {
+        channel.reset();
+    }
+
+    return channel;
+}
+
+LoopbackDevice::LoopbackDevice(std::uint32_t latency_ms)
+    : m_volume(100)
+    , m_latency_ms(latency_ms)
+{
+
+}
+
+LoopbackDevice::~LoopbackDevice()
+{
+    Close();
+}
+
+bool LoopbackDevice::Open(const std::string &device_name, const audio_params_t &audio_params)
+{
+    bool result = false;
+
+    if ( IsOpen() )
+    {
+        Close();
+    }
+
+    if ( audio_params.is_init() )
+    {
+        m_channel = get_channel(device_name, audio_params.audio_format, m_latency_ms);
+
+        result = m_channel != nullptr;
+
+        if (result == false)
+        {
+            LOG(warning) << "Can't Open loopback [" << device_name << "]: format mismatch with other end" LOG_END;
+        }
+        else
+        {
+            m_channel_name = device_name;
+            m_audio_params = audio_params;
+            LOG(info) "Open loopback [" << device_name << "]: success" LOG_END;
+        }
+    }
+    else
+    {
+        LOG(warning) << "Can't Open loopback [" << device_name << "]: audio params not set" LOG_END;
+    }
+
+    return result;
+}
+
+bool LoopbackDevice::Close()
+{
+    bool result = false;
+
+    if (m_channel != nullptr)
+    {
+        m_channel.reset();
+        result = true;
+
+        LOG(info) << "Loopback [" << m_channel_name << "] closed" LOG_END;
+    }
+
+    return result;
+}
+
+bool LoopbackDevice::IsOpen() const
+{
+    return m_channel != nullptr;
+}
+
+bool LoopbackDevice::IsRecorder() const
+{
+    return m_audio_params.recorder;
+}
+
+const audio_params_t &LoopbackDevice::GetParams() const
+{
+    return m_audio_params;
+}
+
+bool LoopbackDevice::SetParams(const audio_params_t &audio_params)
+{
+    // the channel format is fixed once opened
+    bool result = audio_params.is_init() && !IsOpen();
+
+    if (result == true)
+    {
+        m_audio_params = audio_params;
+    }
+
+    return result;
+}
+
+std::int32_t LoopbackDevice::Read(void *capture_data, std::size_t size)
+{
+    std::int32_t result = -EBADF;
+
+    if ( IsOpen() )
+    {
+        result = -EACCES;
+
+        if (IsRecorder())
+        {
+            auto data = static_cast<std::uint8_t*>(capture_data);
+
+            {
+                std::lock_guard<std::mutex> lock(m_channel->mutex);
+
+                auto count = m_channel->pop(data, size);
+
+                if (count < size)
+                {
+                    // player is late: play silence and restore the latency
+                    std::memset(data + count, 0, size - count);
+                    m_channel->underruns++;
+                    m_channel->prime();
+                }
+            }
+
+            audio_utils::change_volume(capture_data, size, capture_data, m_audio_params.audio_format.format(), m_volume);
+
+            result = static_cast<std::int32_t>(size);
+        }
+    }
+
+    return result;
+}
+
+std::int32_t LoopbackDevice::Write(const void *playback_data, std::size_t size)
+{
+    std::int32_t result = -EBADF;
+
+    if ( IsOpen() )
+    {
+        result = -EACCES;
+
+        if (!IsRecorder())
+        {
+            std::lock_guard<std::mutex> lock(m_channel->mutex);
+
+            if (m_volume == 100)
+            {
+                m_channel->push(static_cast<const std::uint8_t*>(playback_data), size);
+            }
+            else
+            {
+                auto sample_buffer = audio_processing::shared_frame_pool(size).Acquire();
+
+                if (!sample_buffer)
+                {
+                    return -ENOMEM;
+                }
+
+                audio_utils::change_volume(playback_data, size, sample_buffer.Data(), m_audio_params.audio_format.format(), m_volume);
+                m_channel->push(sample_buffer.Data(), size);
+            }
+
+            result = static_cast<std::int32_t>(size);
+        }
+    }
+
+    return result;
+}
+
+std::uint64_t LoopbackDevice::GetUnderrunCount() const
+{
+    if (m_channel != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(m_channel->mutex);
+        return m_channel->underruns;
+    }
+
+    return 0;
+}
+
+std::uint64_t LoopbackDevice::GetOverrunCount() const
+{
+    if (m_channel != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(m_channel->mutex);
+        return m_channel->overruns;
+    }
+
+    return 0;
+}
+
+}
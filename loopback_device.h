@@ -0,0 +1,52 @@
+#ifndef LOOPBACK_DEVICE_H
+#define LOOPBACK_DEVICE_H
+
+#include "audio_device.h"
+
+namespace audio_devices
+{
+
+struct loopback_channel_t;
+
+// in-memory channel: data written by the player with the same name
+// is read by the recorder after latency_ms of audio
+class LoopbackDevice : public AudioDevice
+{
+    std::string                             m_channel_name;
+    std::shared_ptr<loopback_channel_t>     m_channel;
+
+    audio_params_t                          m_audio_params;
+    std::uint32_t                           m_volume;
+    std::uint32_t                           m_latency_ms;
+
+public:
+
+    LoopbackDevice(std::uint32_t latency_ms = 20);
+    ~LoopbackDevice() override;
+
+    bool Open(const std::string& device_name, const audio_params_t& audio_params = null_audio_params) override;
+    bool Close() override;
+
+    bool IsOpen() const override;
+    bool IsRecorder() const override;
+
+    const audio_params_t& GetParams() const override;
+    bool SetParams(const audio_params_t& audio_params) override;
+
+    std::int32_t Read(void* capture_data, std::size_t size) override;
+    std::int32_t Write(const void* playback_data, std::size_t size) override;
+
+    inline void SetVolume(std::uint32_t volume) override { m_volume = volume; }
+    inline std::uint32_t GetVolume() const override { return m_volume; }
+
+    // takes effect for the channel created by the first opened end
+    inline void SetLatency(std::uint32_t latency_ms) { m_latency_ms = latency_ms; }
+    inline std::uint32_t GetLatency() const { return m_latency_ms; }
+
+    std::uint64_t GetUnderrunCount() const;
+    std::uint64_t GetOverrunCount() const;
+};
+
+}
+
+#endif // LOOPBACK_DEVICE_H
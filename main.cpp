@@ -1,12 +1,179 @@
 #include <iostream>
 #include <thread>
 #include <cstring>
+#include <vector>
+#include <map>
+#include <csignal>
+#include <atomic>
+#include <algorithm>
 
 #include "alsa_device.h"
+#include "duplex_device.h"
+#include "aggregate_device.h"
 #include "aec_controller.h"
+#include "aec_dump.h"
+#include "audio_mixer.h"
+#include "shm_ring.h"
+#include "stats_server.h"
+#include "perf_profiler.h"
+#include "deadline_monitor.h"
+#include "stage_graph.h"
+#include "frame_pool.h"
+#include "failover_device.h"
+#include "capture_fanout.h"
+#include "delay_estimator.h"
+#include "latency_meter.h"
+
+namespace
+{
+
+volatile std::sig_atomic_t stop_requested = 0;
+volatile std::sig_atomic_t report_requested = 0;
+
+void on_stop_signal(int)
+{
+    stop_requested = 1;
+}
 
-int main()
+void on_report_signal(int)
 {
+    report_requested = 1;
+}
+
+// the first channel of interleaved frames, returns its size
+std::size_t copy_first_channel(const audio_devices::audio_format_t& format, const void* data, std::size_t size, void* channel_data)
+{
+    auto frame_octets = format.frames_octets();
+    auto sample_octets = frame_octets / std::max(format.channels, 1u);
+    auto frames = frame_octets > 0 ? size / frame_octets : 0;
+    auto source = static_cast<const char*>(data);
+    auto target = static_cast<char*>(channel_data);
+
+    for (std::size_t f = 0; f < frames; f++)
+    {
+        std::memcpy(target + f * sample_octets, source + f * frame_octets, sample_octets);
+    }
+
+    return frames * sample_octets;
+}
+
+// plays probes through the player and finds them in the recorder, one
+// playback frame per capture frame; the first recorder channel is measured
+int measure_latency(audio_devices::AudioDevice& player, audio_devices::AudioDevice& recorder, const audio_devices::audio_format_t& audio_format, const audio_devices::audio_format_t& capture_format, const audio_processing::latency_meter_config_t& config)
+{
+    audio_processing::LatencyMeter meter(audio_format, config);
+
+    // the ALSA share is known for ALSA devices only
+    auto alsa_player = dynamic_cast<audio_devices::AlsaDevice*>(&player);
+    auto alsa_recorder = dynamic_cast<audio_devices::AlsaDevice*>(&recorder);
+
+    std::vector<char> recorder_frame(capture_format.octets_count(10));
+    std::vector<char> capture_frame(audio_format.octets_count(10));
+    std::vector<char> playback_frame(capture_frame.size());
+
+    std::cout << "Measuring round trip latency: " << config.repetitions << " probes, up to " << meter.GetMaxLatencyMs() << " ms" << std::endl;
+
+    auto begin = std::chrono::high_resolution_clock::now();
+
+    while (!meter.IsDone() && stop_requested == 0)
+    {
+        auto ret = recorder.Read(recorder_frame.data(), recorder_frame.size());
+
+        // a missing frame is counted as silence, the streams stay in step
+        if (ret != static_cast<std::int32_t>(recorder_frame.size()))
+        {
+            std::memset(capture_frame.data(), audio_format.format() == audio_devices::sample_format_t::u8 ? 0x80 : 0, capture_frame.size());
+        }
+        else
+        {
+            copy_first_channel(capture_format, recorder_frame.data(), recorder_frame.size(), capture_frame.data());
+        }
+
+        meter.AddCapture(capture_frame.data(), capture_frame.size()
+                         , alsa_player != nullptr ? alsa_player->GetDelay() : -1
+                         , alsa_recorder != nullptr ? alsa_recorder->GetDelay() : -1);
+
+        meter.GetPlayback(playback_frame.data(), playback_frame.size());
+        player.Write(playback_frame.data(), playback_frame.size());
+
+        // devices that don't block are paced by the clock
+        begin += std::chrono::milliseconds(10);
+
+        auto now = std::chrono::high_resolution_clock::now();
+
+        if (begin > now)
+        {
+            std::this_thread::sleep_for(begin - now);
+        }
+        else if (now - begin > std::chrono::milliseconds(10))
+        {
+            begin = now;
+        }
+    }
+
+    auto report = meter.Analyze();
+    std::uint32_t index = 0;
+
+    for (const auto& measurement : meter.GetMeasurements())
+    {
+        std::cout << "Probe " << index++ << ": ";
+
+        if (measurement.valid)
+        {
+            std::cout << measurement.latency_ms << " ms";
+        }
+        else
+        {
+            std::cout << "not found";
+        }
+
+        if (measurement.buffering_ms >= 0.0)
+        {
+            std::cout << ", buffering " << measurement.buffering_ms << " ms";
+        }
+
+        std::cout << ", peak ratio " << measurement.peak_ratio << std::endl;
+    }
+
+    if (report.valid == 0)
+    {
+        std::cout << "No probe found in the capture, check the levels and the latency range" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Round trip latency: mean " << report.mean_ms << " ms, min " << report.min_ms << " ms, max " << report.max_ms
+              << " ms, jitter " << report.jitter_ms << " ms (" << report.valid << " of " << report.measurements << " probes)" << std::endl;
+
+    if (report.buffering_ms >= 0.0)
+    {
+        std::cout << "ALSA buffering: " << report.buffering_ms << " ms, converters and acoustic path: " << report.other_ms << " ms" << std::endl;
+    }
+
+    return 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    // aec_test [--option[=value]...] [playback_device [recorder_device]]
+    std::vector<std::string> args;
+    std::map<std::string, std::string> options;
+
+    for (int a = 1; a < argc; a++)
+    {
+        std::string arg(argv[a]);
+
+        if (arg.compare(0, 2, "--") == 0)
+        {
+            auto pos = arg.find('=');
+            options[arg.substr(2, pos == std::string::npos ? pos : pos - 2)] = pos == std::string::npos ? "" : arg.substr(pos + 1);
+        }
+        else
+        {
+            args.push_back(arg);
+        }
+    }
 
     int i = 0;
 
@@ -33,23 +200,358 @@ int main()
 
 
 
+    // --huge-pages: frame pools on huge pages, before any pool is created
+    if (options.count("huge-pages") != 0)
+    {
+        audio_processing::frame_pool_options_t pool_options;
+
+        pool_options.max_block_count = 1024;
+        pool_options.huge_pages = true;
+        pool_options.thread_cache = 4;
+
+        audio_processing::set_shared_frame_pool_options(pool_options, 16);
+    }
+
     const std::uint32_t sample_rate = 48000;
     const std::uint32_t frame_size = sample_rate / 100;
     const std::uint32_t buffers_count = 2;
 
+    // --format=u8|s16|s24_3|s24|s32|float: device sample format
+    const std::map<std::string, audio_devices::sample_format_t> sample_formats =
+    {
+        { "u8", audio_devices::sample_format_t::u8 },
+        { "s16", audio_devices::sample_format_t::s16_le },
+        { "s24_3", audio_devices::sample_format_t::s24_3le },
+        { "s24", audio_devices::sample_format_t::s24_le },
+        { "s32", audio_devices::sample_format_t::s32_le },
+        { "float", audio_devices::sample_format_t::float_le }
+    };
+
+    auto sample_format = audio_devices::sample_format_t::s16_le;
+
+    if (options.count("format") != 0)
+    {
+        auto it = sample_formats.find(options["format"]);
+
+        if (it != sample_formats.end())
+        {
+            sample_format = it->second;
+        }
+        else
+        {
+            std::cout << "Unknown sample format " << options["format"] << ", s16 used" << std::endl;
+        }
+    }
+
+    const audio_devices::audio_format_t audio_format(sample_rate, sample_format, 1);
+    const std::size_t frame_octets = frame_size * audio_format.frames_octets();
+
+
+    // device: [alsa:|file:|null:|loopback:|aggregate:]name
+    std::string player_name = device_playback_list.size() > 1 ? device_playback_list[1].name : "null";
+    std::string recorder_name = device_recorder_list.size() > 1 ? device_recorder_list[1].name : "null";
+
+    // the spec is copied, the name is written by Create
+    const std::string player_spec = args.size() > 0 ? args[0] : player_name;
+    const std::string recorder_spec = args.size() > 1 ? args[1] : recorder_name;
+
+    auto player_ptr = audio_devices::AudioDevice::Create(player_spec, player_name);
+    auto recorder_ptr = audio_devices::AudioDevice::Create(recorder_spec, recorder_name);
+
+    audio_devices::AudioDevice* player = player_ptr.get();
+    audio_devices::AudioDevice* recorder = recorder_ptr.get();
+
+    // an aggregate recorder gives a channel per input, all of them are
+    // processed against the mono reference; the player, the reference and
+    // the delay search take the first one
+    std::uint32_t capture_channels = 1;
+
+    if (dynamic_cast<audio_devices::AggregateDevice*>(recorder) != nullptr)
+    {
+        capture_channels += static_cast<std::uint32_t>(std::count(recorder_name.begin(), recorder_name.end(), '+'));
+    }
+
+    if (capture_channels > audio_processing::aec_max_channels)
+    {
+        std::cout << "Too many recorder inputs, " << audio_processing::aec_max_channels << " at most" << std::endl;
+        return 1;
+    }
+
+    const audio_devices::audio_format_t capture_format(sample_rate, sample_format, capture_channels);
+    const std::size_t capture_octets = frame_size * capture_format.frames_octets();
+
+    audio_devices::audio_params_t player_params(false, audio_format, frame_size * 6, true);
+    audio_devices::audio_params_t recorder_params(true, capture_format, frame_size * 4, false);
+
+    // --low-latency: 2 x 5 ms periods
+    if (options.count("low-latency") != 0)
+    {
+        player_params = audio_devices::audio_params_t(false, audio_format, frame_size / 2, true, 2, audio_devices::latency_profile_t::low_latency);
+        recorder_params = audio_devices::audio_params_t(true, capture_format, frame_size / 2, false, 2, audio_devices::latency_profile_t::low_latency);
+    }
+
+    // --failover: a failed player or recorder is reopened in the background,
+    // --standby-player=device, --standby-recorder=device: or replaced by these
+    std::vector<std::pair<std::string, audio_devices::FailoverDevice*>> failover_devices;
 
-	audio_devices::AlsaDevice recorder, player;
+    if (options.count("duplex") == 0
+            && (options.count("failover") != 0
+                || options.count("standby-player") != 0
+                || options.count("standby-recorder") != 0))
+    {
+        auto wrap_device = [&options, &failover_devices](std::unique_ptr<audio_devices::AudioDevice>& device, const std::string& role)
+        {
+            std::unique_ptr<audio_devices::FailoverDevice> failover_device(new audio_devices::FailoverDevice(std::move(device)));
 
-    audio_devices::audio_params_t player_params(false, { sample_rate, 16, 1 }, frame_size * 6, true);
-    audio_devices::audio_params_t recorder_params(true, { sample_rate, 16, 1 }, frame_size * 4, false);
+            if (options.count("standby-" + role) != 0)
+            {
+                failover_device->AddStandby(options["standby-" + role]);
+            }
 
-    audio_processing::AecController aec_controller(sample_rate, 16, 1);
+            failover_device->SetEventHandler([role](const audio_devices::failover_event_t& event)
+            {
+                std::cout << "The " << role << " " << event.device_name
+                          << (event.recovered ? " recovered in " + std::to_string(event.outage_ms) + " ms" : " failed, error = " + std::to_string(event.error))
+                          << std::endl;
+            });
+
+            failover_devices.emplace_back(role, failover_device.get());
+            device = std::move(failover_device);
+        };
+
+        wrap_device(player_ptr, "player");
+        wrap_device(recorder_ptr, "recorder");
+
+        player = player_ptr.get();
+        recorder = recorder_ptr.get();
+    }
 
-    player.Open(device_playback_list[1].name, player_params);
-    player.SetVolume(100);
-    recorder.Open(device_recorder_list[1].name, recorder_params);
-    recorder.SetVolume(100);
+    audio_processing::AecController aec_controller(sample_rate, sample_format, capture_channels, nullptr, 1);
 
+    // --duplex: linked ALSA player and recorder with synchronized start
+    audio_devices::AlsaDuplexDevice duplex_device;
+
+    if (options.count("duplex") != 0)
+    {
+        player = &duplex_device.Player();
+        recorder = &duplex_device.Recorder();
+
+        duplex_device.Open(player_name, player_params, recorder_name, recorder_params);
+    }
+    else
+    {
+        player->Open(player_name, player_params);
+        recorder->Open(recorder_name, recorder_params);
+    }
+
+    player->SetVolume(100);
+    recorder->SetVolume(100);
+
+    // --latency[=chirp|mls]: measure the round trip of the devices instead
+    // of processing, --latency-count=N probes; works on ALSA loopback PCMs
+    if (options.count("latency") != 0)
+    {
+        audio_processing::latency_meter_config_t latency_config;
+
+        if (options["latency"] == "mls")
+        {
+            latency_config.probe = audio_processing::latency_probe_t::mls;
+        }
+
+        if (options.count("latency-count") != 0)
+        {
+            latency_config.repetitions = static_cast<std::uint32_t>(std::max(1ul, std::strtoul(options["latency-count"].c_str(), nullptr, 10)));
+        }
+
+        std::signal(SIGINT, on_stop_signal);
+        std::signal(SIGTERM, on_stop_signal);
+
+        if (duplex_device.IsOpen())
+        {
+            duplex_device.Start();
+        }
+
+        return measure_latency(*player, *recorder, audio_format, capture_format, latency_config);
+    }
+
+    // --shm=name: publish processed capture frames for other processes
+    audio_ipc::ShmRingWriter shm_writer;
+
+    if (options.count("shm") != 0)
+    {
+        shm_writer.Create(options["shm"], { sample_rate, audio_format.bit_per_sample, capture_channels, static_cast<std::uint32_t>(capture_octets) });
+    }
+
+    // --fanout=name@rate[:format][,...]: processed capture published to
+    // more shm rings at their own rate and format
+    audio_processing::CaptureFanout fanout(capture_format);
+    std::vector<std::unique_ptr<audio_ipc::ShmRingWriter>> fanout_writers;
+
+    if (options.count("fanout") != 0)
+    {
+        std::string fanout_list = options["fanout"];
+        std::size_t pos = 0;
+
+        while (pos < fanout_list.size())
+        {
+            auto end = fanout_list.find(',', pos);
+            auto spec = fanout_list.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+            pos = end == std::string::npos ? fanout_list.size() : end + 1;
+
+            auto rate_pos = spec.find('@');
+            auto format_pos = spec.find(':', rate_pos);
+            auto consumer_format = sample_format;
+
+            if (format_pos != std::string::npos)
+            {
+                auto it = sample_formats.find(spec.substr(format_pos + 1));
+                consumer_format = it != sample_formats.end() ? it->second : sample_format;
+            }
+
+            auto consumer_rate = rate_pos != std::string::npos
+                    ? static_cast<std::uint32_t>(std::strtoul(spec.c_str() + rate_pos + 1, nullptr, 10))
+                    : sample_rate;
+
+            const audio_devices::audio_format_t consumer_audio_format(consumer_rate, consumer_format, capture_channels);
+            std::unique_ptr<audio_ipc::ShmRingWriter> writer(new audio_ipc::ShmRingWriter());
+
+            if (fanout.AddConsumer(consumer_audio_format) >= 0
+                    && writer->Create(spec.substr(0, rate_pos), { consumer_rate, consumer_audio_format.bit_per_sample, capture_channels, static_cast<std::uint32_t>(consumer_audio_format.octets_count(10)) }))
+            {
+                fanout_writers.push_back(std::move(writer));
+            }
+            else
+            {
+                std::cout << "Can't add fan-out consumer " << spec << std::endl;
+            }
+        }
+    }
+
+    // --shed: degrade processing when frames miss the 10 ms budget,
+    // outlives the stats server that reads it
+    std::unique_ptr<audio_processing::DeadlineMonitor> deadline_monitor;
+
+    // --delay-search: stream delay found from the far and near signals
+    std::unique_ptr<audio_processing::DelayEstimator> delay_estimator;
+
+    // --stats=port|unix:path: prometheus metrics endpoint
+    audio_processing::StatsServer stats_server;
+
+    if (options.count("stats") != 0)
+    {
+        aec_controller.SetMetrics(true, 1000);
+
+        stats_server.AddSource([&aec_controller](std::ostream& stream)
+        {
+            audio_processing::write_prometheus_metrics(stream, aec_controller.GetMetrics(), "session=\"0\"");
+        });
+
+        stats_server.AddSource([&aec_controller](std::ostream& stream)
+        {
+            audio_processing::write_prometheus_memory(stream, aec_controller.GetMemoryStats(), "session=\"0\"");
+        });
+
+        stats_server.AddSource([](std::ostream& stream)
+        {
+            audio_processing::write_prometheus_frame_pools(stream, audio_processing::get_shared_frame_pool_stats());
+        });
+
+        for (const auto& failover_device : failover_devices)
+        {
+            auto labels = "session=\"0\",device=\"" + failover_device.first + "\"";
+            auto device = failover_device.second;
+
+            stats_server.AddSource([labels, device](std::ostream& stream)
+            {
+                audio_processing::write_prometheus_failover(stream, device->GetStats(), labels);
+            });
+        }
+
+        stats_server.Start(options["stats"]);
+    }
+
+    // --mix=device[,device...]: far-end streams mixed to the player instead
+    // of the recorder loop, [@gain] after a device sets its linear gain
+    audio_processing::AudioMixer mixer(audio_format);
+    std::vector<std::unique_ptr<audio_devices::AudioDevice>> mix_sources;
+    std::vector<std::vector<char>> mix_buffers;
+
+    if (options.count("mix") != 0)
+    {
+        std::string mix_list = options["mix"];
+        std::size_t pos = 0;
+
+        while (pos < mix_list.size())
+        {
+            auto end = mix_list.find(',', pos);
+            auto spec = mix_list.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+            pos = end == std::string::npos ? mix_list.size() : end + 1;
+
+            float gain = 1.0f;
+            auto gain_pos = spec.rfind('@');
+
+            if (gain_pos != std::string::npos)
+            {
+                gain = std::strtof(spec.c_str() + gain_pos + 1, nullptr);
+                spec.resize(gain_pos);
+            }
+
+            std::string source_name;
+            auto source = audio_devices::AudioDevice::Create(spec, source_name);
+
+            if (source != nullptr
+                    && source->Open(source_name, audio_devices::audio_params_t(true, audio_format, frame_size * 4, true)))
+            {
+                mixer.AddStream(gain);
+                mix_sources.push_back(std::move(source));
+                mix_buffers.emplace_back(mixer.GetFrameSize());
+            }
+            else
+            {
+                std::cout << "Can't open mix source " << spec << std::endl;
+            }
+        }
+    }
+
+    // --dump=file: record the session for aec_replay
+    audio_processing::AecDumpRecorder dump_recorder;
+
+    if (options.count("dump") != 0
+            && dump_recorder.Start(options["dump"], sample_rate, sample_format, capture_channels, 1))
+    {
+        aec_controller.SetDumpRecorder(&dump_recorder);
+    }
+
+
+    // --profile: per stage perf counters, report on SIGUSR1 and on exit
+    audio_processing::PerfProfiler profiler;
+    audio_processing::PerfProfiler* stage_profiler = nullptr;
+
+    if (options.count("profile") != 0)
+    {
+        profiler.Open();
+        stage_profiler = &profiler;
+        aec_controller.SetProfiler(stage_profiler);
+
+        std::signal(SIGUSR1, on_report_signal);
+    }
+
+    std::signal(SIGINT, on_stop_signal);
+    std::signal(SIGTERM, on_stop_signal);
+
+    if (duplex_device.IsOpen())
+    {
+        duplex_device.Start();
+
+        // published once the start skew is settled
+        if (stats_server.IsRunning())
+        {
+            stats_server.AddSource([&duplex_device](std::ostream& stream)
+            {
+                audio_processing::write_prometheus_duplex(stream, duplex_device.GetStats(), "session=\"0\"");
+            });
+        }
+    }
 
     auto begin = std::chrono::high_resolution_clock::now();
 
@@ -57,19 +559,257 @@ int main()
     {
         int i = 0;
 
-        char buffers [buffers_count][frame_size * 2];
+        // sized for the widest sample, pool blocks are cache line aligned
+        auto& buffer_pool = audio_processing::shared_frame_pool(capture_octets);
+        audio_processing::FrameRef buffers[buffers_count];
 
-        char empty_buffer[frame_size * 2];
+        for (auto& buffer : buffers)
+        {
+            buffer = buffer_pool.Acquire();
 
-        std::memset(empty_buffer, 0, sizeof(empty_buffer));
+            if (!buffer)
+            {
+                std::cout << "Can't allocate frame buffers" << std::endl;
+                return 1;
+            }
 
-        std::memset(buffers, 0, sizeof(buffers));
+            std::memset(buffer.Data(), 0, buffer.Capacity());
+        }
+
+        // first channel of a multichannel capture, raw and processed
+        std::vector<char> near_buffer(capture_channels > 1 ? frame_octets : 0);
+        std::vector<char> playback_buffer(near_buffer.size());
 
         aec_controller.SetHighPassFilter(true);
         aec_controller.SetGainControl(true, 0);
         aec_controller.SetEchoCancellation(true, 0);
 
-        while (true)
+        // --delay-range=ms: stream delay uncertainty the echo canceller covers
+        if (options.count("delay-range") != 0)
+        {
+            aec_controller.SetDelayRange(static_cast<std::uint32_t>(std::strtoul(options["delay-range"].c_str(), nullptr, 10)));
+        }
+
+        if (options.count("shed") != 0)
+        {
+            deadline_monitor.reset(new audio_processing::DeadlineMonitor(aec_controller));
+
+            deadline_monitor->SetEventHandler([&deadline_monitor](const audio_processing::degrade_event_t& event)
+            {
+                auto step = std::max(event.from_level, event.to_level) - 1;
+
+                std::cout << "Frame " << event.frame_index << ": processing level " << event.from_level << " -> " << event.to_level
+                          << " (" << (event.to_level > event.from_level ? "+" : "-")
+                          << audio_processing::degrade_step_name(deadline_monitor->GetSteps()[step])
+                          << "), load = " << event.average_load << ", misses = " << event.window_misses << std::endl;
+            });
+
+            if (stats_server.IsRunning())
+            {
+                auto monitor = deadline_monitor.get();
+
+                stats_server.AddSource([monitor](std::ostream& stream)
+                {
+                    audio_processing::write_prometheus_deadline(stream, monitor->GetStats(), "session=\"0\"");
+                });
+            }
+        }
+
+        if (options.count("delay-search") != 0)
+        {
+            delay_estimator.reset(new audio_processing::DelayEstimator(aec_controller, sample_rate, sample_format));
+
+            if (stats_server.IsRunning())
+            {
+                auto estimator = delay_estimator.get();
+
+                stats_server.AddSource([estimator](std::ostream& stream)
+                {
+                    audio_processing::write_prometheus_delay_search(stream, estimator->GetStats(), "session=\"0\"");
+                });
+            }
+        }
+
+        auto wait_next_frame = [&begin]()
+        {
+            begin += std::chrono::milliseconds(10);
+
+            auto now = std::chrono::high_resolution_clock::now();
+
+            if (begin > now)
+            {
+                std::this_thread::sleep_for(begin - now);
+            }
+            else if (now - begin > std::chrono::milliseconds(10))
+            {
+                // more than a frame behind: the capture read paces the loop,
+                // catching up on the old schedule only bursts the devices
+                begin = now;
+            }
+        };
+
+        // fan-out consumers are drained to their rings off the audio thread
+        std::atomic<bool> fanout_running(!fanout_writers.empty());
+        std::thread fanout_thread;
+
+        if (fanout_running)
+        {
+            fanout_thread = std::thread([&fanout, &fanout_writers, &fanout_running]()
+            {
+                while (fanout_running)
+                {
+                    audio_processing::FrameRef frame;
+
+                    for (std::uint32_t c = 0; c < fanout_writers.size(); c++)
+                    {
+                        while (fanout.Pop(c, frame))
+                        {
+                            fanout_writers[c]->Publish(frame.Data(), frame.Size());
+                        }
+                    }
+
+                    frame.Reset();
+
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                }
+            });
+        }
+
+        // --graph[=threaded]: the loop below built from stages, threaded
+        // moves the player write to its own thread
+        audio_processing::StageGraph graph;
+        audio_processing::Stage* aec_stage = nullptr;
+        bool use_graph = false;
+
+        // the stages pass one format from the recorder to the player
+        if (options.count("graph") != 0 && capture_channels > 1)
+        {
+            std::cout << "The stage graph takes a mono recorder, running the plain loop" << std::endl;
+        }
+        else if (options.count("graph") != 0)
+        {
+            auto threaded = options["graph"] == "threaded";
+
+            auto source = graph.AddStage(std::unique_ptr<audio_processing::Stage>(new audio_processing::DeviceSourceStage("recorder", *recorder)));
+            aec_stage = graph.AddStage(std::unique_ptr<audio_processing::Stage>(new audio_processing::AecStage("aec", aec_controller, audio_format)));
+            auto sink = graph.AddStage(std::unique_ptr<audio_processing::Stage>(new audio_processing::DeviceSinkStage("player", *player)), threaded ? 1 : 0);
+
+            auto connected = graph.Connect(source, 0, aec_stage, audio_processing::AecStage::near_input);
+            auto far_stage = source;
+
+            if (!mix_sources.empty())
+            {
+                // the mixed frame is shared by the reference and the player
+                auto mix_stage = graph.AddStage(std::unique_ptr<audio_processing::Stage>(new audio_processing::FunctionStage("mixer", {}, { audio_format }
+                        , [&](audio_processing::Stage& stage, audio_processing::FrameRef*, audio_processing::FrameRef* outputs)
+                {
+                    for (std::uint32_t s = 0; s < mix_sources.size(); s++)
+                    {
+                        if (mix_sources[s]->Read(mix_buffers[s].data(), mix_buffers[s].size()) == static_cast<std::int32_t>(mix_buffers[s].size()))
+                        {
+                            mixer.SetFrame(s, mix_buffers[s].data());
+                        }
+                    }
+
+                    outputs[0] = stage.AcquireFrame(0);
+
+                    if (outputs[0])
+                    {
+                        std::memcpy(outputs[0].Data(), mixer.Mix(), outputs[0].Size());
+                    }
+
+                    return static_cast<bool>(outputs[0]);
+                })));
+
+                far_stage = mix_stage;
+
+                connected = connected
+                        && graph.Connect(mix_stage, 0, aec_stage, audio_processing::AecStage::far_input)
+                        && graph.Connect(mix_stage, 0, sink, 0, threaded ? 4 : 0);
+            }
+            else
+            {
+                // the recorded frame is the reference, the processed one is played
+                connected = connected
+                        && graph.Connect(source, 0, aec_stage, audio_processing::AecStage::far_input)
+                        && graph.Connect(aec_stage, 0, sink, 0, threaded ? 4 : 0);
+            }
+
+            if (delay_estimator != nullptr)
+            {
+                // near end before processing, far end from the reference producer
+                auto delay_stage = graph.AddStage(std::unique_ptr<audio_processing::Stage>(new audio_processing::FunctionStage("delay", { audio_format, audio_format }, {}
+                        , [&delay_estimator](audio_processing::Stage&, audio_processing::FrameRef* inputs, audio_processing::FrameRef*)
+                {
+                    if (inputs[0] && inputs[1])
+                    {
+                        delay_estimator->AddPlayback(inputs[0].Data(), inputs[0].Size());
+                        delay_estimator->AddCapture(inputs[1].Data(), inputs[1].Size());
+                    }
+
+                    return true;
+                })));
+
+                connected = connected
+                        && graph.Connect(far_stage, 0, delay_stage, 0)
+                        && graph.Connect(source, 0, delay_stage, 1);
+            }
+
+            if (shm_writer.IsOpen())
+            {
+                auto shm_stage = graph.AddStage(std::unique_ptr<audio_processing::Stage>(new audio_processing::FunctionStage("shm", { audio_format }, {}
+                        , [&shm_writer](audio_processing::Stage&, audio_processing::FrameRef* inputs, audio_processing::FrameRef*)
+                {
+                    return !inputs[0] || shm_writer.Publish(inputs[0].Data(), inputs[0].Size());
+                })));
+
+                connected = connected && graph.Connect(aec_stage, 0, shm_stage, 0);
+            }
+
+            if (fanout_running)
+            {
+                auto fanout_stage = graph.AddStage(std::unique_ptr<audio_processing::Stage>(new audio_processing::FunctionStage("fanout", { audio_format }, {}
+                        , [&fanout](audio_processing::Stage&, audio_processing::FrameRef* inputs, audio_processing::FrameRef*)
+                {
+                    return !inputs[0] || fanout.Push(inputs[0].Data(), inputs[0].Size());
+                })));
+
+                connected = connected && graph.Connect(aec_stage, 0, fanout_stage, 0);
+            }
+
+            use_graph = connected && graph.Start();
+
+            if (!use_graph)
+            {
+                std::cout << "Can't build the stage graph, running the plain loop" << std::endl;
+            }
+        }
+
+        while (use_graph && stop_requested == 0)
+        {
+            graph.RunOnce();
+
+            if (report_requested != 0)
+            {
+                report_requested = 0;
+                graph.Report(std::cout);
+            }
+
+            if (deadline_monitor != nullptr)
+            {
+                deadline_monitor->AddFrame(graph.GetStageStats(aec_stage).last_time_ns);
+            }
+
+            wait_next_frame();
+        }
+
+        if (use_graph)
+        {
+            graph.Stop();
+            graph.Report(std::cout);
+        }
+
+        while (!use_graph && stop_requested == 0)
         {
             // std::memset(buffer2, -32768, sizeof(buffer2));
 
@@ -78,16 +818,70 @@ int main()
             auto r_idx = (i + 0) % buffers_count;
             auto w_idx = (i + 0) % buffers_count;
 
-            auto& read_buffer = buffers[r_idx];
-            auto& write_buffer = buffers[w_idx];
+            auto read_buffer = buffers[r_idx].Data();
+            auto write_buffer = buffers[w_idx].Data();
+
+            std::int32_t ret = 0;
 
-            auto ret = recorder.Read(read_buffer, sizeof(read_buffer));
+            {
+                audio_processing::PerfProfiler::Scope profile_scope(stage_profiler, audio_processing::profile_stage_t::device_read);
+                ret = recorder->Read(read_buffer, capture_octets);
+            }
 
             auto aec_t_1 = std::chrono::high_resolution_clock::now();
 
-            aec_controller.Playback(write_buffer, sizeof(write_buffer));
+            const void* playback_frame = write_buffer;
+            std::int32_t playback_size = ret;
+            const void* near_frame = read_buffer;
 
-            aec_controller.Capture(read_buffer, sizeof(read_buffer));
+            if (capture_channels > 1)
+            {
+                playback_size = ret > 0 ? static_cast<std::int32_t>(copy_first_channel(capture_format, read_buffer, ret, near_buffer.data())) : ret;
+                playback_frame = near_buffer.data();
+                near_frame = near_buffer.data();
+            }
+
+            // the mixed frame is shared by the reference and the player
+            if (!mix_sources.empty())
+            {
+                for (std::uint32_t s = 0; s < mix_sources.size(); s++)
+                {
+                    if (mix_sources[s]->Read(mix_buffers[s].data(), mix_buffers[s].size()) == static_cast<std::int32_t>(mix_buffers[s].size()))
+                    {
+                        mixer.SetFrame(s, mix_buffers[s].data());
+                    }
+                }
+
+                playback_frame = mixer.Mix();
+                playback_size = mixer.GetFrameSize();
+            }
+
+            if (delay_estimator != nullptr)
+            {
+                delay_estimator->AddPlayback(playback_frame, frame_octets);
+                delay_estimator->AddCapture(near_frame, frame_octets);
+            }
+
+            aec_controller.Playback(playback_frame, frame_octets);
+
+            aec_controller.Capture(read_buffer, capture_octets);
+
+            if (ret > 0)
+            {
+                shm_writer.Publish(read_buffer, ret);
+            }
+
+            if (ret == static_cast<std::int32_t>(capture_octets) && fanout_running)
+            {
+                fanout.Push(read_buffer, ret);
+            }
+
+            // the player gets the processed first channel
+            if (capture_channels > 1 && mix_sources.empty() && ret > 0)
+            {
+                copy_first_channel(capture_format, read_buffer, ret, playback_buffer.data());
+                playback_frame = playback_buffer.data();
+            }
 
             auto aec_1 = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - aec_t_1).count();
 
@@ -98,14 +892,24 @@ int main()
 
             auto t_2 = std::chrono::high_resolution_clock::now();
 
-            if (ret > 0)
+            if (playback_size > 0)
             {
-                player.Write(write_buffer, ret);
+                audio_processing::PerfProfiler::Scope profile_scope(stage_profiler, audio_processing::profile_stage_t::device_write);
+                player->Write(playback_frame, playback_size);
             }
 
-            begin += std::chrono::milliseconds(10);
+            if (report_requested != 0)
+            {
+                report_requested = 0;
+                profiler.Report(std::cout);
+            }
+
+            if (deadline_monitor != nullptr)
+            {
+                deadline_monitor->AddFrame(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - aec_t_1).count());
+            }
 
-            std::this_thread::sleep_for(begin - std::chrono::high_resolution_clock::now());
+            wait_next_frame();
 
             auto dl_1 = std::chrono::duration_cast<std::chrono::milliseconds>(t_2 - t_1).count();
             auto dl_2 = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t_2).count();
@@ -113,6 +917,26 @@ int main()
             // std::cout << "Read time = " << dl_1 << ", write time = " << dl_2 << std::endl;
             i++;
         }
+
+        if (fanout_thread.joinable())
+        {
+            fanout_running = false;
+            fanout_thread.join();
+        }
+    }
+
+    if (stage_profiler != nullptr)
+    {
+        profiler.Report(std::cout);
+    }
+
+    auto memory = aec_controller.GetMemoryStats();
+
+    if (memory.heap.tracked)
+    {
+        std::cout << "Controller memory: " << memory.heap.bytes << " bytes in " << memory.heap.blocks << " blocks, peak "
+                  << memory.heap.peak_bytes << " bytes, malloc " << memory.heap.malloc_bytes
+                  << " bytes, frames " << memory.frame_bytes << " bytes" << std::endl;
     }
 
     return 0;
@@ -0,0 +1,125 @@
+#include "mapped_file.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_devices
+{
+
+MappedFile::MappedFile()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_writable(false)
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string &file_name)
+{
+    Close();
+
+    auto fd = open(file_name.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        LOG(warning) << "Can't open file [" << file_name << "], errno = " << errno LOG_END;
+        return false;
+    }
+
+    struct stat st = {};
+    void* data = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        LOG(warning) << "Can't map file [" << file_name << "], errno = " << errno LOG_END;
+        return false;
+    }
+
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    m_file_name = file_name;
+    m_data = data;
+    m_size = st.st_size;
+    m_writable = false;
+
+    return true;
+}
+
+bool MappedFile::Create(const std::string &file_name, std::size_t size)
+{
+    Close();
+
+    auto fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0)
+    {
+        LOG(warning) << "Can't create file [" << file_name << "], errno = " << errno LOG_END;
+        return false;
+    }
+
+    void* data = MAP_FAILED;
+
+    if (size > 0 && ftruncate(fd, size) == 0)
+    {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        LOG(warning) << "Can't map file [" << file_name << "], errno = " << errno LOG_END;
+        return false;
+    }
+
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    m_file_name = file_name;
+    m_data = data;
+    m_size = size;
+    m_writable = true;
+
+    return true;
+}
+
+bool MappedFile::Close()
+{
+    bool result = false;
+
+    if (m_data != nullptr)
+    {
+        result = munmap(m_data, m_size) == 0;
+
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    return result;
+}
+
+}
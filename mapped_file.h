@@ -0,0 +1,41 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace audio_devices
+{
+
+class MappedFile
+{
+    std::string                     m_file_name;
+    void*                           m_data;
+    std::size_t                     m_size;
+    bool                            m_writable;
+
+public:
+
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // read only mapping of the whole file, read ahead hinted as sequential
+    bool Open(const std::string& file_name);
+    // new file of the given size mapped for writing
+    bool Create(const std::string& file_name, std::size_t size);
+    bool Close();
+
+    inline bool IsOpen() const { return m_data != nullptr; }
+
+    inline const std::uint8_t* Data() const { return static_cast<const std::uint8_t*>(m_data); }
+    inline std::uint8_t* MutableData() { return m_writable ? static_cast<std::uint8_t*>(m_data) : nullptr; }
+    inline std::size_t Size() const { return m_size; }
+};
+
+}
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,220 @@
+#include "memory_tracker.h"
+
+#include <new>
+#include <cerrno>
+
+#include <malloc.h>
+
+// Replaceable allocation functions of the tools built with
+// AEC_MEMORY_TRACKING, never part of aec_core: a program that links the
+// library keeps its own allocator. The aligned ones are left to the
+// runtime and pair with its own deallocation.
+// The malloc family is replaced as well, the shared libraries bind to it:
+// the glibc allocator does the work, the usable size of the blocks is
+// counted per thread without locks.
+
+extern "C"
+{
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* data, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+void* __libc_valloc(std::size_t size);
+void* __libc_pvalloc(std::size_t size);
+void __libc_free(void* data);
+}
+
+namespace
+{
+
+// executable TLS, taken without allocating
+thread_local std::int64_t thread_malloc_bytes = 0;
+
+std::int64_t get_thread_malloc_bytes()
+{
+    return thread_malloc_bytes;
+}
+
+void* count_block(void* data)
+{
+    if (data != nullptr)
+    {
+        thread_malloc_bytes += static_cast<std::int64_t>(malloc_usable_size(data));
+    }
+
+    return data;
+}
+
+void* tracked_new(std::size_t size)
+{
+    for (;;)
+    {
+        auto data = audio_processing::memory_tracking_allocate(size > 0 ? size : 1);
+
+        if (data != nullptr)
+        {
+            return data;
+        }
+
+        auto handler = std::get_new_handler();
+
+        if (handler == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        handler();
+    }
+}
+
+struct memory_hooks_t
+{
+    memory_hooks_t()
+    {
+        audio_processing::enable_memory_tracking(get_thread_malloc_bytes);
+    }
+} memory_hooks;
+
+}
+
+void* operator new(std::size_t size)
+{
+    return tracked_new(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return tracked_new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return tracked_new(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return tracked_new(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void operator delete(void* data) noexcept
+{
+    audio_processing::memory_tracking_free(data);
+}
+
+void operator delete[](void* data) noexcept
+{
+    audio_processing::memory_tracking_free(data);
+}
+
+void operator delete(void* data, const std::nothrow_t&) noexcept
+{
+    audio_processing::memory_tracking_free(data);
+}
+
+void operator delete[](void* data, const std::nothrow_t&) noexcept
+{
+    audio_processing::memory_tracking_free(data);
+}
+
+void operator delete(void* data, std::size_t) noexcept
+{
+    audio_processing::memory_tracking_free(data);
+}
+
+void operator delete[](void* data, std::size_t) noexcept
+{
+    audio_processing::memory_tracking_free(data);
+}
+
+extern "C"
+{
+
+void* malloc(std::size_t size)
+{
+    return count_block(__libc_malloc(size));
+}
+
+void* calloc(std::size_t count, std::size_t size)
+{
+    return count_block(__libc_calloc(count, size));
+}
+
+void* realloc(void* data, std::size_t size)
+{
+    auto previous = data != nullptr ? static_cast<std::int64_t>(malloc_usable_size(data)) : 0;
+    auto result = __libc_realloc(data, size);
+
+    // a failed realloc keeps the block, realloc to 0 frees it
+    if (result != nullptr || size == 0)
+    {
+        thread_malloc_bytes -= previous;
+    }
+
+    return count_block(result);
+}
+
+void* memalign(std::size_t alignment, std::size_t size)
+{
+    return count_block(__libc_memalign(alignment, size));
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size)
+{
+    return count_block(__libc_memalign(alignment, size));
+}
+
+int posix_memalign(void** data, std::size_t alignment, std::size_t size)
+{
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+
+    auto result = count_block(__libc_memalign(alignment, size));
+
+    if (result == nullptr)
+    {
+        return ENOMEM;
+    }
+
+    *data = result;
+
+    return 0;
+}
+
+void* valloc(std::size_t size)
+{
+    return count_block(__libc_valloc(size));
+}
+
+void* pvalloc(std::size_t size)
+{
+    return count_block(__libc_pvalloc(size));
+}
+
+void free(void* data)
+{
+    if (data != nullptr)
+    {
+        thread_malloc_bytes -= static_cast<std::int64_t>(malloc_usable_size(data));
+    }
+
+    __libc_free(data);
+}
+
+}
@@ -0,0 +1,204 @@
+#include "memory_tracker.h"
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+#include <malloc.h>
+
+namespace audio_processing
+{
+
+// owned by the account and by every block stamped with it
+struct memory_account_state_t
+{
+    std::atomic<std::uint64_t>                          bytes;
+    std::atomic<std::uint64_t>                          peak_bytes;
+    std::atomic<std::uint64_t>                          blocks;
+    std::atomic<std::uint64_t>                          allocations;
+    std::atomic<std::int64_t>                           malloc_bytes;
+    std::atomic<std::uint64_t>                          references;
+};
+
+namespace
+{
+
+std::atomic<bool> tracking_enabled(false);
+// set once before tracking is enabled
+std::int64_t (*malloc_counter)() = nullptr;
+
+// constant initialized, safe inside operator new on any thread
+thread_local memory_account_state_t* current_account = nullptr;
+// operator new blocks of this thread as malloc sees them, net of deletes
+thread_local std::int64_t thread_new_bytes = 0;
+thread_local std::uint32_t scope_depth = 0;
+
+// the state itself is not accounted
+memory_account_state_t* create_state()
+{
+    auto memory = std::malloc(sizeof(memory_account_state_t));
+
+    if (memory == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto state = new (memory) memory_account_state_t();
+
+    state->bytes = 0;
+    state->peak_bytes = 0;
+    state->blocks = 0;
+    state->allocations = 0;
+    state->malloc_bytes = 0;
+    state->references = 1;
+
+    return state;
+}
+
+void release_state(memory_account_state_t* state)
+{
+    if (state != nullptr && state->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        state->~memory_account_state_t();
+        std::free(state);
+    }
+}
+
+// in front of every block, keeps the malloc alignment
+union block_header_t
+{
+    struct
+    {
+        memory_account_state_t*                         account;
+        std::size_t                                     size;
+    }                                                   block;
+    std::max_align_t                                    alignment;
+};
+
+}
+
+MemoryAccount::MemoryAccount()
+    : m_state(create_state())
+{
+
+}
+
+MemoryAccount::~MemoryAccount()
+{
+    release_state(m_state);
+}
+
+memory_stats_t MemoryAccount::GetStats() const
+{
+    memory_stats_t stats = {};
+
+    stats.tracked = is_memory_tracking_enabled();
+
+    if (m_state != nullptr)
+    {
+        stats.bytes = m_state->bytes.load(std::memory_order_relaxed);
+        stats.peak_bytes = m_state->peak_bytes.load(std::memory_order_relaxed);
+        stats.blocks = m_state->blocks.load(std::memory_order_relaxed);
+        stats.allocations = m_state->allocations.load(std::memory_order_relaxed);
+        stats.malloc_bytes = m_state->malloc_bytes.load(std::memory_order_relaxed);
+    }
+
+    return stats;
+}
+
+MemoryScope::MemoryScope(const MemoryAccount &account)
+    : m_previous(current_account)
+    , m_tracked(account.m_state != nullptr && is_memory_tracking_enabled())
+    , m_malloc_bytes(0)
+    , m_new_bytes(0)
+{
+    current_account = account.m_state;
+
+    if (m_tracked && scope_depth++ == 0)
+    {
+        m_new_bytes = thread_new_bytes;
+        m_malloc_bytes = malloc_counter();
+    }
+}
+
+MemoryScope::~MemoryScope()
+{
+    if (m_tracked && --scope_depth == 0)
+    {
+        // operator new blocks are malloc blocks too, counted by the account
+        auto bytes = (malloc_counter() - m_malloc_bytes) - (thread_new_bytes - m_new_bytes);
+
+        current_account->malloc_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    current_account = m_previous;
+}
+
+bool is_memory_tracking_enabled()
+{
+    return tracking_enabled.load(std::memory_order_relaxed);
+}
+
+void enable_memory_tracking(std::int64_t (*thread_malloc_bytes)())
+{
+    malloc_counter = thread_malloc_bytes;
+    tracking_enabled = true;
+}
+
+void* memory_tracking_allocate(std::size_t size)
+{
+    auto header = static_cast<block_header_t*>(std::malloc(sizeof(block_header_t) + size));
+
+    if (header == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto account = current_account;
+
+    header->block.account = account;
+    header->block.size = size;
+
+    thread_new_bytes += static_cast<std::int64_t>(malloc_usable_size(header));
+
+    if (account != nullptr)
+    {
+        account->references.fetch_add(1, std::memory_order_relaxed);
+        account->blocks.fetch_add(1, std::memory_order_relaxed);
+        account->allocations.fetch_add(1, std::memory_order_relaxed);
+
+        auto bytes = account->bytes.fetch_add(size, std::memory_order_relaxed) + size;
+        auto peak = account->peak_bytes.load(std::memory_order_relaxed);
+
+        while (bytes > peak && !account->peak_bytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    return header + 1;
+}
+
+void memory_tracking_free(void* data)
+{
+    if (data == nullptr)
+    {
+        return;
+    }
+
+    auto header = static_cast<block_header_t*>(data) - 1;
+    auto account = header->block.account;
+
+    thread_new_bytes -= static_cast<std::int64_t>(malloc_usable_size(header));
+
+    if (account != nullptr)
+    {
+        account->bytes.fetch_sub(header->block.size, std::memory_order_relaxed);
+        account->blocks.fetch_sub(1, std::memory_order_relaxed);
+
+        release_state(account);
+    }
+
+    std::free(header);
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace audio_processing
+{
+
+// readable from any thread
+struct memory_stats_t
+{
+    bool            tracked;            // the program is built with AEC_MEMORY_TRACKING
+    std::uint64_t   bytes;              // live operator new blocks
+    std::uint64_t   peak_bytes;
+    std::uint64_t   blocks;
+    std::uint64_t   allocations;        // since the account was created
+    std::int64_t    malloc_bytes;       // malloc blocks of scopes net of their frees, operator new blocks left out
+};
+
+struct memory_account_state_t;
+
+// Heap use of whatever runs inside a MemoryScope of the account. The tools
+// built with AEC_MEMORY_TRACKING link memory_hooks.cpp, whose global
+// operator new stamps every block with the account of the scope open on the
+// allocating thread and delete credits it back from any thread. Blocks may
+// outlive the account, the counters are kept until the last one is freed.
+// webrtc allocates most of its state with malloc, the hooks also replace
+// malloc and count its blocks per thread. The library never replaces an
+// allocator, programs without the hooks get empty accounts.
+class MemoryAccount
+{
+    memory_account_state_t*                             m_state;
+
+    friend class MemoryScope;
+
+public:
+    MemoryAccount();
+    ~MemoryAccount();
+
+    MemoryAccount(const MemoryAccount&) = delete;
+    MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+    memory_stats_t GetStats() const;
+};
+
+// allocations of this thread go to the account until the scope ends,
+// scopes nest. The outermost one also charges the malloc blocks this thread
+// allocated meanwhile net of the ones it freed, blocks freed later on other
+// threads are not credited back
+class MemoryScope
+{
+    memory_account_state_t*                             m_previous;
+    bool                                                m_tracked;
+    std::int64_t                                        m_malloc_bytes;
+    std::int64_t                                        m_new_bytes;
+
+public:
+    explicit MemoryScope(const MemoryAccount& account);
+    ~MemoryScope();
+
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+};
+
+bool is_memory_tracking_enabled();
+
+// for memory_hooks.cpp only, thread_malloc_bytes is the usable size of the
+// malloc blocks of the calling thread net of its frees
+void enable_memory_tracking(std::int64_t (*thread_malloc_bytes)());
+void* memory_tracking_allocate(std::size_t size);
+void memory_tracking_free(void* data);
+
+}
+
+#endif // MEMORY_TRACKER_H
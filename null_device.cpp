@@ -0,0 +1,104 @@
+#include "null_device.h"
+
+#include <cstring>
+#include <cerrno>
+
+namespace audio_devices
+{
+
+NullDevice::NullDevice()
+    : m_open(false)
+    , m_volume(100)
+{
+
+}
+
+NullDevice::~NullDevice()
+{
+    Close();
+}
+
+bool NullDevice::Open(const std::string &device_name, const audio_params_t &audio_params)
+{
+    m_open = audio_params.is_init();
+
+    if (m_open)
+    {
+        m_audio_params = audio_params;
+    }
+
+    return m_open;
+}
+
+bool NullDevice::Close()
+{
+    bool result = m_open;
+
+    m_open = false;
+
+    return result;
+}
+
+bool NullDevice::IsOpen() const
+{
+    return m_open;
+}
+
+bool NullDevice::IsRecorder() const
+{
+    return m_audio_params.recorder;
+}
+
+const audio_params_t &NullDevice::GetParams() const
+{
+    return m_audio_params;
+}
+
+bool NullDevice::SetParams(const audio_params_t &audio_params)
+{
+    bool result = audio_params.is_init();
+
+    if (result == true)
+    {
+        m_audio_params = audio_params;
+    }
+
+    return result;
+}
+
+std::int32_t NullDevice::Read(void *capture_data, std::size_t size)
+{
+    std::int32_t result = -EBADF;
+
+    if ( IsOpen() )
+    {
+        result = -EACCES;
+
+        if (IsRecorder())
+        {
+            std::memset(capture_data, 0, size);
+            result = static_cast<std::int32_t>(size);
+        }
+    }
+
+    return result;
+}
+
+std::int32_t NullDevice::Write(const void *playback_data, std::size_t size)
+{
+    std::int32_t result = -EBADF;
+
+    if ( IsOpen() )
+    {
+        result = -EACCES;
+
+        if (!IsRecorder())
+        {
+            result = static_cast<std::int32_t>(size);
+        }
+    }
+
+    return result;
+}
+
+}
@@ -0,0 +1,39 @@
+#ifndef NULL_DEVICE_H
+#define NULL_DEVICE_H
+
+#include "audio_device.h"
+
+namespace audio_devices
+{
+
+// recorder returns silence, player discards data
+class NullDevice : public AudioDevice
+{
+    bool                            m_open;
+    audio_params_t                  m_audio_params;
+    std::uint32_t                   m_volume;
+
+public:
+
+    NullDevice();
+    ~NullDevice() override;
+
+    bool Open(const std::string& device_name, const audio_params_t& audio_params = null_audio_params) override;
+    bool Close() override;
+
+    bool IsOpen() const override;
+    bool IsRecorder() const override;
+
+    const audio_params_t& GetParams() const override;
+    bool SetParams(const audio_params_t& audio_params) override;
+
+    std::int32_t Read(void* capture_data, std::size_t size) override;
+    std::int32_t Write(const void* playback_data, std::size_t size) override;
+
+    inline void SetVolume(std::uint32_t volume) override { m_volume = volume; }
+    inline std::uint32_t GetVolume() const override { return m_volume; }
+};
+
+}
+
+#endif // NULL_DEVICE_H
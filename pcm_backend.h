@@ -0,0 +1,66 @@
+#ifndef PCM_BACKEND_H
+#define PCM_BACKEND_H
+
+#include "audio_device.h"
+
+#include <string>
+#include <cstdint>
+
+namespace audio_devices
+{
+
+// parameters granted by the driver
+struct pcm_config_t
+{
+    std::uint32_t   sample_rate;
+    std::uint32_t   period_frames;
+    std::uint32_t   buffer_frames;
+    std::uint32_t   periods;
+    std::uint32_t   start_threshold;
+    std::uint32_t   stop_threshold;
+    std::uint32_t   avail_min;
+    bool            timestamps;
+
+    pcm_config_t()
+        : sample_rate(0)
+        , period_frames(0)
+        , buffer_frames(0)
+        , periods(0)
+        , start_threshold(0)
+        , stop_threshold(0)
+        , avail_min(0)
+        , timestamps(false)
+    {}
+
+    inline std::uint32_t buffer_duration_us() const { return sample_rate > 0 ? static_cast<std::uint32_t>((static_cast<std::uint64_t>(buffer_frames) * 1000000) / sample_rate) : 0; }
+    inline std::uint32_t period_duration_us() const { return sample_rate > 0 ? static_cast<std::uint32_t>((static_cast<std::uint64_t>(period_frames) * 1000000) / sample_rate) : 0; }
+};
+
+// PCM stream used by AlsaDevice instead of libasound, the calls follow
+// snd_pcm_* semantics: frame counts or negative errno (-EPIPE, -ESTRPIPE,
+// -EAGAIN...)
+class PcmBackend
+{
+public:
+
+    virtual ~PcmBackend() {}
+
+    // configures the stream and reports what was granted
+    virtual std::int32_t Open(const std::string& device_name, const audio_params_t& audio_params, bool manual_start, pcm_config_t& pcm_config) = 0;
+    virtual void Close() = 0;
+    virtual bool IsOpen() const = 0;
+
+    virtual std::int32_t ReadFrames(void* data, std::uint32_t frames) = 0;
+    virtual std::int32_t WriteFrames(const void* data, std::uint32_t frames) = 0;
+
+    virtual std::int32_t Prepare() = 0;
+    virtual std::int32_t Resume() = 0;
+    // 1 - ready, 0 - timeout
+    virtual std::int32_t Wait(std::int32_t timeout_ms) = 0;
+    virtual std::int32_t Start() = 0;
+    virtual std::int32_t Delay(std::int32_t& frames) const = 0;
+};
+
+}
+
+#endif // PCM_BACKEND_H
@@ -0,0 +1,101 @@
+#ifndef PCM_COROUTINE_H
+#define PCM_COROUTINE_H
+
+#include "pcm_reactor.h"
+
+// co_await front end of PcmReactor, needs a C++20 compiler:
+//
+//  pcm_task_t capture(PcmReactor& reactor, AlsaDevice& device)
+//  {
+//      while (co_await async_read_frame(reactor, device, buffer) > 0) { ... }
+//  }
+//
+// The coroutine runs on the reactor thread between suspension points.
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <exception>
+#include <cerrno>
+
+namespace audio_devices
+{
+
+// fire and forget coroutine, the frame is freed when the body returns
+struct pcm_task_t
+{
+    struct promise_type
+    {
+        pcm_task_t get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// result of co_await: bytes or negative errno
+class PcmAwaitable
+{
+    PcmReactor&         m_reactor;
+    AlsaDevice&         m_device;
+    void*               m_data;
+    std::size_t         m_size;
+    bool                m_write;
+    std::int32_t        m_result;
+
+public:
+    PcmAwaitable(PcmReactor& reactor, AlsaDevice& device, void* data, std::size_t size, bool write)
+        : m_reactor(reactor)
+        , m_device(device)
+        , m_data(data)
+        , m_size(size)
+        , m_write(write)
+        , m_result(-EBADF)
+    {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        auto handler = [this, handle](std::int32_t result)
+        {
+            m_result = result;
+            handle.resume();
+        };
+
+        // not submitted - resume at once with -EBADF
+        return m_write
+                ? m_reactor.AsyncWrite(m_device, m_data, m_size, handler)
+                : m_reactor.AsyncRead(m_device, m_data, m_size, handler);
+    }
+
+    std::int32_t await_resume() const noexcept { return m_result; }
+};
+
+inline PcmAwaitable async_read(PcmReactor& reactor, AlsaDevice& device, void* capture_data, std::size_t size)
+{
+    return PcmAwaitable(reactor, device, capture_data, size, false);
+}
+
+inline PcmAwaitable async_write(PcmReactor& reactor, AlsaDevice& device, const void* playback_data, std::size_t size)
+{
+    return PcmAwaitable(reactor, device, const_cast<void*>(playback_data), size, true);
+}
+
+// 10 ms of the device format
+inline PcmAwaitable async_read_frame(PcmReactor& reactor, AlsaDevice& device, void* capture_data)
+{
+    return async_read(reactor, device, capture_data, device.GetParams().audio_format.octets_count(10));
+}
+
+inline PcmAwaitable async_write_frame(PcmReactor& reactor, AlsaDevice& device, const void* playback_data)
+{
+    return async_write(reactor, device, playback_data, device.GetParams().audio_format.octets_count(10));
+}
+
+}
+
+#endif
+
+#endif // PCM_COROUTINE_H
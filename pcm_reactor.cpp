@@ -0,0 +1,266 @@
+#include "pcm_reactor.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <algorithm>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_devices
+{
+
+PcmReactor::PcmReactor()
+    : m_next_id(1)
+    , m_pending_count(0)
+    , m_wakeup_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , m_stop(false)
+{
+    if (m_wakeup_fd < 0)
+    {
+        LOG(warning) << "Can't create reactor wakeup, errno = " << errno LOG_END;
+    }
+}
+
+PcmReactor::~PcmReactor()
+{
+    for (std::size_t i = 0; i < m_operations.size(); i++)
+    {
+        if (m_operations[i].id != 0)
+        {
+            complete(i, -ECANCELED);
+        }
+    }
+
+    if (m_wakeup_fd >= 0)
+    {
+        close(m_wakeup_fd);
+    }
+}
+
+bool PcmReactor::AsyncRead(AlsaDevice &device, void *capture_data, std::size_t size, io_handler_t handler)
+{
+    return device.IsRecorder()
+            && submit(device, false, capture_data, size, std::move(handler));
+}
+
+bool PcmReactor::AsyncWrite(AlsaDevice &device, const void *playback_data, std::size_t size, io_handler_t handler)
+{
+    // the buffer is only read
+    return !device.IsRecorder()
+            && submit(device, true, const_cast<void*>(playback_data), size, std::move(handler));
+}
+
+bool PcmReactor::Cancel(AlsaDevice &device)
+{
+    for (std::size_t i = 0; i < m_operations.size(); i++)
+    {
+        if (m_operations[i].id != 0 && m_operations[i].device == &device)
+        {
+            complete(i, -ECANCELED);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::int32_t PcmReactor::RunOnce(std::int32_t timeout_ms)
+{
+    m_descriptors.clear();
+    m_poll_slots.clear();
+
+    if (m_wakeup_fd >= 0)
+    {
+        m_descriptors.push_back({ m_wakeup_fd, POLLIN, 0 });
+    }
+
+    for (std::size_t i = 0; i < m_operations.size(); i++)
+    {
+        auto& operation = m_operations[i];
+
+        if (operation.id == 0)
+        {
+            continue;
+        }
+
+        // data may be ready already, poll only reports period wakeups
+        auto result = transfer(operation);
+
+        if (result != -EAGAIN)
+        {
+            complete(i, result);
+            continue;
+        }
+
+        auto count = operation.device->GetPollCount();
+        auto offset = m_descriptors.size();
+
+        m_descriptors.resize(offset + count);
+
+        if (count == 0 || !operation.device->GetPollDescriptors(&m_descriptors[offset], count))
+        {
+            m_descriptors.resize(offset);
+            complete(i, -ENOTSUP);
+            continue;
+        }
+
+        m_poll_slots.push_back({ i, operation.id, offset, count });
+    }
+
+    if (m_poll_slots.empty())
+    {
+        return 0;
+    }
+
+    auto ready = poll(m_descriptors.data(), m_descriptors.size(), timeout_ms);
+
+    if (ready < 0)
+    {
+        return errno == EINTR ? 0 : -errno;
+    }
+
+    if (m_wakeup_fd >= 0 && (m_descriptors[0].revents & POLLIN) != 0)
+    {
+        std::uint64_t value = 0;
+
+        if (read(m_wakeup_fd, &value, sizeof(value)) < 0)
+        {
+            LOG(warning) << "Can't reset reactor wakeup, errno = " << errno LOG_END;
+        }
+    }
+
+    std::int32_t completed = 0;
+
+    for (const auto& slot : m_poll_slots)
+    {
+        // handlers may have freed or reused the slot
+        if (slot.index >= m_operations.size() || m_operations[slot.index].id != slot.id)
+        {
+            continue;
+        }
+
+        auto& operation = m_operations[slot.index];
+        auto events = operation.device->GetPollEvents(&m_descriptors[slot.offset], slot.count);
+
+        if (events == 0)
+        {
+            continue;
+        }
+
+        auto result = transfer(operation);
+
+        if (result != -EAGAIN)
+        {
+            complete(slot.index, result);
+            completed++;
+        }
+    }
+
+    return completed;
+}
+
+void PcmReactor::Run()
+{
+    m_stop = false;
+
+    while (!m_stop && m_pending_count > 0)
+    {
+        if (RunOnce(-1) < 0)
+        {
+            break;
+        }
+    }
+}
+
+void PcmReactor::Stop()
+{
+    m_stop = true;
+
+    if (m_wakeup_fd >= 0)
+    {
+        std::uint64_t value = 1;
+
+        if (write(m_wakeup_fd, &value, sizeof(value)) < 0)
+        {
+            LOG(warning) << "Can't wake up reactor, errno = " << errno LOG_END;
+        }
+    }
+}
+
+bool PcmReactor::submit(AlsaDevice &device, bool write, void *data, std::size_t size, io_handler_t handler)
+{
+    std::size_t free_index = m_operations.size();
+
+    for (std::size_t i = 0; i < m_operations.size(); i++)
+    {
+        if (m_operations[i].id == 0)
+        {
+            free_index = std::min(free_index, i);
+        }
+        else if (m_operations[i].device == &device)
+        {
+            LOG(warning) << "Device has a pending operation" LOG_END;
+            return false;
+        }
+    }
+
+    if (!device.IsOpen() || size == 0)
+    {
+        return false;
+    }
+
+    if (free_index == m_operations.size())
+    {
+        m_operations.emplace_back();
+    }
+
+    m_operations[free_index] = { m_next_id++, &device, write, static_cast<std::uint8_t*>(data), size, 0, std::move(handler) };
+    m_pending_count++;
+
+    return true;
+}
+
+std::int32_t PcmReactor::transfer(operation_t &operation)
+{
+    while (operation.done < operation.size)
+    {
+        auto result = operation.write
+                ? operation.device->TryWrite(operation.data + operation.done, operation.size - operation.done)
+                : operation.device->TryRead(operation.data + operation.done, operation.size - operation.done);
+
+        if (result <= 0)
+        {
+            return result == 0 ? -EAGAIN : result;
+        }
+
+        operation.done += result;
+    }
+
+    return static_cast<std::int32_t>(operation.done);
+}
+
+void PcmReactor::complete(std::size_t index, std::int32_t result)
+{
+    // the slot is free before the handler runs, it may submit again
+    auto handler = std::move(m_operations[index].handler);
+
+    m_operations[index].id = 0;
+    m_operations[index].handler = nullptr;
+    m_pending_count--;
+
+    if (handler)
+    {
+        handler(result);
+    }
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef PCM_REACTOR_H
+#define PCM_REACTOR_H
+
+#include "alsa_device.h"
+
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+#include <poll.h>
+
+namespace audio_devices
+{
+
+// Single threaded poll(2) loop over ALSA devices. Each device has at most
+// one pending read or write; the handler runs on the reactor thread once
+// the whole buffer is transferred (result = size) or on error (negative
+// errno, bytes already transferred are lost). Handlers may start the next
+// operation. One reactor thread can serve any number of devices.
+class PcmReactor
+{
+public:
+    using io_handler_t = std::function<void(std::int32_t result)>;
+
+private:
+    struct operation_t
+    {
+        std::uint64_t       id;         // 0 - free slot
+        AlsaDevice*         device;
+        bool                write;
+        std::uint8_t*       data;
+        std::size_t         size;
+        std::size_t         done;
+        io_handler_t        handler;
+    };
+
+    struct poll_slot_t
+    {
+        std::size_t         index;
+        std::uint64_t       id;
+        std::size_t         offset;
+        std::size_t         count;
+    };
+
+    std::vector<operation_t>                            m_operations;
+    std::uint64_t                                       m_next_id;
+    std::size_t                                         m_pending_count;
+
+    std::vector<pollfd>                                 m_descriptors;
+    std::vector<poll_slot_t>                            m_poll_slots;
+
+    int                                                 m_wakeup_fd;
+    std::atomic<bool>                                   m_stop;
+
+public:
+    PcmReactor();
+    ~PcmReactor();
+
+    PcmReactor(const PcmReactor&) = delete;
+    PcmReactor& operator=(const PcmReactor&) = delete;
+
+    bool AsyncRead(AlsaDevice& device, void* capture_data, std::size_t size, io_handler_t handler);
+    bool AsyncWrite(AlsaDevice& device, const void* playback_data, std::size_t size, io_handler_t handler);
+    // handler is called with -ECANCELED
+    bool Cancel(AlsaDevice& device);
+
+    // completed operations, negative errno of poll
+    std::int32_t RunOnce(std::int32_t timeout_ms);
+    // until Stop or nothing pending
+    void Run();
+    // any thread
+    void Stop();
+
+    inline std::size_t GetPendingCount() const { return m_pending_count; }
+
+private:
+    bool submit(AlsaDevice& device, bool write, void* data, std::size_t size, io_handler_t handler);
+    std::int32_t transfer(operation_t& operation);
+    void complete(std::size_t index, std::int32_t result);
+};
+
+}
+
+#endif // PCM_REACTOR_H
@@ -0,0 +1,320 @@
+#include "perf_profiler.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <iomanip>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_processing
+{
+
+static const struct
+{
+    std::uint32_t   type;
+    std::uint64_t   config;
+    const char*     name;
+}
+perf_events[perf_counter_count] =
+{
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache_misses" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch_misses" },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context_switches" }
+};
+
+static const char* stage_names[profile_stage_count] =
+{
+    "device_read",
+    "convert",
+    "process_reverse",
+    "process_stream",
+    "device_write"
+};
+
+static int perf_event_open(std::uint32_t type, std::uint64_t config, int group_fd)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd < 0 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    // this thread, any cpu
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+
+static std::uint64_t monotonic_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PerfProfiler::Scope::Scope(PerfProfiler *profiler, profile_stage_t stage)
+    : m_profiler(profiler)
+    , m_stage(stage)
+{
+    if (m_profiler != nullptr)
+    {
+        m_profiler->Sample(m_start);
+    }
+}
+
+PerfProfiler::Scope::~Scope()
+{
+    if (m_profiler != nullptr)
+    {
+        perf_sample_t end;
+        m_profiler->Sample(end);
+        m_profiler->Account(m_stage, m_start, end);
+    }
+}
+
+PerfProfiler::PerfProfiler()
+    : m_group_fd(-1)
+    , m_opened_count(0)
+{
+    for (std::size_t c = 0; c < perf_counter_count; c++)
+    {
+        m_fds[c] = -1;
+        m_read_index[c] = -1;
+    }
+
+    Reset();
+}
+
+PerfProfiler::~PerfProfiler()
+{
+    Close();
+}
+
+bool PerfProfiler::Open()
+{
+    Close();
+
+    for (std::size_t c = 0; c < perf_counter_count; c++)
+    {
+        // the first counter that opens leads the group
+        auto fd = perf_event_open(perf_events[c].type, perf_events[c].config, m_group_fd);
+
+        if (fd < 0)
+        {
+            LOG(warning) << "Perf counter " << perf_events[c].name << " is not available, errno = " << errno LOG_END;
+            continue;
+        }
+
+        if (m_group_fd < 0)
+        {
+            m_group_fd = fd;
+        }
+
+        m_fds[c] = fd;
+        m_read_index[c] = static_cast<int>(m_opened_count++);
+    }
+
+    if (m_group_fd >= 0)
+    {
+        ioctl(m_group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(m_group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    else
+    {
+        LOG(warning) << "No perf counters, wall time only (check /proc/sys/kernel/perf_event_paranoid)" LOG_END;
+    }
+
+    Reset();
+
+    return m_group_fd >= 0;
+}
+
+void PerfProfiler::Close()
+{
+    for (std::size_t c = 0; c < perf_counter_count; c++)
+    {
+        // leader last, closing it first detaches the members
+        if (m_fds[c] >= 0 && m_fds[c] != m_group_fd)
+        {
+            close(m_fds[c]);
+        }
+
+        m_fds[c] = -1;
+        m_read_index[c] = -1;
+    }
+
+    if (m_group_fd >= 0)
+    {
+        close(m_group_fd);
+        m_group_fd = -1;
+    }
+
+    m_opened_count = 0;
+}
+
+bool PerfProfiler::IsCounterAvailable(perf_counter_t counter) const
+{
+    return m_read_index[static_cast<std::size_t>(counter)] >= 0;
+}
+
+void PerfProfiler::Sample(perf_sample_t &sample) const
+{
+    // PERF_FORMAT_GROUP: nr, value[nr]
+    std::uint64_t buffer[1 + perf_counter_count] = {};
+
+    if (m_group_fd >= 0
+            && read(m_group_fd, buffer, sizeof(std::uint64_t) * (1 + m_opened_count)) > 0)
+    {
+        for (std::size_t c = 0; c < perf_counter_count; c++)
+        {
+            sample.values[c] = m_read_index[c] >= 0
+                    ? buffer[1 + m_read_index[c]]
+                    : 0;
+        }
+    }
+    else
+    {
+        std::memset(sample.values, 0, sizeof(sample.values));
+    }
+
+    sample.time_ns = monotonic_ns();
+}
+
+void PerfProfiler::Account(profile_stage_t stage, const perf_sample_t &start, const perf_sample_t &end)
+{
+    auto& stats = m_stages[static_cast<std::size_t>(stage)];
+
+    stats.calls++;
+
+    for (std::size_t c = 0; c < perf_counter_count; c++)
+    {
+        stats.totals[c] += end.values[c] - start.values[c];
+    }
+
+    auto time_ns = end.time_ns - start.time_ns;
+
+    stats.total_time_ns += time_ns;
+
+    if (time_ns > stats.max_time_ns)
+    {
+        stats.max_time_ns = time_ns;
+    }
+}
+
+const stage_stats_t &PerfProfiler::GetStageStats(profile_stage_t stage) const
+{
+    return m_stages[static_cast<std::size_t>(stage)];
+}
+
+void PerfProfiler::Reset()
+{
+    std::memset(m_stages, 0, sizeof(m_stages));
+}
+
+void PerfProfiler::Report(std::ostream &stream) const
+{
+    auto per_call = [](std::uint64_t value, std::uint64_t calls) -> double
+    {
+        return calls > 0 ? static_cast<double>(value) / calls : 0.0;
+    };
+
+    auto counter = [&](std::ostream& s, const stage_stats_t& stats, perf_counter_t c)
+    {
+        s << std::setw(14);
+
+        if (IsCounterAvailable(c))
+        {
+            s << per_call(stats.totals[static_cast<std::size_t>(c)], stats.calls);
+        }
+        else
+        {
+            s << "n/a";
+        }
+    };
+
+    auto flags = stream.flags();
+
+    stream << std::fixed << std::setprecision(1)
+           << std::left << std::setw(16) << "stage" << std::right
+           << std::setw(10) << "calls"
+           << std::setw(10) << "avg_us"
+           << std::setw(10) << "max_us"
+           << std::setw(14) << "cycles"
+           << std::setw(14) << "instructions"
+           << std::setw(8) << "ipc"
+           << std::setw(14) << "cache_misses"
+           << std::setw(14) << "branch_misses"
+           << std::setw(14) << "ctx_switches"
+           << std::endl;
+
+    for (std::size_t s = 0; s < profile_stage_count; s++)
+    {
+        const auto& stats = m_stages[s];
+
+        if (stats.calls == 0)
+        {
+            continue;
+        }
+
+        auto cycles = stats.totals[static_cast<std::size_t>(perf_counter_t::cycles)];
+        auto instructions = stats.totals[static_cast<std::size_t>(perf_counter_t::instructions)];
+
+        stream << std::left << std::setw(16) << stage_names[s] << std::right
+               << std::setw(10) << stats.calls
+               << std::setw(10) << per_call(stats.total_time_ns, stats.calls) / 1000.0
+               << std::setw(10) << static_cast<double>(stats.max_time_ns) / 1000.0;
+
+        counter(stream, stats, perf_counter_t::cycles);
+        counter(stream, stats, perf_counter_t::instructions);
+
+        stream << std::setw(8) << std::setprecision(2);
+
+        if (IsCounterAvailable(perf_counter_t::cycles) && IsCounterAvailable(perf_counter_t::instructions) && cycles > 0)
+        {
+            stream << static_cast<double>(instructions) / cycles;
+        }
+        else
+        {
+            stream << "n/a";
+        }
+
+        stream << std::setprecision(1);
+
+        counter(stream, stats, perf_counter_t::cache_misses);
+        counter(stream, stats, perf_counter_t::branch_misses);
+
+        // total, per call is mostly zero
+        stream << std::setw(14);
+
+        if (IsCounterAvailable(perf_counter_t::context_switches))
+        {
+            stream << stats.totals[static_cast<std::size_t>(perf_counter_t::context_switches)];
+        }
+        else
+        {
+            stream << "n/a";
+        }
+
+        stream << std::endl;
+    }
+
+    stream.flags(flags);
+}
+
+}
@@ -0,0 +1,97 @@
+#ifndef PERF_PROFILER_H
+#define PERF_PROFILER_H
+
+#include <ostream>
+#include <cstdint>
+
+namespace audio_processing
+{
+
+enum class profile_stage_t
+{
+    device_read,
+    convert,
+    process_reverse,
+    process_stream,
+    device_write,
+    count
+};
+
+enum class perf_counter_t
+{
+    cycles,
+    instructions,
+    cache_misses,
+    branch_misses,
+    context_switches,
+    count
+};
+
+const std::size_t perf_counter_count = static_cast<std::size_t>(perf_counter_t::count);
+const std::size_t profile_stage_count = static_cast<std::size_t>(profile_stage_t::count);
+
+struct perf_sample_t
+{
+    std::uint64_t   values[perf_counter_count];
+    std::uint64_t   time_ns;
+};
+
+struct stage_stats_t
+{
+    std::uint64_t   calls;
+    std::uint64_t   totals[perf_counter_count];
+    std::uint64_t   total_time_ns;
+    std::uint64_t   max_time_ns;
+};
+
+// Hardware counters of the thread that called Open, grouped so one read()
+// returns all of them. Counters the kernel or CPU refuses are reported as
+// n/a, without any the profiler falls back to wall time only.
+class PerfProfiler
+{
+    int                                                 m_group_fd;
+    int                                                 m_fds[perf_counter_count];
+    // position of the counter in the group read, -1 - not available
+    int                                                 m_read_index[perf_counter_count];
+    std::size_t                                         m_opened_count;
+    stage_stats_t                                       m_stages[profile_stage_count];
+
+public:
+
+    class Scope
+    {
+        PerfProfiler*                                   m_profiler;
+        profile_stage_t                                 m_stage;
+        perf_sample_t                                   m_start;
+
+    public:
+        // profiler may be nullptr
+        Scope(PerfProfiler* profiler, profile_stage_t stage);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    PerfProfiler();
+    ~PerfProfiler();
+
+    PerfProfiler(const PerfProfiler&) = delete;
+    PerfProfiler& operator=(const PerfProfiler&) = delete;
+
+    bool Open();
+    void Close();
+    inline bool IsOpen() const { return m_group_fd >= 0; }
+    bool IsCounterAvailable(perf_counter_t counter) const;
+
+    void Sample(perf_sample_t& sample) const;
+    void Account(profile_stage_t stage, const perf_sample_t& start, const perf_sample_t& end);
+
+    const stage_stats_t& GetStageStats(profile_stage_t stage) const;
+    void Reset();
+    void Report(std::ostream& stream) const;
+};
+
+}
+
+#endif // PERF_PROFILER_H
@@ -0,0 +1,156 @@
+#include "resampler.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace audio_processing
+{
+
+// transition band starts at this part of the lower Nyquist frequency
+const double resampler_passband = 0.9;
+
+static std::uint32_t gcd(std::uint32_t a, std::uint32_t b)
+{
+    while (b != 0)
+    {
+        auto t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+Resampler::Resampler(std::uint32_t input_rate, std::uint32_t output_rate, std::uint32_t channels, std::uint32_t taps_per_phase)
+    : m_input_rate(input_rate)
+    , m_output_rate(output_rate)
+    , m_channels(std::max(channels, 1u))
+    , m_interpolation(1)
+    , m_decimation(1)
+    , m_taps(std::max(taps_per_phase, 2u))
+    , m_time(0)
+{
+    auto divisor = gcd(input_rate, output_rate);
+
+    if (divisor != 0)
+    {
+        m_interpolation = output_rate / divisor;
+        m_decimation = input_rate / divisor;
+    }
+
+    // the filter spans the same time at the lower rate when decimating
+    if (m_decimation > m_interpolation)
+    {
+        m_taps *= (m_decimation + m_interpolation - 1) / m_interpolation;
+    }
+
+    // prototype at input_rate * L, cutoff at the lower of the two Nyquists
+    const double pi = 3.14159265358979323846;
+    std::size_t length = static_cast<std::size_t>(m_taps) * m_interpolation;
+    double cutoff = resampler_passband * 0.5 / std::max(m_interpolation, m_decimation);
+    double center = static_cast<double>(length - 1) / 2.0;
+
+    std::vector<double> prototype(length);
+
+    for (std::size_t n = 0; n < length; n++)
+    {
+        double x = static_cast<double>(n) - center;
+        double sinc = x == 0.0
+                ? 2.0 * cutoff
+                : std::sin(2.0 * pi * cutoff * x) / (pi * x);
+
+        // Blackman
+        double window = 0.42
+                - 0.5 * std::cos(2.0 * pi * n / (length - 1))
+                + 0.08 * std::cos(4.0 * pi * n / (length - 1));
+
+        prototype[n] = sinc * window * m_interpolation;
+    }
+
+    // phase p, tap k: prototype[p + k * L] applied to input[i - k],
+    // stored reversed for a forward dot product over the buffer
+    m_coefficients.resize(length);
+
+    for (std::uint32_t p = 0; p < m_interpolation; p++)
+    {
+        for (std::uint32_t k = 0; k < m_taps; k++)
+        {
+            m_coefficients[p * m_taps + (m_taps - 1 - k)] = static_cast<float>(prototype[p + k * m_interpolation]);
+        }
+    }
+
+    m_channel_buffers.resize(m_channels);
+
+    Reset();
+}
+
+std::size_t Resampler::GetMaxOutputFrames(std::size_t input_frames) const
+{
+    return (input_frames * m_interpolation) / m_decimation + 1;
+}
+
+std::size_t Resampler::Process(const float *input, std::size_t input_frames, float *output)
+{
+    std::size_t history = m_taps - 1;
+
+    for (std::uint32_t c = 0; c < m_channels; c++)
+    {
+        auto& buffer = m_channel_buffers[c];
+
+        buffer.resize(history + input_frames);
+
+        for (std::size_t i = 0; i < input_frames; i++)
+        {
+            buffer[history + i] = input[i * m_channels + c];
+        }
+    }
+
+    std::size_t output_frames = 0;
+    std::uint64_t end_time = static_cast<std::uint64_t>(input_frames) * m_interpolation;
+
+    while (m_time < end_time)
+    {
+        auto index = static_cast<std::size_t>(m_time / m_interpolation);
+        auto phase = static_cast<std::size_t>(m_time % m_interpolation);
+        auto coefficients = &m_coefficients[phase * m_taps];
+
+        for (std::uint32_t c = 0; c < m_channels; c++)
+        {
+            // buffer[index + history] is input[index]
+            auto samples = &m_channel_buffers[c][index];
+            float sum = 0.0f;
+
+            for (std::uint32_t k = 0; k < m_taps; k++)
+            {
+                sum += coefficients[k] * samples[k];
+            }
+
+            output[output_frames * m_channels + c] = sum;
+        }
+
+        output_frames++;
+        m_time += m_decimation;
+    }
+
+    m_time -= end_time;
+
+    for (auto& buffer : m_channel_buffers)
+    {
+        std::copy(buffer.end() - history, buffer.end(), buffer.begin());
+        buffer.resize(history);
+    }
+
+    return output_frames;
+}
+
+void Resampler::Reset()
+{
+    m_time = 0;
+
+    for (auto& buffer : m_channel_buffers)
+    {
+        buffer.assign(m_taps - 1, 0.0f);
+    }
+}
+
+}
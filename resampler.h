@@ -0,0 +1,50 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace audio_processing
+{
+
+// Rational polyphase resampler of interleaved float frames: the rates are
+// reduced to L/M and every output sample is one phase of a windowed sinc
+// low-pass, taps_per_phase samples of the lower rate long. State is kept
+// between calls, so 10 ms frames of rates that are multiples of 100 Hz give
+// exactly output_rate / 100 frames per call. The delay is about half the
+// filter.
+class Resampler
+{
+    std::uint32_t                                       m_input_rate;
+    std::uint32_t                                       m_output_rate;
+    std::uint32_t                                       m_channels;
+    std::uint32_t                                       m_interpolation;    // L
+    std::uint32_t                                       m_decimation;       // M
+    std::uint32_t                                       m_taps;
+
+    // per phase, taps in input order
+    std::vector<float>                                  m_coefficients;
+    // per channel: taps - 1 samples of history, then the input
+    std::vector<std::vector<float>>                     m_channel_buffers;
+    std::uint64_t                                       m_time;             // next output, in L steps of the input
+
+public:
+    Resampler(std::uint32_t input_rate, std::uint32_t output_rate, std::uint32_t channels = 1, std::uint32_t taps_per_phase = 32);
+
+    // output frames for input_frames at most
+    std::size_t GetMaxOutputFrames(std::size_t input_frames) const;
+
+    // returns the output frames written
+    std::size_t Process(const float* input, std::size_t input_frames, float* output);
+
+    void Reset();
+
+    inline std::uint32_t GetInputRate() const { return m_input_rate; }
+    inline std::uint32_t GetOutputRate() const { return m_output_rate; }
+    inline std::uint32_t GetChannels() const { return m_channels; }
+};
+
+}
+
+#endif // RESAMPLER_H
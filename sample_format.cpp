@@ -0,0 +1,207 @@
+#include "sample_format.h"
+
+#include <limits>
+#include <cstring>
+
+namespace audio_devices
+{
+
+const char* sample_format_name(sample_format_t sample_format)
+{
+    switch(sample_format)
+    {
+        case sample_format_t::u8:
+            return "U8";
+        case sample_format_t::s16_le:
+            return "S16_LE";
+        case sample_format_t::s24_3le:
+            return "S24_3LE";
+        case sample_format_t::s24_le:
+            return "S24_LE";
+        case sample_format_t::s32_le:
+            return "S32_LE";
+        case sample_format_t::float_le:
+            return "FLOAT_LE";
+        default:;
+    }
+
+    return "UNKNOWN";
+}
+
+namespace audio_utils
+{
+
+const std::int32_t s24_max = 0x7fffff;
+
+template<typename Tval>
+static inline Tval saturate(float value, float scale)
+{
+    auto scaled = value * scale;
+
+    if (scaled >= static_cast<float>(std::numeric_limits<Tval>::max()))
+    {
+        return std::numeric_limits<Tval>::max();
+    }
+
+    if (scaled <= static_cast<float>(std::numeric_limits<Tval>::min()))
+    {
+        return std::numeric_limits<Tval>::min();
+    }
+
+    return static_cast<Tval>(scaled);
+}
+
+static inline std::int32_t saturate_s24(float value)
+{
+    auto scaled = value * static_cast<float>(s24_max);
+
+    if (scaled >= static_cast<float>(s24_max))
+    {
+        return s24_max;
+    }
+
+    if (scaled <= static_cast<float>(-s24_max - 1))
+    {
+        return -s24_max - 1;
+    }
+
+    return static_cast<std::int32_t>(scaled);
+}
+
+template<typename Tval>
+static void signed_to_float(const void* pcm_data, std::size_t sample_count, float* float_data)
+{
+    auto pcm = static_cast<const Tval*>(pcm_data);
+    const float scale = 1.0f / static_cast<float>(std::numeric_limits<Tval>::max());
+
+    for (std::size_t i = 0; i < sample_count; i++)
+    {
+        float_data[i] = static_cast<float>(pcm[i]) * scale;
+    }
+}
+
+template<typename Tval>
+static void float_to_signed(const float* float_data, std::size_t sample_count, void* pcm_data)
+{
+    auto pcm = static_cast<Tval*>(pcm_data);
+    const float scale = static_cast<float>(std::numeric_limits<Tval>::max());
+
+    for (std::size_t i = 0; i < sample_count; i++)
+    {
+        pcm[i] = saturate<Tval>(float_data[i], scale);
+    }
+}
+
+void pcm_to_float(const void* pcm_data, std::size_t sample_count, float* float_data, sample_format_t sample_format)
+{
+    const float s24_scale = 1.0f / static_cast<float>(s24_max);
+
+    switch(sample_format)
+    {
+        case sample_format_t::u8:
+        {
+            auto pcm = static_cast<const std::uint8_t*>(pcm_data);
+
+            for (std::size_t i = 0; i < sample_count; i++)
+            {
+                float_data[i] = static_cast<float>(static_cast<std::int32_t>(pcm[i]) - 128) / 127.0f;
+            }
+        }
+        break;
+        case sample_format_t::s16_le:
+            signed_to_float<std::int16_t>(pcm_data, sample_count, float_data);
+        break;
+        case sample_format_t::s24_3le:
+        {
+            auto pcm = static_cast<const std::uint8_t*>(pcm_data);
+
+            for (std::size_t i = 0; i < sample_count; i++, pcm += 3)
+            {
+                // to the top of 32 bit word, arithmetic shift back extends the sign
+                auto value = static_cast<std::int32_t>(static_cast<std::uint32_t>(pcm[0]) << 8
+                                                       | static_cast<std::uint32_t>(pcm[1]) << 16
+                                                       | static_cast<std::uint32_t>(pcm[2]) << 24) >> 8;
+
+                float_data[i] = static_cast<float>(value) * s24_scale;
+            }
+        }
+        break;
+        case sample_format_t::s24_le:
+        {
+            auto pcm = static_cast<const std::uint32_t*>(pcm_data);
+
+            for (std::size_t i = 0; i < sample_count; i++)
+            {
+                // the top byte is padding
+                auto value = static_cast<std::int32_t>(pcm[i] << 8) >> 8;
+
+                float_data[i] = static_cast<float>(value) * s24_scale;
+            }
+        }
+        break;
+        case sample_format_t::s32_le:
+            signed_to_float<std::int32_t>(pcm_data, sample_count, float_data);
+        break;
+        case sample_format_t::float_le:
+            std::memcpy(float_data, pcm_data, sample_count * sizeof(float));
+        break;
+        default:
+            throw("Error sample format parameter");
+    }
+}
+
+void float_to_pcm(const float* float_data, std::size_t sample_count, void* pcm_data, sample_format_t sample_format)
+{
+    switch(sample_format)
+    {
+        case sample_format_t::u8:
+        {
+            auto pcm = static_cast<std::uint8_t*>(pcm_data);
+
+            for (std::size_t i = 0; i < sample_count; i++)
+            {
+                pcm[i] = static_cast<std::uint8_t>(saturate<std::int8_t>(float_data[i], 127.0f) + 128);
+            }
+        }
+        break;
+        case sample_format_t::s16_le:
+            float_to_signed<std::int16_t>(float_data, sample_count, pcm_data);
+        break;
+        case sample_format_t::s24_3le:
+        {
+            auto pcm = static_cast<std::uint8_t*>(pcm_data);
+
+            for (std::size_t i = 0; i < sample_count; i++, pcm += 3)
+            {
+                auto value = static_cast<std::uint32_t>(saturate_s24(float_data[i]));
+
+                pcm[0] = static_cast<std::uint8_t>(value);
+                pcm[1] = static_cast<std::uint8_t>(value >> 8);
+                pcm[2] = static_cast<std::uint8_t>(value >> 16);
+            }
+        }
+        break;
+        case sample_format_t::s24_le:
+        {
+            auto pcm = static_cast<std::int32_t*>(pcm_data);
+
+            for (std::size_t i = 0; i < sample_count; i++)
+            {
+                pcm[i] = saturate_s24(float_data[i]);
+            }
+        }
+        break;
+        case sample_format_t::s32_le:
+            float_to_signed<std::int32_t>(float_data, sample_count, pcm_data);
+        break;
+        case sample_format_t::float_le:
+            std::memcpy(pcm_data, float_data, sample_count * sizeof(float));
+        break;
+        default:
+            throw("Error sample format parameter");
+    }
+}
+
+}
+
+}
@@ -0,0 +1,73 @@
+#ifndef SAMPLE_FORMAT_H
+#define SAMPLE_FORMAT_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace audio_devices
+{
+
+enum class sample_format_t
+{
+    unknown,
+    u8,
+    s16_le,
+    s24_3le,    // packed 3 bytes
+    s24_le,     // low 3 bytes of 32 bit word
+    s32_le,
+    float_le
+};
+
+// format implied by bit_per_sample alone
+inline sample_format_t default_sample_format(std::uint32_t bit_per_sample)
+{
+    switch(bit_per_sample)
+    {
+        case 8:
+            return sample_format_t::u8;
+        case 16:
+            return sample_format_t::s16_le;
+        case 24:
+            return sample_format_t::s24_3le;
+        case 32:
+            return sample_format_t::s32_le;
+    }
+
+    return sample_format_t::unknown;
+}
+
+// container size
+inline std::uint32_t sample_format_bits(sample_format_t sample_format)
+{
+    switch(sample_format)
+    {
+        case sample_format_t::u8:
+            return 8;
+        case sample_format_t::s16_le:
+            return 16;
+        case sample_format_t::s24_3le:
+            return 24;
+        case sample_format_t::s24_le:
+        case sample_format_t::s32_le:
+        case sample_format_t::float_le:
+            return 32;
+        default:;
+    }
+
+    return 0;
+}
+
+const char* sample_format_name(sample_format_t sample_format);
+
+namespace audio_utils
+{
+
+// float samples are normalized to [-1..1], pcm output is saturated
+void pcm_to_float(const void* pcm_data, std::size_t sample_count, float* float_data, sample_format_t sample_format);
+void float_to_pcm(const float* float_data, std::size_t sample_count, void* pcm_data, sample_format_t sample_format);
+
+}
+
+}
+
+#endif // SAMPLE_FORMAT_H
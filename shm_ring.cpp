@@ -0,0 +1,398 @@
+#include "shm_ring.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <new>
+#include <algorithm>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error "shm ring requires lock-free 64-bit atomics"
+#endif
+
+namespace audio_ipc
+{
+
+const std::size_t cache_line_size = 64;
+
+static inline std::size_t align_up(std::size_t size, std::size_t align)
+{
+    return (size + align - 1) & ~(align - 1);
+}
+
+static inline std::string shm_name(const std::string& name)
+{
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+static inline std::size_t header_size()
+{
+    return align_up(sizeof(shm_ring_header_t), cache_line_size);
+}
+
+//------------------------------------------------------------------------------
+
+ShmRingWriter::ShmRingWriter()
+    : m_memory(nullptr)
+    , m_memory_size(0)
+    , m_header(nullptr)
+    , m_write_seq(0)
+{
+
+}
+
+ShmRingWriter::~ShmRingWriter()
+{
+    Close();
+}
+
+bool ShmRingWriter::Create(const std::string &name, const shm_ring_format_t &format, std::uint32_t slot_count)
+{
+    if (IsOpen())
+    {
+        Close();
+    }
+
+    if (format.frame_size == 0 || slot_count < 2)
+    {
+        LOG(warning) << "Can't create shm ring [" << name << "]: bad format" LOG_END;
+        return false;
+    }
+
+    auto slot_stride = align_up(sizeof(shm_slot_header_t) + format.frame_size, cache_line_size);
+    auto memory_size = header_size() + slot_stride * slot_count;
+
+    m_name = shm_name(name);
+
+    auto fd = shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0644);
+
+    if (fd < 0)
+    {
+        LOG(warning) << "Can't create shm ring [" << m_name << "], errno = " << errno LOG_END;
+        return false;
+    }
+
+    void* memory = MAP_FAILED;
+
+    if (ftruncate(fd, memory_size) == 0)
+    {
+        memory = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);
+
+    if (memory == MAP_FAILED)
+    {
+        LOG(warning) << "Can't map shm ring [" << m_name << "], errno = " << errno LOG_END;
+        shm_unlink(m_name.c_str());
+        return false;
+    }
+
+    std::memset(memory, 0, memory_size);
+
+    m_memory = memory;
+    m_memory_size = memory_size;
+    m_header = new (memory) shm_ring_header_t();
+
+    m_header->version = shm_ring_version;
+    m_header->sample_rate = format.sample_rate;
+    m_header->bit_per_sample = format.bit_per_sample;
+    m_header->channels = format.channels;
+    m_header->frame_size = format.frame_size;
+    m_header->slot_count = slot_count;
+    m_header->slot_stride = slot_stride;
+    m_header->write_seq.store(0, std::memory_order_relaxed);
+
+    for (std::uint32_t i = 0; i < slot_count; i++)
+    {
+        new (static_cast<std::uint8_t*>(memory) + header_size() + i * slot_stride) shm_slot_header_t();
+    }
+
+    m_write_seq = 0;
+
+    // readers check magic the last
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = shm_ring_magic;
+
+    LOG(info) << "Shm ring [" << m_name << "] created, " << slot_count << " x " << format.frame_size << " bytes" LOG_END;
+
+    return true;
+}
+
+bool ShmRingWriter::Close()
+{
+    bool result = false;
+
+    if (m_memory != nullptr)
+    {
+        munmap(m_memory, m_memory_size);
+        result = shm_unlink(m_name.c_str()) == 0;
+
+        m_memory = nullptr;
+        m_header = nullptr;
+
+        LOG(info) << "Shm ring [" << m_name << "] closed" LOG_END;
+    }
+
+    return result;
+}
+
+bool ShmRingWriter::Publish(const void *frame_data, std::size_t size, std::uint64_t timestamp_ns)
+{
+    if (!IsOpen() || size > m_header->frame_size)
+    {
+        return false;
+    }
+
+    if (timestamp_ns == 0)
+    {
+        timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    auto seq = m_write_seq;
+    auto slot_ptr = static_cast<std::uint8_t*>(m_memory) + header_size() + (seq % m_header->slot_count) * m_header->slot_stride;
+    auto slot = reinterpret_cast<shm_slot_header_t*>(slot_ptr);
+
+    slot->state.store(2 * seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::memcpy(slot_ptr + sizeof(shm_slot_header_t), frame_data, size);
+    slot->size = static_cast<std::uint32_t>(size);
+    slot->timestamp_ns = timestamp_ns;
+
+    slot->state.store(2 * seq + 2, std::memory_order_release);
+
+    m_write_seq = seq + 1;
+    m_header->write_seq.store(m_write_seq, std::memory_order_release);
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool shm_frame_view_t::is_valid() const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return slot != nullptr && slot->state.load(std::memory_order_relaxed) == 2 * seq + 2;
+}
+
+ShmRingReader::ShmRingReader()
+    : m_memory(nullptr)
+    , m_memory_size(0)
+    , m_header(nullptr)
+    , m_read_seq(0)
+    , m_lost_frames(0)
+{
+
+}
+
+ShmRingReader::~ShmRingReader()
+{
+    Close();
+}
+
+bool ShmRingReader::Open(const std::string &name, bool start_from_oldest)
+{
+    if (IsOpen())
+    {
+        Close();
+    }
+
+    auto fd = shm_open(shm_name(name).c_str(), O_RDONLY, 0);
+
+    if (fd < 0)
+    {
+        LOG(warning) << "Can't open shm ring [" << name << "], errno = " << errno LOG_END;
+        return false;
+    }
+
+    struct stat st = {};
+    void* memory = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= header_size())
+    {
+        memory = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);
+
+    if (memory == MAP_FAILED)
+    {
+        LOG(warning) << "Can't map shm ring [" << name << "], errno = " << errno LOG_END;
+        return false;
+    }
+
+    auto header = static_cast<const shm_ring_header_t*>(memory);
+
+    if (header->magic != shm_ring_magic
+            || header->version != shm_ring_version
+            || header_size() + static_cast<std::size_t>(header->slot_stride) * header->slot_count > static_cast<std::size_t>(st.st_size))
+    {
+        LOG(warning) << "Shm ring [" << name << "] has bad header" LOG_END;
+        munmap(memory, st.st_size);
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    m_memory = memory;
+    m_memory_size = st.st_size;
+    m_header = header;
+    m_lost_frames = 0;
+
+    auto write_seq = m_header->write_seq.load(std::memory_order_acquire);
+
+    auto window = static_cast<std::uint64_t>(m_header->slot_count - 1);
+
+    m_read_seq = !start_from_oldest
+            ? write_seq
+            : (write_seq > window ? write_seq - window : 0);
+
+    return true;
+}
+
+bool ShmRingReader::Close()
+{
+    bool result = false;
+
+    if (m_memory != nullptr)
+    {
+        result = munmap(m_memory, m_memory_size) == 0;
+
+        m_memory = nullptr;
+        m_header = nullptr;
+    }
+
+    return result;
+}
+
+shm_ring_format_t ShmRingReader::GetFormat() const
+{
+    shm_ring_format_t format = {};
+
+    if (IsOpen())
+    {
+        format.sample_rate = m_header->sample_rate;
+        format.bit_per_sample = m_header->bit_per_sample;
+        format.channels = m_header->channels;
+        format.frame_size = m_header->frame_size;
+    }
+
+    return format;
+}
+
+std::int32_t ShmRingReader::Read(void *frame_data, std::size_t size, std::uint64_t *seq)
+{
+    if (!IsOpen())
+    {
+        return -EBADF;
+    }
+
+    std::uint64_t read_seq = 0;
+
+    while (nextSeq(read_seq))
+    {
+        auto slot = getSlot(read_seq);
+        auto state = slot->state.load(std::memory_order_acquire);
+
+        m_read_seq++;
+
+        if (state == 2 * read_seq + 2)
+        {
+            auto frame_size = std::min<std::size_t>(slot->size, size);
+
+            std::memcpy(frame_data, reinterpret_cast<const std::uint8_t*>(slot) + sizeof(shm_slot_header_t), frame_size);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (slot->state.load(std::memory_order_relaxed) == state)
+            {
+                if (seq != nullptr)
+                {
+                    *seq = read_seq;
+                }
+
+                return static_cast<std::int32_t>(frame_size);
+            }
+        }
+
+        // overwritten while reading
+        m_lost_frames++;
+    }
+
+    return 0;
+}
+
+bool ShmRingReader::Peek(shm_frame_view_t &frame_view)
+{
+    std::uint64_t read_seq = 0;
+
+    while (IsOpen() && nextSeq(read_seq))
+    {
+        auto slot = getSlot(read_seq);
+
+        m_read_seq++;
+
+        if (slot->state.load(std::memory_order_acquire) == 2 * read_seq + 2)
+        {
+            frame_view.data = reinterpret_cast<const std::uint8_t*>(slot) + sizeof(shm_slot_header_t);
+            frame_view.size = slot->size;
+            frame_view.seq = read_seq;
+            frame_view.timestamp_ns = slot->timestamp_ns;
+            frame_view.slot = slot;
+
+            return true;
+        }
+
+        m_lost_frames++;
+    }
+
+    return false;
+}
+
+const shm_slot_header_t *ShmRingReader::getSlot(std::uint64_t seq) const
+{
+    auto slot_ptr = static_cast<const std::uint8_t*>(m_memory) + header_size() + (seq % m_header->slot_count) * m_header->slot_stride;
+
+    return reinterpret_cast<const shm_slot_header_t*>(slot_ptr);
+}
+
+bool ShmRingReader::nextSeq(std::uint64_t &seq)
+{
+    auto write_seq = m_header->write_seq.load(std::memory_order_acquire);
+
+    if (m_read_seq >= write_seq)
+    {
+        return false;
+    }
+
+    // the oldest slot may be already rewritten by the writer
+    auto window = static_cast<std::uint64_t>(m_header->slot_count - 1);
+
+    if (write_seq - m_read_seq > window)
+    {
+        m_lost_frames += write_seq - window - m_read_seq;
+        m_read_seq = write_seq - window;
+    }
+
+    seq = m_read_seq;
+
+    return true;
+}
+
+}
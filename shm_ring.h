@@ -0,0 +1,130 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace audio_ipc
+{
+
+// Single writer / multi reader ring of fixed-size frames in POSIX shared memory.
+// Every slot is guarded by its own sequence (seqlock), so the writer never waits
+// for readers: a slow reader loses the overwritten frames and detects it.
+
+const std::uint32_t shm_ring_magic = 0x41454352; // "AECR"
+const std::uint32_t shm_ring_version = 1;
+
+struct shm_ring_header_t
+{
+    std::uint32_t                   magic;
+    std::uint32_t                   version;
+    std::uint32_t                   sample_rate;
+    std::uint32_t                   bit_per_sample;
+    std::uint32_t                   channels;
+    std::uint32_t                   frame_size;
+    std::uint32_t                   slot_count;
+    std::uint32_t                   slot_stride;
+
+    // count of published frames
+    alignas(64) std::atomic<std::uint64_t>  write_seq;
+};
+
+struct shm_slot_header_t
+{
+    // 2 * seq + 1 while frame seq is being written, 2 * seq + 2 when done
+    std::atomic<std::uint64_t>      state;
+    std::uint64_t                   timestamp_ns;
+    std::uint32_t                   size;
+};
+
+struct shm_ring_format_t
+{
+    std::uint32_t   sample_rate;
+    std::uint32_t   bit_per_sample;
+    std::uint32_t   channels;
+    std::uint32_t   frame_size;
+};
+
+class ShmRingWriter
+{
+    std::string                     m_name;
+    void*                           m_memory;
+    std::size_t                     m_memory_size;
+    shm_ring_header_t*              m_header;
+    std::uint64_t                   m_write_seq;
+
+public:
+    ShmRingWriter();
+    ~ShmRingWriter();
+
+    bool Create(const std::string& name, const shm_ring_format_t& format, std::uint32_t slot_count = 64);
+    bool Close();
+
+    inline bool IsOpen() const { return m_header != nullptr; }
+
+    // wait-free, no syscalls: safe to call from the audio thread
+    bool Publish(const void* frame_data, std::size_t size, std::uint64_t timestamp_ns = 0);
+
+    inline std::uint64_t GetWriteSeq() const { return m_write_seq; }
+};
+
+struct shm_frame_view_t
+{
+    const void*                     data;
+    std::uint32_t                   size;
+    std::uint64_t                   seq;
+    std::uint64_t                   timestamp_ns;
+    const shm_slot_header_t*        slot;
+
+    shm_frame_view_t()
+        : data(nullptr)
+        , size(0)
+        , seq(0)
+        , timestamp_ns(0)
+        , slot(nullptr)
+    {}
+
+    // frame memory was not reused by the writer since Peek
+    bool is_valid() const;
+};
+
+class ShmRingReader
+{
+    void*                           m_memory;
+    std::size_t                     m_memory_size;
+    const shm_ring_header_t*        m_header;
+    std::uint64_t                   m_read_seq;
+    std::uint64_t                   m_lost_frames;
+
+public:
+    ShmRingReader();
+    ~ShmRingReader();
+
+    // start_from_oldest: read frames still in ring, otherwise only new frames
+    bool Open(const std::string& name, bool start_from_oldest = false);
+    bool Close();
+
+    inline bool IsOpen() const { return m_header != nullptr; }
+
+    shm_ring_format_t GetFormat() const;
+
+    // copy next frame, returns frame size, 0 if no new frame, negative on error
+    std::int32_t Read(void* frame_data, std::size_t size, std::uint64_t* seq = nullptr);
+
+    // zero copy access to the next frame, the view must be checked with is_valid()
+    // after the data was consumed
+    bool Peek(shm_frame_view_t& frame_view);
+
+    inline std::uint64_t GetLostFrames() const { return m_lost_frames; }
+    inline std::uint64_t GetReadSeq() const { return m_read_seq; }
+
+private:
+    const shm_slot_header_t* getSlot(std::uint64_t seq) const;
+    bool nextSeq(std::uint64_t& seq);
+};
+
+}
+
+#endif // SHM_RING_H
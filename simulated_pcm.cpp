@@ -0,0 +1,625 @@
+#include "simulated_pcm.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+namespace audio_devices
+{
+
+const std::uint64_t ns_per_ms = 1000000;
+const std::uint64_t ns_per_second = 1000000000;
+const std::uint64_t never_ns = std::numeric_limits<std::uint64_t>::max();
+
+// capture signal
+const double two_pi = 6.283185307179586;
+const double sine_frequency = 440.0;
+const float sine_amplitude = 0.25f;
+const std::uint32_t sine_block_frames = 256;
+
+// period when audio params leave it to the device
+const std::uint32_t default_period_frames = 1024;
+
+VirtualClock::VirtualClock()
+    : m_now_ns(0)
+{
+
+}
+
+void VirtualClock::Advance(std::uint64_t duration_ns)
+{
+    m_now_ns += duration_ns;
+}
+
+void VirtualClock::AdvanceTo(std::uint64_t time_ns)
+{
+    m_now_ns = std::max(m_now_ns, time_ns);
+}
+
+SimulatedPcm::SimulatedPcm(const std::shared_ptr<VirtualClock> &clock, const sim_pcm_config_t &config)
+    : m_clock(clock)
+    , m_config(config)
+    , m_random(config.seed)
+    , m_state(state_t::closed)
+    , m_suspended_state(state_t::closed)
+    , m_recorder(false)
+    , m_nonblock(false)
+    , m_hw_ptr(0)
+    , m_appl_ptr(0)
+    , m_start_hw_ptr(0)
+    , m_start_ns(0)
+    , m_period_ns(0)
+    , m_wakeup_index(0)
+    , m_wakeup_ns(never_ns)
+    , m_jitter_us(config.jitter_us)
+    , m_stall_until_ns(0)
+    , m_suspend_until_ns(0)
+    , m_partial_count(0)
+    , m_fault_ns(0)
+    , m_phase(0.0)
+{
+    std::memset(&m_stats, 0, sizeof(m_stats));
+}
+
+SimulatedPcm::~SimulatedPcm()
+{
+    Close();
+}
+
+void SimulatedPcm::AddFault(const sim_fault_event_t &fault_event)
+{
+    m_faults.push_back(fault_event);
+    m_fault_due_ns.push_back(fault_event.time_ms * ns_per_ms);
+}
+
+void SimulatedPcm::ClearFaults()
+{
+    m_faults.clear();
+    m_fault_due_ns.clear();
+}
+
+std::int32_t SimulatedPcm::Open(const std::string &, const audio_params_t &audio_params, bool manual_start, pcm_config_t &pcm_config)
+{
+    if (!audio_params.is_init() || audio_params.audio_format.format() == sample_format_t::unknown)
+    {
+        return -EINVAL;
+    }
+
+    m_recorder = audio_params.recorder;
+    m_nonblock = audio_params.nonblock_mode;
+    m_format = audio_params.audio_format;
+
+    // same sw params as AlsaDevice sets on the hardware
+    pcm_config_t config;
+
+    config.sample_rate = m_format.sample_rate;
+    config.period_frames = audio_params.buffer_size != 0 ? audio_params.buffer_size : default_period_frames;
+    config.periods = std::max(2u, audio_params.period_count);
+    config.buffer_frames = config.period_frames * config.periods;
+    config.stop_threshold = config.buffer_frames;
+    config.avail_min = config.period_frames;
+
+    if (manual_start)
+    {
+        config.start_threshold = std::numeric_limits<std::uint32_t>::max();
+    }
+    else if (audio_params.latency_profile == latency_profile_t::low_latency)
+    {
+        config.start_threshold = m_recorder ? 1 : config.period_frames;
+    }
+    else
+    {
+        config.start_threshold = 1;
+    }
+
+    config.timestamps = audio_params.latency_profile == latency_profile_t::low_latency;
+
+    m_pcm_config = config;
+    pcm_config = config;
+
+    m_period_ns = (static_cast<std::uint64_t>(config.period_frames) * ns_per_second) / config.sample_rate;
+    m_sine_buffer.resize(sine_block_frames * m_format.channels);
+    m_phase = 0.0;
+
+    m_state = state_t::closed;
+
+    return Prepare();
+}
+
+void SimulatedPcm::Close()
+{
+    m_state = state_t::closed;
+}
+
+bool SimulatedPcm::IsOpen() const
+{
+    return m_state != state_t::closed;
+}
+
+std::int32_t SimulatedPcm::ReadFrames(void *data, std::uint32_t frames)
+{
+    return m_recorder
+            ? transfer(data, nullptr, frames)
+            : -EBADFD;
+}
+
+std::int32_t SimulatedPcm::WriteFrames(const void *data, std::uint32_t frames)
+{
+    return !m_recorder
+            ? transfer(nullptr, data, frames)
+            : -EBADFD;
+}
+
+std::int32_t SimulatedPcm::Prepare()
+{
+    if (m_state == state_t::suspended && m_clock->Now() < m_suspend_until_ns)
+    {
+        return -EBUSY;
+    }
+
+    // Open prepares a closed stream
+    if (m_period_ns == 0)
+    {
+        return -EBADFD;
+    }
+
+    m_state = state_t::prepared;
+    m_hw_ptr = 0;
+    m_appl_ptr = 0;
+    m_wakeup_ns = never_ns;
+
+    return 0;
+}
+
+std::int32_t SimulatedPcm::Resume()
+{
+    if (m_state != state_t::suspended)
+    {
+        return -EBADFD;
+    }
+
+    if (!m_config.resume_supported)
+    {
+        return -ENOSYS;
+    }
+
+    if (m_clock->Now() < m_suspend_until_ns + m_config.resume_delay_ms * ns_per_ms)
+    {
+        return -EAGAIN;
+    }
+
+    if (m_suspended_state == state_t::running)
+    {
+        // the pointer was frozen, the stream goes on from it
+        startStream();
+    }
+    else
+    {
+        m_state = m_suspended_state;
+    }
+
+    return 0;
+}
+
+std::int32_t SimulatedPcm::Wait(std::int32_t timeout_ms)
+{
+    auto deadline_ns = timeout_ms < 0
+            ? never_ns
+            : m_clock->Now() + static_cast<std::uint64_t>(timeout_ms) * ns_per_ms;
+
+    return waitAvail(m_pcm_config.avail_min, deadline_ns);
+}
+
+std::int32_t SimulatedPcm::Start()
+{
+    update();
+
+    if (m_state != state_t::prepared)
+    {
+        return -EBADFD;
+    }
+
+    startStream();
+
+    // empty playback underruns right away
+    update();
+
+    return 0;
+}
+
+std::int32_t SimulatedPcm::Delay(std::int32_t &frames) const
+{
+    auto err = stateError();
+
+    if (err < 0)
+    {
+        return err;
+    }
+
+    auto hw_ptr = m_state == state_t::running
+            ? hwPosition()
+            : m_hw_ptr;
+
+    if (m_recorder)
+    {
+        if (m_state == state_t::running && hw_ptr - m_appl_ptr >= m_pcm_config.stop_threshold)
+        {
+            return -EPIPE;
+        }
+
+        frames = static_cast<std::int32_t>(hw_ptr - m_appl_ptr);
+    }
+    else
+    {
+        if (m_state == state_t::running && hw_ptr >= m_appl_ptr)
+        {
+            return -EPIPE;
+        }
+
+        frames = static_cast<std::int32_t>(m_appl_ptr - hw_ptr);
+    }
+
+    return 0;
+}
+
+void SimulatedPcm::update()
+{
+    if (m_state == state_t::running)
+    {
+        auto hw_ptr = hwPosition();
+
+        if (!m_recorder && hw_ptr >= m_appl_ptr)
+        {
+            // underrun when the last queued frame is played
+            m_hw_ptr = m_appl_ptr;
+            enterFault(state_t::xrun, frameTime(m_hw_ptr));
+        }
+        else if (m_recorder && hw_ptr - m_appl_ptr >= m_pcm_config.stop_threshold)
+        {
+            // overrun when the buffer is full
+            m_hw_ptr = m_appl_ptr + m_pcm_config.stop_threshold;
+            enterFault(state_t::xrun, frameTime(m_hw_ptr));
+        }
+        else
+        {
+            m_hw_ptr = hw_ptr;
+        }
+
+        if (m_wakeup_ns <= m_clock->Now())
+        {
+            // missed wakeups are not queued
+            m_wakeup_index = (m_clock->Now() - m_start_ns) / m_period_ns;
+            scheduleWakeup();
+        }
+    }
+
+    applyFaults();
+}
+
+void SimulatedPcm::applyFaults()
+{
+    auto now = m_clock->Now();
+
+    for (std::size_t i = 0; i < m_faults.size(); i++)
+    {
+        while (m_fault_due_ns[i] <= now)
+        {
+            const auto& fault_event = m_faults[i];
+            auto due_ns = m_fault_due_ns[i];
+
+            switch(fault_event.fault)
+            {
+                case sim_fault_t::xrun:
+                    if (m_state == state_t::running)
+                    {
+                        enterFault(state_t::xrun, due_ns);
+                    }
+                break;
+                case sim_fault_t::suspend:
+                    if (m_state != state_t::closed && m_state != state_t::suspended)
+                    {
+                        m_suspended_state = m_state;
+                        m_suspend_until_ns = due_ns + fault_event.value * ns_per_ms;
+                        enterFault(state_t::suspended, due_ns);
+                    }
+                break;
+                case sim_fault_t::stall:
+                    m_stall_until_ns = std::max(m_stall_until_ns, due_ns + fault_event.value * ns_per_ms);
+                break;
+                case sim_fault_t::partial:
+                    m_partial_count += std::max(1u, fault_event.value);
+                break;
+                case sim_fault_t::jitter:
+                    m_jitter_us = fault_event.value;
+                break;
+            }
+
+            m_fault_due_ns[i] = fault_event.repeat_ms != 0
+                    ? due_ns + fault_event.repeat_ms * ns_per_ms
+                    : never_ns;
+        }
+    }
+}
+
+void SimulatedPcm::startStream()
+{
+    m_state = state_t::running;
+    m_start_ns = m_clock->Now();
+    m_start_hw_ptr = m_hw_ptr;
+    m_wakeup_index = 0;
+
+    scheduleWakeup();
+}
+
+void SimulatedPcm::enterFault(state_t state, std::uint64_t time_ns)
+{
+    m_state = state;
+
+    // recovery is measured from the first fault
+    if (m_fault_ns == 0)
+    {
+        m_fault_ns = std::max<std::uint64_t>(time_ns, 1);
+    }
+
+    if (state == state_t::xrun)
+    {
+        m_stats.xruns++;
+    }
+    else
+    {
+        m_stats.suspends++;
+    }
+}
+
+void SimulatedPcm::scheduleWakeup()
+{
+    m_wakeup_index++;
+
+    std::int64_t jitter_ns = 0;
+
+    if (m_jitter_us > 0)
+    {
+        std::uniform_int_distribution<std::int64_t> distribution(-static_cast<std::int64_t>(m_jitter_us), m_jitter_us);
+        jitter_ns = distribution(m_random) * 1000;
+    }
+
+    auto wakeup_ns = static_cast<std::int64_t>(m_start_ns + m_wakeup_index * m_period_ns) + jitter_ns;
+
+    m_wakeup_ns = static_cast<std::uint64_t>(std::max(wakeup_ns, static_cast<std::int64_t>(m_clock->Now()) + 1));
+}
+
+std::uint64_t SimulatedPcm::nextWakeup() const
+{
+    return std::max(m_wakeup_ns, m_stall_until_ns);
+}
+
+std::uint64_t SimulatedPcm::frameTime(std::uint64_t hw_ptr) const
+{
+    return m_start_ns + ((hw_ptr - m_start_hw_ptr) * ns_per_second) / m_pcm_config.sample_rate;
+}
+
+std::uint64_t SimulatedPcm::hwPosition() const
+{
+    return m_start_hw_ptr + ((m_clock->Now() - m_start_ns) * m_pcm_config.sample_rate) / ns_per_second;
+}
+
+std::uint64_t SimulatedPcm::nextFaultDue() const
+{
+    auto result = never_ns;
+
+    for (auto due_ns : m_fault_due_ns)
+    {
+        result = std::min(result, due_ns);
+    }
+
+    return result;
+}
+
+std::int32_t SimulatedPcm::waitAvail(std::uint32_t frames, std::uint64_t deadline_ns)
+{
+    while (true)
+    {
+        update();
+
+        auto err = stateError();
+
+        if (err < 0)
+        {
+            return err;
+        }
+
+        if (avail() >= frames)
+        {
+            return 1;
+        }
+
+        // a stopped stream changes only by faults
+        auto wakeup_ns = std::min(m_state == state_t::running ? nextWakeup() : never_ns, nextFaultDue());
+
+        if (wakeup_ns > deadline_ns)
+        {
+            if (deadline_ns == never_ns)
+            {
+                // blocking io on a stream that never starts
+                return -EIO;
+            }
+
+            m_clock->AdvanceTo(deadline_ns);
+            update();
+
+            return stateError() < 0
+                    ? stateError()
+                    : (avail() >= frames ? 1 : 0);
+        }
+
+        m_clock->AdvanceTo(wakeup_ns);
+    }
+}
+
+std::int32_t SimulatedPcm::stateError() const
+{
+    switch(m_state)
+    {
+        case state_t::closed:
+            return -EBADFD;
+        case state_t::xrun:
+            return -EPIPE;
+        case state_t::suspended:
+            return -ESTRPIPE;
+        default:;
+    }
+
+    return 0;
+}
+
+std::uint32_t SimulatedPcm::avail() const
+{
+    return static_cast<std::uint32_t>(m_recorder
+                                      ? m_hw_ptr - m_appl_ptr
+                                      : m_pcm_config.buffer_frames - (m_appl_ptr - m_hw_ptr));
+}
+
+std::int32_t SimulatedPcm::transfer(void *capture_data, const void *playback_data, std::uint32_t frames)
+{
+    update();
+
+    // capture starts on the read
+    if (m_recorder && m_state == state_t::prepared && frames >= m_pcm_config.start_threshold)
+    {
+        startStream();
+    }
+
+    auto err = stateError();
+
+    if (err < 0 || frames == 0)
+    {
+        return err;
+    }
+
+    auto limit = frames;
+
+    if (m_partial_count > 0 && frames > 1)
+    {
+        m_partial_count--;
+        limit = frames / 2;
+    }
+
+    auto frame_bytes = m_format.frames_octets();
+    std::uint32_t transferred = 0;
+
+    while (transferred < limit)
+    {
+        update();
+
+        err = stateError();
+
+        if (err < 0)
+        {
+            break;
+        }
+
+        auto count = std::min(avail(), limit - transferred);
+
+        if (count == 0)
+        {
+            if (m_nonblock)
+            {
+                break;
+            }
+
+            err = waitAvail(std::min(m_pcm_config.avail_min, limit - transferred), never_ns);
+
+            if (err < 0)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        if (capture_data != nullptr)
+        {
+            generate(static_cast<std::uint8_t*>(capture_data) + transferred * frame_bytes, count);
+        }
+
+        m_appl_ptr += count;
+        transferred += count;
+
+        if (!m_recorder && m_state == state_t::prepared
+                && m_appl_ptr - m_hw_ptr >= m_pcm_config.start_threshold)
+        {
+            startStream();
+        }
+    }
+
+    if (transferred == 0)
+    {
+        if (err < 0)
+        {
+            return err;
+        }
+
+        m_stats.eagain++;
+
+        return -EAGAIN;
+    }
+
+    if (transferred < frames)
+    {
+        m_stats.partial_transfers++;
+    }
+
+    completeTransfer(transferred);
+
+    return static_cast<std::int32_t>(transferred);
+}
+
+void SimulatedPcm::generate(void *data, std::uint32_t frames)
+{
+    auto output = static_cast<std::uint8_t*>(data);
+    auto frame_bytes = m_format.frames_octets();
+    auto step = two_pi * sine_frequency / m_format.sample_rate;
+
+    while (frames > 0)
+    {
+        auto count = std::min(frames, sine_block_frames);
+        std::size_t s = 0;
+
+        for (std::uint32_t f = 0; f < count; f++)
+        {
+            auto value = sine_amplitude * static_cast<float>(std::sin(m_phase));
+
+            for (std::uint32_t c = 0; c < m_format.channels; c++)
+            {
+                m_sine_buffer[s++] = value;
+            }
+
+            m_phase = std::fmod(m_phase + step, two_pi);
+        }
+
+        audio_utils::float_to_pcm(m_sine_buffer.data(), s, output, m_format.format());
+
+        output += count * frame_bytes;
+        frames -= count;
+    }
+}
+
+void SimulatedPcm::completeTransfer(std::uint32_t frames)
+{
+    m_stats.frames += frames;
+
+    if (m_fault_ns != 0)
+    {
+        auto recovery_ns = m_clock->Now() - std::min(m_fault_ns, m_clock->Now());
+
+        m_stats.recoveries++;
+        m_stats.recovery_time_total_ns += recovery_ns;
+        m_stats.recovery_time_max_ns = std::max(m_stats.recovery_time_max_ns, recovery_ns);
+
+        m_fault_ns = 0;
+    }
+}
+
+}
@@ -0,0 +1,171 @@
+#ifndef SIMULATED_PCM_H
+#define SIMULATED_PCM_H
+
+#include "pcm_backend.h"
+
+#include <memory>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+namespace audio_devices
+{
+
+// Time source of simulated streams, moves only when somebody advances it:
+// blocking transfers and waits of the streams, pacing sleeps of the caller
+class VirtualClock
+{
+    std::uint64_t                                       m_now_ns;
+
+public:
+    VirtualClock();
+
+    inline std::uint64_t Now() const { return m_now_ns; }
+    void Advance(std::uint64_t duration_ns);
+    // never goes back
+    void AdvanceTo(std::uint64_t time_ns);
+};
+
+enum class sim_fault_t
+{
+    xrun,       // immediate xrun of a running stream
+    suspend,    // system suspend for value ms
+    stall,      // period wakeups delayed by value ms, the hardware keeps running
+    partial,    // next value transfers return at most half of the frames
+    jitter      // period wakeup jitter becomes value us
+};
+
+struct sim_fault_event_t
+{
+    std::uint64_t   time_ms;        // virtual time
+    sim_fault_t     fault;
+    std::uint32_t   value;
+    std::uint64_t   repeat_ms;      // 0 - once
+};
+
+struct sim_pcm_config_t
+{
+    std::uint32_t   jitter_us;          // uniform +/- of the period wakeup
+    std::uint32_t   resume_delay_ms;    // -EAGAIN from Resume after the suspend ends
+    bool            resume_supported;   // false - Resume fails, recovery needs Prepare
+    std::uint32_t   seed;
+
+    sim_pcm_config_t(std::uint32_t jitter = 0, std::uint32_t resume_delay = 0, bool resume = true, std::uint32_t s = 1)
+        : jitter_us(jitter)
+        , resume_delay_ms(resume_delay)
+        , resume_supported(resume)
+        , seed(s)
+    {}
+};
+
+struct sim_pcm_stats_t
+{
+    std::uint64_t   frames;
+    std::uint32_t   xruns;
+    std::uint32_t   suspends;
+    std::uint32_t   partial_transfers;
+    std::uint32_t   eagain;
+    // fault to the first successful transfer after it
+    std::uint32_t   recoveries;
+    std::uint64_t   recovery_time_total_ns;
+    std::uint64_t   recovery_time_max_ns;
+};
+
+// PCM stream without hardware. The hardware pointer follows the virtual
+// clock at the sample rate, waiters wake up on period boundaries (plus
+// jitter), xrun rules are the ALSA ones with stop threshold = buffer size.
+// Capture produces a sine, playback data is dropped. Not thread safe, all
+// streams of one clock are driven from one thread.
+class SimulatedPcm : public PcmBackend
+{
+    enum class state_t
+    {
+        closed,
+        prepared,
+        running,
+        xrun,
+        suspended
+    };
+
+    std::shared_ptr<VirtualClock>                       m_clock;
+    sim_pcm_config_t                                    m_config;
+    std::minstd_rand                                    m_random;
+
+    state_t                                             m_state;
+    state_t                                             m_suspended_state;
+    bool                                                m_recorder;
+    bool                                                m_nonblock;
+    audio_format_t                                      m_format;
+    pcm_config_t                                        m_pcm_config;
+
+    // frames since prepare
+    std::uint64_t                                       m_hw_ptr;
+    std::uint64_t                                       m_appl_ptr;
+    std::uint64_t                                       m_start_hw_ptr;
+    std::uint64_t                                       m_start_ns;
+
+    std::uint64_t                                       m_period_ns;
+    std::uint64_t                                       m_wakeup_index;
+    std::uint64_t                                       m_wakeup_ns;
+    std::uint32_t                                       m_jitter_us;
+    std::uint64_t                                       m_stall_until_ns;
+    std::uint64_t                                       m_suspend_until_ns;
+    std::uint32_t                                       m_partial_count;
+
+    std::vector<sim_fault_event_t>                      m_faults;
+    std::vector<std::uint64_t>                          m_fault_due_ns;
+
+    // 0 - no fault pending recovery
+    std::uint64_t                                       m_fault_ns;
+    sim_pcm_stats_t                                     m_stats;
+
+    double                                              m_phase;
+    std::vector<float>                                  m_sine_buffer;
+
+public:
+    SimulatedPcm(const std::shared_ptr<VirtualClock>& clock, const sim_pcm_config_t& config = sim_pcm_config_t());
+    ~SimulatedPcm() override;
+
+    // due times are absolute virtual times
+    void AddFault(const sim_fault_event_t& fault_event);
+    void ClearFaults();
+
+    inline const sim_pcm_stats_t& GetStats() const { return m_stats; }
+    inline const std::shared_ptr<VirtualClock>& GetClock() const { return m_clock; }
+
+    std::int32_t Open(const std::string& device_name, const audio_params_t& audio_params, bool manual_start, pcm_config_t& pcm_config) override;
+    void Close() override;
+    bool IsOpen() const override;
+
+    std::int32_t ReadFrames(void* data, std::uint32_t frames) override;
+    std::int32_t WriteFrames(const void* data, std::uint32_t frames) override;
+
+    std::int32_t Prepare() override;
+    std::int32_t Resume() override;
+    std::int32_t Wait(std::int32_t timeout_ms) override;
+    std::int32_t Start() override;
+    std::int32_t Delay(std::int32_t& frames) const override;
+
+private:
+    void update();
+    void applyFaults();
+    void startStream();
+    void enterFault(state_t state, std::uint64_t time_ns);
+    void scheduleWakeup();
+    std::uint64_t nextWakeup() const;
+    std::uint64_t frameTime(std::uint64_t hw_ptr) const;
+
+    std::uint64_t hwPosition() const;
+    std::uint64_t nextFaultDue() const;
+    std::int32_t waitAvail(std::uint32_t frames, std::uint64_t deadline_ns);
+
+    std::int32_t stateError() const;
+    std::uint32_t avail() const;
+    std::int32_t transfer(void* capture_data, const void* playback_data, std::uint32_t frames);
+    void generate(void* data, std::uint32_t frames);
+    void completeTransfer(std::uint32_t frames);
+};
+
+}
+
+#endif // SIMULATED_PCM_H
@@ -0,0 +1,569 @@
+#include "stage_graph.h"
+#include "aec_controller.h"
+
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <iomanip>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_processing
+{
+
+static const std::size_t no_edge = std::numeric_limits<std::size_t>::max();
+
+FrameRef Stage::AcquireFrame(std::uint32_t output)
+{
+    return output < m_pools.size() && m_pools[output] != nullptr
+            ? m_pools[output]->Acquire()
+            : FrameRef();
+}
+
+std::uint32_t Stage::addInput(const port_format_t &format)
+{
+    m_inputs.push_back(format);
+    return m_inputs.size() - 1;
+}
+
+std::uint32_t Stage::addOutput(const port_format_t &format)
+{
+    m_outputs.push_back(format);
+    return m_outputs.size() - 1;
+}
+
+DeviceSourceStage::DeviceSourceStage(const std::string &name, audio_devices::AudioDevice &device, std::uint32_t duration_ms)
+    : Stage(name)
+    , m_device(device)
+{
+    addOutput(port_format_t(device.GetParams().audio_format, duration_ms));
+}
+
+bool DeviceSourceStage::Process(FrameRef *inputs, FrameRef *outputs)
+{
+    auto frame = AcquireFrame(0);
+
+    if (!frame)
+    {
+        return false;
+    }
+
+    auto result = m_device.Read(frame.Data(), frame.Size());
+
+    if (result == static_cast<std::int32_t>(frame.Size()))
+    {
+        outputs[0] = std::move(frame);
+    }
+
+    // nonblocking devices may have nothing yet
+    return result >= 0;
+}
+
+DeviceSinkStage::DeviceSinkStage(const std::string &name, audio_devices::AudioDevice &device, std::uint32_t duration_ms)
+    : Stage(name)
+    , m_device(device)
+{
+    addInput(port_format_t(device.GetParams().audio_format, duration_ms));
+}
+
+bool DeviceSinkStage::Process(FrameRef *inputs, FrameRef *outputs)
+{
+    return !inputs[0]
+            || m_device.Write(inputs[0].Data(), inputs[0].Size()) >= 0;
+}
+
+AecStage::AecStage(const std::string &name, AecController &controller, const audio_devices::audio_format_t &format)
+    : Stage(name)
+    , m_controller(controller)
+{
+    addInput(port_format_t(format));
+    addInput(port_format_t(format));
+    addOutput(port_format_t(format));
+}
+
+bool AecStage::Process(FrameRef *inputs, FrameRef *outputs)
+{
+    auto& far_frame = inputs[far_input];
+    auto& near_frame = inputs[near_input];
+
+    bool result = true;
+
+    if (far_frame)
+    {
+        result = m_controller.Playback(far_frame.Data(), far_frame.Size());
+    }
+
+    if (!near_frame)
+    {
+        return result;
+    }
+
+    if (near_frame.IsUnique())
+    {
+        result &= m_controller.Capture(near_frame.Data(), near_frame.Size());
+        outputs[0] = std::move(near_frame);
+    }
+    else
+    {
+        // the input is shared, only read by the controller
+        auto output_frame = AcquireFrame(0);
+
+        if (!output_frame)
+        {
+            return false;
+        }
+
+        result &= m_controller.Capture(near_frame.Data(), near_frame.Size(), output_frame.Data());
+        outputs[0] = std::move(output_frame);
+    }
+
+    return result;
+}
+
+FunctionStage::FunctionStage(const std::string &name, const std::vector<port_format_t> &inputs, const std::vector<port_format_t> &outputs, const process_t &process)
+    : Stage(name)
+    , m_process(process)
+{
+    for (const auto& format : inputs)
+    {
+        addInput(format);
+    }
+
+    for (const auto& format : outputs)
+    {
+        addOutput(format);
+    }
+}
+
+bool FunctionStage::Process(FrameRef *inputs, FrameRef *outputs)
+{
+    return m_process(*this, inputs, outputs);
+}
+
+StageGraph::StageGraph()
+    : m_prepared(false)
+    , m_running(false)
+{
+
+}
+
+StageGraph::~StageGraph()
+{
+    Stop();
+
+    // queued frames go back to the pools while the stages still exist
+    m_edges.clear();
+
+    for (auto& node : m_nodes)
+    {
+        node->inputs.clear();
+        node->outputs.clear();
+    }
+}
+
+Stage *StageGraph::AddStage(std::unique_ptr<Stage> stage, std::uint32_t worker)
+{
+    if (m_running || stage == nullptr)
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<node_t> node(new node_t());
+
+    node->stage = std::move(stage);
+    node->worker = worker;
+    node->input_edges.assign(node->stage->GetInputCount(), no_edge);
+    node->output_edges.resize(node->stage->GetOutputCount());
+    node->calls = 0;
+    node->errors = 0;
+    node->drops = 0;
+    node->total_time_ns = 0;
+    node->max_time_ns = 0;
+    node->last_time_ns = 0;
+
+    m_nodes.push_back(std::move(node));
+    m_prepared = false;
+
+    return m_nodes.back()->stage.get();
+}
+
+bool StageGraph::Connect(Stage *from, std::uint32_t output, Stage *to, std::uint32_t input, std::size_t queue_capacity)
+{
+    auto from_index = findNode(from);
+    auto to_index = findNode(to);
+
+    if (m_running || from_index == no_edge || to_index == no_edge)
+    {
+        return false;
+    }
+
+    auto& from_node = *m_nodes[from_index];
+    auto& to_node = *m_nodes[to_index];
+
+    if (output >= from->GetOutputCount()
+            || input >= to->GetInputCount()
+            || to_node.input_edges[input] != no_edge)
+    {
+        LOG(error) << "Can't connect " << from->GetName() << ":" << output << " to " << to->GetName() << ":" << input LOG_END;
+        return false;
+    }
+
+    if (!from->GetOutputFormat(output).is_compatible(to->GetInputFormat(input)))
+    {
+        LOG(error) << "Port format mismatch " << from->GetName() << ":" << output << " -> " << to->GetName() << ":" << input LOG_END;
+        return false;
+    }
+
+    if (queue_capacity == 0 && from_node.worker != to_node.worker)
+    {
+        LOG(error) << "Connection across workers needs a queue " << from->GetName() << " -> " << to->GetName() LOG_END;
+        return false;
+    }
+
+    edge_t edge;
+
+    edge.from = from_index;
+    edge.output = output;
+    edge.to = to_index;
+    edge.input = input;
+
+    if (queue_capacity > 0)
+    {
+        edge.queue.reset(new LockFreeQueue<FrameRef>(queue_capacity));
+    }
+
+    from_node.output_edges[output].push_back(m_edges.size());
+    to_node.input_edges[input] = m_edges.size();
+
+    m_edges.push_back(std::move(edge));
+    m_prepared = false;
+
+    return true;
+}
+
+bool StageGraph::Prepare()
+{
+    if (m_running)
+    {
+        return false;
+    }
+
+    m_prepared = false;
+
+    // dependency order, Kahn
+    std::vector<std::size_t> pending(m_nodes.size(), 0);
+    std::vector<std::size_t> order;
+
+    for (std::size_t n = 0; n < m_nodes.size(); n++)
+    {
+        for (std::size_t i = 0; i < m_nodes[n]->input_edges.size(); i++)
+        {
+            if (m_nodes[n]->input_edges[i] == no_edge)
+            {
+                LOG(error) << "Input " << i << " of " << m_nodes[n]->stage->GetName() << " is not connected" LOG_END;
+                return false;
+            }
+        }
+
+        pending[n] = m_nodes[n]->input_edges.size();
+
+        if (pending[n] == 0)
+        {
+            order.push_back(n);
+        }
+    }
+
+    for (std::size_t o = 0; o < order.size(); o++)
+    {
+        for (const auto& edges : m_nodes[order[o]]->output_edges)
+        {
+            for (auto e : edges)
+            {
+                if (--pending[m_edges[e].to] == 0)
+                {
+                    order.push_back(m_edges[e].to);
+                }
+            }
+        }
+    }
+
+    if (order.size() != m_nodes.size())
+    {
+        LOG(error) << "Stage graph has a cycle" LOG_END;
+        return false;
+    }
+
+    std::uint32_t worker_count = 1;
+
+    for (const auto& node : m_nodes)
+    {
+        worker_count = std::max(worker_count, node->worker + 1);
+    }
+
+    m_workers.clear();
+
+    for (std::uint32_t w = 0; w < worker_count; w++)
+    {
+        m_workers.emplace_back(new worker_t());
+    }
+
+    for (auto n : order)
+    {
+        m_workers[m_nodes[n]->worker]->order.push_back(n);
+    }
+
+    // frames are passed on as they are, so a frame of any pool may sit at
+    // every input and in every queue at once, plus the one being produced
+    std::size_t frame_count = 2;
+
+    for (const auto& edge : m_edges)
+    {
+        frame_count += 1 + (edge.queue != nullptr ? edge.queue->Capacity() : 0);
+    }
+
+    for (auto& node : m_nodes)
+    {
+        auto& stage = *node->stage;
+
+        node->inputs.assign(stage.GetInputCount(), FrameRef());
+        node->outputs.assign(stage.GetOutputCount(), FrameRef());
+
+        stage.m_pools.clear();
+
+        for (std::uint32_t o = 0; o < stage.GetOutputCount(); o++)
+        {
+            stage.m_pools.emplace_back(new FramePool(stage.GetOutputFormat(o).frame_size(), frame_count));
+        }
+    }
+
+    m_prepared = true;
+
+    return true;
+}
+
+bool StageGraph::Start()
+{
+    if (m_running || (!m_prepared && !Prepare()))
+    {
+        return false;
+    }
+
+    m_running = true;
+
+    for (std::uint32_t w = 1; w < m_workers.size(); w++)
+    {
+        m_workers[w]->thread = std::thread(&StageGraph::workerThread, this, w);
+    }
+
+    return true;
+}
+
+void StageGraph::Stop()
+{
+    m_running = false;
+
+    for (auto& worker : m_workers)
+    {
+        worker->signal.notify_all();
+
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+}
+
+bool StageGraph::RunOnce()
+{
+    if (!m_prepared && !Prepare())
+    {
+        return false;
+    }
+
+    return runWorker(0, false);
+}
+
+graph_stage_stats_t StageGraph::GetStageStats(const Stage *stage) const
+{
+    graph_stage_stats_t stats = {};
+
+    auto index = findNode(stage);
+
+    if (index != no_edge)
+    {
+        const auto& node = *m_nodes[index];
+
+        stats.calls = node.calls;
+        stats.errors = node.errors;
+        stats.drops = node.drops;
+        stats.total_time_ns = node.total_time_ns;
+        stats.max_time_ns = node.max_time_ns;
+        stats.last_time_ns = node.last_time_ns;
+    }
+
+    return stats;
+}
+
+void StageGraph::Report(std::ostream &stream) const
+{
+    auto flags = stream.flags();
+
+    stream << std::fixed << std::setprecision(1)
+           << std::left << std::setw(16) << "stage" << std::right
+           << std::setw(8) << "worker"
+           << std::setw(10) << "calls"
+           << std::setw(10) << "avg_us"
+           << std::setw(10) << "max_us"
+           << std::setw(10) << "errors"
+           << std::setw(10) << "drops"
+           << std::endl;
+
+    for (const auto& node : m_nodes)
+    {
+        auto stats = GetStageStats(node->stage.get());
+
+        stream << std::left << std::setw(16) << node->stage->GetName() << std::right
+               << std::setw(8) << node->worker
+               << std::setw(10) << stats.calls
+               << std::setw(10) << (stats.calls > 0 ? static_cast<double>(stats.total_time_ns) / stats.calls / 1000.0 : 0.0)
+               << std::setw(10) << static_cast<double>(stats.max_time_ns) / 1000.0
+               << std::setw(10) << stats.errors
+               << std::setw(10) << stats.drops
+               << std::endl;
+    }
+
+    stream.flags(flags);
+}
+
+std::size_t StageGraph::findNode(const Stage *stage) const
+{
+    for (std::size_t n = 0; n < m_nodes.size(); n++)
+    {
+        if (m_nodes[n]->stage.get() == stage)
+        {
+            return n;
+        }
+    }
+
+    return no_edge;
+}
+
+bool StageGraph::runWorker(std::uint32_t worker, bool wait)
+{
+    bool result = true;
+
+    for (auto n : m_workers[worker]->order)
+    {
+        result &= runStage(*m_nodes[n], wait);
+
+        if (wait && !m_running)
+        {
+            return false;
+        }
+    }
+
+    return result;
+}
+
+bool StageGraph::runStage(node_t &node, bool wait)
+{
+    for (std::size_t i = 0; i < node.inputs.size(); i++)
+    {
+        auto& edge = m_edges[node.input_edges[i]];
+
+        // direct inputs were set by the producer earlier in this tick
+        if (edge.queue == nullptr || edge.queue->Pop(node.inputs[i]) || !wait)
+        {
+            continue;
+        }
+
+        auto& worker = *m_workers[node.worker];
+
+        // producers signal without the lock, a lost wakeup costs a millisecond
+        while (!edge.queue->Pop(node.inputs[i]))
+        {
+            if (!m_running)
+            {
+                return false;
+            }
+
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.signal.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    auto result = node.stage->Process(node.inputs.data(), node.outputs.data());
+
+    std::uint64_t time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+    // a node is run by one thread, readers only load
+    node.calls.store(node.calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    node.total_time_ns.store(node.total_time_ns.load(std::memory_order_relaxed) + time_ns, std::memory_order_relaxed);
+    node.last_time_ns.store(time_ns, std::memory_order_relaxed);
+
+    if (time_ns > node.max_time_ns.load(std::memory_order_relaxed))
+    {
+        node.max_time_ns.store(time_ns, std::memory_order_relaxed);
+    }
+
+    if (!result)
+    {
+        node.errors.store(node.errors.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    for (std::size_t o = 0; o < node.outputs.size(); o++)
+    {
+        auto& frame = node.outputs[o];
+
+        if (!frame)
+        {
+            continue;
+        }
+
+        for (auto e : node.output_edges[o])
+        {
+            auto& edge = m_edges[e];
+
+            if (edge.queue == nullptr)
+            {
+                m_nodes[edge.to]->inputs[edge.input] = frame;
+            }
+            else if (edge.queue->Push(frame))
+            {
+                m_workers[m_nodes[edge.to]->worker]->signal.notify_one();
+            }
+            else
+            {
+                node.drops.store(node.drops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+        }
+
+        frame.Reset();
+    }
+
+    for (auto& frame : node.inputs)
+    {
+        frame.Reset();
+    }
+
+    return result;
+}
+
+void StageGraph::workerThread(std::uint32_t worker)
+{
+    while (m_running)
+    {
+        runWorker(worker, true);
+    }
+}
+
+}
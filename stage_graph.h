@@ -0,0 +1,233 @@
+#ifndef STAGE_GRAPH_H
+#define STAGE_GRAPH_H
+
+#include "frame_pool.h"
+#include "audio_device.h"
+#include "lockfree_queue.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <ostream>
+#include <cstdint>
+
+namespace audio_processing
+{
+
+class AecController;
+
+// frames passed through a port
+struct port_format_t
+{
+    audio_devices::audio_format_t   audio_format;
+    std::uint32_t                   duration_ms;
+
+    port_format_t(const audio_devices::audio_format_t& format = audio_devices::null_audio_format, std::uint32_t duration = 10)
+        : audio_format(format)
+        , duration_ms(duration)
+    {}
+
+    inline std::size_t frame_size() const { return audio_format.octets_count(duration_ms); }
+
+    inline bool is_compatible(const port_format_t& other) const
+    {
+        return audio_format.sample_rate == other.audio_format.sample_rate
+                && audio_format.channels == other.audio_format.channels
+                && audio_format.format() == other.audio_format.format()
+                && duration_ms == other.duration_ms;
+    }
+};
+
+struct graph_stage_stats_t
+{
+    std::uint64_t   calls;
+    std::uint64_t   errors;         // Process returned false
+    std::uint64_t   drops;          // frames a full queue refused
+    std::uint64_t   total_time_ns;
+    std::uint64_t   max_time_ns;
+    std::uint64_t   last_time_ns;
+};
+
+// Unit of the graph: takes one frame per input port and produces one frame
+// per output port on every tick. Sources have no inputs, sinks no outputs.
+class Stage
+{
+    friend class StageGraph;
+
+    std::string                                         m_name;
+    std::vector<port_format_t>                          m_inputs;
+    std::vector<port_format_t>                          m_outputs;
+    // one per output, created by the graph
+    std::vector<std::unique_ptr<FramePool>>             m_pools;
+
+public:
+    explicit Stage(const std::string& name) : m_name(name) {}
+    virtual ~Stage() {}
+
+    Stage(const Stage&) = delete;
+    Stage& operator=(const Stage&) = delete;
+
+    // inputs[i] is the frame of input port i, empty if the producer had
+    // none this tick; outputs are empty on entry, may be left empty
+    virtual bool Process(FrameRef* inputs, FrameRef* outputs) = 0;
+
+    // frame of the output port format, empty when the pool is exhausted
+    FrameRef AcquireFrame(std::uint32_t output);
+
+    inline const std::string& GetName() const { return m_name; }
+    inline std::uint32_t GetInputCount() const { return m_inputs.size(); }
+    inline std::uint32_t GetOutputCount() const { return m_outputs.size(); }
+    inline const port_format_t& GetInputFormat(std::uint32_t input) const { return m_inputs[input]; }
+    inline const port_format_t& GetOutputFormat(std::uint32_t output) const { return m_outputs[output]; }
+
+protected:
+    // ports are declared by the constructors, returns the port index
+    std::uint32_t addInput(const port_format_t& format);
+    std::uint32_t addOutput(const port_format_t& format);
+};
+
+// output 0: frames read from a recorder, nothing on a short read
+class DeviceSourceStage : public Stage
+{
+    audio_devices::AudioDevice&                         m_device;
+
+public:
+    DeviceSourceStage(const std::string& name, audio_devices::AudioDevice& device, std::uint32_t duration_ms = 10);
+
+    bool Process(FrameRef* inputs, FrameRef* outputs) override;
+};
+
+// input 0: frames written to a player
+class DeviceSinkStage : public Stage
+{
+    audio_devices::AudioDevice&                         m_device;
+
+public:
+    DeviceSinkStage(const std::string& name, audio_devices::AudioDevice& device, std::uint32_t duration_ms = 10);
+
+    bool Process(FrameRef* inputs, FrameRef* outputs) override;
+};
+
+// input 0: far end, input 1: near end, output 0: processed near end;
+// a near frame nobody else holds is processed in place
+class AecStage : public Stage
+{
+public:
+    enum { far_input = 0, near_input = 1 };
+
+private:
+    AecController&                                      m_controller;
+
+public:
+    AecStage(const std::string& name, AecController& controller, const audio_devices::audio_format_t& format);
+
+    bool Process(FrameRef* inputs, FrameRef* outputs) override;
+};
+
+// stage made of a function, for taps and one-off steps
+class FunctionStage : public Stage
+{
+public:
+    using process_t = std::function<bool(Stage& stage, FrameRef* inputs, FrameRef* outputs)>;
+
+private:
+    process_t                                           m_process;
+
+public:
+    FunctionStage(const std::string& name, const std::vector<port_format_t>& inputs, const std::vector<port_format_t>& outputs, const process_t& process);
+
+    bool Process(FrameRef* inputs, FrameRef* outputs) override;
+};
+
+// Runs connected stages once per tick in dependency order. Stages of
+// worker 0 run in RunOnce on the caller thread, every other worker has its
+// own thread started by Start. Direct connections stay within a worker;
+// connections with a queue capacity pass frames through a bounded
+// lock-free queue and may cross workers. Worker threads wait for their
+// queued inputs, worker 0 never waits: a missing frame is an empty input.
+// Frames are handed over by reference, a full queue drops the frame.
+class StageGraph
+{
+    struct edge_t
+    {
+        std::size_t                                     from;
+        std::uint32_t                                   output;
+        std::size_t                                     to;
+        std::uint32_t                                   input;
+        std::unique_ptr<LockFreeQueue<FrameRef>>        queue;
+    };
+
+    struct node_t
+    {
+        std::unique_ptr<Stage>                          stage;
+        std::uint32_t                                   worker;
+        std::vector<FrameRef>                           inputs;
+        std::vector<FrameRef>                           outputs;
+        std::vector<std::size_t>                        input_edges;    // per input, edge index
+        std::vector<std::vector<std::size_t>>           output_edges;   // per output
+
+        std::atomic<std::uint64_t>                      calls;
+        std::atomic<std::uint64_t>                      errors;
+        std::atomic<std::uint64_t>                      drops;
+        std::atomic<std::uint64_t>                      total_time_ns;
+        std::atomic<std::uint64_t>                      max_time_ns;
+        std::atomic<std::uint64_t>                      last_time_ns;
+    };
+
+    struct worker_t
+    {
+        std::vector<std::size_t>                        order;
+        std::thread                                     thread;
+        std::mutex                                      mutex;
+        std::condition_variable                         signal;
+    };
+
+    std::vector<std::unique_ptr<node_t>>                m_nodes;
+    std::vector<edge_t>                                 m_edges;
+    std::vector<std::unique_ptr<worker_t>>              m_workers;
+    bool                                                m_prepared;
+    std::atomic<bool>                                   m_running;
+
+public:
+    StageGraph();
+    ~StageGraph();
+
+    StageGraph(const StageGraph&) = delete;
+    StageGraph& operator=(const StageGraph&) = delete;
+
+    // the graph owns the stage, the pointer identifies it in Connect
+    Stage* AddStage(std::unique_ptr<Stage> stage, std::uint32_t worker = 0);
+
+    // an output may feed several inputs, an input takes one output;
+    // queue_capacity 0 - direct connection
+    bool Connect(Stage* from, std::uint32_t output, Stage* to, std::uint32_t input, std::size_t queue_capacity = 0);
+
+    // checks the connections, orders stages and allocates the frames
+    bool Prepare();
+
+    bool Start();
+    void Stop();
+    inline bool IsRunning() const { return m_running; }
+
+    // one tick of worker 0, false if any stage failed
+    bool RunOnce();
+
+    // thread safe
+    graph_stage_stats_t GetStageStats(const Stage* stage) const;
+    void Report(std::ostream& stream) const;
+
+private:
+    std::size_t findNode(const Stage* stage) const;
+    bool runWorker(std::uint32_t worker, bool wait);
+    bool runStage(node_t& node, bool wait);
+    void workerThread(std::uint32_t worker);
+};
+
+}
+
+#endif // STAGE_GRAPH_H
@@ -0,0 +1,362 @@
+#include "stats_server.h"
+#include "aec_controller.h"
+#include "deadline_monitor.h"
+#include "delay_estimator.h"
+#include "frame_pool.h"
+#include "failover_device.h"
+#include "duplex_device.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+
+#ifndef LOG_END
+
+#include <iostream>
+
+#define LOG(a)	std::cout << "[" << #a << "] "
+#define LOG_END << std::endl;
+
+#endif
+
+namespace audio_processing
+{
+
+const int stats_poll_timeout_ms = 200;
+const std::size_t stats_request_max_size = 4096;
+
+static void write_metric(std::ostream& stream, const char* name, const std::string& labels, double value)
+{
+    stream << "aec_" << name;
+
+    if (!labels.empty())
+    {
+        stream << "{" << labels << "}";
+    }
+
+    stream << " " << value << "\n";
+}
+
+static void write_statistic(std::ostream& stream, const char* name, const std::string& labels, const aec_statistic_t& statistic)
+{
+    std::string separator = labels.empty() ? "" : ",";
+
+    write_metric(stream, name, labels + separator + "stat=\"instant\"", statistic.instant);
+    write_metric(stream, name, labels + separator + "stat=\"average\"", statistic.average);
+    write_metric(stream, name, labels + separator + "stat=\"maximum\"", statistic.maximum);
+    write_metric(stream, name, labels + separator + "stat=\"minimum\"", statistic.minimum);
+}
+
+void write_prometheus_metrics(std::ostream &stream, const aec_metrics_t &metrics, const std::string &labels)
+{
+    if (metrics.echo_metrics_valid)
+    {
+        write_statistic(stream, "echo_return_loss_db", labels, metrics.echo_return_loss);
+        write_statistic(stream, "echo_return_loss_enhancement_db", labels, metrics.echo_return_loss_enhancement);
+        write_statistic(stream, "residual_echo_return_loss_db", labels, metrics.residual_echo_return_loss);
+        write_statistic(stream, "a_nlp_db", labels, metrics.a_nlp);
+    }
+
+    write_metric(stream, "stream_has_echo", labels, metrics.stream_has_echo);
+
+    if (metrics.delay_metrics_valid)
+    {
+        write_metric(stream, "delay_median_ms", labels, metrics.delay_median_ms);
+        write_metric(stream, "delay_std_ms", labels, metrics.delay_std_ms);
+        write_metric(stream, "delay_poor_fraction", labels, metrics.fraction_poor_delays);
+    }
+
+    write_metric(stream, "speech_probability", labels, metrics.speech_probability);
+    write_metric(stream, "stream_has_voice", labels, metrics.stream_has_voice);
+    write_metric(stream, "rms_level_dbfs", labels, metrics.rms_level_dbfs);
+    write_metric(stream, "agc_analog_level", labels, metrics.agc_analog_level);
+    write_metric(stream, "agc_saturated", labels, metrics.agc_saturated);
+
+    write_metric(stream, "playback_frames_total", labels, metrics.playback_frames);
+    write_metric(stream, "capture_frames_total", labels, metrics.capture_frames);
+    write_metric(stream, "playback_errors_total", labels, metrics.playback_errors);
+    write_metric(stream, "capture_errors_total", labels, metrics.capture_errors);
+    write_metric(stream, "process_time_us_total", labels, metrics.process_time_us);
+    write_metric(stream, "gate_skipped_playback_frames_total", labels, metrics.gate_stats.skipped_playback_frames);
+    write_metric(stream, "gate_reduced_capture_frames_total", labels, metrics.gate_stats.reduced_capture_frames);
+    write_metric(stream, "metrics_samples_total", labels, metrics.sample_count);
+}
+
+void write_prometheus_memory(std::ostream &stream, const aec_memory_stats_t &stats, const std::string &labels)
+{
+    // heap series only when the allocations are tracked
+    if (stats.heap.tracked)
+    {
+        write_metric(stream, "memory_heap_bytes", labels, stats.heap.bytes);
+        write_metric(stream, "memory_heap_peak_bytes", labels, stats.heap.peak_bytes);
+        write_metric(stream, "memory_heap_blocks", labels, stats.heap.blocks);
+        write_metric(stream, "memory_allocations_total", labels, stats.heap.allocations);
+        write_metric(stream, "memory_malloc_bytes", labels, stats.heap.malloc_bytes);
+    }
+
+    write_metric(stream, "memory_frame_bytes", labels, stats.frame_bytes);
+}
+
+void write_prometheus_deadline(std::ostream &stream, const deadline_stats_t &stats, const std::string &labels)
+{
+    write_metric(stream, "deadline_frames_total", labels, stats.frames);
+    write_metric(stream, "deadline_misses_total", labels, stats.misses);
+    write_metric(stream, "deadline_degrades_total", labels, stats.degrades);
+    write_metric(stream, "deadline_restores_total", labels, stats.restores);
+    write_metric(stream, "deadline_reinitializations_total", labels, stats.reinitializations);
+    write_metric(stream, "deadline_level", labels, stats.level);
+    write_metric(stream, "deadline_max_processing_us", labels, stats.max_processing_us);
+}
+
+void write_prometheus_delay_search(std::ostream &stream, const delay_search_stats_t &stats, const std::string &labels)
+{
+    write_metric(stream, "delay_searches_total", labels, stats.searches);
+    write_metric(stream, "delay_confident_searches_total", labels, stats.confident);
+    write_metric(stream, "delay_published_total", labels, stats.published);
+    write_metric(stream, "delay_stream_delay_ms", labels, stats.delay_ms);
+    write_metric(stream, "delay_last_estimate_ms", labels, stats.last_estimate_ms);
+    write_metric(stream, "delay_last_peak_ratio", labels, stats.last_peak_ratio);
+    write_metric(stream, "delay_last_search_us", labels, stats.last_search_us);
+}
+
+void write_prometheus_failover(std::ostream &stream, const audio_devices::failover_stats_t &stats, const std::string &labels)
+{
+    write_metric(stream, "device_failures_total", labels, stats.failures);
+    write_metric(stream, "device_recoveries_total", labels, stats.recoveries);
+    write_metric(stream, "device_concealed_calls_total", labels, stats.concealed_calls);
+    write_metric(stream, "device_last_outage_ms", labels, stats.last_outage_ms);
+    write_metric(stream, "device_active_index", labels, stats.active_device);
+    write_metric(stream, "device_healthy", labels, stats.healthy);
+}
+
+void write_prometheus_duplex(std::ostream &stream, const audio_devices::duplex_stats_t &stats, const std::string &labels)
+{
+    write_metric(stream, "duplex_linked", labels, stats.linked);
+    write_metric(stream, "duplex_started", labels, stats.started);
+    write_metric(stream, "duplex_start_skew_us", labels, stats.skew_us);
+    write_metric(stream, "duplex_corrected_frames", labels, stats.corrected_frames);
+    write_metric(stream, "duplex_residual_skew_frames", labels, stats.residual_frames);
+    write_metric(stream, "duplex_round_trip_frames", labels, stats.round_trip_frames);
+}
+
+void write_prometheus_frame_pools(std::ostream &stream, const std::vector<frame_pool_stats_t> &pools, const std::string &labels)
+{
+    std::string separator = labels.empty() ? "" : ",";
+
+    for (const auto& pool : pools)
+    {
+        auto pool_labels = labels + separator + "block_size=\"" + std::to_string(pool.block_size) + "\"";
+
+        write_metric(stream, "frame_pool_blocks", pool_labels, pool.block_count);
+        write_metric(stream, "frame_pool_outstanding", pool_labels, pool.outstanding);
+        write_metric(stream, "frame_pool_high_water", pool_labels, pool.high_water);
+        write_metric(stream, "frame_pool_failures_total", pool_labels, pool.failures);
+        write_metric(stream, "frame_pool_huge_pages", pool_labels, pool.huge_pages);
+    }
+}
+
+StatsServer::StatsServer()
+    : m_running(false)
+    , m_listen_fd(-1)
+{
+
+}
+
+StatsServer::~StatsServer()
+{
+    Stop();
+}
+
+bool StatsServer::Start(const std::string &address)
+{
+    Stop();
+
+    static const std::string unix_prefix = "unix:";
+
+    if (address.compare(0, unix_prefix.size(), unix_prefix) == 0)
+    {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+
+        m_unix_path = address.substr(unix_prefix.size());
+        std::strncpy(addr.sun_path, m_unix_path.c_str(), sizeof(addr.sun_path) - 1);
+
+        unlink(m_unix_path.c_str());
+
+        m_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (m_listen_fd >= 0 && bind(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            close(m_listen_fd);
+            m_listen_fd = -1;
+        }
+    }
+    else
+    {
+        auto port = std::strtol(address.c_str(), nullptr, 10);
+
+        if (port <= 0 || port > 65535)
+        {
+            LOG(error) << "Can't start stats server: bad address [" << address << "]" LOG_END;
+            return false;
+        }
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(static_cast<std::uint16_t>(port));
+
+        m_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        int reuse = 1;
+        setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if (m_listen_fd >= 0 && bind(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            close(m_listen_fd);
+            m_listen_fd = -1;
+        }
+    }
+
+    if (m_listen_fd < 0 || listen(m_listen_fd, 8) < 0)
+    {
+        LOG(error) << "Can't start stats server on [" << address << "], errno = " << errno LOG_END;
+        Stop();
+        return false;
+    }
+
+    m_running = true;
+    m_thread = std::thread(&StatsServer::serverProc, this);
+
+    LOG(info) << "Stats server started on [" << address << "]" LOG_END;
+
+    return true;
+}
+
+bool StatsServer::Stop()
+{
+    bool result = m_running;
+
+    m_running = false;
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    if (m_listen_fd >= 0)
+    {
+        close(m_listen_fd);
+        m_listen_fd = -1;
+    }
+
+    if (!m_unix_path.empty())
+    {
+        unlink(m_unix_path.c_str());
+        m_unix_path.clear();
+    }
+
+    return result;
+}
+
+void StatsServer::AddSource(const stats_source_t &source)
+{
+    std::lock_guard<std::mutex> lock(m_sources_mutex);
+
+    m_sources.push_back(source);
+}
+
+std::string StatsServer::Collect()
+{
+    std::ostringstream stream;
+
+    std::lock_guard<std::mutex> lock(m_sources_mutex);
+
+    for (const auto& source : m_sources)
+    {
+        source(stream);
+    }
+
+    return stream.str();
+}
+
+void StatsServer::serverProc()
+{
+    while (m_running)
+    {
+        pollfd pfd = { m_listen_fd, POLLIN, 0 };
+
+        if (poll(&pfd, 1, stats_poll_timeout_ms) > 0 && (pfd.revents & POLLIN) != 0)
+        {
+            auto client_fd = accept(m_listen_fd, nullptr, nullptr);
+
+            if (client_fd >= 0)
+            {
+                handleClient(client_fd);
+                close(client_fd);
+            }
+        }
+    }
+}
+
+void StatsServer::handleClient(int client_fd)
+{
+    // one request per connection, any path returns the metrics
+    std::string request;
+    char buffer[512];
+
+    while (request.find("\r\n\r\n") == std::string::npos
+           && request.size() < stats_request_max_size)
+    {
+        pollfd pfd = { client_fd, POLLIN, 0 };
+
+        if (poll(&pfd, 1, stats_poll_timeout_ms) <= 0)
+        {
+            break;
+        }
+
+        auto count = recv(client_fd, buffer, sizeof(buffer), 0);
+
+        if (count <= 0)
+        {
+            break;
+        }
+
+        request.append(buffer, count);
+    }
+
+    auto body = Collect();
+
+    std::ostringstream response;
+
+    response << "HTTP/1.0 200 OK\r\n"
+             << "Content-Type: text/plain; version=0.0.4\r\n"
+             << "Content-Length: " << body.size() << "\r\n"
+             << "Connection: close\r\n\r\n"
+             << body;
+
+    auto data = response.str();
+    std::size_t sent = 0;
+
+    while (sent < data.size())
+    {
+        auto count = send(client_fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+
+        if (count <= 0)
+        {
+            break;
+        }
+
+        sent += count;
+    }
+}
+
+}
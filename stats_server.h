@@ -0,0 +1,80 @@
+#ifndef STATS_SERVER_H
+#define STATS_SERVER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+
+namespace audio_devices
+{
+
+struct failover_stats_t;
+struct duplex_stats_t;
+
+}
+
+namespace audio_processing
+{
+
+struct aec_metrics_t;
+struct aec_memory_stats_t;
+struct deadline_stats_t;
+struct delay_search_stats_t;
+struct frame_pool_stats_t;
+
+// Prometheus text exposition of the controller metrics, labels as 'session="1"'
+void write_prometheus_metrics(std::ostream& stream, const aec_metrics_t& metrics, const std::string& labels = "");
+void write_prometheus_memory(std::ostream& stream, const aec_memory_stats_t& stats, const std::string& labels = "");
+void write_prometheus_deadline(std::ostream& stream, const deadline_stats_t& stats, const std::string& labels = "");
+void write_prometheus_delay_search(std::ostream& stream, const delay_search_stats_t& stats, const std::string& labels = "");
+void write_prometheus_failover(std::ostream& stream, const audio_devices::failover_stats_t& stats, const std::string& labels = "");
+void write_prometheus_duplex(std::ostream& stream, const audio_devices::duplex_stats_t& stats, const std::string& labels = "");
+// one series per pool, labeled with its block_size
+void write_prometheus_frame_pools(std::ostream& stream, const std::vector<frame_pool_stats_t>& pools, const std::string& labels = "");
+
+// Serves metrics over HTTP from its own thread, never calls into the
+// audio thread: sources must return already sampled data
+class StatsServer
+{
+public:
+
+    using stats_source_t = std::function<void(std::ostream&)>;
+
+private:
+
+    std::vector<stats_source_t>         m_sources;
+    std::mutex                          m_sources_mutex;
+
+    std::thread                         m_thread;
+    std::atomic<bool>                   m_running;
+    int                                 m_listen_fd;
+    std::string                         m_unix_path;
+
+public:
+
+    StatsServer();
+    ~StatsServer();
+
+    // address: "port" (bound to 127.0.0.1) or "unix:/path/to/socket"
+    bool Start(const std::string& address);
+    bool Stop();
+
+    inline bool IsRunning() const { return m_running; }
+
+    void AddSource(const stats_source_t& source);
+
+    std::string Collect();
+
+private:
+
+    void serverProc();
+    void handleClient(int client_fd);
+};
+
+}
+
+#endif // STATS_SERVER_H
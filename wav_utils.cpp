@@ -0,0 +1,131 @@
+#include "wav_utils.h"
+
+#include <cstring>
+
+namespace audio_devices
+{
+
+namespace wav_utils
+{
+
+const std::uint16_t wav_format_pcm = 1;
+const std::uint16_t wav_format_float = 3;
+const std::uint16_t wav_format_extensible = 0xfffe;
+
+static inline std::uint32_t get_le(const std::uint8_t* data, std::size_t bytes)
+{
+    std::uint32_t result = 0;
+
+    for (std::size_t i = 0; i < bytes; i++)
+    {
+        result |= static_cast<std::uint32_t>(data[i]) << (i * 8);
+    }
+
+    return result;
+}
+
+static inline void set_le(std::uint8_t* data, std::uint32_t value, std::size_t bytes)
+{
+    for (std::size_t i = 0; i < bytes; i++)
+    {
+        data[i] = static_cast<std::uint8_t>(value >> (i * 8));
+    }
+}
+
+bool parse_header(const void *data, std::size_t size, audio_format_t &audio_format, std::size_t &data_offset, std::size_t &data_size)
+{
+    auto ptr = static_cast<const std::uint8_t*>(data);
+
+    if (size < 12
+            || std::memcmp(ptr, "RIFF", 4) != 0
+            || std::memcmp(ptr + 8, "WAVE", 4) != 0)
+    {
+        return false;
+    }
+
+    bool has_format = false;
+    std::size_t offset = 12;
+
+    while (offset + 8 <= size)
+    {
+        auto chunk_id = ptr + offset;
+        std::size_t chunk_size = get_le(ptr + offset + 4, 4);
+
+        offset += 8;
+
+        if (std::memcmp(chunk_id, "fmt ", 4) == 0)
+        {
+            if (chunk_size < 16 || offset + 16 > size)
+            {
+                return false;
+            }
+
+            auto format_tag = get_le(ptr + offset, 2);
+
+            // extensible: sub format GUID starts with the format tag
+            if (format_tag == wav_format_extensible)
+            {
+                format_tag = chunk_size >= 40 && offset + 26 <= size
+                        ? get_le(ptr + offset + 24, 2)
+                        : wav_format_pcm;
+            }
+
+            if (format_tag != wav_format_pcm && format_tag != wav_format_float)
+            {
+                return false;
+            }
+
+            audio_format.channels = get_le(ptr + offset + 2, 2);
+            audio_format.sample_rate = get_le(ptr + offset + 4, 4);
+            audio_format.bit_per_sample = get_le(ptr + offset + 14, 2);
+            audio_format.sample_format = format_tag == wav_format_float
+                    ? (audio_format.bit_per_sample == 32 ? sample_format_t::float_le : sample_format_t::unknown)
+                    : default_sample_format(audio_format.bit_per_sample);
+
+            if (audio_format.sample_format == sample_format_t::unknown)
+            {
+                return false;
+            }
+
+            has_format = true;
+        }
+        else if (std::memcmp(chunk_id, "data", 4) == 0)
+        {
+            // zero size (unfinished recording) means up to the end of data,
+            // caller should clamp it to the real size of the source
+            data_offset = offset;
+            data_size = chunk_size;
+
+            return has_format;
+        }
+
+        offset += chunk_size + (chunk_size & 1);
+    }
+
+    return false;
+}
+
+void make_header(const audio_format_t &audio_format, std::uint32_t data_size, void *header)
+{
+    auto ptr = static_cast<std::uint8_t*>(header);
+
+    std::memcpy(ptr, "RIFF", 4);
+    set_le(ptr + 4, data_size + wav_header_size - 8, 4);
+    std::memcpy(ptr + 8, "WAVE", 4);
+
+    std::memcpy(ptr + 12, "fmt ", 4);
+    set_le(ptr + 16, 16, 4);
+    set_le(ptr + 20, audio_format.format() == sample_format_t::float_le ? wav_format_float : wav_format_pcm, 2);
+    set_le(ptr + 22, audio_format.channels, 2);
+    set_le(ptr + 24, audio_format.sample_rate, 4);
+    set_le(ptr + 28, audio_format.bytes_per_second(), 4);
+    set_le(ptr + 32, audio_format.frames_octets(), 2);
+    set_le(ptr + 34, audio_format.bit_per_sample, 2);
+
+    std::memcpy(ptr + 36, "data", 4);
+    set_le(ptr + 40, data_size, 4);
+}
+
+}
+
+}
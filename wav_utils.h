@@ -0,0 +1,22 @@
+#ifndef WAV_UTILS_H
+#define WAV_UTILS_H
+
+#include "audio_device.h"
+
+namespace audio_devices
+{
+
+namespace wav_utils
+{
+
+const std::size_t wav_header_size = 44;
+
+// data_size is taken from the data chunk as is and may exceed the source size
+bool parse_header(const void* data, std::size_t size, audio_format_t& audio_format, std::size_t& data_offset, std::size_t& data_size);
+void make_header(const audio_format_t& audio_format, std::uint32_t data_size, void* header);
+
+}
+
+}
+
+#endif // WAV_UTILS_H